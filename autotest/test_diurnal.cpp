@@ -0,0 +1,190 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Test the diurnal wind grids against the serial cell loop
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <cmath>
+
+#include "cellDiurnal.h"
+
+#include <boost/date_time/local_time/local_time.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "DIURNAL" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       diurnal/parallel_grids
+******************************************************************************/
+
+/*
+** Number of cells where two grids differ at all.
+*/
+static int CountDifferent( const AsciiGrid<double> &a, const AsciiGrid<double> &b )
+{
+    int nDifferent = 0;
+    for( int i = 0; i < a.get_nRows(); i++ )
+        for( int j = 0; j < a.get_nCols(); j++ )
+            if( !( a( i, j ) == b( i, j ) ) )
+                nDifferent++;
+    return nDifferent;
+}
+
+BOOST_AUTO_TEST_SUITE( diurnal )
+
+/**
+* cellDiurnal::compute_diurnal_wind_grids() must give the same grids as
+* computing the cells one after another with one cellDiurnal, as
+* initialize::addDiurnal() used to, for any number of threads.  The DEM is a
+* ridge and a hill on a tilted plain in the late afternoon, so it has sunny
+* upslope cells, shaded downslope cells and flat cells without diurnal flow
+* at the start of the rows, which follow a different cell depending on how
+* the rows are split between the threads.
+*/
+BOOST_AUTO_TEST_CASE( parallel_grids )
+{
+    const int nRows = 40, nCols = 30;
+    const double cellSize = 30.0;
+
+    Elevation elev;
+    elev.set_headerData( nCols, nRows, 0.0, 0.0, cellSize, -9999.0, 0.0 );
+    for( int i = 0; i < nRows; i++ )
+        for( int j = 0; j < nCols; j++ )
+            elev( i, j ) = 1500.0 + 3.0 * j + 120.0 * std::exp( -std::pow( ( j - 10 ) / 4.0, 2 ) ) +
+                           80.0 * std::exp( -( std::pow( i - 28.0, 2 ) + std::pow( j - 22.0, 2 ) ) / 20.0 );
+    //a flat corner at the start of the rows
+    for( int i = 0; i < 6; i++ )
+        for( int j = 0; j < 6; j++ )
+            elev( i, j ) = 1500.0;
+
+    boost::local_time::time_zone_ptr timeZone( new boost::local_time::posix_time_zone( "MST-07" ) );
+    boost::local_time::local_date_time time( boost::gregorian::date( 2014, 7, 15 ),
+                                             boost::posix_time::hours( 17 ), timeZone,
+                                             boost::local_time::local_date_time::NOT_DATE_TIME_ON_ERROR );
+    Solar solar( time, 45.0, -113.0, 0.0, 0.0 );
+    Aspect aspect( &elev, 1 );
+    Slope slope( &elev, 1 );
+    Shade shade( &elev, solar.get_theta(), solar.get_phi(), 1 );
+
+    surfProperties surface;
+    surface.Roughness.set_headerData( elev );
+    surface.Roughness = 0.01;
+    surface.Rough_d.set_headerData( elev );
+    surface.Rough_d = 0.0;
+    surface.Rough_h.set_headerData( elev );
+    surface.Rough_h = 0.0;
+    surface.Albedo.set_headerData( elev );
+    surface.Albedo = 0.25;
+    surface.Bowen.set_headerData( elev );
+    surface.Bowen = 1.0;
+    surface.Cg.set_headerData( elev );
+    surface.Cg = 0.15;
+    surface.Anthropogenic.set_headerData( elev );
+    surface.Anthropogenic = 0.0;
+    surface.Z = 10.0;
+
+    AsciiGrid<double> cloudCover( elev ), airTemp( elev ), windSpeed( elev );
+    cloudCover = 0.2;
+    airTemp = 300.0;
+    for( int i = 0; i < nRows; i++ )
+        for( int j = 0; j < nCols; j++ )
+            windSpeed( i, j ) = 1.0 + 0.1 * j;
+
+    //the serial loop of initialize::addDiurnal() before the grids were computed in parallel
+    AsciiGrid<double> refGrids[7];
+    for( int g = 0; g < 7; g++ )
+        refGrids[g].set_headerData( elev );
+    cellDiurnal serial( &elev, &shade, &solar, 0.0001, 0.01, 0.2, 0.2 );
+    for( int i = 0; i < nRows; i++ )
+    {
+        for( int j = 0; j < nCols; j++ )
+        {
+            double Xord, Yord;
+            elev.get_cellPosition( i, j, &Xord, &Yord );
+            serial.initialize( Xord, Yord, aspect( i, j ), slope( i, j ),
+                               cloudCover( i, j ), airTemp( i, j ), windSpeed( i, j ), surface.Z,
+                               surface.Albedo( i, j ), surface.Bowen( i, j ),
+                               surface.Cg( i, j ), surface.Anthropogenic( i, j ),
+                               surface.Roughness( i, j ), surface.Rough_h( i, j ),
+                               surface.Rough_d( i, j ) );
+            serial.compute_cell_diurnal_wind( i, j, &refGrids[0]( i, j ), &refGrids[1]( i, j ),
+                                              &refGrids[2]( i, j ), &refGrids[3]( i, j ),
+                                              &refGrids[4]( i, j ), &refGrids[5]( i, j ),
+                                              &refGrids[6]( i, j ) );
+        }
+    }
+
+    int nUpslope = 0, nDownslope = 0;
+    for( int i = 0; i < nRows; i++ )
+    {
+        for( int j = 0; j < nCols; j++ )
+        {
+            if( refGrids[2]( i, j ) > 0.0 )
+                nUpslope++;
+            else if( refGrids[2]( i, j ) < 0.0 )
+                nDownslope++;
+        }
+    }
+    BOOST_REQUIRE( nUpslope > 0 );
+    BOOST_REQUIRE( nDownslope > 0 );
+
+    const char *names[] = { "U", "V", "W", "height", "L", "U_star", "BL_height" };
+#ifdef _OPENMP
+    int nMaxThreads = omp_get_max_threads();
+#endif
+    int threads[] = { 1, 2, 3, 8 };
+    for( int t = 0; t < 4; t++ )
+    {
+#ifdef _OPENMP
+        omp_set_num_threads( threads[t] );
+#endif
+        AsciiGrid<double> grids[7];
+        for( int g = 0; g < 7; g++ )
+            grids[g].set_headerData( elev );
+        cellDiurnal cells( &elev, &shade, &solar, 0.0001, 0.01, 0.2, 0.2 );
+        cells.compute_diurnal_wind_grids( aspect, slope, cloudCover, airTemp, windSpeed, surface,
+                                          grids[0], grids[1], grids[2], grids[3],
+                                          grids[4], grids[5], grids[6] );
+        for( int g = 0; g < 7; g++ )
+        {
+            BOOST_TEST_MESSAGE( names[g] << " with " << threads[t] << " threads" );
+            BOOST_CHECK_EQUAL( CountDifferent( grids[g], refGrids[g] ), 0 );
+        }
+    }
+#ifdef _OPENMP
+    omp_set_num_threads( nMaxThreads );
+#endif
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/******************************************************************************
+*                        END "DIURNAL" BOOST TEST SUITE
+*****************************************************************************/
@@ -0,0 +1,199 @@
+/******************************************************************************
+ *
+ * $Id$ 
+ *
+ * Project:  WindNinja
+ * Purpose:  Test the domain cache file
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+ 
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include "domainContext.h"
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "DOMAIN_CACHE" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       domain_cache/round_trip
+*       domain_cache/invalid_file
+******************************************************************************/
+
+/*
+** Fill a context as buildDomainContext() would, with a tilted 4 x 3 x 3 mesh
+** and a matrix holding the diagonal and the next node of each row.
+*/
+static void BuildTestContext( DomainContext &context )
+{
+    const int nrows = 4, ncols = 3, nlayers = 3;
+
+    context.dem.set_headerData( ncols, nrows, 1000.0, 2000.0, 100.0, -9999.0, 0.0 );
+    for( int i = 0; i < nrows; i++ )
+        for( int j = 0; j < ncols; j++ )
+            context.dem( i, j ) = 1500.0 + 10.0 * i + 3.0 * j;
+    context.surface.Roughness.set_headerData( context.dem );
+    context.surface.Roughness = 0.1;
+    context.surface.Rough_d.set_headerData( context.dem );
+    context.surface.Rough_d = 0.0;
+    context.surface.Rough_h.set_headerData( context.dem );
+    context.surface.Rough_h = 1.0;
+    context.surface.Albedo.set_headerData( context.dem );
+    context.surface.Albedo = 0.25;
+    context.surface.Bowen.set_headerData( context.dem );
+    context.surface.Bowen = 1.0;
+    context.surface.Cg.set_headerData( context.dem );
+    context.surface.Cg = 0.15;
+    context.surface.Anthropogenic.set_headerData( context.dem );
+    context.surface.Anthropogenic = 0.0;
+
+    Mesh &mesh = context.mesh;
+    mesh.nrows = nrows;
+    mesh.ncols = ncols;
+    mesh.nlayers = nlayers;
+    mesh.numVertLayers = nlayers;
+    mesh.nrowsElem = nrows - 1;
+    mesh.ncolsElem = ncols - 1;
+    mesh.nlayersElem = nlayers - 1;
+    mesh.NUMNP = nrows * ncols * nlayers;
+    mesh.NUMEL = mesh.nrowsElem * mesh.ncolsElem * mesh.nlayersElem;
+    mesh.meshResolution = 100.0;
+    mesh.domainHeight = 300.0;
+    mesh.XORD.allocate( nrows, ncols, nlayers );
+    mesh.YORD.allocate( nrows, ncols, nlayers );
+    mesh.ZORD.allocate( nrows, ncols, nlayers );
+    for( int k = 0; k < nlayers; k++ )
+    {
+        for( int i = 0; i < nrows; i++ )
+        {
+            for( int j = 0; j < ncols; j++ )
+            {
+                mesh.XORD( i, j, k ) = 100.0 * j;
+                mesh.YORD( i, j, k ) = 100.0 * i;
+                mesh.ZORD( i, j, k ) = context.dem( i, j ) + 150.0 * k;
+            }
+        }
+    }
+
+    int n = mesh.NUMNP;
+    context.NUMNP = n;
+    context.row_ptr = new int[n + 1];
+    context.col_ind = new int[2 * n - 1];
+    context.SK = new double[2 * n - 1];
+    int nz = 0;
+    for( int i = 0; i < n; i++ )
+    {
+        context.row_ptr[i] = nz;
+        context.col_ind[nz] = i;
+        context.SK[nz++] = 4.0 + i;
+        if( i + 1 < n )
+        {
+            context.col_ind[nz] = i + 1;
+            context.SK[nz++] = -1.0;
+        }
+    }
+    context.row_ptr[n] = nz;
+}
+
+BOOST_AUTO_TEST_SUITE( domain_cache )
+
+/**
+* Test writing a domain to a cache file and reading it back
+*/
+BOOST_AUTO_TEST_CASE( round_trip )
+{
+    DomainContext context;
+    BuildTestContext( context );
+    std::string fileName = CPLGenerateTempFilename( "domain_cache" );
+    BOOST_REQUIRE( context.writeCache( fileName ) );
+
+    DomainContext cached;
+    BOOST_REQUIRE( cached.readCache( fileName ) );
+    VSIUnlink( fileName.c_str() );
+
+    BOOST_REQUIRE_EQUAL( cached.NUMNP, context.NUMNP );
+    BOOST_REQUIRE_EQUAL( cached.mesh.NUMEL, context.mesh.NUMEL );
+    BOOST_CHECK_EQUAL( cached.dem.get_nRows(), context.dem.get_nRows() );
+    BOOST_CHECK_EQUAL( cached.dem( 3, 2 ), context.dem( 3, 2 ) );
+    BOOST_CHECK_EQUAL( cached.surface.Albedo( 1, 1 ), 0.25 );
+    BOOST_CHECK_EQUAL( cached.mesh.ZORD( 2, 1, 2 ), context.mesh.ZORD( 2, 1, 2 ) );
+    BOOST_CHECK_EQUAL( cached.mesh.domainHeight, context.mesh.domainHeight );
+    for( int i = 0; i <= context.NUMNP; i++ )
+        BOOST_CHECK_EQUAL( cached.row_ptr[i], context.row_ptr[i] );
+    for( int i = 0; i < context.row_ptr[context.NUMNP]; i++ )
+    {
+        BOOST_CHECK_EQUAL( cached.col_ind[i], context.col_ind[i] );
+        BOOST_CHECK_EQUAL( cached.SK[i], context.SK[i] );
+    }
+}
+
+/**
+* Test that truncated files and matrices indexing out of the mesh are
+* rejected
+*/
+BOOST_AUTO_TEST_CASE( invalid_file )
+{
+    DomainContext context;
+    BuildTestContext( context );
+    std::string fileName = CPLGenerateTempFilename( "domain_cache" );
+    BOOST_REQUIRE( context.writeCache( fileName ) );
+
+    std::vector<char> bytes;
+    FILE *fp = fopen( fileName.c_str(), "rb" );
+    BOOST_REQUIRE( fp != NULL );
+    int c;
+    while( ( c = fgetc( fp ) ) != EOF )
+        bytes.push_back( (char)c );
+    fclose( fp );
+
+    //truncated in the matrix values
+    fp = fopen( fileName.c_str(), "wb" );
+    fwrite( &bytes[0], 1, bytes.size() - 8, fp );
+    fclose( fp );
+    DomainContext truncated;
+    BOOST_CHECK( !truncated.readCache( fileName ) );
+    BOOST_CHECK( !truncated.isBuilt() );
+
+    //second column index of the first row past the last node
+    int nnz = context.row_ptr[context.NUMNP];
+    size_t offset = bytes.size() - nnz * ( sizeof( double ) + sizeof( int ) ) + sizeof( int );
+    int badColumn = context.NUMNP + 5;
+    memcpy( &bytes[offset], &badColumn, sizeof( int ) );
+    fp = fopen( fileName.c_str(), "wb" );
+    fwrite( &bytes[0], 1, bytes.size(), fp );
+    fclose( fp );
+    DomainContext badIndex;
+    BOOST_CHECK( !badIndex.readCache( fileName ) );
+    BOOST_CHECK( !badIndex.isBuilt() );
+
+    VSIUnlink( fileName.c_str() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/******************************************************************************
+*                        END "DOMAIN_CACHE" BOOST TEST SUITE
+*****************************************************************************/
@@ -0,0 +1,102 @@
+/******************************************************************************
+ *
+ * $Id$ 
+ *
+ * Project:  WindNinja
+ * Purpose:  Test the 3d field storage
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <vector>
+
+#include "mesh.h"
+#include "wn_3dArray.h"
+#include "wn_3dScalarField.h"
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "FIELDS" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       fields/layer_major
+*       fields/pack_interleaved
+******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE( fields )
+
+/*
+** wn_3dArray stores the values in the node numbering, so &a(0) is usable as
+** the raw node array, and copies keep the values.
+*/
+BOOST_AUTO_TEST_CASE( layer_major )
+{
+    const int rows = 7, cols = 10, layers = 5;
+    wn_3dArray a( rows, cols, layers );
+    for( int k = 0; k < layers; k++ )
+        for( int i = 0; i < rows; i++ )
+            for( int j = 0; j < cols; j++ )
+                a( i, j, k ) = 100.0 * k + 10.0 * i + j;
+
+    const double *raw = &a( 0 );
+    wn_3dArray c( a );
+    for( int k = 0; k < layers; k++ )
+        for( int i = 0; i < rows; i++ )
+            for( int j = 0; j < cols; j++ )
+            {
+                int n = k * rows * cols + i * cols + j;
+                BOOST_REQUIRE( &a( i, j, k ) == raw + n );
+                BOOST_REQUIRE( a( n ) == a( i, j, k ) );
+                BOOST_REQUIRE( c( n ) == a( n ) );
+            }
+}
+
+/*
+** packInterleaved() puts the three components of a node next to each other.
+*/
+BOOST_AUTO_TEST_CASE( pack_interleaved )
+{
+    Mesh mesh;
+    mesh.nrows = 4;
+    mesh.ncols = 3;
+    mesh.nlayers = 5;
+    mesh.NUMNP = mesh.nrows * mesh.ncols * mesh.nlayers;
+
+    wn_3dScalarField x( &mesh ), y( &mesh ), z( &mesh );
+    for( int n = 0; n < mesh.NUMNP; n++ )
+    {
+        x( n ) = n;
+        y( n ) = 1000.0 + n;
+        z( n ) = -1.0 * n;
+    }
+
+    std::vector<double> xyz( 3 * mesh.NUMNP );
+    wn_3dScalarField::packInterleaved( x, y, z, &xyz[0] );
+    for( int n = 0; n < mesh.NUMNP; n++ )
+    {
+        BOOST_REQUIRE( xyz[3 * n] == x( n ) );
+        BOOST_REQUIRE( xyz[3 * n + 1] == y( n ) );
+        BOOST_REQUIRE( xyz[3 * n + 2] == z( n ) );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
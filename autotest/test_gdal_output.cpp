@@ -160,6 +160,38 @@ BOOST_AUTO_TEST_CASE(invalid_format) {
   BOOST_REQUIRE(rc != 0);
 }
 
+BOOST_AUTO_TEST_CASE(ascii_grid) {
+  AsciiGrid<double> spd(3, 2, 0.5, 1.25, 10, -9999);
+  spd(0, 0) = 2.675;
+  spd(0, 1) = -0.004;
+  spd(0, 2) = 0.125;
+  spd(1, 0) = -9999;
+  spd(1, 1) = 12345.5;
+  spd(1, 2) = 7;
+  spd.write_Grid("out_grid.asc", 2);
+
+  std::ifstream in("out_grid.asc");
+  std::stringstream text;
+  text << in.rdbuf();
+  BOOST_CHECK_EQUAL(text.str(), "ncols\t3\n"
+                                "nrows\t2\n"
+                                "xllcorner\t0.500000\n"
+                                "yllcorner\t1.250000\n"
+                                "cellsize\t10.000000\n"
+                                "NODATA_value\t-9999.000000\n"
+                                "-9999.00\t12345.50\t7.00\t\n"
+                                "2.67\t-0.00\t0.12\t\n");
+
+  AsciiGrid<double> back;
+  back.read_Grid("out_grid.asc");
+  BOOST_REQUIRE_EQUAL(back.get_nRows(), 2);
+  BOOST_REQUIRE_EQUAL(back.get_nCols(), 3);
+  BOOST_CHECK_EQUAL(back.get_xllCorner(), 0.5);
+  BOOST_CHECK_EQUAL(back(0, 0), 2.67);
+  BOOST_CHECK_EQUAL(back(1, 1), 12345.5);
+  BOOST_CHECK_EQUAL(back(1, 0), -9999.0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #endif /* WIN32 */
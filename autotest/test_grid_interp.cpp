@@ -40,6 +40,8 @@
 *******************************************************************************
 *   Tests:
 *       grid_interp/order
+*       grid_interp/area_average
+*       grid_interp/inverse_distance
 ******************************************************************************/
 
 BOOST_AUTO_TEST_SUITE( grid_interp )
@@ -62,6 +64,80 @@ BOOST_AUTO_TEST_CASE( order )
     
 }
 
+/**
+* Test coarsening a grid to the average of the cells covered, skipping no
+* data cells
+*/
+BOOST_AUTO_TEST_CASE( area_average )
+{
+    AsciiGrid<double> grid(4, 4, 0.0, 0.0, 10.0, -9999.0, 0.0);
+    for(int i = 0; i < 4; i++)
+        for(int j = 0; j < 4; j++)
+            grid(i, j) = i * 4 + j;
+    grid(3, 3) = -9999.0;
+
+    AsciiGrid<double> coarse = grid.resample_Grid(20.0, AsciiGrid<double>::areaAverage);
+    BOOST_REQUIRE_EQUAL(coarse.get_nRows(), 2);
+    BOOST_REQUIRE_EQUAL(coarse.get_nCols(), 2);
+    BOOST_CHECK_CLOSE(coarse(0, 0), 2.5, 1e-10);
+    BOOST_CHECK_CLOSE(coarse(0, 1), 4.5, 1e-10);
+    BOOST_CHECK_CLOSE(coarse(1, 0), 10.5, 1e-10);
+    BOOST_CHECK_CLOSE(coarse(1, 1), 35.0 / 3.0, 1e-10);
+
+    //the grids of one geometry share the tables
+    GridResampler resampler = grid.get_resampler(20.0, AsciiGrid<double>::order0);
+    AsciiGrid<double> other(grid);
+    other.resample_Grid_in_place(resampler);
+    BOOST_CHECK_EQUAL(other(1, 0), grid(3, 1));
+}
+
+/**
+* Test inverse distance weighting of points with and without an influence
+* radius, one variable at a time and together
+*/
+BOOST_AUTO_TEST_CASE( inverse_distance )
+{
+    AsciiGrid<double> grid(3, 3, 0.0, 0.0, 10.0, -9999.0, 0.0);
+    double X[] = {0.0, 30.0};
+    double Y[] = {5.0, 5.0};
+    double radius[] = {-1.0, 12.0};
+    double a[] = {1.0, 3.0};
+    double b[] = {-2.0, 4.0};
+
+    grid.interpolateFromPoints(a, X, Y, radius, 2, 1.0);
+    BOOST_CHECK_CLOSE(grid(0, 0), 1.0, 1e-10);
+    BOOST_CHECK_CLOSE(grid(0, 2), (1.0 / 25.0 + 3.0 / 5.0) / (1.0 / 25.0 + 1.0 / 5.0), 1e-10);
+    BOOST_CHECK_CLOSE(grid(2, 2), 1.0, 1e-10);
+
+    grid.interpolateFromPoints(a, X, Y, radius, 2, 2.0);
+    BOOST_CHECK_CLOSE(grid(0, 2), (1.0 / 625.0 + 3.0 / 25.0) / (1.0 / 625.0 + 1.0 / 25.0), 1e-10);
+
+    //cells out of reach of every point are no data
+    radius[0] = 6.0;
+    grid.interpolateFromPoints(a, X, Y, radius, 2, 2.0);
+    BOOST_CHECK_EQUAL(grid(2, 0), -9999.0);
+    BOOST_CHECK_CLOSE(grid(0, 2), 3.0, 1e-10);
+
+    AsciiGrid<double> gridB(grid);
+    gridB.interpolateFromPoints(b, X, Y, radius, 2, 2.0);
+
+    AsciiGrid<double> oneA(grid), oneB(grid);
+    boost::shared_ptr<const IdwInterpolator> idw =
+        IdwInterpolator::get(3, 3, 0.0, 0.0, 10.0, X, Y, radius, 2, 2.0);
+    const double *values[] = {a, b};
+    Array2D<double> *grids[] = {&oneA.data, &oneB.data};
+    idw->interpolate(2, values, grids);
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            BOOST_CHECK_EQUAL(oneA(i, j), grid(i, j));
+            BOOST_CHECK_EQUAL(oneB(i, j), gridB(i, j));
+        }
+    }
+    IdwInterpolator::clear();
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 /******************************************************************************
@@ -0,0 +1,147 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Test the wind grids at the output heights
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "ninja.h"
+#include "ninja_conv.h"
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "OUTPUT_HEIGHTS" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       output_heights/log_profile
+******************************************************************************/
+
+/*
+** Copy mackay.tif to a temporary GeoTIFF with every cell at 1500 m, so the
+** run keeps the projection and the size of a real DEM but has no terrain.
+*/
+static std::string WriteFlatDem()
+{
+    GDALAllRegister();
+    GDALDatasetH hSrcDS = GDALOpen( FindDataPath( "mackay.tif" ).c_str(), GA_ReadOnly );
+    if( hSrcDS == NULL )
+        return "";
+
+    std::string fileName = CPLFormFilename( NULL, CPLGenerateTempFilename( "flat_dem" ), ".tif" );
+    GDALDatasetH hDS = GDALCreateCopy( GDALGetDriverByName( "GTiff" ), fileName.c_str(),
+                                       hSrcDS, FALSE, NULL, NULL, NULL );
+    GDALClose( hSrcDS );
+    if( hDS == NULL )
+        return "";
+
+    int nXSize = GDALGetRasterXSize( hDS );
+    int nYSize = GDALGetRasterYSize( hDS );
+    std::vector<double> row( nXSize, 1500.0 );
+    GDALRasterBandH hBand = GDALGetRasterBand( hDS, 1 );
+    for( int i = 0; i < nYSize; i++ )
+        GDALRasterIO( hBand, GF_Write, 0, i, nXSize, 1, &row[0], nXSize, 1,
+                      GDT_Float64, 0, 0 );
+    GDALClose( hDS );
+    return fileName;
+}
+
+BOOST_AUTO_TEST_SUITE( output_heights )
+
+/**
+* Test the grids at the extra output heights of a domain average run on flat
+* ground.  The initial field is then the neutral log profile and already mass
+* consistent, so every height should match the profile through the input wind,
+* both in the first cell where the profile is applied directly and above it
+* where the layers are interpolated linearly.
+*/
+BOOST_AUTO_TEST_CASE( log_profile )
+{
+    std::string demFile = WriteFlatDem();
+    BOOST_REQUIRE( demFile != "" );
+
+    const double inputSpeed = 5.0;
+    const double inputHeight = 10.0;
+    const double roughness = 0.01;  //grass, no displacement height
+    std::vector<double> heights;
+    heights.push_back( 0.5 );   //in the first cell, about 0.6 m deep at this resolution
+    heights.push_back( 3.0 );
+    heights.push_back( 20.0 );
+    heights.push_back( 50.0 );
+
+    ninja windsim;
+    windsim.set_ninjaCommunication( 0, ninjaComClass::ninjaQuietCom );
+    windsim.set_numberCPUs( 1 );
+    windsim.set_DEM( demFile );
+    windsim.set_position();
+    windsim.set_initializationMethod( WindNinjaInputs::domainAverageInitializationFlag );
+    windsim.set_inputSpeed( inputSpeed, velocityUnits::metersPerSecond );
+    windsim.set_inputDirection( 270.0 );
+    windsim.set_inputWindHeight( inputHeight, lengthUnits::meters );
+    windsim.set_outputWindHeight( inputHeight, lengthUnits::meters );
+    windsim.set_extraOutputWindHeights( heights, lengthUnits::meters );
+    windsim.set_outputSpeedUnits( velocityUnits::metersPerSecond );
+    windsim.set_uniVegetation( WindNinjaInputs::grass );
+    windsim.set_meshResolution( 250.0, lengthUnits::meters );
+    windsim.set_numVertLayers( 20 );
+    windsim.keepOutputGridsInMemory( true );
+
+    BOOST_REQUIRE( windsim.simulate_wind() );
+    VSIUnlink( demFile.c_str() );
+    BOOST_REQUIRE_EQUAL( windsim.extraVelocityGrids.size(), heights.size() );
+
+    for( unsigned int h = 0; h < heights.size(); h++ )
+    {
+        double expected = inputSpeed * std::log( heights[h] / roughness ) /
+                          std::log( inputHeight / roughness );
+        const AsciiGrid<double> &speed = windsim.extraVelocityGrids[h];
+        const AsciiGrid<double> &angle = windsim.extraAngleGrids[h];
+        //the boundary rows and columns are left to the solver
+        double worstSpeed = expected, worstAngle = 270.0;
+        for( int i = 2; i < speed.get_nRows() - 2; i++ )
+        {
+            for( int j = 2; j < speed.get_nCols() - 2; j++ )
+            {
+                if( std::fabs( speed( i, j ) - expected ) > std::fabs( worstSpeed - expected ) )
+                    worstSpeed = speed( i, j );
+                if( std::fabs( angle( i, j ) - 270.0 ) > std::fabs( worstAngle - 270.0 ) )
+                    worstAngle = angle( i, j );
+            }
+        }
+        BOOST_TEST_MESSAGE( "height " << heights[h] << " m, log profile " << expected << " m/s" );
+        BOOST_CHECK_CLOSE( worstSpeed, expected, 2.0 );
+        BOOST_CHECK_CLOSE( worstAngle, 270.0, 0.5 );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/******************************************************************************
+*                        END "OUTPUT_HEIGHTS" BOOST TEST SUITE
+*****************************************************************************/
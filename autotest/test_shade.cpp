@@ -0,0 +1,105 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Test the horizon map against the ray march of Shade
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <cmath>
+
+#include "horizonMap.h"
+#include "Shade.h"
+#include "cpl_conv.h"
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "SHADE" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       shade/horizon_map
+******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE( shade )
+
+/**
+* Compare HorizonMap::shadeGrid() with the ray march (NINJA_HORIZON_SECTORS=0)
+* on a narrow north-south ridge on a tilted plain, 40 x 30 cells.  The ridge
+* runs to the edges of the DEM and its shadow reaches them at low sun, so
+* the edge cells are checked as well.  The ray march steps from cell to cell,
+* so a cell is only counted wrong if the map shades it and the march does
+* not 2 degrees lower, or the march shades it 2 degrees higher and the map
+* does not.  The sun is kept on the axes and the diagonals where the march
+* steps along its own path.
+*/
+BOOST_AUTO_TEST_CASE( horizon_map )
+{
+    const int nRows = 40, nCols = 30;
+    const double cellSize = 30.0;
+    const double tol = 2.0;
+
+    Elevation elev;
+    elev.set_headerData( nCols, nRows, 0.0, 0.0, cellSize, -9999.0, 0.0 );
+    for( int i = 0; i < nRows; i++ )
+        for( int j = 0; j < nCols; j++ )
+            elev( i, j ) = 150.0 * std::exp( -std::pow( ( j - 15 ) / 1.5, 2 ) ) + 1.0 * i;
+
+    HorizonMap map;
+    map.compute( &elev, 64, 1 );
+
+    CPLSetConfigOption( "NINJA_HORIZON_SECTORS", "0" );
+    const double thetas[] = { 45.0, 90.0, 135.0, 225.0, 270.0, 315.0 };
+    const double phis[] = { 10.0, 20.0, 35.0 };
+    for( int t = 0; t < 6; t++ )
+    {
+        for( int p = 0; p < 3; p++ )
+        {
+            Shade low( &elev, thetas[t], phis[p] - tol, 1 );
+            Shade high( &elev, thetas[t], phis[p] + tol, 1 );
+            AsciiGrid<short> shade( nCols, nRows, 0.0, 0.0, cellSize, -9999, 0 );
+            map.shadeGrid( thetas[t], phis[p], shade );
+
+            int nWrong = 0;
+            for( int i = 0; i < nRows; i++ )
+            {
+                for( int j = 0; j < nCols; j++ )
+                {
+                    bool wrong = ( shade( i, j ) == Shade::shaded && low( i, j ) == Shade::unshaded ) ||
+                                 ( high( i, j ) == Shade::shaded && shade( i, j ) == Shade::unshaded );
+                    if( !wrong )
+                        continue;
+                    nWrong++;
+                    if( i == 0 || j == 0 || i == nRows - 1 || j == nCols - 1 )
+                        BOOST_ERROR( "edge cell " << i << ", " << j << " differs at theta "
+                                     << thetas[t] << ", phi " << phis[p] );
+                }
+            }
+            //a cell or two where the march misses the top of the ridge
+            BOOST_CHECK_LE( nWrong, nRows * nCols / 100 );
+        }
+    }
+    CPLSetConfigOption( "NINJA_HORIZON_SECTORS", NULL );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
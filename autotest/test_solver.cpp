@@ -0,0 +1,649 @@
+/******************************************************************************
+ *
+ * $Id$ 
+ *
+ * Project:  WindNinja
+ * Purpose:  Test the solver kernels
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+ 
+#include <cmath>
+#include <vector>
+
+#include "mesh.h"
+#include "stiffnessOperator.h"
+#include "elementGeometry.h"
+#include "sparseMatVec.h"
+#include "preconditioner.h"
+#include "solutionSpace.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "SOLVER" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       solver/stiffness_operator
+*       solver/chebyshev
+*       solver/symmetric_matvec
+*       solver/parallel_ssor
+*       solver/multigrid
+*       solver/solution_space
+*       solver/element_geometry
+*       solver/single_precision
+******************************************************************************/
+
+/*
+** Build a small terrain following mesh without a DEM.  The grid is stretched
+** vertically and the ground is tilted so the elements are not all the same.
+*/
+static void BuildTestMesh( Mesh &mesh, int nrows, int ncols, int nlayers )
+{
+    mesh.nrows = nrows;
+    mesh.ncols = ncols;
+    mesh.nlayers = nlayers;
+    mesh.nrowsElem = nrows - 1;
+    mesh.ncolsElem = ncols - 1;
+    mesh.nlayersElem = nlayers - 1;
+    mesh.NUMNP = nrows * ncols * nlayers;
+    mesh.NUMEL = mesh.nrowsElem * mesh.ncolsElem * mesh.nlayersElem;
+    mesh.XORD.allocate( nrows, ncols, nlayers );
+    mesh.YORD.allocate( nrows, ncols, nlayers );
+    mesh.ZORD.allocate( nrows, ncols, nlayers );
+    for( int k = 0; k < nlayers; k++ )
+    {
+        for( int i = 0; i < nrows; i++ )
+        {
+            for( int j = 0; j < ncols; j++ )
+            {
+                double ground = 2.0 * i + 3.0 * j + 5.0 * std::sin( 0.7 * i * j );
+                mesh.XORD( i, j, k ) = 100.0 * j;
+                mesh.YORD( i, j, k ) = 100.0 * i;
+                mesh.ZORD( i, j, k ) = ground + 10.0 * ( std::pow( 1.3, k ) - 1.0 );
+            }
+        }
+    }
+}
+
+static double Dot( const double *x, const double *y, int n )
+{
+    double sum = 0.0;
+    for( int i = 0; i < n; i++ )
+        sum += x[i] * y[i];
+    return sum;
+}
+
+/*
+** Upper triangle of a symmetric matrix with the 27 point pattern of the
+** stiffness matrix on an nrows x ncols x nlayers grid, in compressed row
+** storage.
+*/
+static void BuildTestMatrix( int nrows, int ncols, int nlayers,
+                             std::vector<int> &row_ptr, std::vector<int> &col_ind,
+                             std::vector<double> &val )
+{
+    int n = nrows * ncols * nlayers;
+    row_ptr.assign( n + 1, 0 );
+    col_ind.clear();
+    val.clear();
+    for( int k = 0; k < nlayers; k++ )
+    {
+        for( int i = 0; i < nrows; i++ )
+        {
+            for( int j = 0; j < ncols; j++ )
+            {
+                int row = k * nrows * ncols + i * ncols + j;
+                row_ptr[row] = col_ind.size();
+                for( int kk = k - 1; kk <= k + 1; kk++ )
+                {
+                    for( int ii = i - 1; ii <= i + 1; ii++ )
+                    {
+                        for( int jj = j - 1; jj <= j + 1; jj++ )
+                        {
+                            if( kk < 0 || kk >= nlayers || ii < 0 || ii >= nrows ||
+                                jj < 0 || jj >= ncols )
+                                continue;
+                            int col = kk * nrows * ncols + ii * ncols + jj;
+                            if( col < row )
+                                continue;
+                            col_ind.push_back( col );
+                            val.push_back( col == row ? 30.0 : -1.0 - 0.01 * ( ( row + col ) % 17 ) );
+                        }
+                    }
+                }
+            }
+        }
+    }
+    row_ptr[n] = col_ind.size();
+}
+
+/*
+** Upper triangle of the stiffness matrix of the operator, in compressed row
+** storage.  The columns are probed with 27 vectors, each one the sum of the
+** unit vectors of the nodes that are 3 apart in every direction, since those
+** do not share any element.
+*/
+static void AssembleOperator( StiffnessOperator &A, const Mesh &mesh,
+                              std::vector<int> &row_ptr, std::vector<int> &col_ind,
+                              std::vector<double> &val )
+{
+    int n = mesh.NUMNP;
+    int nrc = mesh.nrows * mesh.ncols;
+    std::vector<double> e( n );
+    std::vector<std::vector<double> > Ae( 27, std::vector<double>( n ) );
+    for( int c = 0; c < 27; c++ )
+    {
+        for( int node = 0; node < n; node++ )
+        {
+            int k = node / nrc, i = ( node % nrc ) / mesh.ncols, j = node % mesh.ncols;
+            e[node] = ( k % 3 ) * 9 + ( i % 3 ) * 3 + j % 3 == c ? 1.0 : 0.0;
+        }
+        A.apply( &e[0], &Ae[c][0] );
+    }
+
+    BuildTestMatrix( mesh.nrows, mesh.ncols, mesh.nlayers, row_ptr, col_ind, val );
+    for( int row = 0; row < n; row++ )
+    {
+        for( int p = row_ptr[row]; p < row_ptr[row + 1]; p++ )
+        {
+            int col = col_ind[p];
+            int k = col / nrc, i = ( col % nrc ) / mesh.ncols, j = col % mesh.ncols;
+            val[p] = Ae[( k % 3 ) * 9 + ( i % 3 ) * 3 + j % 3][row];
+        }
+    }
+}
+
+/*
+** Preconditioned conjugate gradients from the initial guess x, returns the
+** number of iterations to reduce the residual to tol*|b|.
+*/
+static int SolvePCG( const std::vector<int> &row_ptr, const std::vector<int> &col_ind,
+                     const std::vector<double> &val, Preconditioner &M,
+                     const std::vector<double> &b, std::vector<double> &x, double tol )
+{
+    int n = b.size();
+    std::vector<double> r( n ), z( n ), p( n ), q( n );
+    symmetricCsrMatVec( n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1], &x[0], &r[0] );
+    for( int i = 0; i < n; i++ )
+        r[i] = b[i] - r[i];
+    double normb = std::sqrt( Dot( &b[0], &b[0], n ) );
+    if( std::sqrt( Dot( &r[0], &r[0], n ) ) < tol * normb )
+        return 0;
+    double rhoOld = 0.0;
+    for( int it = 1; it <= 1000; it++ )
+    {
+        M.solve( &r[0], &z[0], const_cast<int*>( &row_ptr[0] ), const_cast<int*>( &col_ind[0] ) );
+        double rho = Dot( &r[0], &z[0], n );
+        for( int i = 0; i < n; i++ )
+            p[i] = z[i] + ( it == 1 ? 0.0 : rho / rhoOld ) * p[i];
+        symmetricCsrMatVec( n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1], &p[0], &q[0] );
+        double alpha = rho / Dot( &p[0], &q[0], n );
+        for( int i = 0; i < n; i++ )
+        {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+        }
+        rhoOld = rho;
+        if( std::sqrt( Dot( &r[0], &r[0], n ) ) < tol * normb )
+            return it;
+    }
+    return -1;
+}
+
+BOOST_AUTO_TEST_SUITE( solver )
+
+/**
+* The matrix-free operator must be symmetric, act as the identity on the
+* boundary nodes and give zero for a constant field away from the boundary.
+*/
+BOOST_AUTO_TEST_CASE( stiffness_operator )
+{
+    Mesh mesh;
+    BuildTestMesh( mesh, 7, 8, 6 );
+    int n = mesh.NUMNP;
+
+    StiffnessOperator A;
+    ElementGeometry geometry;
+    geometry.initialize( &mesh, ElementGeometry::compact );
+    A.initialize( &mesh, &geometry, NULL, 1.0, StiffnessOperator::Jacobi, 1 );
+    BOOST_REQUIRE( A.NUMNP == n );
+
+    std::vector<double> x( n ), y( n ), Ax( n ), Ay( n );
+    for( int i = 0; i < n; i++ )
+    {
+        x[i] = std::sin( 0.37 * i );
+        y[i] = std::cos( 0.11 * i * i );
+    }
+    A.apply( &x[0], &Ax[0] );
+    A.apply( &y[0], &Ay[0] );
+    double xAy = Dot( &x[0], &Ay[0], n );
+    double yAx = Dot( &y[0], &Ax[0], n );
+    BOOST_CHECK_CLOSE( xAy, yAx, 1e-9 );
+
+    //top layer is a boundary
+    int top = ( mesh.nlayers - 1 ) * mesh.nrows * mesh.ncols + 3 * mesh.ncols + 3;
+    BOOST_CHECK_EQUAL( Ax[top], x[top] );
+
+    std::vector<double> one( n, 1.0 ), Aone( n );
+    A.apply( &one[0], &Aone[0] );
+    //(2,3,1) has no boundary neighbors, so its row of the stiffness matrix sums to zero
+    int interior = 1 * mesh.nrows * mesh.ncols + 2 * mesh.ncols + 3;
+    BOOST_CHECK_SMALL( Aone[interior], 1e-10 );
+}
+
+/**
+* The Chebyshev preconditioner must be symmetric positive definite so it can
+* be used in conjugate gradients.
+*/
+BOOST_AUTO_TEST_CASE( chebyshev )
+{
+    Mesh mesh;
+    BuildTestMesh( mesh, 7, 8, 6 );
+    int n = mesh.NUMNP;
+
+    StiffnessOperator A;
+    ElementGeometry geometry;
+    geometry.initialize( &mesh, ElementGeometry::compact );
+    A.initialize( &mesh, &geometry, NULL, 1.0, StiffnessOperator::Chebyshev, 4 );
+
+    std::vector<double> r( n ), s( n ), Mr( n ), Ms( n );
+    for( int i = 0; i < n; i++ )
+    {
+        r[i] = std::sin( 0.37 * i );
+        s[i] = std::cos( 0.11 * i * i );
+    }
+    A.precondition( &r[0], &Mr[0] );
+    A.precondition( &s[0], &Ms[0] );
+    BOOST_CHECK_CLOSE( Dot( &r[0], &Ms[0], n ), Dot( &s[0], &Mr[0], n ), 1e-9 );
+    BOOST_CHECK( Dot( &r[0], &Mr[0], n ) > 0.0 );
+    BOOST_CHECK( Dot( &s[0], &Ms[0], n ) > 0.0 );
+}
+
+/**
+* The parallel symmetric product must match the serial reference for any
+* number of threads, including more threads than the matrix bandwidth allows
+* for halos that overlap several row blocks.  The fused version must also
+* return x.(A*x) and r.x.
+*/
+BOOST_AUTO_TEST_CASE( symmetric_matvec )
+{
+    std::vector<int> row_ptr, col_ind;
+    std::vector<double> val;
+    BuildTestMatrix( 9, 11, 7, row_ptr, col_ind, val );
+    int n = row_ptr.size() - 1;
+
+    std::vector<double> x( n ), y( n ), yRef( n ), r( n );
+    for( int i = 0; i < n; i++ )
+    {
+        x[i] = std::sin( 0.37 * i ) + 0.5;
+        r[i] = std::cos( 0.11 * i );
+    }
+
+    symmetricCsrMatVecSerial( n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1],
+                              &x[0], &yRef[0] );
+
+    int threads[] = { 1, 2, 3, 8, 64 };
+    for( int t = 0; t < 5; t++ )
+    {
+#ifdef _OPENMP
+        omp_set_num_threads( threads[t] );
+#endif
+        symmetricCsrMatVec( n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1],
+                            &x[0], &y[0] );
+        for( int i = 0; i < n; i++ )
+            BOOST_REQUIRE_CLOSE( y[i], yRef[i], 1e-10 );
+
+        double rx = 0.0;
+        double xAx = symmetricCsrMatVecDot( n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1],
+                                            &x[0], &y[0], &r[0], &rx );
+        for( int i = 0; i < n; i++ )
+            BOOST_REQUIRE_CLOSE( y[i], yRef[i], 1e-10 );
+        BOOST_CHECK_CLOSE( xAx, Dot( &x[0], &yRef[0], n ), 1e-10 );
+        BOOST_CHECK_CLOSE( rx, Dot( &r[0], &x[0], n ), 1e-10 );
+    }
+}
+
+/**
+* The level scheduled SSOR preconditioner must give the same result as the
+* sequential one.
+*/
+BOOST_AUTO_TEST_CASE( parallel_ssor )
+{
+    std::vector<int> row_ptr, col_ind;
+    std::vector<double> val;
+    BuildTestMatrix( 6, 9, 5, row_ptr, col_ind, val );
+    int n = row_ptr.size() - 1;
+    char matdescra[6] = { 's', 'u', 'n', 'c', 0, 0 };
+
+    Preconditioner ssor, parallelSsor;
+    BOOST_REQUIRE( ssor.initialize( n, &val[0], &row_ptr[0], &col_ind[0],
+                                    Preconditioner::SSOR, matdescra ) );
+    BOOST_REQUIRE( parallelSsor.initialize( n, &val[0], &row_ptr[0], &col_ind[0],
+                                            Preconditioner::ParallelSSOR, matdescra ) );
+    //the levels follow the diagonals of the grid, far fewer than the rows
+    BOOST_CHECK( parallelSsor.get_numLevels() > 2 );
+    BOOST_CHECK( parallelSsor.get_numLevels() < n / 3 );
+
+    std::vector<double> r( n ), z( n ), zRef( n );
+    for( int i = 0; i < n; i++ )
+        r[i] = std::cos( 0.23 * i );
+
+    ssor.solve( &r[0], &zRef[0], &row_ptr[0], &col_ind[0] );
+
+    int threads[] = { 1, 3, 8 };
+    for( int t = 0; t < 3; t++ )
+    {
+#ifdef _OPENMP
+        omp_set_num_threads( threads[t] );
+#endif
+        parallelSsor.solve( &r[0], &z[0], &row_ptr[0], &col_ind[0] );
+        for( int i = 0; i < n; i++ )
+            BOOST_REQUIRE_CLOSE( z[i], zRef[i], 1e-9 );
+    }
+}
+
+/**
+* The multigrid preconditioner must be symmetric and need fewer iterations
+* than SSOR, and about as many on a grid twice as fine.
+*/
+BOOST_AUTO_TEST_CASE( multigrid )
+{
+    char matdescra[6] = { 's', 'u', 'n', 'c', 0, 0 };
+    int sizes[2][3] = { { 17, 16, 10 }, { 33, 32, 10 } };
+    int iterations[2];
+
+    for( int m = 0; m < 2; m++ )
+    {
+        Mesh mesh;
+        BuildTestMesh( mesh, sizes[m][0], sizes[m][1], sizes[m][2] );
+        int n = mesh.NUMNP;
+        StiffnessOperator A;
+        ElementGeometry geometry;
+        geometry.initialize( &mesh, ElementGeometry::compact );
+        A.initialize( &mesh, &geometry, NULL, 1.0, StiffnessOperator::Jacobi, 1 );
+        std::vector<int> row_ptr, col_ind;
+        std::vector<double> val;
+        AssembleOperator( A, mesh, row_ptr, col_ind, val );
+
+        Preconditioner mg, ssor;
+        //the multigrid preconditioner needs the grid dimensions
+        BOOST_CHECK( !mg.initialize( n, &val[0], &row_ptr[0], &col_ind[0],
+                                     Preconditioner::Multigrid, matdescra ) );
+        mg.set_gridDimensions( mesh.nrows, mesh.ncols, mesh.nlayers );
+        BOOST_REQUIRE( mg.initialize( n, &val[0], &row_ptr[0], &col_ind[0],
+                                      Preconditioner::Multigrid, matdescra ) );
+        BOOST_REQUIRE( ssor.initialize( n, &val[0], &row_ptr[0], &col_ind[0],
+                                        Preconditioner::SSOR, matdescra ) );
+        BOOST_CHECK( mg.get_numLevels() > 2 );
+
+        std::vector<double> r( n ), s( n ), Mr( n ), Ms( n );
+        for( int i = 0; i < n; i++ )
+        {
+            r[i] = std::sin( 0.37 * i );
+            s[i] = std::cos( 0.11 * i * i );
+        }
+        mg.solve( &r[0], &Mr[0], &row_ptr[0], &col_ind[0] );
+        mg.solve( &s[0], &Ms[0], &row_ptr[0], &col_ind[0] );
+        BOOST_CHECK_CLOSE( Dot( &r[0], &Ms[0], n ), Dot( &s[0], &Mr[0], n ), 1e-8 );
+        BOOST_CHECK( Dot( &r[0], &Mr[0], n ) > 0.0 );
+
+        //right hand side of a smooth solution that is zero on the boundary
+        std::vector<double> x( n ), b( n );
+        for( int k = 0; k < mesh.nlayers; k++ )
+            for( int i = 0; i < mesh.nrows; i++ )
+                for( int j = 0; j < mesh.ncols; j++ )
+                    x[( k * mesh.nrows + i ) * mesh.ncols + j] =
+                        std::sin( M_PI * i / ( mesh.nrows - 1 ) ) *
+                        std::sin( M_PI * j / ( mesh.ncols - 1 ) ) *
+                        std::cos( 0.5 * M_PI * k / ( mesh.nlayers - 1 ) );
+        symmetricCsrMatVec( n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1], &x[0], &b[0] );
+
+        std::vector<double> x0( n, 0.0 ), x1( n, 0.0 );
+        iterations[m] = SolvePCG( row_ptr, col_ind, val, mg, b, x0, 1e-6 );
+        int ssorIterations = SolvePCG( row_ptr, col_ind, val, ssor, b, x1, 1e-6 );
+        BOOST_TEST_MESSAGE( "multigrid " << iterations[m] << " iterations, SSOR " << ssorIterations );
+        BOOST_REQUIRE( iterations[m] > 0 );
+        BOOST_CHECK( iterations[m] < ssorIterations );
+    }
+    BOOST_CHECK( iterations[1] <= iterations[0] + 5 );
+}
+
+/**
+* Solving a sequence of slowly changing problems from the projection on the
+* previous solutions must take far fewer iterations than starting from zero,
+* also after the space is full, and a right hand side of a stored solution
+* must be solved exactly.
+*/
+BOOST_AUTO_TEST_CASE( solution_space )
+{
+    char matdescra[6] = { 's', 'u', 'n', 'c', 0, 0 };
+    Mesh mesh;
+    BuildTestMesh( mesh, 17, 16, 10 );
+    int n = mesh.NUMNP;
+    StiffnessOperator A;
+    ElementGeometry geometry;
+    geometry.initialize( &mesh, ElementGeometry::compact );
+    A.initialize( &mesh, &geometry, NULL, 1.0, StiffnessOperator::Jacobi, 1 );
+    std::vector<int> row_ptr, col_ind;
+    std::vector<double> val;
+    AssembleOperator( A, mesh, row_ptr, col_ind, val );
+    Preconditioner M;
+    BOOST_REQUIRE( M.initialize( n, &val[0], &row_ptr[0], &col_ind[0],
+                                 Preconditioner::SSOR, matdescra ) );
+
+    SolutionSpace space;
+    space.initialize( n, 4 );
+    std::vector<double> x( n ), Ax( n ), b( n ), b0( n );
+    int coldIterations = 0;
+    for( int step = 0; step < 6; step++ )
+    {
+        //right hand side rotating slowly from step to step
+        double angle = 0.1 * step;
+        for( int i = 0; i < n; i++ )
+            b[i] = std::cos( angle ) * std::sin( 0.37 * i ) + std::sin( angle ) * std::cos( 0.11 * i );
+        if( step == 0 )
+            b0 = b;
+
+        int nVectors = space.project( &b[0], &x[0] );
+        BOOST_CHECK( nVectors <= 4 );
+        BOOST_CHECK( step == 0 || nVectors > 0 );
+        int iterations = SolvePCG( row_ptr, col_ind, val, M, b, x, 1e-3 );
+        BOOST_TEST_MESSAGE( "step " << step << ": " << iterations << " iterations" );
+        BOOST_REQUIRE( iterations >= 0 );
+        if( step == 0 )
+            coldIterations = iterations;
+        else
+            BOOST_CHECK( 2 * iterations < coldIterations );
+
+        symmetricCsrMatVec( n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1], &x[0], &Ax[0] );
+        space.add( &x[0], &Ax[0] );
+    }
+    BOOST_CHECK_EQUAL( space.get_numVectors(), 4 );
+
+    //b = A*x of the last solution, which is in the space
+    std::vector<double> guess( n ), r( n );
+    space.project( &Ax[0], &guess[0] );
+    for( int i = 0; i < n; i++ )
+        r[i] = guess[i] - x[i];
+    BOOST_CHECK( std::sqrt( Dot( &r[0], &r[0], n ) ) < 1e-6 * std::sqrt( Dot( &x[0], &x[0], n ) ) );
+
+    space.clear();
+    BOOST_CHECK_EQUAL( space.project( &b0[0], &x[0] ), 0 );
+    BOOST_CHECK_EQUAL( Dot( &x[0], &x[0], n ), 0.0 );
+}
+
+/**
+* The stored geometry factors, in both layouts, must be the ones the element
+* computes, the smoothed nodal gradients must be exact for a linear field and a
+* mesh with non-uniform horizontal spacing must fall back to the full layout.
+*/
+BOOST_AUTO_TEST_CASE( element_geometry )
+{
+    Mesh mesh;
+    BuildTestMesh( mesh, 7, 8, 6 );
+    element elem( &mesh );
+    elem.initializeQuadPtArrays();
+
+    ElementGeometry full, compact;
+    full.initialize( &mesh, ElementGeometry::full );
+    compact.initialize( &mesh, ElementGeometry::compact );
+    BOOST_CHECK( full.get_layout() == ElementGeometry::full );
+    BOOST_CHECK( compact.get_layout() == ElementGeometry::compact );
+    BOOST_CHECK( compact.get_memoryMB() < full.get_memoryMB() / 2 );
+
+    double dndx[8], dndy[8], dndz[8], detJW, x, y, z;
+    for( int e = 0; e < mesh.NUMEL; e++ )
+    {
+        for( int q = 0; q < elem.NUMQPTV; q++ )
+        {
+            double xe, ye, ze;
+            elem.computeJacobianQuadraturePoint( q, e, xe, ye, ze );
+            ElementGeometry *layouts[2] = { &full, &compact };
+            for( int l = 0; l < 2; l++ )
+            {
+                layouts[l]->get( e, q, dndx, dndy, dndz, detJW, x, y, z );
+                BOOST_REQUIRE_CLOSE( detJW, elem.DETJ * elem.WT, 1e-10 );
+                BOOST_REQUIRE_CLOSE( x, xe, 1e-10 );
+                BOOST_REQUIRE_CLOSE( y, ye, 1e-10 );
+                BOOST_REQUIRE_CLOSE( z, ze, 1e-10 );
+                for( int k = 0; k < mesh.NNPE; k++ )
+                {
+                    BOOST_REQUIRE_SMALL( dndx[k] - elem.DNDX[k], 1e-12 );
+                    BOOST_REQUIRE_SMALL( dndy[k] - elem.DNDY[k], 1e-12 );
+                    BOOST_REQUIRE_SMALL( dndz[k] - elem.DNDZ[k], 1e-12 );
+                }
+            }
+        }
+    }
+
+    //the smoothed gradient of a linear field is exact at every node
+    int n = mesh.NUMNP;
+    std::vector<double> phi( n ), gx( n ), gy( n ), gz( n );
+    for( int i = 0; i < n; i++ )
+        phi[i] = 0.3 * mesh.XORD( i ) - 0.2 * mesh.YORD( i ) + 1.7 * mesh.ZORD( i );
+    int threads[] = { 1, 3, 8 };
+    for( int t = 0; t < 3; t++ )
+    {
+#ifdef _OPENMP
+        omp_set_num_threads( threads[t] );
+#endif
+        compact.smoothGradient( &phi[0], &gx[0], &gy[0], &gz[0] );
+        for( int i = 0; i < n; i++ )
+        {
+            BOOST_REQUIRE_CLOSE( gx[i], 0.3, 1e-9 );
+            BOOST_REQUIRE_CLOSE( gy[i], -0.2, 1e-9 );
+            BOOST_REQUIRE_CLOSE( gz[i], 1.7, 1e-9 );
+        }
+    }
+
+    mesh.XORD( 3, 4, 2 ) += 1.0;
+    compact.initialize( &mesh, ElementGeometry::compact );
+    BOOST_CHECK( compact.get_layout() == ElementGeometry::full );
+}
+
+/**
+* The single precision matrix vector product and ParallelSSOR factors must
+* agree with the double ones to float accuracy, and iterative refinement with
+* them must reach the double precision solution.
+*/
+BOOST_AUTO_TEST_CASE( single_precision )
+{
+    std::vector<int> row_ptr, col_ind;
+    std::vector<double> val;
+    BuildTestMatrix( 6, 9, 5, row_ptr, col_ind, val );
+    int n = row_ptr.size() - 1;
+    char matdescra[6] = { 's', 'u', 'n', 'c', 0, 0 };
+
+    std::vector<float> valf( val.size() );
+    std::vector<double> valRounded( val.size() );
+    for( size_t i = 0; i < val.size(); i++ )
+    {
+        valf[i] = (float)val[i];
+        valRounded[i] = valf[i];
+    }
+
+    std::vector<double> x( n ), y( n ), yRef( n ), r( n );
+    for( int i = 0; i < n; i++ )
+    {
+        x[i] = std::sin( 0.37 * i ) + 0.5;
+        r[i] = std::cos( 0.11 * i );
+    }
+    symmetricCsrMatVec( n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1], &x[0], &yRef[0] );
+    symmetricCsrMatVec( n, &valf[0], &col_ind[0], &row_ptr[0], &row_ptr[1], &x[0], &y[0] );
+    double normRef = std::sqrt( Dot( &yRef[0], &yRef[0], n ) );
+    for( int i = 0; i < n; i++ )
+        BOOST_REQUIRE( std::fabs( y[i] - yRef[i] ) < 1e-6 * normRef );
+
+    double rx = 0.0;
+    double xAx = symmetricCsrMatVecDot( n, &valf[0], &col_ind[0], &row_ptr[0], &row_ptr[1],
+                                        &x[0], &y[0], &r[0], &rx );
+    BOOST_CHECK_CLOSE( xAx, Dot( &x[0], &yRef[0], n ), 1e-4 );
+    BOOST_CHECK_CLOSE( rx, Dot( &r[0], &x[0], n ), 1e-10 );
+
+    Preconditioner ssor, ssorSingle;
+    ssorSingle.set_singlePrecision( true );
+    BOOST_REQUIRE( ssor.initialize( n, &val[0], &row_ptr[0], &col_ind[0],
+                                    Preconditioner::ParallelSSOR, matdescra ) );
+    BOOST_REQUIRE( ssorSingle.initialize( n, &val[0], &row_ptr[0], &col_ind[0],
+                                          Preconditioner::ParallelSSOR, matdescra ) );
+    std::vector<double> z( n ), zRef( n );
+    ssor.solve( &r[0], &zRef[0], &row_ptr[0], &col_ind[0] );
+    ssorSingle.solve( &r[0], &z[0], &row_ptr[0], &col_ind[0] );
+    double normZ = std::sqrt( Dot( &zRef[0], &zRef[0], n ) );
+    for( int i = 0; i < n; i++ )
+        BOOST_REQUIRE( std::fabs( z[i] - zRef[i] ) < 1e-6 * normZ );
+
+    //refinement: corrections from the rounded matrix, residuals from the double one
+    std::vector<double> b( yRef ), xRef( n, 0.0 ), xMixed( n, 0.0 ), d( n );
+    BOOST_REQUIRE( SolvePCG( row_ptr, col_ind, val, ssor, b, xRef, 1e-12 ) > 0 );
+    double resid = 1.0;
+    int steps;
+    for( steps = 0; steps < 5 && resid > 1e-12; steps++ )
+    {
+        symmetricCsrMatVec( n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1], &xMixed[0], &r[0] );
+        for( int i = 0; i < n; i++ )
+        {
+            r[i] = b[i] - r[i];
+            d[i] = 0.0;
+        }
+        resid = std::sqrt( Dot( &r[0], &r[0], n ) ) / normRef;
+        if( resid <= 1e-12 )
+            break;
+        BOOST_REQUIRE( SolvePCG( row_ptr, col_ind, valRounded, ssorSingle, r, d, 1e-6 ) >= 0 );
+        for( int i = 0; i < n; i++ )
+            xMixed[i] += d[i];
+    }
+    BOOST_CHECK( resid <= 1e-12 );
+    BOOST_CHECK( steps <= 4 );
+    double normX = std::sqrt( Dot( &xRef[0], &xRef[0], n ) );
+    for( int i = 0; i < n; i++ )
+        BOOST_REQUIRE( std::fabs( xMixed[i] - xRef[i] ) < 1e-9 * normX );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/******************************************************************************
+*                        END "SOLVER" BOOST TEST SUITE
+*****************************************************************************/
@@ -0,0 +1,99 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Test the trace of the runs
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#include "ninjaTrace.h"
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "TRACE" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       trace/json_samples
+******************************************************************************/
+
+/*
+** Number of times text appears in s.
+*/
+static int CountText( const std::string &s, const std::string &text )
+{
+    int n = 0;
+    for( size_t pos = s.find( text ); pos != std::string::npos; pos = s.find( text, pos + 1 ) )
+        n++;
+    return n;
+}
+
+BOOST_AUTO_TEST_SUITE( trace )
+
+/**
+* Test that two series of samples recorded in turns, as the refinement and
+* the inner iterations of the single precision solver do, are written as
+* one list each, and that non-finite values are written as null.
+*/
+BOOST_AUTO_TEST_CASE( json_samples )
+{
+    std::string fileName = CPLGenerateTempFilename( "trace" );
+    CPLSetConfigOption( "NINJA_TRACE_FILE", fileName.c_str() );
+    CPLSetConfigOption( "NINJA_TRACE_FORMAT", "JSON" );
+    NinjaTrace::start();
+    CPLSetConfigOption( "NINJA_TRACE_FILE", NULL );
+    CPLSetConfigOption( "NINJA_TRACE_FORMAT", NULL );
+    BOOST_REQUIRE( NinjaTrace::isEnabled() );
+
+    NinjaTrace::addSample( 0, "residual", 1, 0.5 );
+    NinjaTrace::addSample( 0, "residual", 2, 0.25 );
+    NinjaTrace::addSample( 0, "refinement_residual", 1, 0.125 );
+    NinjaTrace::addSample( 0, "residual", 3, 0.0625 );
+    NinjaTrace::addSample( 0, "refinement_residual", 2, std::numeric_limits<double>::quiet_NaN() );
+    BOOST_REQUIRE( NinjaTrace::finish() );
+
+    std::string json;
+    FILE *fp = fopen( fileName.c_str(), "rb" );
+    BOOST_REQUIRE( fp != NULL );
+    int c;
+    while( ( c = fgetc( fp ) ) != EOF )
+        json += (char)c;
+    fclose( fp );
+    VSIUnlink( fileName.c_str() );
+
+    BOOST_CHECK_EQUAL( CountText( json, "\"residual\":" ), 1 );
+    BOOST_CHECK_EQUAL( CountText( json, "\"refinement_residual\":" ), 1 );
+    BOOST_CHECK_EQUAL( CountText( json, "\"residual\": [[1, 0.5], [2, 0.25], [3, 0.0625]]" ), 1 );
+    BOOST_CHECK_EQUAL( CountText( json, "\"refinement_residual\": [[1, 0.125], [2, null]]" ), 1 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/******************************************************************************
+*                        END "TRACE" BOOST TEST SUITE
+*****************************************************************************/
@@ -0,0 +1,269 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Element loop gather benchmark for the 3d field layouts
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+
+/*
+** Times the gather of u0, v0 and w0 at the 8 nodes of every element, the
+** access pattern of the element loops in ninja::discretize(), for the storage
+** choices of the 3d fields:
+**
+**   layers      wn_3dArray, layer major (the node numbering)
+**   packed      u0, v0, w0 interleaved node by node
+**                (wn_3dScalarField::packInterleaved())
+**
+** The mesh sizes are computed from the DEMs the same way as in bench_spmv.
+** Each element does 8 quadrature points of 24 multiply-adds on the gathered
+** values, so the timing is of the gather, not the arithmetic.  Reports time
+** per sweep and million elements per second.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <vector>
+
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+
+#include "wn_3dArray.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+void Usage()
+{
+    printf("bench_fields [--layers n] [--iterations n] [--threads n]\n");
+    printf("             dem_file [dem_file ...]\n");
+    printf("Example:\n");
+    printf("  bench_fields data/big_butte.tif\n");
+    exit(1);
+}
+
+static double WallTime()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+** Row and column offsets of the local nodes of an element, the order of
+** Mesh::get_global_node().
+*/
+static const int nodeI[8] = {0, 0, 1, 1, 0, 0, 1, 1};
+static const int nodeJ[8] = {0, 1, 1, 0, 0, 1, 1, 0};
+static const int nodeK[8] = {0, 0, 0, 0, 1, 1, 1, 1};
+
+/* Stand-in for the shape function derivatives at the quadrature points */
+static double dN[8][3][8];
+
+static double QuadratureSum(const double *u, const double *v, const double *w)
+{
+    double h = 0.0;
+    for(int q = 0; q < 8; q++)
+        for(int k = 0; k < 8; k++)
+            h += dN[q][0][k] * u[k] + dN[q][1][k] * v[k] + dN[q][2][k] * w[k];
+    return h;
+}
+
+static double SweepArrays(const wn_3dArray &u0, const wn_3dArray &v0,
+                          const wn_3dArray &w0)
+{
+    int nrowsElem = u0.rows_ - 1;
+    int ncolsElem = u0.cols_ - 1;
+    int nlayersElem = u0.layers_ - 1;
+    double total = 0.0;
+    int i;
+#pragma omp parallel for reduction(+:total)
+    for(i = 0; i < nrowsElem; i++)
+    {
+        double u[8], v[8], w[8];
+        for(int k = 0; k < nlayersElem; k++)
+        {
+            for(int j = 0; j < ncolsElem; j++)
+            {
+                for(int n = 0; n < 8; n++)
+                {
+                    u[n] = u0(i + nodeI[n], j + nodeJ[n], k + nodeK[n]);
+                    v[n] = v0(i + nodeI[n], j + nodeJ[n], k + nodeK[n]);
+                    w[n] = w0(i + nodeI[n], j + nodeJ[n], k + nodeK[n]);
+                }
+                total += QuadratureSum(u, v, w);
+            }
+        }
+    }
+    return total;
+}
+
+static double SweepPacked(const double *uvw0, int nrows, int ncols, int nlayers)
+{
+    double total = 0.0;
+    int i;
+#pragma omp parallel for reduction(+:total)
+    for(i = 0; i < nrows - 1; i++)
+    {
+        double u[8], v[8], w[8];
+        for(int k = 0; k < nlayers - 1; k++)
+        {
+            for(int j = 0; j < ncols - 1; j++)
+            {
+                for(int n = 0; n < 8; n++)
+                {
+                    int node = (k + nodeK[n]) * nrows * ncols + (i + nodeI[n]) * ncols + j + nodeJ[n];
+                    u[n] = uvw0[3 * node];
+                    v[n] = uvw0[3 * node + 1];
+                    w[n] = uvw0[3 * node + 2];
+                }
+                total += QuadratureSum(u, v, w);
+            }
+        }
+    }
+    return total;
+}
+
+static void Report(const char *name, double t, int nElements)
+{
+    printf("    %-10s %10.3f ms %10.3f Melem/s\n", name, t * 1000.0,
+           nElements / t * 1e-6);
+}
+
+int main(int argc, char *argv[])
+{
+    int nLayers = 20;
+    int nIterations = 20;
+    std::vector<const char*> demFiles;
+
+    int i = 1;
+    while(i < argc)
+    {
+        if(EQUAL(argv[i], "--layers") && i + 1 < argc)
+            nLayers = atoi(argv[++i]);
+        else if(EQUAL(argv[i], "--iterations") && i + 1 < argc)
+            nIterations = atoi(argv[++i]);
+        else if(EQUAL(argv[i], "--threads") && i + 1 < argc)
+        {
+#ifdef _OPENMP
+            omp_set_num_threads(atoi(argv[++i]));
+#else
+            i++;
+#endif
+        }
+        else if(EQUAL(argv[i], "--help") || EQUAL(argv[i], "-h"))
+            Usage();
+        else
+            demFiles.push_back(argv[i]);
+        i++;
+    }
+    if(demFiles.empty() || nLayers < 2 || nIterations < 1)
+        Usage();
+
+    GDALAllRegister();
+
+    int nThreads = 1;
+#ifdef _OPENMP
+    nThreads = omp_get_max_threads();
+#endif
+    printf("threads: %d, layers: %d, iterations: %d\n", nThreads, nLayers, nIterations);
+
+    for(int q = 0; q < 8; q++)
+        for(int c = 0; c < 3; c++)
+            for(int k = 0; k < 8; k++)
+                dN[q][c][k] = 0.001 * (q + 1) * (c + 1) - 0.0001 * k;
+
+    const char *meshNames[] = {"coarse", "medium", "fine"};
+    const int targetCells[] = {4000, 10000, 20000};    //see Mesh::Mesh()
+
+    for(unsigned int d = 0; d < demFiles.size(); d++)
+    {
+        GDALDataset *poDS = (GDALDataset*)GDALOpen(demFiles[d], GA_ReadOnly);
+        if(poDS == NULL)
+        {
+            fprintf(stderr, "Could not open %s\n", demFiles[d]);
+            continue;
+        }
+        double adfGeoTransform[6];
+        poDS->GetGeoTransform(adfGeoTransform);
+        double cellSize = fabs(adfGeoTransform[1]);
+        double xLength = (poDS->GetRasterXSize() + 1) * cellSize;
+        double yLength = (poDS->GetRasterYSize() + 1) * cellSize;
+        GDALClose((GDALDatasetH)poDS);
+
+        printf("%s\n", demFiles[d]);
+        for(int m = 0; m < 3; m++)
+        {
+            //same as Mesh::compute_cellsize()
+            double nXcells = 2 * sqrt((double)targetCells[m]) * (xLength / (xLength + yLength));
+            double nYcells = 2 * sqrt((double)targetCells[m]) * (yLength / (xLength + yLength));
+            double resolution = (xLength / nXcells + yLength / nYcells) / 2;
+            int ncols = (int)(xLength / resolution + 0.5);
+            int nrows = (int)(yLength / resolution + 0.5);
+            int nElements = (nrows - 1) * (ncols - 1) * (nLayers - 1);
+            int nNodes = nrows * ncols * nLayers;
+
+            wn_3dArray layers[3];
+            std::vector<double> packed(3 * nNodes);
+            for(int c = 0; c < 3; c++)
+            {
+                layers[c].allocate(nrows, ncols, nLayers);
+                for(int n = 0; n < nNodes; n++)
+                {
+                    layers[c](n) = 1.0 + 0.001 * ((n + c) % 101);
+                    packed[3 * n + c] = layers[c](n);
+                }
+            }
+
+            printf("  %s mesh: %d x %d x %d, %d elements\n", meshNames[m],
+                   nrows, ncols, nLayers, nElements);
+
+            double sum[2], t[2], start;
+            sum[0] = SweepArrays(layers[0], layers[1], layers[2]);    //warm up
+            start = WallTime();
+            for(int it = 0; it < nIterations; it++)
+                sum[0] = SweepArrays(layers[0], layers[1], layers[2]);
+            t[0] = (WallTime() - start) / nIterations;
+
+            sum[1] = SweepPacked(&packed[0], nrows, ncols, nLayers);
+            start = WallTime();
+            for(int it = 0; it < nIterations; it++)
+                sum[1] = SweepPacked(&packed[0], nrows, ncols, nLayers);
+            t[1] = (WallTime() - start) / nIterations;
+
+            Report("layers", t[0], nElements);
+            Report("packed", t[1], nElements);
+            if(fabs(sum[1] - sum[0]) > 1e-9 * fabs(sum[0]))
+                fprintf(stderr, "  layouts do not agree: %g %g\n", sum[0], sum[1]);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Micro-benchmark for the symmetric sparse matrix-vector product
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+
+/*
+** Times the symmetric CRS matrix-vector product used by the conjugate gradient
+** solver on matrices the size WindNinja builds for the given DEMs.
+**
+** For each DEM the horizontal mesh size is computed the same way
+** Mesh::compute_cellsize() does for the coarse, medium and fine mesh choices,
+** with 20 vertical layers.  The matrix has the 27 point pattern of the
+** stiffness matrix, only the upper triangle stored.  The values do not matter
+** for the timing.
+**
+** Reports time per product, GFLOP/s and the effective memory bandwidth for
+** the serial transpose reference and the parallel kernel.  The bandwidth
+** counts each array as read (or written) once per product: val and col_ind,
+** row_ptr, x and y.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <vector>
+
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+
+#include "sparseMatVec.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef void (*MatVecFunc)(int, const double *, const int *, const int *,
+                           const int *, const double *, double *);
+
+void Usage()
+{
+    printf("bench_spmv [--layers n] [--iterations n] [--threads n]\n");
+    printf("           dem_file [dem_file ...]\n");
+    printf("Example:\n");
+    printf("  bench_spmv data/big_butte.tif data/missoula_valley.tif\n");
+    exit(1);
+}
+
+static double WallTime()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+** Build the upper triangle of the 27 point stiffness matrix pattern, the same
+** layout as ninja::buildSparsityPattern().
+*/
+static void BuildMatrix(int nrows, int ncols, int nlayers,
+                        std::vector<int> &row_ptr, std::vector<int> &col_ind,
+                        std::vector<double> &val)
+{
+    int n = nrows * ncols * nlayers;
+    row_ptr.assign(n + 1, 0);
+    col_ind.clear();
+    val.clear();
+    col_ind.reserve((size_t)n * 14);
+    val.reserve((size_t)n * 14);
+    for(int k = 0; k < nlayers; k++)
+    {
+        for(int i = 0; i < nrows; i++)
+        {
+            for(int j = 0; j < ncols; j++)
+            {
+                int row = k * nrows * ncols + i * ncols + j;
+                row_ptr[row] = col_ind.size();
+                for(int kk = k - 1; kk <= k + 1; kk++)
+                {
+                    for(int ii = i - 1; ii <= i + 1; ii++)
+                    {
+                        for(int jj = j - 1; jj <= j + 1; jj++)
+                        {
+                            if(kk < 0 || kk >= nlayers || ii < 0 || ii >= nrows ||
+                               jj < 0 || jj >= ncols)
+                                continue;
+                            int col = kk * nrows * ncols + ii * ncols + jj;
+                            if(col < row)
+                                continue;
+                            col_ind.push_back(col);
+                            val.push_back(col == row ? 26.0 : -1.0);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    row_ptr[n] = col_ind.size();
+}
+
+static void TimeKernel(const char *name, MatVecFunc f, int nIterations,
+                       std::vector<int> &row_ptr, std::vector<int> &col_ind,
+                       std::vector<double> &val, std::vector<double> &x,
+                       std::vector<double> &y)
+{
+    int n = row_ptr.size() - 1;
+    int nnz = col_ind.size();
+
+    f(n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1], &x[0], &y[0]);    //warm up
+
+    double start = WallTime();
+    for(int it = 0; it < nIterations; it++)
+        f(n, &val[0], &col_ind[0], &row_ptr[0], &row_ptr[1], &x[0], &y[0]);
+    double t = (WallTime() - start) / nIterations;
+
+    //the diagonal is one multiply-add, the off diagonal entries two each
+    double flops = 2.0 * n + 4.0 * (nnz - n);
+    double bytes = nnz * (sizeof(double) + sizeof(int)) +
+                   (n + 1) * sizeof(int) + 2.0 * n * sizeof(double);
+
+    printf("    %-10s %10.3f ms %8.3f GFLOP/s %8.3f GB/s\n", name, t * 1000.0,
+           flops / t * 1e-9, bytes / t * 1e-9);
+}
+
+int main(int argc, char *argv[])
+{
+    int nLayers = 20;
+    int nIterations = 50;
+    std::vector<const char*> demFiles;
+
+    int i = 1;
+    while(i < argc)
+    {
+        if(EQUAL(argv[i], "--layers") && i + 1 < argc)
+            nLayers = atoi(argv[++i]);
+        else if(EQUAL(argv[i], "--iterations") && i + 1 < argc)
+            nIterations = atoi(argv[++i]);
+        else if(EQUAL(argv[i], "--threads") && i + 1 < argc)
+        {
+#ifdef _OPENMP
+            omp_set_num_threads(atoi(argv[++i]));
+#else
+            i++;
+#endif
+        }
+        else if(EQUAL(argv[i], "--help") || EQUAL(argv[i], "-h"))
+            Usage();
+        else
+            demFiles.push_back(argv[i]);
+        i++;
+    }
+    if(demFiles.empty() || nLayers < 2 || nIterations < 1)
+        Usage();
+
+    GDALAllRegister();
+
+    int nThreads = 1;
+#ifdef _OPENMP
+    nThreads = omp_get_max_threads();
+#endif
+    printf("threads: %d, layers: %d, iterations: %d\n", nThreads, nLayers, nIterations);
+
+    const char *meshNames[] = {"coarse", "medium", "fine"};
+    const int targetCells[] = {4000, 10000, 20000};    //see Mesh::Mesh()
+
+    for(unsigned int d = 0; d < demFiles.size(); d++)
+    {
+        GDALDataset *poDS = (GDALDataset*)GDALOpen(demFiles[d], GA_ReadOnly);
+        if(poDS == NULL)
+        {
+            fprintf(stderr, "Could not open %s\n", demFiles[d]);
+            continue;
+        }
+        double adfGeoTransform[6];
+        poDS->GetGeoTransform(adfGeoTransform);
+        double cellSize = fabs(adfGeoTransform[1]);
+        double xLength = (poDS->GetRasterXSize() + 1) * cellSize;
+        double yLength = (poDS->GetRasterYSize() + 1) * cellSize;
+        GDALClose((GDALDatasetH)poDS);
+
+        printf("%s\n", demFiles[d]);
+        for(int m = 0; m < 3; m++)
+        {
+            //same as Mesh::compute_cellsize()
+            double nXcells = 2 * sqrt((double)targetCells[m]) * (xLength / (xLength + yLength));
+            double nYcells = 2 * sqrt((double)targetCells[m]) * (yLength / (xLength + yLength));
+            double resolution = (xLength / nXcells + yLength / nYcells) / 2;
+            int ncols = (int)(xLength / resolution + 0.5);
+            int nrows = (int)(yLength / resolution + 0.5);
+
+            std::vector<int> row_ptr, col_ind;
+            std::vector<double> val;
+            BuildMatrix(nrows, ncols, nLayers, row_ptr, col_ind, val);
+            int n = row_ptr.size() - 1;
+            std::vector<double> x(n), y(n);
+            for(int j = 0; j < n; j++)
+                x[j] = 1.0 + 0.001 * (j % 101);
+
+            printf("  %s mesh: %d x %d x %d, %d nodes, %d nonzeros\n", meshNames[m],
+                   nrows, ncols, nLayers, n, (int)col_ind.size());
+            TimeKernel("serial", symmetricCsrMatVecSerial, nIterations,
+                       row_ptr, col_ind, val, x, y);
+            TimeKernel("parallel", symmetricCsrMatVec, nIterations,
+                       row_ptr, col_ind, val, x, y);
+        }
+    }
+
+    return 0;
+}
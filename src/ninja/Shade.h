@@ -33,6 +33,7 @@
 #include "ascii_grid.h"
 #include "Elevation.h"
 #include "ninjaMathUtility.h"
+#include "horizonMap.h"
 //#include <conio.h>  // This can be taken out!! only here for debugging...
 #include <stdio.h>  // This can be taken out!! only here for debugging...
 
@@ -76,13 +76,20 @@ void surfProperties::deallocate()
 
 bool surfProperties::resample_in_place(double resampleCellSize, AsciiGrid<double>::interpTypeEnum interpType)
 {
-	Roughness.resample_Grid_in_place(resampleCellSize, interpType);
-	Rough_d.resample_Grid_in_place(resampleCellSize, interpType);
-	Rough_h.resample_Grid_in_place(resampleCellSize, interpType);
-	Albedo.resample_Grid_in_place(resampleCellSize, interpType);
-	Bowen.resample_Grid_in_place(resampleCellSize, interpType);
-	Cg.resample_Grid_in_place(resampleCellSize, interpType);
-	Anthropogenic.resample_Grid_in_place(resampleCellSize, interpType);
+	if(Roughness.get_cellSize() == resampleCellSize)
+		return true;
+
+	//the grids share the geometry of the dem, so the index and weight
+	//tables are computed once for all of them
+	GridResampler resampler = Roughness.get_resampler(resampleCellSize, interpType);
+
+	Roughness.resample_Grid_in_place(resampler);
+	Rough_d.resample_Grid_in_place(resampler);
+	Rough_h.resample_Grid_in_place(resampler);
+	Albedo.resample_Grid_in_place(resampler);
+	Bowen.resample_Grid_in_place(resampler);
+	Cg.resample_Grid_in_place(resampler);
+	Anthropogenic.resample_Grid_in_place(resampler);
 
 	return true;
 }
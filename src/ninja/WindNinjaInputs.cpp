@@ -193,6 +193,7 @@ WindNinjaInputs::WindNinjaInputs(const WindNinjaInputs &rhs)
   inputWindHeight = rhs.inputWindHeight;
   outputWindHeightUnits = rhs.outputWindHeightUnits;
   outputWindHeight = rhs.outputWindHeight;
+  extraOutputWindHeights = rhs.extraOutputWindHeights;
   
   realStations=rhs.realStations;
 
@@ -387,6 +388,7 @@ WindNinjaInputs &WindNinjaInputs::operator=(const WindNinjaInputs &rhs)
       inputWindHeight = rhs.inputWindHeight;
       outputWindHeightUnits = rhs.outputWindHeightUnits;
       outputWindHeight = rhs.outputWindHeight;
+      extraOutputWindHeights = rhs.extraOutputWindHeights;
       
       
       stations = rhs.stations;
@@ -142,6 +142,7 @@ public:
     double inputWindHeight;		//height of input wind above the top of the vegetation (always stored in meters!)
     lengthUnits::eLengthUnits outputWindHeightUnits;	//units of outputWindHeight when read in (always stored in meters!)
     double outputWindHeight;		//height of output wind above the top of the vegetation (always stored in meters!)
+    std::vector<double> extraOutputWindHeights;	//more output heights interpolated from the same solution (meters)
     bool stationFetch;
 //    std::vector<std::vector<wxStationList> > vecStations;
     std::vector<wxStation> stations;		//array of weather stations used in point initialization
@@ -0,0 +1,140 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Assigns the runs of a ninjaArmy and the threads they use
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "armyScheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+/**
+ * @param nRuns Number of runs in the army.
+ * @param numProcessors Number of threads for the whole army.
+ */
+ArmyScheduler::ArmyScheduler(int nRuns, int numProcessors)
+{
+    nRuns_ = std::max(nRuns, 0);
+    numProcessors_ = std::max(numProcessors, 1);
+
+    int threadsPerRun = atoi(CPLGetConfigOption("NINJA_ARMY_THREADS_PER_RUN", "0"));
+    if(threadsPerRun < 1)
+        threadsPerRun = std::max(1, numProcessors_ / std::max(nRuns_, 1));
+    threadsPerRun = std::min(threadsPerRun, numProcessors_);
+
+    nWorkers_ = std::max(1, std::min(nRuns_, numProcessors_ / threadsPerRun));
+
+    //runs that hold their grids, mesh and fields at the same time
+    int maxRunsInMemory = atoi(CPLGetConfigOption("NINJA_ARMY_MAX_RUNS_IN_MEMORY", "0"));
+    if(maxRunsInMemory > 0)
+        nWorkers_ = std::min(nWorkers_, maxRunsInMemory);
+
+    nextRun_ = 0;
+    nFinished_ = 0;
+    freeThreads_ = numProcessors_;
+    idleWorkers_ = nWorkers_;
+
+    startTime_ = wallTime();
+    lastFinishTime_ = startTime_;
+}
+
+/**
+ * @return The number of threads of the outer parallel region, that is the
+ *         maximum number of runs done at the same time.
+ */
+int ArmyScheduler::get_numWorkers() const
+{
+    return nWorkers_;
+}
+
+/**
+ * Take the next run.  Called by the worker threads when they are idle.
+ * @param run Set to the index of the run to do.
+ * @param nThreads Set to the number of threads to do it with, which must be
+ *        given back with finishRun().
+ * @return False if all runs are taken.
+ */
+bool ArmyScheduler::nextRun(int &run, int &nThreads)
+{
+    bool found = false;
+#pragma omp critical(armyScheduler)
+    {
+        if(nextRun_ < nRuns_)
+        {
+            run = nextRun_++;
+            int nShares = std::max(1, std::min(idleWorkers_, nRuns_ - run));
+            nThreads = std::max(1, freeThreads_ / nShares);
+            freeThreads_ -= nThreads;
+            idleWorkers_--;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * Give back the threads of a run taken with nextRun().
+ */
+void ArmyScheduler::finishRun(int nThreads)
+{
+    double now = wallTime();
+#pragma omp critical(armyScheduler)
+    {
+        freeThreads_ += nThreads;
+        idleWorkers_++;
+        nFinished_++;
+        lastFinishTime_ = std::max(lastFinishTime_, now);
+    }
+}
+
+/**
+ * @return Seconds from the construction to the end of the last finished run.
+ */
+double ArmyScheduler::get_elapsedSeconds() const
+{
+    return lastFinishTime_ - startTime_;
+}
+
+/**
+ * @return Finished runs per minute of wall clock time.
+ */
+double ArmyScheduler::get_runsPerMinute() const
+{
+    double elapsed = get_elapsedSeconds();
+    if(elapsed <= 0.0)
+        return 0.0;
+    return 60.0 * nFinished_ / elapsed;
+}
+
+double ArmyScheduler::wallTime()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)time(NULL);
+#endif
+}
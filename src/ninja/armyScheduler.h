@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Assigns the runs of a ninjaArmy and the threads they use
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef ARMY_SCHEDULER_H
+#define ARMY_SCHEDULER_H
+
+#include "cpl_conv.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Hands out the runs of a ninjaArmy to a team of worker threads and splits
+ * the processors between the concurrent runs and the OpenMP loops inside
+ * each run (nested parallelism).
+ *
+ * The number of workers is numProcessors / threads per run, where the
+ * threads per run are NINJA_ARMY_THREADS_PER_RUN or, if that is not set,
+ * numProcessors / number of runs (so 5 runs on 32 processors are 5 runs of
+ * 6 threads and 100 runs on 8 processors are 8 runs of 1 thread).
+ * NINJA_ARMY_MAX_RUNS_IN_MEMORY caps the number of workers, the processors
+ * are then split between fewer, wider runs.
+ *
+ * The ninjas of an army only read their inputs and allocate the mesh and
+ * fields in simulate_wind() and are deleted by ninjaArmy::startRuns() as
+ * soon as the run is done, so the memory of an army is that of the runs in
+ * progress: at most get_numWorkers(), however many time steps it has.
+ *
+ * Workers take the next run as soon as they are idle (nextRun()), so a
+ * cheap run does not hold up the runs behind it as a static schedule would.
+ * The threads of a run are decided when it is taken: the free processors
+ * divided between the idle workers, or the runs left if there are fewer.
+ * Towards the end of an army the last runs get the processors of the
+ * workers that have nothing left to do.
+ */
+class ArmyScheduler
+{
+public:
+    ArmyScheduler(int nRuns, int numProcessors);
+
+    int get_numWorkers() const;
+
+    bool nextRun(int &run, int &nThreads);
+    void finishRun(int nThreads);
+
+    double get_elapsedSeconds() const;
+    double get_runsPerMinute() const;
+
+private:
+    int nRuns_;
+    int numProcessors_;
+    int nWorkers_;
+
+    int nextRun_;           //first run not taken yet
+    int nFinished_;
+    int freeThreads_;       //processors not used by a running run
+    int idleWorkers_;
+
+    double startTime_;
+    double lastFinishTime_;
+
+    static double wallTime();
+};
+
+#endif  //ARMY_SCHEDULER_H
@@ -0,0 +1,273 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Fast formatting and parsing of ASCII grid values
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+
+#ifndef ASCII_GRID_TEXT_H
+#define ASCII_GRID_TEXT_H
+
+#include <string>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include "cpl_port.h"
+
+/**
+ * Formatting and parsing of the values of AAIGrid (.asc) files.
+ *
+ * format_fixed() gives the same text as printf("%.<decimals>f") in the C
+ * locale: the exact binary value is scaled to an integer number of
+ * 1/10^decimals and rounded half to even, like printf does, with integer
+ * arithmetic.  Values of 2^52 or more, infinities and NaN go to sprintf.
+ *
+ * parse_double() gives the same values as scanf("%lf"): numbers of up to
+ * 19 significant digits and a power of ten up to 22 are converted with one
+ * exact multiplication or division (Clinger's fast path), which is
+ * correctly rounded, and the others go to strtod().
+ */
+class AsciiGridText
+{
+public:
+    /**
+     * Size of the buffer the format functions need.  %.3f of DBL_MAX is
+     * 314 characters long.
+     */
+    static const int maxLength = 320;
+
+    /**
+     * Writes v with the given number of decimals (0 to 3).
+     * @param out Buffer of maxLength characters, not null terminated.
+     * @param v Value.
+     * @param decimals Number of decimals.
+     * @return Number of characters written.
+     */
+    static inline int format_fixed(char *out, double v, int decimals)
+    {
+        static const GUIntBig scale[] = {1, 10, 100, 1000};
+
+        double a = std::fabs(v);
+        if(!(a < 4503599627370496.0) || decimals < 0 || decimals > 3)
+            return sprintf(out, "%.*f", decimals, v);
+
+        //a = m * 2^-shift, shift is at least 2 as a < 2^52
+        int e;
+        GUIntBig m = (GUIntBig)std::ldexp(std::frexp(a, &e), 53);
+        int shift = 53 - e;
+
+        //q = a * 10^decimals rounded half to even, m * 1000 < 2^63
+        GUIntBig n = m * scale[decimals];
+        GUIntBig q = 0;
+        if(shift < 64)
+        {
+            GUIntBig one = 1;
+            GUIntBig r = n & ((one << shift) - 1);
+            GUIntBig half = one << (shift - 1);
+            q = n >> shift;
+            if(r > half || (r == half && (q & 1)))
+                q++;
+        }
+
+        char *p = out;
+        if(v < 0.0 || (v == 0.0 && 1.0 / v < 0.0))    //printf keeps the sign of -0.0 and of values rounded to 0
+            *p++ = '-';
+        p += format_unsigned(p, q / scale[decimals]);
+        if(decimals > 0)
+        {
+            GUIntBig f = q % scale[decimals];
+            *p = '.';
+            for(int k = decimals; k > 0; k--)
+            {
+                p[k] = (char)('0' + f % 10);
+                f /= 10;
+            }
+            p += decimals + 1;
+        }
+        return (int)(p - out);
+    }
+
+    /**
+     * Writes v as printf("%d") does.
+     * @param out Buffer of maxLength characters, not null terminated.
+     * @param v Value.
+     * @return Number of characters written.
+     */
+    static inline int format_int(char *out, int v)
+    {
+        if(v < 0)
+        {
+            *out = '-';
+            return 1 + format_unsigned(out + 1, (GUIntBig)(-(GIntBig)v));
+        }
+        return format_unsigned(out, (GUIntBig)v);
+    }
+
+    /**
+     * Reads the number at p, after any white space, and moves p past it.
+     * @param p Position in a null terminated text.
+     * @param value Number read.
+     * @return false if the text ends or is not a number at p.
+     */
+    static inline bool parse_double(const char *&p, double &value)
+    {
+        static const double power10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+                                         1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+                                         1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+                                         1e19, 1e20, 1e21, 1e22};
+
+        const char *s = skip_space(p);
+        if(*s == '\0')
+            return false;
+
+        const char *q = s;
+        bool negative = (*q == '-');
+        if(*q == '-' || *q == '+')
+            q++;
+
+        GUIntBig m = 0;
+        int digits = 0;         //significant digits in m
+        int exp10 = 0;
+        bool any = false;
+        bool fast = true;
+        for(; is_digit(*q); q++)
+        {
+            any = true;
+            if(m == 0 && *q == '0')
+                continue;
+            if(digits == 19)
+                fast = false;
+            else
+            {
+                m = m * 10 + (*q - '0');
+                digits++;
+            }
+        }
+        if(*q == '.')
+        {
+            for(q++; is_digit(*q); q++)
+            {
+                any = true;
+                if(m == 0 && *q == '0')
+                {
+                    exp10--;
+                    continue;
+                }
+                if(digits == 19)
+                    fast = false;
+                else
+                {
+                    m = m * 10 + (*q - '0');
+                    digits++;
+                    exp10--;
+                }
+            }
+        }
+        if(*q == 'e' || *q == 'E')
+        {
+            const char *t = q + 1;
+            bool negativeExp = (*t == '-');
+            if(*t == '-' || *t == '+')
+                t++;
+            if(!is_digit(*t))
+                fast = false;
+            int e = 0;
+            for(; is_digit(*t); t++)
+            {
+                if(e < 10000)
+                    e = e * 10 + (*t - '0');
+            }
+            exp10 += negativeExp ? -e : e;
+            q = t;
+        }
+        if(!any || (*q != '\0' && !is_space(*q)))
+            fast = false;
+
+        if(fast && m == 0)
+        {
+            value = negative ? -0.0 : 0.0;
+            p = q;
+            return true;
+        }
+        if(fast && m <= ((GUIntBig)1 << 53) && exp10 >= -22 && exp10 <= 22)
+        {
+            double d = (double)m;
+            d = exp10 < 0 ? d / power10[-exp10] : d * power10[exp10];
+            value = negative ? -d : d;
+            p = q;
+            return true;
+        }
+
+        char *end;
+        value = strtod(s, &end);
+        if(end == s)
+            return false;
+        p = end;
+        return true;
+    }
+
+    /**
+     * Reads the word at p, after any white space, and moves p past it.
+     * @param p Position in a null terminated text.
+     * @return The word, empty if the text ends.
+     */
+    static inline std::string parse_word(const char *&p)
+    {
+        const char *s = skip_space(p);
+        p = s;
+        while(*p != '\0' && !is_space(*p))
+            p++;
+        return std::string(s, p - s);
+    }
+
+private:
+    static inline bool is_digit(char c) {return c >= '0' && c <= '9';}
+    static inline bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+    static inline const char *skip_space(const char *p)
+    {
+        while(is_space(*p))
+            p++;
+        return p;
+    }
+
+    static inline int format_unsigned(char *out, GUIntBig v)
+    {
+        char digits[24];
+        int n = 0;
+        do
+        {
+            digits[n++] = (char)('0' + v % 10);
+            v /= 10;
+        } while(v != 0);
+        for(int k = 0; k < n; k++)
+            out[k] = digits[n - 1 - k];
+        return n;
+    }
+};
+
+#endif /* ASCII_GRID_TEXT_H */
@@ -47,7 +47,11 @@
 #include "gdal.h"
 #include "gdal_priv.h"
 #include "cpl_port.h"
+#include "cpl_vsi.h"
 #include "Array2D.h"
+#include "asciiGridText.h"
+#include "gridResampler.h"
+#include "idwInterpolator.h"
 
 #include "ogr_spatialref.h" //nsw
 #include "gdal_version.h" //nsw
@@ -97,6 +101,7 @@ public:
         order1,
         order2,
         order3,
+        areaAverage,  /*!< Average of the cells covered, to coarsen a grid */
     };
 
     enum tiffType
@@ -161,9 +166,13 @@ public:
 
     AsciiGrid<T> resample_Grid(double resampleCellSize,
                                interpTypeEnum interpType);
+    AsciiGrid<T> resample_Grid(const GridResampler &resampler) const;
     void resample_Grid_in_place(double resampleCellSize,
                                 interpTypeEnum interpType);
     void resample_Grid_in_place(int arraySize, interpTypeEnum interpType);
+    void resample_Grid_in_place(const GridResampler &resampler);
+    GridResampler get_resampler(double resampleCellSize,
+                                interpTypeEnum interpType) const;
 
     void interpolateFromGrid(AsciiGrid &A, interpTypeEnum interpType);
 
@@ -497,28 +506,40 @@ bool AsciiGrid<T>::set_noDataValue(double nDV)
 template <class T>
 void AsciiGrid<T>::read_Grid(const std::string inputFile)
 {
-    char *krap;
-    krap = new char[5000];
-    std::string kkrap;
-    FILE *fin;
+    //read the whole file at once and parse it in memory
+    VSILFILE *fin;
 
-    if((fin = fopen(inputFile.c_str(), "r")) == NULL)
+    if((fin = VSIFOpenL(inputFile.c_str(), "rb")) == NULL)
         throw std::runtime_error("No input file found in AsciiGrid<T>::read_Grid().");
 
-    fscanf(fin, "%s", krap);
-    kkrap.assign(krap);
-    if((kkrap!="ncols") && (kkrap!="NCOLS"))
+    VSIFSeekL(fin, 0, SEEK_END);
+    size_t fileSize = (size_t)VSIFTellL(fin);
+    VSIFSeekL(fin, 0, SEEK_SET);
+    std::vector<char> text(fileSize + 1);
+    text[VSIFReadL(&text[0], 1, fileSize, fin)] = '\0';
+    VSIFCloseL(fin);
+
+    const char *p = &text[0];
+    std::string keyword = AsciiGridText::parse_word(p);
+    if((keyword!="ncols") && (keyword!="NCOLS"))
         throw std::runtime_error("File does not appear to be in the correct format in AsciiGrid<T>::read_Grid().");
 
-    int nCols,nRows;
-    T noDataValue;
+    //ncols, nrows, xllcorner, yllcorner, cellsize and NODATA_value
+    double header[6];
+    for(int k = 0; k < 6; k++)
+    {
+        if(k > 0)
+            AsciiGridText::parse_word(p);
+        if(!AsciiGridText::parse_double(p, header[k]))
+            throw std::runtime_error("File does not appear to be in the correct format in AsciiGrid<T>::read_Grid().");
+    }
 
-    fscanf(fin, "%d", &nCols);
-    fscanf(fin, "%s %d", krap, &nRows);
-    fscanf(fin, "%s %lf", krap, &xllCorner);
-    fscanf(fin, "%s %lf", krap, &yllCorner);
-    fscanf(fin, "%s %lf", krap, &cellSize);
-    fscanf(fin, "%s %lf", krap, &noDataValue);
+    int nCols = (int)header[0];
+    int nRows = (int)header[1];
+    xllCorner = header[2];
+    yllCorner = header[3];
+    cellSize = header[4];
+    T noDataValue = T(header[5]);
 
     data.setMatrix(nRows,nCols,noDataValue);
 
@@ -527,11 +548,11 @@ void AsciiGrid<T>::read_Grid(const std::string inputFile)
     {
         for (int j = 0;j < nCols;j++)
         {
-            fscanf(fin,"%lf",&value);
+            if(!AsciiGridText::parse_double(p, value))
+                throw std::runtime_error("File has too few values in AsciiGrid<T>::read_Grid().");
             data(i,j) = T(value);
         }
     }
-    fclose(fin);
 
     if(data.size() == 0)
         throw std::runtime_error("File has no data values in AsciiGrid<T>::read_Grid().");
@@ -760,26 +781,71 @@ AsciiGrid<T> AsciiGrid<T>::resample_Grid(double resampleCellSize, interpTypeEnum
             return *this;
     }
 
-    int newNumCols = int(xDim / resampleCellSize);
-    int newNumRows = int(yDim / resampleCellSize);
+    return resample_Grid(get_resampler(resampleCellSize, interpType));
+}
 
-    AsciiGrid<T>A(newNumCols, newNumRows, xllCorner, yllCorner, resampleCellSize, data.getNoDataValue(), data.getNoDataValue(), prjString);
+/**
+ * @brief Resample the grid with the tables of a resampler
+ * Several grids of the same geometry can share one resampler.
+ * @param resampler Resampler built for a grid of this geometry.
+ * @return The resampled grid.
+ */
+template <class T>
+AsciiGrid<T> AsciiGrid<T>::resample_Grid(const GridResampler &resampler) const
+{
+    if(!resampler.is_sourceGeometry(data.get_numCols(), data.get_numRows(),
+                                    xllCorner, yllCorner, cellSize))
+        throw std::logic_error("The resampler was built for another grid in AsciiGrid<T>::resample_Grid().");
 
-    double xC = 0;
-    double yC = 0;
+    AsciiGrid<T>A(resampler.get_nCols(), resampler.get_nRows(),
+                  resampler.get_xllCorner(), resampler.get_yllCorner(),
+                  resampler.get_cellSize(), data.getNoDataValue(),
+                  data.getNoDataValue(), prjString);
 
-    for(int i = 0;i < newNumRows;i++)
-    {
-        for(int j = 0;j < newNumCols;j++)
-        {
-            A.get_cellPosition(i, j, &xC, &yC);
+    resampler.resample(data, A.data);
 
-            A.set_cellValue(i, j, interpolateGrid(xC, yC, interpType));
-        }
-    }
     return A;
 }
 
+/**
+ * @brief Build the index and weight tables to resample the grid
+ * The resampled grid has the same lower left corner and covers as much of
+ * the grid as whole cells of resampleCellSize can.
+ * @param resampleCellSize Cell size of the resampled grid.
+ * @param interpType order0 (nearest), order1 (bilinear) or areaAverage.
+ * @return The resampler.
+ */
+template <class T>
+GridResampler AsciiGrid<T>::get_resampler(double resampleCellSize,
+                                          interpTypeEnum interpType) const
+{
+    GridResampler::eMethod method;
+    switch(interpType)
+    {
+        case order0:
+            method = GridResampler::nearest;
+            break;
+        case order1:
+            method = GridResampler::bilinear;
+            break;
+        case areaAverage:
+            method = GridResampler::areaAverage;
+            break;
+        default:
+            throw std::logic_error("Resampling is only implemented for order0, order1 and areaAverage in AsciiGrid<T>::get_resampler().");
+    }
+
+    if(resampleCellSize > std::min(get_xDimension(), get_yDimension()))
+        throw std::runtime_error("Desired resampleCellSize is too large for grid in AsciiGrid<T>::get_resampler().");
+
+    int newNumCols = int(get_xDimension() / resampleCellSize);
+    int newNumRows = int(get_yDimension() / resampleCellSize);
+
+    return GridResampler(data.get_numCols(), data.get_numRows(), xllCorner,
+                         yllCorner, cellSize, newNumCols, newNumRows,
+                         xllCorner, yllCorner, resampleCellSize, method);
+}
+
 template <class T>
 void AsciiGrid<T>::resample_Grid_in_place(double resampleCellSize, interpTypeEnum interpType)
 {
@@ -801,27 +867,20 @@ void AsciiGrid<T>::resample_Grid_in_place(double resampleCellSize, interpTypeEnu
             //return 0;
         }
 
-        int newNumCols = int(xDim / resampleCellSize);
-        int newNumRows = int(yDim / resampleCellSize);
-
-        AsciiGrid<T>A(newNumCols, newNumRows, xllCorner, yllCorner, resampleCellSize, data.getNoDataValue(), data.getNoDataValue(), prjString);
-
-        double xC = 0;
-        double yC = 0;
-
-        for(int i = 0;i < newNumRows;i++)
-        {
-            for(int j = 0;j < newNumCols;j++)
-            {
-                A.get_cellPosition(i, j, &xC, &yC);
-
-                A.set_cellValue(i, j, interpolateGrid(xC, yC, interpType));
-            }
-        }
-        *this = A;
+        *this = resample_Grid(get_resampler(resampleCellSize, interpType));
     }
 }
 
+/**
+ * @brief Resample the grid in place with the tables of a resampler
+ * @param resampler Resampler built for a grid of this geometry.
+ */
+template <class T>
+void AsciiGrid<T>::resample_Grid_in_place(const GridResampler &resampler)
+{
+    *this = resample_Grid(resampler);
+}
+
 template <class T>
 void AsciiGrid<T>::resample_Grid_in_place(int arraySize, interpTypeEnum interpType)
 {           // Given arraySize (approximate number of desired surface cells), resample the grid
@@ -848,25 +907,7 @@ void AsciiGrid<T>::resample_Grid_in_place(int arraySize, interpTypeEnum interpTy
             //return false;
         }
 
-        int newNumCols = int(xDim / resampleCellSize);
-        int newNumRows = int(yDim / resampleCellSize);
-
-        AsciiGrid<T>A(newNumCols, newNumRows, xllCorner, yllCorner, resampleCellSize, data.getNoDataValue(), data.getNoDataValue(), prjString);
-
-        double xC = 0;
-        double yC = 0;
-
-        for(int i = 0;i < newNumRows;i++)
-        {
-            for(int j = 0;j < newNumCols;j++)
-            {
-                A.get_cellPosition(i, j, &xC, &yC);
-
-                A.set_cellValue(i, j, interpolateGrid(xC, yC, interpType));
-            }
-        }
-
-        *this = A;
+        *this = resample_Grid(get_resampler(resampleCellSize, interpType));
     }
 }
 
@@ -964,43 +1005,24 @@ void AsciiGrid<T>::interpolateFromPoints(T* pointData, double* X, double* Y, dou
     //interpDistPower is the power used for the distance weighting (usually 1.0 or 2.0 for inverse distance weighting or inverse distance squared weighting, respectively)
 
 
-    double weight, weight_sum, distance, xC, yC;
-    T value;
+    //The weights only depend on the points and the grid, so they are kept
+    //by IdwInterpolator and shared with the other grids interpolated from
+    //the same points (see IdwInterpolator::interpolate() to weigh several
+    //variables in one pass)
 
     if(interpDistPower <= 0)
         throw std::out_of_range("interpDistPower in AsciiGrid<T>::interpolateFromPoints() must be greater than 0.");
     if(numPoints <=0)
         throw std::out_of_range("numPoints in AsciiGrid<T>::interpolateFromPoints() must be greater than 0.");
 
+    boost::shared_ptr<const IdwInterpolator> idw =
+        IdwInterpolator::get(data.get_numCols(), data.get_numRows(), xllCorner,
+                             yllCorner, cellSize, X, Y, influenceRadius,
+                             numPoints, interpDistPower);
 
-    *this = data.getNoDataValue();
-
-    for(int i = 0;i < data.get_numRows();i++)
-    {
-        for(int j = 0;j < data.get_numCols();j++)
-        {
-            value = 0.0;
-            get_cellPosition(i, j, &xC, &yC);
-            weight_sum = 0.0;
-
-            for(int k = 0; k < numPoints; k++)
-            {
-                distance = std::sqrt((xC-X[k])*(xC-X[k]) + (yC-Y[k])*(yC-Y[k]));
-                if(influenceRadius[k] >= 0.0)   //negative influence radius means infinite influence radius
-                {
-                    if(distance > influenceRadius[k])   //if distance from current cell location to station is larger than the influence radius, skip this station
-                        continue;
-                }
-                weight = 1.0/std::pow(distance,interpDistPower);
-                weight_sum = weight_sum + weight;
-                value = value + pointData[k] * weight;
-            }
-            if(weight_sum != 0) //if value IS zero, then don't set the value because this means all points don't have an influence radius that reaches this cell (this effectively leaves the value as the no_data value)
-                set_cellValue(i, j, value/weight_sum);
-        }
-    }
-
-
+    const T *values[] = {pointData};
+    Array2D<T> *grids[] = {&data};
+    idw->interpolate(1, values, grids);
 }
 
 template <class T>
@@ -1088,7 +1110,9 @@ T AsciiGrid<T>::interpolateGrid(double x, double y, interpTypeEnum interpType) c
     switch(interpType)
     {
         //nearest neighbor, 0th order interpolation.
+        //a point has no area, so an area average is the cell it is in
         case order0:
+        case areaAverage:
             get_cellIndex(xCoord, yCoord, &i, &j);
             answer = get_cellValue(i, j);
             return answer;
@@ -1164,7 +1188,9 @@ T AsciiGrid<T>::interpolateGridLocalCoordinates(double x, double y, interpTypeEn
     switch(interpType)
     {
         //nearest neighbor, 0th order interpolation.
+        //a point has no area, so an area average is the cell it is in
         case order0:
+        case areaAverage:
             get_cellIndexLocalCoordinates(xCoord, yCoord, &i, &j);
             answer = get_cellValue(i, j);
             return answer;
@@ -1339,72 +1365,65 @@ void AsciiGrid<T>::write_Grid(std::string outputFile, int numDecimals)
     if(numDecimals < -1 || numDecimals > 3)
         numDecimals = 2;
 
-    switch(numDecimals)
-    {
-        case -1:    //for printing bools, or longs or ints
-            for(int i = data.get_numRows() - 1;i >= 0;i--)
-            {
-                for (int j = 0;j < data.get_numCols();j++)
-                {
-                    fprintf(fout,"%d\t", (int)data(i,j));
-                }
-                fprintf(fout,"\n");
-            }
-            break;
-        case 0:
-            for(int i = data.get_numRows() - 1;i >= 0;i--)
-            {
-                for (int j = 0;j < data.get_numCols();j++)
-                {
-                    fprintf(fout,"%.0lf\t",data(i,j));
-                }
-                fprintf(fout,"\n");
-            }
-            break;
-
-        case 1:
-            for(int i = data.get_numRows() - 1;i >= 0;i--)
+    //the rows are formatted in blocks, in parallel, and each block is
+    //written at once.  numDecimals of -1 is for printing bools, or longs or
+    //ints
+    int nRows = data.get_numRows();
+    int nCols = data.get_numCols();
+    int blockRows = std::max(1, std::min(nRows, (1 << 20) / std::max(nCols, 1)));
+    std::vector<std::string> rowText(blockRows);
+    std::string blockText;
+    bool outOfMemory = false;
+
+    for(int b = 0; b < nRows && !outOfMemory; b += blockRows)
+    {
+        int nBlockRows = std::min(blockRows, nRows - b);
+        int r;
+#pragma omp parallel for schedule(dynamic, 16)
+        for(r = 0; r < nBlockRows; r++)
+        {
+            int i = nRows - 1 - (b + r);
+            char value[AsciiGridText::maxLength + 1];
+            std::string &text = rowText[r];
+            text.clear();
+            try
             {
-                for (int j = 0; j < data.get_numCols(); j++)
+                for(int j = 0; j < nCols; j++)
                 {
-                    fprintf(fout,"%.1lf\t",data(i,j));
+                    int n;
+                    if(numDecimals == -1)
+                        n = AsciiGridText::format_int(value, (int)data(i,j));
+                    else
+                        n = AsciiGridText::format_fixed(value, (double)data(i,j), numDecimals);
+                    value[n++] = '\t';
+                    text.append(value, n);
                 }
-                fprintf(fout,"\n");
+                text += '\n';
             }
-            break;
-
-        case 2:
-            for(int i = data.get_numRows() - 1;i >= 0;i--)
+            catch(std::bad_alloc &)
             {
-                for (int j = 0;j < data.get_numCols();j++)
-                {
-                    fprintf(fout,"%.2lf\t",data(i,j));
-                }
-                fprintf(fout,"\n");
+                //exceptions can't leave the parallel region
+#pragma omp critical(asciiGrid_write)
+                outOfMemory = true;
             }
-            break;
-
-        case 3:
-            for(int i = data.get_numRows() - 1;i >= 0;i--)
-            {
-                for (int j = 0;j < data.get_numCols();j++)
-                {
-                    fprintf(fout,"%.3lf\t",data(i,j));
-                }
-                fprintf(fout,"\n");
-            }
-            break;
+        }
 
-        default:
-            for(int i = data.get_numRows() - 1;i >= 0;i--)
+        if(!outOfMemory)
+        {
+            blockText.clear();
+            for(r = 0; r < nBlockRows; r++)
+                blockText += rowText[r];
+            if(fwrite(blockText.data(), 1, blockText.size(), fout) != blockText.size())
             {
-                for (int j = 0;j < data.get_numCols();j++)
-                {
-                    fprintf(fout,"%.2lf\t",data(i,j));
-                }
-                fprintf(fout,"\n");
+                fclose(fout);
+                throw std::runtime_error("Cannot write output file in AsciiGrid<T>::write_Grid().");
             }
-            break;
+        }
+    }
+    if(outOfMemory)
+    {
+        fclose(fout);
+        throw std::bad_alloc();
     }
     fclose(fout);
 
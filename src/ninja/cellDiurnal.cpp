@@ -65,6 +65,7 @@ cellDiurnal::cellDiurnal(Elevation const* incomingDem, Shade const* shd,
 
     i = 0;
     j = 0;
+    solarIntensity = 0;
     Qsw = 0;
     Qh = 0;
     diurnal_wind = false;
@@ -102,6 +103,9 @@ cellDiurnal::cellDiurnal(Elevation const* incomingDem, Shade const* shd,
 
     inputWindspeed = -1.0;
 
+    propertiesAirTemp = -1.0;
+    propertiesCloudCover = -1.0;
+
 #ifdef CELL_DIURNAL_DEBUG
     std::cout << "End construct class cellDiurnal using cellDiurnal(class Dem dem)\tTime Elapsed: " 
             << fxTimer.stop() << std::endl;
@@ -144,6 +148,7 @@ cellDiurnal::cellDiurnal(cellDiurnal &c)
     j = c.j;
     CloudCover = c.CloudCover;
     airTemp = c.airTemp;
+    solarIntensity = c.solarIntensity;
     Qsw = c.Qsw;
     Qh = c.Qh;
     diurnal_wind = c.diurnal_wind;
@@ -174,6 +179,9 @@ cellDiurnal::cellDiurnal(cellDiurnal &c)
 
     l = c.l;
 
+    propertiesAirTemp = -1.0;
+    propertiesCloudCover = -1.0;
+
 #ifdef CELL_DIURNAL_DEBUG
     std::cout << "End construct class cellDiurnal using cellDiurnal(class Dem dem)\tTime Elapsed: "
         << fxTimer.stop() << std::endl;
@@ -216,6 +224,7 @@ void cellDiurnal::create(Elevation const* incomingDem, Shade const* shd, Solar *
 
     i = 0;
     j = 0;
+    solarIntensity = 0;
     Qsw = 0;
     Qh = 0;
     diurnal_wind = false;
@@ -248,6 +257,9 @@ void cellDiurnal::create(Elevation const* incomingDem, Shade const* shd, Solar *
 
     inputWindspeed = -1.0;
 
+    propertiesAirTemp = -1.0;
+    propertiesCloudCover = -1.0;
+
 #ifdef CELL_DIURNAL_DEBUG
     std::cout << "End construct class cellDiurnal using cellDiurnal(class Dem dem)\tTime Elapsed: "
         << fxTimer.stop() << std::endl;
@@ -292,10 +304,25 @@ void cellDiurnal::initialize(double& Xord, double& Yord, const double& asp,
 
 void cellDiurnal::compute_solarIntensity()
 {
-    //Set aspect and slope for this cell in the diurnalSolar class BEFORE we run it to compute solar intensity!
-    diurnalSolar.set_aspect(aspect);	
-    diurnalSolar.set_slope(slope);
-    diurnalSolar.call_solPos();
+    //The sun position is the same for every cell, only the surface changes
+    solarIntensity = diurnalSolar.get_solarIntensity(aspect, slope);
+}
+
+//Air properties and radiation terms of the current air temperature and cloud cover
+void cellDiurnal::compute_airProperties()
+{
+    if(airTemp != propertiesAirTemp)
+    {
+        propertiesAirTemp = airTemp;
+        rhoCp = air.get_rho(airTemp)*air.get_cSubP(airTemp);
+        c1AirTemp6 = c1 * std::pow(airTemp,6);
+        sigmaAirTemp4 = 5.67e-8 * std::pow(airTemp,4);
+    }
+    if(CloudCover != propertiesCloudCover)
+    {
+        propertiesCloudCover = CloudCover;
+        cloudFactor = 1.0 + b1 * std::pow(CloudCover, b2);
+    }
 }
 
 //compute incident shortwave radiation to cell based on Solpos and Holtslag and Ulden 1983 to correct for
@@ -308,10 +335,11 @@ void cellDiurnal::compute_Qsw()
     }
     else
     {
-        sinPsi = diurnalSolar.get_solarIntensity() / 1353.0;
+        sinPsi = solarIntensity / 1353.0;
     }
 
-    Qsw = (a1 * sinPsi + a2) * (1.0 + b1 * std::pow(CloudCover, b2));
+    compute_airProperties();
+    Qsw = (a1 * sinPsi + a2) * cloudFactor;
 
     //incident solar radiation cannot be less than 0.0
     if(Qsw < 0.0)
@@ -322,8 +350,8 @@ void cellDiurnal::compute_Qsw()
 
 void cellDiurnal::compute_Qh()	//compute sensible heat flux
 {
-    Qstar = ((1.0 - albedo) * Qsw + c1 * std::pow(airTemp,6) - 5.67e-8 *
-            std::pow(airTemp,4) + c2 * CloudCover)/(1.0 + c3);
+    compute_airProperties();
+    Qstar = ((1.0 - albedo) * Qsw + c1AirTemp6 - sigmaAirTemp4 + c2 * CloudCover)/(1.0 + c3);
 
     Qh = (bowen / (1.0 + bowen)) * (Qstar * (1.0 - cg) + anthropogenic);
 	
@@ -354,7 +382,7 @@ void cellDiurnal::compute_Qh()	//compute sensible heat flux
         do
         {
             u_star_old = u_star;
-            l = (-air.get_rho(airTemp)*air.get_cSubP(airTemp)*airTemp*u_star_old*u_star_old*u_star_old)/(K*g*Qh);
+            l = (-rhoCp*airTemp*u_star_old*u_star_old*u_star_old)/(K*g*Qh);
             u_star = (K*inputWindspeed) / (log(zm/roughness) -
                     stability_function(zm/l, l) + stability_function(roughness/l, l));
 
@@ -394,7 +422,7 @@ void cellDiurnal::compute_Qh()	//compute sensible heat flux
                     u_star = (K*inputWindspeed) / (log(zm/roughness) -
                             stability_function(zm/l, l) +stability_function(roughness/l, l));
                 }while((fabs(1 - u_star/u_star_old)) > stop_crit);
-                Qh = -air.get_rho(airTemp)*air.get_cSubP(airTemp)*u_star*theta_star;
+                Qh = -rhoCp*u_star*theta_star;
             }
 	}
 }
@@ -546,7 +574,7 @@ void cellDiurnal::compute_S()
     {
         S = std::pow(((Qh * g * elev_change) / 
                     ((Cd_upslope + entrainment_coeff_upslope) * 
-                     (air.get_rho(airTemp) * air.get_cSubP(airTemp) * airTemp))), 1.0/3.0);
+                     (rhoCp * airTemp))), 1.0/3.0);
 
     }else  //downslope wind
     {
@@ -559,7 +587,7 @@ void cellDiurnal::compute_S()
         Le = (0.05 * elev_change) / (Cd_downslope + entrainment_coeff_downslope);
 
         S = std::pow(((-Qh * g * hillValleyDist * sinAlpha) /
-                    ((air.get_rho(airTemp) * air.get_cSubP(airTemp) * airTemp) *
+                    ((rhoCp * airTemp) *
                      (Cd_downslope + entrainment_coeff_downslope))), 1.0/3.0) * 
                     std::pow((1.0 - std::pow(2.71828, -1.0 * hillValleyDist / Le)), 1.0/3.0);
     }
@@ -621,6 +649,10 @@ void cellDiurnal::compute_cell_diurnal_wind(int I, int J, double *U,
 {
     i = I;	//Set i,j of current cell
     j = J;
+    //no hill tracked yet, don't keep the one of the last cell.  Cells without
+    //diurnal flow now get a height of 0 instead of the flow height of the
+    //cell computed before them; their wind is 0, so the flow doesn't change
+    elev_change = 0.0;
 
     compute_solarIntensity();
     compute_Qsw();
@@ -676,4 +708,64 @@ void cellDiurnal::compute_cell_diurnal_parameters(int I, int J, double *L, doubl
 
 }
 
-//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Computes the diurnal wind of every cell of the dem.
+ *
+ * The cells are independent, so the rows are split between the threads and
+ * each thread computes its cells with its own copy of this cellDiurnal (the
+ * sun position is computed once, in the Solar given at construction).
+ * The grids are the same as computing the cells one after another with
+ * compute_cell_diurnal_wind(), whatever the number of threads.
+ *
+ * @param asp Aspect of the dem.
+ * @param slp Slope of the dem.
+ * @param cloudCover Cloud cover grid (0-1).
+ * @param airTemperature Air temperature grid (K).
+ * @param windSpeed Input wind speed grid (m/s).
+ * @param surface Surface properties of the dem.
+ * @param U Diurnal u component of each cell.
+ * @param V Diurnal v component of each cell.
+ * @param W Diurnal w component of each cell.
+ * @param height Height of the diurnal flow of each cell.
+ * @param L Monin-Obukhov length of each cell.
+ * @param U_star Friction velocity of each cell.
+ * @param BL_height Atmospheric boundary layer height of each cell.
+ */
+void cellDiurnal::compute_diurnal_wind_grids(Aspect const& asp, Slope const& slp,
+                const AsciiGrid<double>& cloudCover, const AsciiGrid<double>& airTemperature,
+                const AsciiGrid<double>& windSpeed, const surfProperties& surface,
+                AsciiGrid<double>& U, AsciiGrid<double>& V, AsciiGrid<double>& W,
+                AsciiGrid<double>& height, AsciiGrid<double>& L,
+                AsciiGrid<double>& U_star, AsciiGrid<double>& BL_height)
+{
+    int nRows = dem->get_nRows();
+    int nCols = dem->get_nCols();
+
+#pragma omp parallel
+    {
+        cellDiurnal cell(*this);
+        double Xord, Yord;
+        int I, J;
+
+#pragma omp for schedule(dynamic)
+        for(I = 0; I < nRows; I++)
+        {
+            for(J = 0; J < nCols; J++)
+            {
+                dem->get_cellPosition(I, J, &Xord, &Yord);
+
+                cell.initialize(Xord, Yord, asp(I,J), slp(I,J),
+                        cloudCover(I,J), airTemperature(I,J), windSpeed(I,J), surface.Z,
+                        surface.Albedo(I,J), surface.Bowen(I,J),
+                        surface.Cg(I,J), surface.Anthropogenic(I,J),
+                        surface.Roughness(I,J), surface.Rough_h(I,J),
+                        surface.Rough_d(I,J));
+
+                cell.compute_cell_diurnal_wind(I, J, &U(I,J), &V(I,J), &W(I,J),
+                        &height(I,J), &L(I,J), &U_star(I,J), &BL_height(I,J));
+            }
+        }
+    }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
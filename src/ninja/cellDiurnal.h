@@ -84,12 +84,22 @@ class cellDiurnal
                                      double *W, double *height, double *L,
                                      double *U_star, double *BL_height);	
 
+        //Function computes the diurnal wind of every cell of the dem in parallel,
+        //each thread with its own copy of this cellDiurnal
+        void compute_diurnal_wind_grids(Aspect const& asp, Slope const& slp,
+                const AsciiGrid<double>& cloudCover, const AsciiGrid<double>& airTemperature,
+                const AsciiGrid<double>& windSpeed, const surfProperties& surface,
+                AsciiGrid<double>& U, AsciiGrid<double>& V, AsciiGrid<double>& W,
+                AsciiGrid<double>& height, AsciiGrid<double>& L,
+                AsciiGrid<double>& U_star, AsciiGrid<double>& BL_height);
+
         //Function computes the Obukov length, friction velocity, and boundary layer height.
         void compute_cell_diurnal_parameters(int I, int J, double *L, double *U_star, double *BL_height);
         void compute_solarIntensity();
         void compute_Qsw();
 
         int i, j;  //The i,j of the cell we're computing for
+        double solarIntensity; //Extraterrestrial solar intensity on the cell surface (W/m^2)
         double Qsw; //Shortwave radiation incident at cell surface (W/m^2) (corrected for cloud cover, water vapor, dust)
         double CloudCover;  //Cloud cover NOTE: range 0-1, NOT 0-100
         double aspect;
@@ -101,6 +111,7 @@ class cellDiurnal
 	void compute_cellHillDist();
 	void compute_S();
 	void compute_UVW();
+	void compute_airProperties();
 
         //stability function used in surface layer similarity profile computation
 	double stability_function(double z_over_L, double L_switch);
@@ -173,6 +184,15 @@ class cellDiurnal
 
 	double Qstar;  //Intermediate variable
 
+	//terms that only depend on the air temperature or the cloud cover, kept
+	//from the last cell since they are usually the same for the whole grid
+	double propertiesAirTemp;
+	double rhoCp;  //air density times specific heat
+	double c1AirTemp6;  //c1 * airTemp^6
+	double sigmaAirTemp4;  //5.67e-8 * airTemp^4
+	double propertiesCloudCover;
+	double cloudFactor;  //1 + b1 * CloudCover^b2
+
 	double elevOld, elevNew, dist;
 	AsciiGrid<double>::interpTypeEnum interp_order;
 	Air air;  //class holding air properties as function of temperature
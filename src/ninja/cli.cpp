@@ -159,6 +159,9 @@ void initializeOptions()
                 ("mesh_choice", po::value<std::string>(), "mesh resolution choice (coarse, medium, fine)")
                 ("mesh_resolution", po::value<double>(), "mesh resolution")
                 ("units_mesh_resolution", po::value<std::string>(), "mesh resolution units (ft, m)")
+                ("preconditioner", po::value<std::string>(), "preconditioner for the conjugate gradient solver (parallel_ssor, ssor, jacobi, multigrid)")
+                ("trace_file", po::value<std::string>(), "write the time of each phase of the runs, solver iterations and residuals, bytes written and peak memory to path/filename")
+                ("trace_format", po::value<std::string>()->default_value("json"), "format of the trace file (json, csv, chrome)")
                 ("output_buffer_clipping", po::value<double>()->default_value(0.0), "percent to clip buffer on output files")
                 ("write_wx_model_goog_output", po::value<bool>()->default_value(false), "write a Google Earth kmz output file for the raw wx model forecast (true, false)")
                 ("write_goog_output", po::value<bool>()->default_value(false), "write a Google Earth kmz output file (true, false)")
@@ -361,6 +364,9 @@ int windNinjaCLI(int argc, char* argv[])
                 ("mesh_choice", po::value<std::string>(), "mesh resolution choice (coarse, medium, fine)")
                 ("mesh_resolution", po::value<double>(), "mesh resolution")
                 ("units_mesh_resolution", po::value<std::string>(), "mesh resolution units (ft, m)")
+                ("preconditioner", po::value<std::string>(), "preconditioner for the conjugate gradient solver (parallel_ssor, ssor, jacobi, multigrid)")
+                ("trace_file", po::value<std::string>(), "write the time of each phase of the runs, solver iterations and residuals, bytes written and peak memory to path/filename")
+                ("trace_format", po::value<std::string>()->default_value("json"), "format of the trace file (json, csv, chrome)")
                 ("output_buffer_clipping", po::value<double>()->default_value(0.0), "percent to clip buffer on output files")
                 ("write_wx_model_goog_output", po::value<bool>()->default_value(false), "write a Google Earth kmz output file for the raw wx model forecast (true, false)")
                 ("write_goog_output", po::value<bool>()->default_value(false), "write a Google Earth kmz output file (true, false)")
@@ -668,6 +674,34 @@ int windNinjaCLI(int argc, char* argv[])
             }
         }
 
+        //the solver reads the preconditioner choice when the ninjas are constructed
+        if(vm.count("preconditioner"))
+        {
+            std::string precond = vm["preconditioner"].as<std::string>();
+            if(precond != "parallel_ssor" && precond != "ssor" &&
+               precond != "jacobi" && precond != "multigrid")
+            {
+                cout << "'preconditioner' of " << precond << " is not valid.\n" \
+                    << "Choices are: parallel_ssor, ssor, jacobi, or multigrid.\n";
+                return -1;
+            }
+            CPLSetConfigOption("NINJA_PRECONDITIONER", precond.c_str());
+        }
+
+        //read by ninjaArmy::startRuns()
+        if(vm.count("trace_file"))
+        {
+            std::string format = vm["trace_format"].as<std::string>();
+            if(format != "json" && format != "csv" && format != "chrome")
+            {
+                cout << "'trace_format' of " << format << " is not valid.\n" \
+                    << "Choices are: json, csv, or chrome.\n";
+                return -1;
+            }
+            CPLSetConfigOption("NINJA_TRACE_FILE", vm["trace_file"].as<std::string>().c_str());
+            CPLSetConfigOption("NINJA_TRACE_FORMAT", format.c_str());
+        }
+
 #ifdef NINJAFOAM
         ninjaArmy windsim(1, vm["momentum_flag"].as<bool>()); //-Moved to header file
 #else
@@ -67,6 +67,8 @@ void domainAverageInitialization::initializeFields(WindNinjaInputs &input,
 
 void domainAverageInitialization::setInitializationGrids(WindNinjaInputs& input)
 {
+    NinjaTraceScope trace(input.inputsRunNumber, "init_grids");
+
     //set initialization grids
     speedInitializationGrid = input.inputSpeed;
     dirInitializationGrid = input.inputDirection;
@@ -85,6 +87,8 @@ void domainAverageInitialization::setInitializationGrids(WindNinjaInputs& input)
 
 void domainAverageInitialization::initializeBoundaryLayer(WindNinjaInputs& input)
 {
+    NinjaTraceScope trace(input.inputsRunNumber, "init_boundary_layer");
+
     int i, j;
 
     double inwindu=0.0;		//input u wind component
@@ -0,0 +1,453 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Read-only domain data shared by the runs of a ninjaArmy
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "domainContext.h"
+#include "cpl_multiproc.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+/* Bump when the layout of the cache file or what goes into it changes */
+static const int cacheVersion = 1;
+static const char cacheMagic[8] = {'W','N','D','O','M','A','I','N'};
+
+/*
+** Binary I/O of the cache file.  Values are written in the byte order of the
+** machine, the header holds a check value so files from another byte order
+** are rejected.
+*/
+static bool WriteBlock(VSILFILE *fp, const void *p, size_t size, size_t n)
+{
+    return n == 0 || VSIFWriteL(p, size, n, fp) == n;
+}
+
+static bool ReadBlock(VSILFILE *fp, void *p, size_t size, size_t n)
+{
+    return n == 0 || VSIFReadL(p, size, n, fp) == n;
+}
+
+static bool WriteInt(VSILFILE *fp, GIntBig value)
+{
+    return WriteBlock(fp, &value, sizeof(value), 1);
+}
+
+static bool ReadInt(VSILFILE *fp, GIntBig &value)
+{
+    return ReadBlock(fp, &value, sizeof(value), 1);
+}
+
+static bool WriteString(VSILFILE *fp, const std::string &s)
+{
+    return WriteInt(fp, s.size()) && WriteBlock(fp, s.c_str(), 1, s.size());
+}
+
+static bool ReadString(VSILFILE *fp, std::string &s)
+{
+    GIntBig n;
+    if(!ReadInt(fp, n) || n < 0 || n > 1000000)
+        return false;
+    std::vector<char> buf(n+1, '\0');
+    if(!ReadBlock(fp, &buf[0], 1, n))
+        return false;
+    s = &buf[0];
+    return true;
+}
+
+static bool WriteGrid(VSILFILE *fp, const AsciiGrid<double> &grid)
+{
+    int nR = grid.get_nRows(), nC = grid.get_nCols();
+    double header[4] = {grid.get_xllCorner(), grid.get_yllCorner(), grid.get_cellSize(), grid.get_noDataValue()};
+    std::vector<double> values((size_t)nR*nC);
+    for(int i=0; i<nR; i++)
+        for(int j=0; j<nC; j++)
+            values[(size_t)i*nC+j] = grid(i,j);
+    return WriteInt(fp, nR) && WriteInt(fp, nC) && WriteBlock(fp, header, sizeof(double), 4) &&
+           WriteString(fp, grid.prjString) && WriteBlock(fp, values.empty() ? NULL : &values[0], sizeof(double), values.size());
+}
+
+static bool ReadGrid(VSILFILE *fp, AsciiGrid<double> &grid)
+{
+    GIntBig nR, nC;
+    double header[4];
+    std::string prj;
+    if(!ReadInt(fp, nR) || !ReadInt(fp, nC) || nR < 0 || nC < 0 || nR*nC > 1000000000 ||
+       !ReadBlock(fp, header, sizeof(double), 4) || !ReadString(fp, prj))
+        return false;
+    std::vector<double> values((size_t)(nR*nC));
+    if(!ReadBlock(fp, values.empty() ? NULL : &values[0], sizeof(double), values.size()))
+        return false;
+    grid.set_headerData((int)nC, (int)nR, header[0], header[1], header[2], header[3], header[3], prj);
+    for(int i=0; i<nR; i++)
+        for(int j=0; j<nC; j++)
+            grid(i,j) = values[(size_t)i*nC+j];
+    return true;
+}
+
+static bool WriteArray(VSILFILE *fp, const wn_3dArray &a)
+{
+    int n = a.rows_*a.cols_*a.layers_;
+    std::vector<double> values(n);
+    for(int i=0; i<n; i++)
+        values[i] = a(i);
+    return WriteInt(fp, a.rows_) && WriteInt(fp, a.cols_) && WriteInt(fp, a.layers_) &&
+           WriteBlock(fp, n ? &values[0] : NULL, sizeof(double), n);
+}
+
+static bool ReadArray(VSILFILE *fp, wn_3dArray &a)
+{
+    GIntBig rows, cols, layers;
+    if(!ReadInt(fp, rows) || !ReadInt(fp, cols) || !ReadInt(fp, layers) ||
+       rows <= 0 || cols <= 0 || layers <= 0 || rows*cols*layers > 1000000000)
+        return false;
+    int n = (int)(rows*cols*layers);
+    std::vector<double> values(n);
+    if(!ReadBlock(fp, &values[0], sizeof(double), n))
+        return false;
+    a.allocate((int)rows, (int)cols, (int)layers);
+    for(int i=0; i<n; i++)
+        a(i) = values[i];
+    return true;
+}
+
+/*
+** Checks a matrix read from a cache file before the solver indexes with it:
+** rows in order, ending at nnz, each starting with its diagonal and only
+** holding columns of the upper triangle.
+*/
+static bool ValidMatrix(int n, GIntBig nnz, const int *row_ptr, const int *col_ind)
+{
+    if(row_ptr[0] != 0 || row_ptr[n] != nnz)
+        return false;
+    for(int i=0; i<n; i++)
+    {
+        if(row_ptr[i+1] <= row_ptr[i] || col_ind[row_ptr[i]] != i)
+            return false;
+        for(int j=row_ptr[i]+1; j<row_ptr[i+1]; j++)
+        {
+            if(col_ind[j] <= i || col_ind[j] >= n)
+                return false;
+        }
+    }
+    return true;
+}
+
+/* 64 bit FNV-1a */
+static void HashBytes(GUIntBig &h, const void *p, size_t n)
+{
+    const unsigned char *c = (const unsigned char*)p;
+    for(size_t i=0; i<n; i++)
+    {
+        h ^= c[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+DomainContext::DomainContext()
+{
+    NUMNP = 0;
+    SK = NULL;
+    SKf = NULL;
+    row_ptr = NULL;
+    col_ind = NULL;
+}
+
+DomainContext::~DomainContext()
+{
+    deallocate();
+}
+
+/**
+ * @return true if the matrix and preconditioner have been built and the
+ * context can be handed to the ninjas.
+ */
+bool DomainContext::isBuilt() const
+{
+    return (SK != NULL && row_ptr != NULL && col_ind != NULL && NUMNP > 0);
+}
+
+/**
+ * Copy the shared DEM, surface grids and mesh into a ninja's inputs.
+ * This replaces readInputFile(), set_uniVegetation() and
+ * Mesh::buildStandardMesh() for a run using the context.  Only the gridded
+ * surface properties are copied, the wind speed and wind height stored in
+ * the surface class belong to the individual run.
+ * @param input Inputs of the ninja to fill.
+ * @param mesh Mesh of the ninja to fill.
+ */
+void DomainContext::applyTo(WindNinjaInputs &input, Mesh &mesh) const
+{
+    if(!isBuilt())
+        throw std::logic_error("DomainContext::applyTo() called before the context was built.");
+
+    std::string demFileName = input.dem.fileName;     //a cached context may come from a copy of the DEM elsewhere
+    input.dem = dem;
+    input.dem.fileName = demFileName;
+
+    input.surface.Roughness = surface.Roughness;
+    input.surface.RoughnessUnits = surface.RoughnessUnits;
+    input.surface.Rough_d = surface.Rough_d;
+    input.surface.Rough_dUnits = surface.Rough_dUnits;
+    input.surface.Rough_h = surface.Rough_h;
+    input.surface.Rough_hUnits = surface.Rough_hUnits;
+    input.surface.Albedo = surface.Albedo;
+    input.surface.Bowen = surface.Bowen;
+    input.surface.Cg = surface.Cg;
+    input.surface.Anthropogenic = surface.Anthropogenic;
+
+    mesh = this->mesh;
+}
+
+/**
+ * Name of the cache file of a domain, in the NINJA_DOMAIN_CACHE_DIR directory.
+ * The name is a hash of the bytes of the DEM file and the settings the
+ * resampled grids, the mesh and the matrix depend on: the mesh resolution or
+ * resolution choice, the vertical layers and growth, the output heights (the
+ * domain height depends on them), the vegetation and the stability flag.
+ * Must be called before the mesh is built, the mesh resolution of a
+ * coarse/medium/fine choice is only known afterwards.
+ * @param input Inputs of the run, with the DEM file name set.
+ * @param mesh Mesh settings of the run.
+ * @return The file name, or an empty string if no cache directory is set or
+ *         the DEM file cannot be read.
+ */
+std::string DomainContext::cacheFileName(const WindNinjaInputs &input, const Mesh &mesh)
+{
+    const char *pszDir = CPLGetConfigOption("NINJA_DOMAIN_CACHE_DIR", NULL);
+    if(pszDir == NULL || *pszDir == '\0')
+        return std::string();
+
+    VSILFILE *fp = VSIFOpenL(input.dem.fileName.c_str(), "rb");
+    if(fp == NULL)
+        return std::string();
+    GUIntBig h = 14695981039346656037ULL;
+    std::vector<char> buf(1 << 20);
+    size_t n;
+    while((n = VSIFReadL(&buf[0], 1, buf.size(), fp)) > 0)
+        HashBytes(h, &buf[0], n);
+    VSIFCloseL(fp);
+
+    double outputHeight = input.outputWindHeight;
+    for(unsigned int i=0; i<input.extraOutputWindHeights.size(); i++)
+        outputHeight = std::max(outputHeight, input.extraOutputWindHeights[i]);
+
+    GIntBig stability = 0;
+#ifdef STABILITY
+    stability = input.stabilityFlag;
+#endif
+    GIntBig settings[] = {cacheVersion, (GIntBig)mesh.meshResChoice, (GIntBig)mesh.meshResolutionUnits,
+                          mesh.numVertLayers, mesh.targetNumHorizCells,
+                          (GIntBig)input.vegetation, stability};
+    double lengths[] = {mesh.meshResolution, mesh.vertGrowth, mesh.maxAspectRatio, outputHeight};
+    HashBytes(h, settings, sizeof(settings));
+    HashBytes(h, lengths, sizeof(lengths));
+
+    std::string name = CPLSPrintf("%08x%08x", (unsigned int)(h >> 32), (unsigned int)(h & 0xffffffff));
+    return std::string(CPLFormFilename(pszDir, name.c_str(), "wndc"));
+}
+
+/**
+ * Read the DEM, surface grids, mesh and matrix from a cache file written by
+ * writeCache().  The geometry, preconditioner and warm start solutions still
+ * have to be set up (ninja::initializeDomainContext()).
+ * @param fileName Cache file (see cacheFileName()).
+ * @return true if the file exists and is valid, otherwise the context is left
+ *         empty.
+ */
+bool DomainContext::readCache(const std::string &fileName)
+{
+    VSILFILE *fp = VSIFOpenL(fileName.c_str(), "rb");
+    if(fp == NULL)
+        return false;
+
+    deallocate();
+
+    char magic[8];
+    GIntBig version, byteOrder, value, units[6], sizes[9], longs[5];
+    double lengths[4];
+    bool ok = ReadBlock(fp, magic, 1, 8) && memcmp(magic, cacheMagic, 8) == 0 &&
+              ReadInt(fp, version) && version == cacheVersion &&
+              ReadInt(fp, byteOrder) && byteOrder == 0x01020304;
+
+    //DEM and surface grids
+    ok = ok && ReadGrid(fp, dem) && ReadInt(fp, value);
+    if(ok)
+        dem.elevationUnits = (Elevation::eElevDistanceUnits)value;
+    ok = ok && ReadGrid(fp, surface.Roughness) && ReadGrid(fp, surface.Rough_d) &&
+         ReadGrid(fp, surface.Rough_h) && ReadGrid(fp, surface.Albedo) &&
+         ReadGrid(fp, surface.Bowen) && ReadGrid(fp, surface.Cg) &&
+         ReadGrid(fp, surface.Anthropogenic);
+
+    //mesh
+    ok = ok && ReadBlock(fp, units, sizeof(GIntBig), 6) && ReadBlock(fp, sizes, sizeof(GIntBig), 9) &&
+         ReadBlock(fp, longs, sizeof(GIntBig), 5) && ReadBlock(fp, lengths, sizeof(double), 4) &&
+         ReadArray(fp, mesh.XORD) && ReadArray(fp, mesh.YORD) && ReadArray(fp, mesh.ZORD);
+    if(ok)
+    {
+        surface.RoughnessUnits = (lengthUnits::eLengthUnits)units[0];
+        surface.Rough_dUnits = (lengthUnits::eLengthUnits)units[1];
+        surface.Rough_hUnits = (lengthUnits::eLengthUnits)units[2];
+        mesh.meshResolutionUnits = (lengthUnits::eLengthUnits)units[3];
+        mesh.domainHeightUnits = (lengthUnits::eLengthUnits)units[4];
+        mesh.meshResChoice = (Mesh::eMeshChoice)units[5];
+        mesh.NUMNP = (int)sizes[0];
+        mesh.NUMEL = (int)sizes[1];
+        mesh.NNPE = (int)sizes[2];
+        mesh.nrows = (int)sizes[3];
+        mesh.ncols = (int)sizes[4];
+        mesh.nlayers = (int)sizes[5];
+        mesh.nrowsElem = (int)sizes[6];
+        mesh.ncolsElem = (int)sizes[7];
+        mesh.nlayersElem = (int)sizes[8];
+        mesh.numVertLayers = (long)longs[0];
+        mesh.targetNumHorizCells = (long)longs[1];
+        mesh.coarseTargetCells = (long)longs[2];
+        mesh.mediumTargetCells = (long)longs[3];
+        mesh.fineTargetCells = (long)longs[4];
+        mesh.meshResolution = lengths[0];
+        mesh.domainHeight = lengths[1];
+        mesh.vertGrowth = lengths[2];
+        mesh.maxAspectRatio = lengths[3];
+        //the sizes must agree with each other and with the grids read
+        ok = sizes[3] >= 2 && sizes[4] >= 2 && sizes[5] >= 2 &&
+             sizes[0] == sizes[3]*sizes[4]*sizes[5] &&
+             sizes[6] == sizes[3]-1 && sizes[7] == sizes[4]-1 && sizes[8] == sizes[5]-1 &&
+             sizes[1] == sizes[6]*sizes[7]*sizes[8] && sizes[2] == 8 &&
+             dem.get_nRows() == mesh.nrows && dem.get_nCols() == mesh.ncols;
+        const AsciiGrid<double> *grids[] = {&surface.Roughness, &surface.Rough_d, &surface.Rough_h,
+                                            &surface.Albedo, &surface.Bowen, &surface.Cg,
+                                            &surface.Anthropogenic};
+        for(int i=0; i<7 && ok; i++)
+            ok = grids[i]->get_nRows() == mesh.nrows && grids[i]->get_nCols() == mesh.ncols;
+        const wn_3dArray *coords[] = {&mesh.XORD, &mesh.YORD, &mesh.ZORD};
+        for(int i=0; i<3 && ok; i++)
+            ok = coords[i]->rows_ == mesh.nrows && coords[i]->cols_ == mesh.ncols &&
+                 coords[i]->layers_ == mesh.nlayers;
+    }
+
+    //matrix
+    GIntBig nnz = 0;
+    ok = ok && ReadInt(fp, value) && value == mesh.NUMNP && ReadInt(fp, nnz) &&
+         nnz >= value && nnz <= 27*value;
+    if(ok)
+    {
+        NUMNP = (int)value;
+        row_ptr = new int[NUMNP+1];
+        col_ind = new int[nnz];
+        SK = new double[nnz];
+        ok = ReadBlock(fp, row_ptr, sizeof(int), NUMNP+1) &&
+             ReadBlock(fp, col_ind, sizeof(int), nnz) &&
+             ReadBlock(fp, SK, sizeof(double), nnz) &&
+             ValidMatrix(NUMNP, nnz, row_ptr, col_ind);
+    }
+    VSIFCloseL(fp);
+
+    if(!ok)
+    {
+        CPLDebug("NINJA", "Ignoring invalid domain cache file %s", fileName.c_str());
+        deallocate();
+    }
+    return ok;
+}
+
+/**
+ * Write the DEM, surface grids, mesh and matrix to a cache file.  The file is
+ * written under a temporary name and renamed, so other processes never read a
+ * partial file.
+ * @param fileName Cache file (see cacheFileName()).
+ * @return true if the file was written.
+ */
+bool DomainContext::writeCache(const std::string &fileName) const
+{
+    if(!isBuilt())
+        return false;
+
+    VSIMkdir(CPLGetPath(fileName.c_str()), 0755);
+    std::string tmpName = fileName + CPLSPrintf(".%d.tmp", (int)CPLGetPID());
+    VSILFILE *fp = VSIFOpenL(tmpName.c_str(), "wb");
+    if(fp == NULL)
+        return false;
+
+    GIntBig units[6] = {surface.RoughnessUnits, surface.Rough_dUnits, surface.Rough_hUnits,
+                        mesh.meshResolutionUnits, mesh.domainHeightUnits, mesh.meshResChoice};
+    GIntBig sizes[9] = {mesh.NUMNP, mesh.NUMEL, mesh.NNPE, mesh.nrows, mesh.ncols, mesh.nlayers,
+                        mesh.nrowsElem, mesh.ncolsElem, mesh.nlayersElem};
+    GIntBig longs[5] = {mesh.numVertLayers, mesh.targetNumHorizCells, mesh.coarseTargetCells,
+                        mesh.mediumTargetCells, mesh.fineTargetCells};
+    double lengths[4] = {mesh.meshResolution, mesh.domainHeight, mesh.vertGrowth, mesh.maxAspectRatio};
+    int nnz = row_ptr[NUMNP];
+
+    bool ok = WriteBlock(fp, cacheMagic, 1, 8) && WriteInt(fp, cacheVersion) && WriteInt(fp, 0x01020304) &&
+              WriteGrid(fp, dem) && WriteInt(fp, dem.elevationUnits) &&
+              WriteGrid(fp, surface.Roughness) && WriteGrid(fp, surface.Rough_d) &&
+              WriteGrid(fp, surface.Rough_h) && WriteGrid(fp, surface.Albedo) &&
+              WriteGrid(fp, surface.Bowen) && WriteGrid(fp, surface.Cg) &&
+              WriteGrid(fp, surface.Anthropogenic) &&
+              WriteBlock(fp, units, sizeof(GIntBig), 6) && WriteBlock(fp, sizes, sizeof(GIntBig), 9) &&
+              WriteBlock(fp, longs, sizeof(GIntBig), 5) && WriteBlock(fp, lengths, sizeof(double), 4) &&
+              WriteArray(fp, mesh.XORD) && WriteArray(fp, mesh.YORD) && WriteArray(fp, mesh.ZORD) &&
+              WriteInt(fp, NUMNP) && WriteInt(fp, nnz) &&
+              WriteBlock(fp, row_ptr, sizeof(int), NUMNP+1) &&
+              WriteBlock(fp, col_ind, sizeof(int), nnz) &&
+              WriteBlock(fp, SK, sizeof(double), nnz);
+    if(VSIFCloseL(fp) != 0)
+        ok = false;
+
+    if(ok)
+        ok = (VSIRename(tmpName.c_str(), fileName.c_str()) == 0);
+    if(!ok)
+        VSIUnlink(tmpName.c_str());
+    return ok;
+}
+
+void DomainContext::deallocate()
+{
+    if(SK)
+    {
+        delete[] SK;
+        SK = NULL;
+    }
+    if(SKf)
+    {
+        delete[] SKf;
+        SKf = NULL;
+    }
+    if(row_ptr)
+    {
+        delete[] row_ptr;
+        row_ptr = NULL;
+    }
+    if(col_ind)
+    {
+        delete[] col_ind;
+        col_ind = NULL;
+    }
+    solutions.clear();
+    geometry.deallocate();
+    NUMNP = 0;
+}
@@ -0,0 +1,95 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Read-only domain data shared by the runs of a ninjaArmy
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef DOMAIN_CONTEXT_H
+#define DOMAIN_CONTEXT_H
+
+#include "WindNinjaInputs.h"
+#include "mesh.h"
+#include "preconditioner.h"
+#include "elementGeometry.h"
+#include "solutionSpace.h"
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+/**
+ * Domain data that does not change between the runs of a ninjaArmy.
+ *
+ * For neutral stability domain average and weather model armies every run
+ * uses the same DEM, surface grids and mesh, so the stiffness matrix (with
+ * boundary conditions applied) and its preconditioner are identical too; only
+ * the right hand side changes from run to run.  The army builds one
+ * DomainContext before the runs start and hands each ninja a const pointer to
+ * it.  The ninjas copy the (already resampled) DEM, surface grids and mesh and
+ * solve against the shared matrix and preconditioner instead of rebuilding
+ * them.
+ *
+ * The context owns SK, SKf, row_ptr and col_ind.  It must outlive every ninja that
+ * references it and must not be modified once it has been built, except for
+ * the solutions collected for warm starts (NINJA_WARM_START).
+ *
+ * With NINJA_DOMAIN_CACHE_DIR set, the DEM and surface grids, the mesh and
+ * the matrix are also kept on disk, in a binary file named by a hash of the
+ * DEM file and the settings they depend on (cacheFileName()).  A later process
+ * using the same DEM and settings reads them back (readCache()) instead of
+ * reading and resampling the DEM, building the mesh and assembling the matrix.
+ * The element geometry, the preconditioner and SKf are not stored, they are
+ * rebuilt from the mesh and matrix (ninja::initializeDomainContext()).
+ */
+class DomainContext
+{
+public:
+    DomainContext();
+    ~DomainContext();
+
+    bool isBuilt() const;
+    void applyTo(WindNinjaInputs &input, Mesh &mesh) const;
+    void deallocate();
+
+    static std::string cacheFileName(const WindNinjaInputs &input, const Mesh &mesh);
+    bool readCache(const std::string &fileName);
+    bool writeCache(const std::string &fileName) const;
+
+    Elevation dem;              //DEM after resampling to the mesh resolution
+    surfProperties surface;     //surface grids after resampling to the mesh resolution
+    Mesh mesh;
+    ElementGeometry geometry;   //element geometry factors of mesh
+
+    int NUMNP;
+    double *SK;                 //stiffness matrix with boundary conditions applied (upper triangle, CRS)
+    float *SKf;                 //SK rounded to float for NINJA_SINGLE_PRECISION, NULL otherwise
+    int *row_ptr, *col_ind;
+    Preconditioner precond;     //already initialized on SK, use the solve() overload taking a work vector
+    mutable SolutionSpace solutions;    //solutions of the runs so far, for warm starts (locks internally)
+
+private:
+    DomainContext(const DomainContext &rhs);               //not copyable
+    DomainContext &operator=(const DomainContext &rhs);
+};
+
+#endif  //DOMAIN_CONTEXT_H
@@ -0,0 +1,467 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Geometric factors of the mesh elements at the quadrature points
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "elementGeometry.h"
+
+ElementGeometry::ElementGeometry()
+{
+    mesh_ = NULL;
+    layout_ = full;
+    NUMEL = 0;
+    NNPE = 0;
+    NUMQPTV = 0;
+
+    DETJW_ = NULL;
+    DNDX_ = NULL;
+    DNDY_ = NULL;
+    DNDZ_ = NULL;
+    XQ_ = NULL;
+    YQ_ = NULL;
+    ZQ_ = NULL;
+    smoothW_ = NULL;
+    invDiag_ = NULL;
+    ZU_ = NULL;
+    ZV_ = NULL;
+    ZW_ = NULL;
+    weight_ = NULL;
+    jacX_ = NULL;
+    jacY_ = NULL;
+    offX_ = NULL;
+    offY_ = NULL;
+    SFu_ = NULL;
+    SFv_ = NULL;
+    SFw_ = NULL;
+}
+
+ElementGeometry::~ElementGeometry()
+{
+    deallocate();
+}
+
+/**
+ * Computes the factors of all elements of a mesh.
+ * @param m Mesh, must stay unchanged while the factors are used.
+ * @param layout Storage layout.  compact falls back to full if the horizontal
+ *               spacing of the mesh is not uniform.
+ */
+void ElementGeometry::initialize(Mesh const* m, eLayout layout)
+{
+    int i, q, k;
+
+    deallocate();
+
+    mesh_ = m;
+    NUMEL = m->NUMEL;
+    NNPE = m->NNPE;
+
+    element elem(m);
+    elem.initializeQuadPtArrays();
+    NUMQPTV = elem.NUMQPTV;
+
+    layout_ = (layout == compact && isUniformXY()) ? compact : full;
+
+    weight_ = new double[NUMQPTV];
+    for(q=0;q<NUMQPTV;q++)
+    {
+        weight_[q] = elem.WT;
+        if(NUMQPTV==27)
+        {
+            if(q<=7)
+                weight_[q]=elem.WT1;
+            else if(q<=19)
+                weight_[q]=elem.WT2;
+            else if(q<=25)
+                weight_[q]=elem.WT3;
+            else
+                weight_[q]=elem.WT4;
+        }
+    }
+
+    ZQ_ = new double[NUMEL*NUMQPTV];
+    smoothW_ = new double[NUMEL*NUMQPTV*NNPE];
+    invDiag_ = new double[m->NUMNP];
+    if(layout_ == full)
+    {
+        DETJW_ = new double[NUMEL*NUMQPTV];
+        DNDX_ = new double[NUMEL*NUMQPTV*NNPE];
+        DNDY_ = new double[NUMEL*NUMQPTV*NNPE];
+        DNDZ_ = new double[NUMEL*NUMQPTV*NNPE];
+        XQ_ = new double[NUMEL*NUMQPTV];
+        YQ_ = new double[NUMEL*NUMQPTV];
+    }else{
+        ZU_ = new double[NUMEL*NUMQPTV];
+        ZV_ = new double[NUMEL*NUMQPTV];
+        ZW_ = new double[NUMEL*NUMQPTV];
+        jacX_ = new double[NUMQPTV*3];
+        jacY_ = new double[NUMQPTV*3];
+        offX_ = new double[NUMQPTV];
+        offY_ = new double[NUMQPTV];
+        SFu_ = new double[NUMQPTV*NNPE];
+        SFv_ = new double[NUMQPTV*NNPE];
+        SFw_ = new double[NUMQPTV*NNPE];
+
+        //the x and y rows of the Jacobian are those of element 0 for all elements
+        double x, y, z;
+        int node0 = m->get_node0(0);
+        for(q=0;q<NUMQPTV;q++)
+        {
+            elem.computeJacobianQuadraturePoint(q, 0, x, y, z);
+            for(k=0;k<3;k++)
+            {
+                jacX_[q*3+k] = elem.RJACV[0*3+k];
+                jacY_[q*3+k] = elem.RJACV[1*3+k];
+            }
+            offX_[q] = x - m->XORD(node0);
+            offY_[q] = y - m->YORD(node0);
+            for(k=0;k<NNPE;k++)
+            {
+                SFu_[q*NNPE+k] = elem.SFV[1*NNPE*NUMQPTV+k*NUMQPTV+q];
+                SFv_[q*NNPE+k] = elem.SFV[2*NNPE*NUMQPTV+k*NUMQPTV+q];
+                SFw_[q*NNPE+k] = elem.SFV[3*NNPE*NUMQPTV+k*NUMQPTV+q];
+            }
+        }
+    }
+
+#pragma omp parallel default(shared) private(i,q,k)
+    {
+        element e(m);
+        double x, y, z;
+
+#pragma omp for
+        for(i=0;i<NUMEL;i++)
+        {
+            for(q=0;q<NUMQPTV;q++)
+            {
+                int p = i*NUMQPTV+q;
+                e.computeJacobianQuadraturePoint(q, i, x, y, z);
+                ZQ_[p] = z;
+                for(k=0;k<NNPE;k++)
+                {
+                    int node = m->get_global_node(k, i);
+                    double dx = m->XORD(node) - x;
+                    double dy = m->YORD(node) - y;
+                    double dz = m->ZORD(node) - z;
+                    smoothW_[p*NNPE+k] = 1.0/std::sqrt(dx*dx + dy*dy + dz*dz);
+                }
+                if(layout_ == full)
+                {
+                    DETJW_[p] = e.DETJ*weight_[q];
+                    XQ_[p] = x;
+                    YQ_[p] = y;
+                    for(k=0;k<NNPE;k++)
+                    {
+                        DNDX_[p*NNPE+k] = e.DNDX[k];
+                        DNDY_[p*NNPE+k] = e.DNDY[k];
+                        DNDZ_[p*NNPE+k] = e.DNDZ[k];
+                    }
+                }else{
+                    ZU_[p] = e.RJACV[2*3+0];
+                    ZV_[p] = e.RJACV[2*3+1];
+                    ZW_[p] = e.RJACV[2*3+2];
+                }
+            }
+        }
+    }
+
+    //sum of the weights at each node, serial since elements share nodes
+    for(i=0;i<m->NUMNP;i++)
+        invDiag_[i] = 0.0;
+    for(i=0;i<NUMEL;i++)
+    {
+        for(k=0;k<NNPE;k++)
+        {
+            int node = m->get_global_node(k, i);
+            for(q=0;q<NUMQPTV;q++)
+                invDiag_[node] += smoothW_[(i*NUMQPTV+q)*NNPE+k];
+        }
+    }
+    for(i=0;i<m->NUMNP;i++)
+        invDiag_[i] = 1.0/invDiag_[i];
+}
+
+void ElementGeometry::deallocate()
+{
+    delete[] DETJW_;
+    DETJW_ = NULL;
+    delete[] DNDX_;
+    DNDX_ = NULL;
+    delete[] DNDY_;
+    DNDY_ = NULL;
+    delete[] DNDZ_;
+    DNDZ_ = NULL;
+    delete[] XQ_;
+    XQ_ = NULL;
+    delete[] YQ_;
+    YQ_ = NULL;
+    delete[] ZQ_;
+    ZQ_ = NULL;
+    delete[] smoothW_;
+    smoothW_ = NULL;
+    delete[] invDiag_;
+    invDiag_ = NULL;
+    delete[] ZU_;
+    ZU_ = NULL;
+    delete[] ZV_;
+    ZV_ = NULL;
+    delete[] ZW_;
+    ZW_ = NULL;
+    delete[] weight_;
+    weight_ = NULL;
+    delete[] jacX_;
+    jacX_ = NULL;
+    delete[] jacY_;
+    jacY_ = NULL;
+    delete[] offX_;
+    offX_ = NULL;
+    delete[] offY_;
+    offY_ = NULL;
+    delete[] SFu_;
+    SFu_ = NULL;
+    delete[] SFv_;
+    SFv_ = NULL;
+    delete[] SFw_;
+    SFw_ = NULL;
+
+    mesh_ = NULL;
+    NUMEL = 0;
+}
+
+bool ElementGeometry::isBuilt() const
+{
+    return (ZQ_ != NULL);
+}
+
+ElementGeometry::eLayout ElementGeometry::get_layout() const
+{
+    return layout_;
+}
+
+int ElementGeometry::get_numQuadPoints() const
+{
+    return NUMQPTV;
+}
+
+/**
+ * @return Memory used by the factors in megabytes.
+ */
+double ElementGeometry::get_memoryMB() const
+{
+    double n = (double)NUMEL*NUMQPTV;
+    double doubles = (layout_ == full) ? n*(4 + 3*NNPE) : n*4;
+    doubles += n*NNPE + (mesh_ ? mesh_->NUMNP : 0);     //smoothing weights
+    return doubles*sizeof(double)/(1024.0*1024.0);
+}
+
+/**
+ * Factors of one quadrature point, the same values
+ * element::computeJacobianQuadraturePoint() computes.
+ * @param elemNum Element number.
+ * @param q Local quadrature point number.
+ * @param DNDX Filled with dN/dx of the NNPE nodes.
+ * @param DNDY Filled with dN/dy of the NNPE nodes.
+ * @param DNDZ Filled with dN/dz of the NNPE nodes.
+ * @param DETJW Set to the determinant of the Jacobian times the quadrature weight.
+ * @param x Set to the x coordinate of the quadrature point.
+ * @param y Set to the y coordinate of the quadrature point.
+ * @param z Set to the z coordinate of the quadrature point.
+ */
+void ElementGeometry::get(const int &elemNum, const int &q, double *DNDX, double *DNDY, double *DNDZ,
+                          double &DETJW, double &x, double &y, double &z) const
+{
+    int k;
+    int p = elemNum*NUMQPTV+q;
+
+    z = ZQ_[p];
+
+    if(layout_ == full)
+    {
+        const double *dx = &DNDX_[p*NNPE];
+        const double *dy = &DNDY_[p*NNPE];
+        const double *dz = &DNDZ_[p*NNPE];
+        for(k=0;k<NNPE;k++)
+        {
+            DNDX[k] = dx[k];
+            DNDY[k] = dy[k];
+            DNDZ[k] = dz[k];
+        }
+        DETJW = DETJW_[p];
+        x = XQ_[p];
+        y = YQ_[p];
+        return;
+    }
+
+    //Jacobian rows (jx, jy, jz), inverse as in element::computeJacobianQuadraturePoint()
+    const double *jx = &jacX_[q*3];
+    const double *jy = &jacY_[q*3];
+    double jz[3] = {ZU_[p], ZV_[p], ZW_[p]};
+
+    double DETJ = jx[0]*(jy[1]*jz[2]-jy[2]*jz[1])-jx[1]*(jy[0]*jz[2]-jy[2]*jz[0])+jx[2]*(jy[0]*jz[1]-jy[1]*jz[0]);
+    double rdet = 1.0/DETJ;
+    double I00=(jy[1]*jz[2]-jy[2]*jz[1])*rdet;
+    double I01=(jx[2]*jz[1]-jx[1]*jz[2])*rdet;
+    double I02=(jx[1]*jy[2]-jx[2]*jy[1])*rdet;
+    double I10=(jy[2]*jz[0]-jy[0]*jz[2])*rdet;
+    double I11=(jx[0]*jz[2]-jx[2]*jz[0])*rdet;
+    double I12=(jx[2]*jy[0]-jx[0]*jy[2])*rdet;
+    double I20=(jy[0]*jz[1]-jy[1]*jz[0])*rdet;
+    double I21=(jx[1]*jz[0]-jx[0]*jz[1])*rdet;
+    double I22=(jx[0]*jy[1]-jx[1]*jy[0])*rdet;
+
+    const double *Nu = &SFu_[q*NNPE];
+    const double *Nv = &SFv_[q*NNPE];
+    const double *Nw = &SFw_[q*NNPE];
+    for(k=0;k<NNPE;k++)
+    {
+        DNDX[k] = I00*Nu[k]+I10*Nv[k]+I20*Nw[k];
+        DNDY[k] = I01*Nu[k]+I11*Nv[k]+I21*Nw[k];
+        DNDZ[k] = I02*Nu[k]+I12*Nv[k]+I22*Nw[k];
+    }
+    DETJW = DETJ*weight_[q];
+
+    int node0 = mesh_->get_node0(elemNum);
+    x = mesh_->XORD(node0)+offX_[q];
+    y = mesh_->YORD(node0)+offY_[q];
+}
+
+/**
+ * Nodal gradient of a nodal field by "stress smoothing" (Thompson, Introduction
+ * to the Finite Element Method, p. 228): the gradient at each quadrature point
+ * is distributed to the nodes of the element with inverse distance weights.
+ * Elements are done in 8 colours (parity of the element (i,j,k) index) like in
+ * ninja::discretize(), so no two threads update the same node and the results
+ * are written in place.  Opens its own parallel region.
+ * @param phi Nodal values.
+ * @param dphidx Set to the smoothed d(phi)/dx at the nodes.
+ * @param dphidy Set to the smoothed d(phi)/dy at the nodes.
+ * @param dphidz Set to the smoothed d(phi)/dz at the nodes.
+ */
+void ElementGeometry::smoothGradient(const double *phi, double *dphidx, double *dphidy, double *dphidz) const
+{
+    const Mesh &m = *mesh_;
+    int i;
+
+#pragma omp parallel default(shared) private(i)
+    {
+        double DNDX[8], DNDY[8], DNDZ[8];
+        int nodes[8];
+        double gx, gy, gz, DETJW, x, y, z;
+        int color, c, ci, cj, ck, nci, ncj, nColorElems, elemNum, node0, q, k;
+        int ei, ej, ek;
+        int strides[8];
+        m.get_nodeStrides(strides);
+
+#pragma omp for
+        for(i=0;i<m.NUMNP;i++)
+        {
+            dphidx[i] = 0.0;
+            dphidy[i] = 0.0;
+            dphidz[i] = 0.0;
+        }
+
+        for(color=0;color<8;color++)
+        {
+            ci=color%2;
+            cj=(color/2)%2;
+            ck=color/4;
+            nci=(m.nrowsElem-ci+1)/2;
+            ncj=(m.ncolsElem-cj+1)/2;
+            nColorElems=nci*ncj*((m.nlayersElem-ck+1)/2);
+
+#pragma omp for
+            for(c=0;c<nColorElems;c++)
+            {
+                ei = 2*((c/ncj)%nci)+ci;
+                ej = 2*(c%ncj)+cj;
+                ek = 2*(c/(ncj*nci))+ck;
+                elemNum = m.get_elemNum(ei, ej, ek);
+                node0 = m.get_node0(ei, ej, ek);
+                for(k=0;k<NNPE;k++)
+                    nodes[k] = node0+strides[k];
+
+                for(q=0;q<NUMQPTV;q++)
+                {
+                    get(elemNum, q, DNDX, DNDY, DNDZ, DETJW, x, y, z);
+                    gx = gy = gz = 0.0;
+                    for(k=0;k<NNPE;k++)
+                    {
+                        gx += DNDX[k]*phi[nodes[k]];
+                        gy += DNDY[k]*phi[nodes[k]];
+                        gz += DNDZ[k]*phi[nodes[k]];
+                    }
+                    const double *w = &smoothW_[(elemNum*NUMQPTV+q)*NNPE];
+                    for(k=0;k<NNPE;k++)
+                    {
+                        dphidx[nodes[k]] += w[k]*gx;
+                        dphidy[nodes[k]] += w[k]*gy;
+                        dphidz[nodes[k]] += w[k]*gz;
+                    }
+                }
+            }
+        }
+
+#pragma omp for
+        for(i=0;i<m.NUMNP;i++)
+        {
+            dphidx[i] *= invDiag_[i];
+            dphidy[i] *= invDiag_[i];
+            dphidz[i] *= invDiag_[i];
+        }
+    }
+}
+
+/**
+ * @return true if XORD only depends on the column and YORD only on the row,
+ * both with a constant spacing, which is how Mesh::buildStandardMesh() builds
+ * the horizontal grid.
+ */
+bool ElementGeometry::isUniformXY() const
+{
+    const Mesh &m = *mesh_;
+    if(m.nrows < 2 || m.ncols < 2)
+        return false;
+
+    double x0 = m.XORD(0,0,0);
+    double y0 = m.YORD(0,0,0);
+    double dx = m.XORD(0,1,0) - x0;
+    double dy = m.YORD(1,0,0) - y0;
+    double tol = 1e-6*(std::fabs(dx) + std::fabs(dy));
+
+    for(int k=0;k<m.nlayers;k++)
+    {
+        for(int i=0;i<m.nrows;i++)
+        {
+            for(int j=0;j<m.ncols;j++)
+            {
+                if(std::fabs(m.XORD(i,j,k) - (x0 + j*dx)) > tol ||
+                   std::fabs(m.YORD(i,j,k) - (y0 + i*dy)) > tol)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
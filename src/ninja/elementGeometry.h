@@ -0,0 +1,121 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Geometric factors of the mesh elements at the quadrature points
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef ELEMENT_GEOMETRY_H
+#define ELEMENT_GEOMETRY_H
+
+#include "mesh.h"
+#include "element.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Jacobian determinants, shape function gradients and coordinates of all
+ * element quadrature points of a mesh, computed once.
+ *
+ * element::computeJacobianQuadraturePoint() gathers the coordinates of the 8
+ * nodes and inverts the 3x3 Jacobian every time it is called, and assembly,
+ * the velocity calculation, the gradients for the friction velocity and the
+ * matrix-free operator all call it for every element again.  Instead they
+ * read the factors from one ElementGeometry of the mesh.
+ *
+ * Two layouts (structure of arrays, element by element):
+ *
+ * full     DETJ*WT, dN/dx, dN/dy, dN/dz of the 8 nodes and (x,y,z) per
+ *          quadrature point, 28 doubles per point.
+ * compact  For meshes with uniform horizontal spacing (Mesh::buildStandardMesh())
+ *          x and y are linear in the element coordinates and the same for all
+ *          elements, only the z row of the Jacobian and z vary.  Those 4
+ *          doubles per point are stored and the gradients are rebuilt from
+ *          them in get().  If the mesh is not uniform the full layout is
+ *          used instead.
+ *
+ * It also keeps the inverse distance weights of the "stress smoothing" of
+ * nodal gradients (smoothGradient()), which only depend on the geometry:
+ * another 8 doubles per point and one per node in both layouts (see
+ * get_memoryMB()).
+ *
+ * The factors belong to the mesh passed to initialize(), which must not
+ * change (or move) while they are used.
+ */
+class ElementGeometry
+{
+public:
+    ElementGeometry();
+    ~ElementGeometry();
+
+    enum eLayout{
+        full,
+        compact
+    };
+
+    void initialize(Mesh const* m, eLayout layout);
+    void deallocate();
+    bool isBuilt() const;
+
+    eLayout get_layout() const;
+    int get_numQuadPoints() const;
+    double get_memoryMB() const;
+
+    void get(const int &elemNum, const int &q, double *DNDX, double *DNDY, double *DNDZ,
+             double &DETJW, double &x, double &y, double &z) const;
+
+    void smoothGradient(const double *phi, double *dphidx, double *dphidy, double *dphidz) const;
+
+private:
+    ElementGeometry(const ElementGeometry &rhs);            //not copyable
+    ElementGeometry &operator=(const ElementGeometry &rhs);
+
+    bool isUniformXY() const;
+
+    Mesh const* mesh_;
+    eLayout layout_;
+    int NUMEL, NNPE, NUMQPTV;
+
+    //full layout, index (elemNum*NUMQPTV+q) or (elemNum*NUMQPTV+q)*NNPE+k
+    double *DETJW_;
+    double *DNDX_, *DNDY_, *DNDZ_;
+    double *XQ_, *YQ_;
+    double *ZQ_;                    //both layouts
+
+    //stress smoothing, index (elemNum*NUMQPTV+q)*NNPE+k and node number
+    double *smoothW_;               //1/distance from quadrature point q to node k
+    double *invDiag_;               //1/(sum of the weights of a node)
+
+    //compact layout, index elemNum*NUMQPTV+q
+    double *ZU_, *ZV_, *ZW_;        //dz/du, dz/dv, dz/dw
+    //compact layout, the same for all elements, index q, q*3+m or q*NNPE+k
+    double *weight_;                //quadrature weights
+    double *jacX_, *jacY_;          //dx/d(u,v,w), dy/d(u,v,w)
+    double *offX_, *offY_;          //x, y of the point minus x, y of local node 0
+    double *SFu_, *SFv_, *SFw_;     //dN/du, dN/dv, dN/dw
+};
+
+#endif  //ELEMENT_GEOMETRY_H
@@ -531,6 +531,7 @@ void FrictionVelocity::ComputeVertexNormals(Mesh const& mesh, WindNinjaInputs &i
  * @param References to the u, v, and w arrays
  * @param Reference to the mesh
  * @param calcMethod to indicate which method should be used; default is logProfile
+ * @param Element geometry factors of the mesh, computed here if NULL
  */
 void FrictionVelocity::ComputeUstar(WindNinjaInputs &input,
                                    AsciiGrid<double> &grid,
@@ -538,13 +539,21 @@ void FrictionVelocity::ComputeUstar(WindNinjaInputs &input,
                                    wn_3dScalarField &v,
                                    wn_3dScalarField &w,
                                    const Mesh &mesh,
-                                   std::string calcMethod)
+                                   std::string calcMethod,
+                                   ElementGeometry const* geometry)
 {
     wn_3dVectorField uDerivatives, vDerivatives, wDerivatives;
 
-    u.ComputeGradient(input, uDerivatives);  //calculates du/dx, du/dy, du/dz
-    v.ComputeGradient(input, vDerivatives);  //calculates dv/dx, dv/dy, dv/dz
-    w.ComputeGradient(input, wDerivatives);  //calculates dw/dx, dw/dy, dw/dz
+    ElementGeometry localGeometry;     //computed once for the three gradients
+    if(geometry == NULL)
+    {
+        localGeometry.initialize(&mesh, ElementGeometry::compact);
+        geometry = &localGeometry;
+    }
+
+    u.ComputeGradient(uDerivatives, geometry);  //calculates du/dx, du/dy, du/dz
+    v.ComputeGradient(vDerivatives, geometry);  //calculates dv/dx, dv/dy, dv/dz
+    w.ComputeGradient(wDerivatives, geometry);  //calculates dw/dx, dw/dy, dw/dz
 
     //cout << "### uDeriv.vectorData_z(0,0,0) = " << (*uDerivatives.vectorData_z)(0,0,0) << endl;
     //cout << "### uDeriv.vectorData_z = " << (uDerivatives.vectorData_z) << endl;
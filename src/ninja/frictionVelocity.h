@@ -37,6 +37,7 @@
 #include "mesh.h"
 #include "wn_3dScalarField.h"
 #include "wn_3dVectorField.h"
+#include "elementGeometry.h"
 
 
 class FrictionVelocity{
@@ -50,7 +51,8 @@ class FrictionVelocity{
                           wn_3dScalarField &v,
                           wn_3dScalarField &w,
                           const Mesh &mesh,
-                          std::string calcMethod = "logProfile");
+                          std::string calcMethod = "logProfile",
+                          ElementGeometry const* geometry = NULL);
 
         AsciiGrid<double> VertexNormalX;  //grids to store vertex normals
         AsciiGrid<double> VertexNormalY;
@@ -0,0 +1,588 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Geometric multigrid preconditioner for the stiffness matrix
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+
+#include "geometricMultigrid.h"
+
+#include <cmath>
+
+#define MULTIGRID_MAX_LEVELS 20
+#define MULTIGRID_SWEEPS 2          //smoothing sweeps before and after the coarse grid correction
+#define MULTIGRID_OMEGA 0.6         //damping of the line Jacobi smoother
+#define MULTIGRID_MAX_DIRECT 2000   //largest coarsest grid solved with a dense Cholesky factorization
+#define MULTIGRID_COARSE_SWEEPS 20  //smoothing sweeps used instead when it is larger
+
+GeometricMultigrid::GeometricMultigrid()
+{
+    workSize = 0;
+}
+
+GeometricMultigrid::~GeometricMultigrid()
+{
+
+}
+
+/**
+ * Builds the grid hierarchy.
+ * @param A Stiffness matrix with boundary conditions applied, upper triangle in
+ *          compressed row storage.
+ * @param row_ptr Row pointer of A.
+ * @param col_ind Column indices of A.
+ * @param nrows Number of node rows of the mesh.
+ * @param ncols Number of node columns of the mesh.
+ * @param nlayers Number of node layers of the mesh.
+ * @return false if A does not have the 27 point pattern of an
+ *         nrows x ncols x nlayers grid or a matrix is not positive definite.
+ */
+bool GeometricMultigrid::initialize(const double *A, const int *row_ptr, const int *col_ind,
+                           int nrows, int ncols, int nlayers)
+{
+    levels.clear();
+    coarseFactor.clear();
+    workSize = 0;
+
+    levels.reserve(MULTIGRID_MAX_LEVELS);
+    levels.push_back(Level());
+    levels[0].nrows = nrows;
+    levels[0].ncols = ncols;
+    levels[0].nlayers = nlayers;
+    levels[0].NUMNP = nrows*ncols*nlayers;
+
+    if(!buildFinestLevel(A, row_ptr, col_ind))
+        return false;
+
+    while((levels.back().nrows > 3 || levels.back().ncols > 3) &&
+          (int)levels.size() < MULTIGRID_MAX_LEVELS)
+    {
+        levels.push_back(Level());
+        buildCoarseLevel(levels[levels.size()-2], levels.back());
+    }
+
+    for(unsigned int l=0; l<levels.size(); l++)
+    {
+        if(!factorLines(levels[l]))
+            return false;
+    }
+
+    //residual on every level, right hand side and solution on the coarse ones
+    for(unsigned int l=0; l<levels.size(); l++)
+    {
+        levels[l].workOffset = workSize;
+        workSize += (l == 0 ? 1 : 3)*levels[l].NUMNP;
+    }
+
+    return factorCoarsest();
+}
+
+int GeometricMultigrid::get_workSize() const
+{
+    return workSize;
+}
+
+int GeometricMultigrid::get_numLevels() const
+{
+    return levels.size();
+}
+
+/**
+ * Copies the CRS upper triangle of A into full 27 point stencils.
+ */
+bool GeometricMultigrid::buildFinestLevel(const double *A, const int *row_ptr, const int *col_ind)
+{
+    Level &L = levels[0];
+    int nrc = L.nrows*L.ncols;
+    L.stencil.assign(27*(size_t)L.NUMNP, 0.0);
+
+    for(int row=0; row<L.NUMNP; row++)
+    {
+        int k = row/nrc;
+        int i = (row%nrc)/L.ncols;
+        int j = row%L.ncols;
+        for(int n=row_ptr[row]; n<row_ptr[row+1]; n++)
+        {
+            int col = col_ind[n];
+            int dk = col/nrc - k;
+            int di = (col%nrc)/L.ncols - i;
+            int dj = col%L.ncols - j;
+            if(dk < -1 || dk > 1 || di < -1 || di > 1 || dj < -1 || dj > 1)
+                return false;   //not the mesh's stencil
+            int s = stencilIndex(dk, di, dj);
+            L.stencil[27*(size_t)row + s] = A[n];
+            L.stencil[27*(size_t)col + (26 - s)] = A[n];    //26-s is the opposite offset
+        }
+    }
+    return true;
+}
+
+/**
+ * Sets up the transfer along one direction.  Sizes of 3 or less are not
+ * coarsened.  Otherwise coarse index I sits on fine index 2*I, except that the
+ * last coarse index always sits on the last fine index (so for even nFine the
+ * last coarse interval is only one fine interval long).  Fine indices between
+ * two coarse ones are interpolated linearly.
+ *
+ * The first and last nodes of every grid line are on the lateral boundary,
+ * which has Dirichlet conditions (identity rows and columns in A).  Their
+ * error is always zero, so the interior fine nodes do not interpolate from the
+ * coarse end nodes and the boundary stays decoupled on every level.
+ */
+void GeometricMultigrid::buildTransfer(int nFine, int &nCoarse, Transfer1D &transfer) const
+{
+    int i;
+    bool coarsen = nFine > 3;
+    nCoarse = coarsen ? nFine/2 + 1 : nFine;
+
+    transfer.interp.resize(nFine);
+    for(i=0; i<nFine; i++)
+    {
+        Interp1D &t = transfer.interp[i];
+        if(!coarsen)
+        {
+            t.i0 = t.i1 = i;
+            t.w0 = 1.0;
+            t.w1 = 0.0;
+            continue;
+        }
+
+        if(i == nFine-1)
+        {
+            t.i0 = t.i1 = nCoarse-1;
+            t.w0 = 1.0;
+            t.w1 = 0.0;
+        }else if(i%2 == 0){
+            t.i0 = t.i1 = i/2;
+            t.w0 = 1.0;
+            t.w1 = 0.0;
+        }else{
+            t.i0 = i/2;
+            t.i1 = i/2 + 1;
+            t.w0 = t.w1 = 0.5;
+        }
+
+        if(i > 0 && i < nFine-1)
+        {
+            //drop the boundary coarse nodes
+            if(t.i1 == nCoarse-1 && t.i1 != t.i0)
+            {
+                t.i1 = t.i0;
+                t.w1 = 0.0;
+            }
+            if(t.i0 == 0)
+            {
+                t.i0 = t.i1;
+                t.w0 = t.w1;
+                t.w1 = 0.0;
+            }
+        }
+    }
+
+    //transpose
+    transfer.restrictPtr.assign(nCoarse+1, 0);
+    for(i=0; i<nFine; i++)
+    {
+        const Interp1D &t = transfer.interp[i];
+        if(t.w0 != 0.0)
+            transfer.restrictPtr[t.i0+1]++;
+        if(t.w1 != 0.0)
+            transfer.restrictPtr[t.i1+1]++;
+    }
+    for(int I=0; I<nCoarse; I++)
+        transfer.restrictPtr[I+1] += transfer.restrictPtr[I];
+    transfer.restrictIndex.resize(transfer.restrictPtr[nCoarse]);
+    transfer.restrictWeight.resize(transfer.restrictPtr[nCoarse]);
+    std::vector<int> next(transfer.restrictPtr.begin(), transfer.restrictPtr.end()-1);
+    for(i=0; i<nFine; i++)
+    {
+        const Interp1D &t = transfer.interp[i];
+        if(t.w0 != 0.0)
+        {
+            transfer.restrictIndex[next[t.i0]] = i;
+            transfer.restrictWeight[next[t.i0]++] = t.w0;
+        }
+        if(t.w1 != 0.0)
+        {
+            transfer.restrictIndex[next[t.i1]] = i;
+            transfer.restrictWeight[next[t.i1]++] = t.w1;
+        }
+    }
+}
+
+/**
+ * Builds the transfer from fine to coarse and the Galerkin coarse matrix
+ * P^T*A*P.  Each coarse node gathers from the fine nodes that interpolate
+ * from it, so the coarse nodes can be done in parallel.
+ */
+void GeometricMultigrid::buildCoarseLevel(Level &fine, Level &coarse)
+{
+    buildTransfer(fine.nrows, coarse.nrows, fine.rowTransfer);
+    buildTransfer(fine.ncols, coarse.ncols, fine.colTransfer);
+    coarse.nlayers = fine.nlayers;
+    coarse.NUMNP = coarse.nrows*coarse.ncols*coarse.nlayers;
+    coarse.stencil.assign(27*(size_t)coarse.NUMNP, 0.0);
+
+    const Transfer1D &rt = fine.rowTransfer;
+    const Transfer1D &ct = fine.colTransfer;
+    int fnrc = fine.nrows*fine.ncols;
+    int cnrc = coarse.nrows*coarse.ncols;
+    int C;
+
+#pragma omp parallel for default(shared) private(C)
+    for(C=0; C<coarse.NUMNP; C++)
+    {
+        int k = C/cnrc;
+        int I = (C%cnrc)/coarse.ncols;
+        int J = C%coarse.ncols;
+        double *sc = &coarse.stencil[27*(size_t)C];
+
+        for(int a=rt.restrictPtr[I]; a<rt.restrictPtr[I+1]; a++)
+        {
+            int i = rt.restrictIndex[a];
+            for(int b=ct.restrictPtr[J]; b<ct.restrictPtr[J+1]; b++)
+            {
+                int j = ct.restrictIndex[b];
+                double wf = rt.restrictWeight[a]*ct.restrictWeight[b];
+                const double *sf = &fine.stencil[27*((size_t)k*fnrc + i*fine.ncols + j)];
+
+                for(int dk=-1; dk<=1; dk++)
+                {
+                    if(k+dk < 0 || k+dk >= fine.nlayers)
+                        continue;
+                    for(int di=-1; di<=1; di++)
+                    {
+                        if(i+di < 0 || i+di >= fine.nrows)
+                            continue;
+                        const Interp1D &ti = rt.interp[i+di];
+                        for(int dj=-1; dj<=1; dj++)
+                        {
+                            if(j+dj < 0 || j+dj >= fine.ncols)
+                                continue;
+                            double v = wf*sf[stencilIndex(dk, di, dj)];
+                            if(v == 0.0)
+                                continue;
+                            const Interp1D &tj = ct.interp[j+dj];
+                            //spread over the (up to 4) coarse nodes g interpolates from,
+                            //they are all within one coarse cell of C
+                            sc[stencilIndex(dk, ti.i0-I, tj.i0-J)] += v*ti.w0*tj.w0;
+                            if(tj.w1 != 0.0)
+                                sc[stencilIndex(dk, ti.i0-I, tj.i1-J)] += v*ti.w0*tj.w1;
+                            if(ti.w1 != 0.0)
+                            {
+                                sc[stencilIndex(dk, ti.i1-I, tj.i0-J)] += v*ti.w1*tj.w0;
+                                if(tj.w1 != 0.0)
+                                    sc[stencilIndex(dk, ti.i1-I, tj.i1-J)] += v*ti.w1*tj.w1;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * LU factorization of the tridiagonal z-line blocks of a level (the couplings
+ * within each vertical column of nodes), for the Thomas algorithm in smooth().
+ */
+bool GeometricMultigrid::factorLines(Level &L)
+{
+    int nrc = L.nrows*L.ncols;
+    bool ok = true;
+    int q;
+
+    L.lineInvPivot.resize(L.NUMNP);
+    L.lineUpper.resize(L.NUMNP);
+
+    //each thread clears its own copy of ok, && is in OpenMP 2.0
+#pragma omp parallel for default(shared) private(q) reduction(&&:ok)
+    for(q=0; q<nrc; q++)
+    {
+        double prevUpper = 0.0;
+        for(int k=0; k<L.nlayers; k++)
+        {
+            int node = k*nrc + q;
+            const double *s = &L.stencil[27*(size_t)node];
+            double d = s[13] - (k > 0 ? s[stencilIndex(-1, 0, 0)]*prevUpper : 0.0);
+            if(d <= 0.0)
+            {
+                ok = false;     //not positive definite
+                break;
+            }
+            L.lineInvPivot[node] = 1.0/d;
+            prevUpper = (k < L.nlayers-1) ? s[stencilIndex(1, 0, 0)]/d : 0.0;
+            L.lineUpper[node] = prevUpper;
+        }
+    }
+    return ok;
+}
+
+/**
+ * Dense Cholesky factorization of the coarsest matrix, if it is small enough.
+ */
+bool GeometricMultigrid::factorCoarsest()
+{
+    const Level &L = levels.back();
+    int N = L.NUMNP;
+    if(N > MULTIGRID_MAX_DIRECT)
+        return true;    //coarseSolve() smooths instead
+
+    int nrc = L.nrows*L.ncols;
+    coarseFactor.assign((size_t)N*N, 0.0);
+    for(int row=0; row<N; row++)
+    {
+        int k = row/nrc;
+        int i = (row%nrc)/L.ncols;
+        int j = row%L.ncols;
+        for(int dk=-1; dk<=1; dk++)
+            for(int di=-1; di<=1; di++)
+                for(int dj=-1; dj<=1; dj++)
+                {
+                    if(k+dk < 0 || k+dk >= L.nlayers || i+di < 0 || i+di >= L.nrows ||
+                       j+dj < 0 || j+dj >= L.ncols)
+                        continue;
+                    int col = row + dk*nrc + di*L.ncols + dj;
+                    coarseFactor[(size_t)row*N + col] = L.stencil[27*(size_t)row + stencilIndex(dk, di, dj)];
+                }
+    }
+
+    //lower triangle L*L^T = A, in place
+    for(int j=0; j<N; j++)
+    {
+        double d = coarseFactor[(size_t)j*N + j];
+        for(int p=0; p<j; p++)
+            d -= coarseFactor[(size_t)j*N + p]*coarseFactor[(size_t)j*N + p];
+        if(d <= 0.0)
+            return false;
+        d = std::sqrt(d);
+        coarseFactor[(size_t)j*N + j] = d;
+        for(int i=j+1; i<N; i++)
+        {
+            double v = coarseFactor[(size_t)i*N + j];
+            for(int p=0; p<j; p++)
+                v -= coarseFactor[(size_t)i*N + p]*coarseFactor[(size_t)j*N + p];
+            coarseFactor[(size_t)i*N + j] = v/d;
+        }
+    }
+    return true;
+}
+
+/**
+ * Applies one V-cycle, z = M^(-1)*r.
+ * @param r Vector to precondition, NUMNP of the finest level.
+ * @param z Result, NUMNP of the finest level.
+ * @param work Work vector of get_workSize() values.  Only the work vector is
+ *             written, so several threads can share one GeometricMultigrid.
+ */
+void GeometricMultigrid::apply(const double *r, double *z, double *work) const
+{
+    vcycle(0, r, z, work);
+}
+
+void GeometricMultigrid::vcycle(int l, const double *b, double *x, double *work) const
+{
+    const Level &L = levels[l];
+
+    double *r = work + L.workOffset;
+
+    if(l == (int)levels.size()-1)
+    {
+        coarseSolve(b, x, r);
+        return;
+    }
+
+    const Level &C = levels[l+1];
+    double *bc = work + C.workOffset + C.NUMNP;
+    double *xc = work + C.workOffset + 2*C.NUMNP;
+    int n;
+
+#pragma omp parallel for default(shared) private(n)
+    for(n=0; n<L.NUMNP; n++)
+        x[n] = 0.0;
+
+    for(int sweep=0; sweep<MULTIGRID_SWEEPS; sweep++)
+        smooth(L, b, x, r);
+    residual(L, b, x, r);
+    restrictResidual(L, C, r, bc);
+    vcycle(l+1, bc, xc, work);
+    prolongateAdd(L, C, xc, x);
+    for(int sweep=0; sweep<MULTIGRID_SWEEPS; sweep++)
+        smooth(L, b, x, r);
+}
+
+/**
+ * One sweep of damped z-line block Jacobi, x = x + omega*D^(-1)*(b - A*x)
+ * where D holds the couplings within each vertical column of nodes.
+ * @param r Scratch vector of NUMNP values.
+ */
+void GeometricMultigrid::smooth(const Level &L, const double *b, double *x, double *r) const
+{
+    int nrc = L.nrows*L.ncols;
+    int q;
+
+    residual(L, b, x, r);
+
+#pragma omp parallel for default(shared) private(q)
+    for(q=0; q<nrc; q++)
+    {
+        //forward elimination and back substitution down the column, in place in r
+        int node = q;
+        r[node] *= L.lineInvPivot[node];
+        for(int k=1; k<L.nlayers; k++)
+        {
+            node += nrc;
+            r[node] = (r[node] - L.stencil[27*(size_t)node + stencilIndex(-1, 0, 0)]*r[node - nrc])*
+                      L.lineInvPivot[node];
+        }
+        x[node] += MULTIGRID_OMEGA*r[node];
+        for(int k=L.nlayers-2; k>=0; k--)
+        {
+            node -= nrc;
+            r[node] -= L.lineUpper[node]*r[node + nrc];
+            x[node] += MULTIGRID_OMEGA*r[node];
+        }
+    }
+}
+
+/**
+ * r = b - A*x
+ */
+void GeometricMultigrid::residual(const Level &L, const double *b, const double *x, double *r) const
+{
+    int nrc = L.nrows*L.ncols;
+    int ki;
+
+#pragma omp parallel for default(shared) private(ki)
+    for(ki=0; ki<L.nlayers*L.nrows; ki++)
+    {
+        int k = ki/L.nrows;
+        int i = ki%L.nrows;
+        int dkLo = k > 0 ? -1 : 0, dkHi = k < L.nlayers-1 ? 1 : 0;
+        int diLo = i > 0 ? -1 : 0, diHi = i < L.nrows-1 ? 1 : 0;
+        for(int j=0; j<L.ncols; j++)
+        {
+            int node = k*nrc + i*L.ncols + j;
+            int djLo = j > 0 ? -1 : 0, djHi = j < L.ncols-1 ? 1 : 0;
+            const double *s = &L.stencil[27*(size_t)node];
+            double sum = b[node];
+            for(int dk=dkLo; dk<=dkHi; dk++)
+                for(int di=diLo; di<=diHi; di++)
+                    for(int dj=djLo; dj<=djHi; dj++)
+                        sum -= s[stencilIndex(dk, di, dj)]*x[node + dk*nrc + di*L.ncols + dj];
+            r[node] = sum;
+        }
+    }
+}
+
+/**
+ * b = P^T*r
+ */
+void GeometricMultigrid::restrictResidual(const Level &fine, const Level &coarse, const double *r, double *b) const
+{
+    const Transfer1D &rt = fine.rowTransfer;
+    const Transfer1D &ct = fine.colTransfer;
+    int fnrc = fine.nrows*fine.ncols;
+    int cnrc = coarse.nrows*coarse.ncols;
+    int C;
+
+#pragma omp parallel for default(shared) private(C)
+    for(C=0; C<coarse.NUMNP; C++)
+    {
+        int k = C/cnrc;
+        int I = (C%cnrc)/coarse.ncols;
+        int J = C%coarse.ncols;
+        double sum = 0.0;
+        for(int a=rt.restrictPtr[I]; a<rt.restrictPtr[I+1]; a++)
+            for(int c=ct.restrictPtr[J]; c<ct.restrictPtr[J+1]; c++)
+                sum += rt.restrictWeight[a]*ct.restrictWeight[c]*
+                       r[k*fnrc + rt.restrictIndex[a]*fine.ncols + ct.restrictIndex[c]];
+        b[C] = sum;
+    }
+}
+
+/**
+ * x = x + P*xc
+ */
+void GeometricMultigrid::prolongateAdd(const Level &fine, const Level &coarse, const double *xc, double *x) const
+{
+    const Transfer1D &rt = fine.rowTransfer;
+    const Transfer1D &ct = fine.colTransfer;
+    int fnrc = fine.nrows*fine.ncols;
+    int cnrc = coarse.nrows*coarse.ncols;
+    int ki;
+
+#pragma omp parallel for default(shared) private(ki)
+    for(ki=0; ki<fine.nlayers*fine.nrows; ki++)
+    {
+        int k = ki/fine.nrows;
+        int i = ki%fine.nrows;
+        const Interp1D &ti = rt.interp[i];
+        const double *c0 = xc + k*cnrc + ti.i0*coarse.ncols;
+        const double *c1 = xc + k*cnrc + ti.i1*coarse.ncols;
+        for(int j=0; j<fine.ncols; j++)
+        {
+            const Interp1D &tj = ct.interp[j];
+            x[k*fnrc + i*fine.ncols + j] +=
+                ti.w0*(tj.w0*c0[tj.i0] + tj.w1*c0[tj.i1]) +
+                ti.w1*(tj.w0*c1[tj.i0] + tj.w1*c1[tj.i1]);
+        }
+    }
+}
+
+/**
+ * Solves the coarsest level, with the Cholesky factor if there is one, else
+ * approximately with smoothing sweeps.
+ * @param r Scratch vector of NUMNP values.
+ */
+void GeometricMultigrid::coarseSolve(const double *b, double *x, double *r) const
+{
+    const Level &L = levels.back();
+    int N = L.NUMNP;
+
+    if(!coarseFactor.empty())
+    {
+        for(int i=0; i<N; i++)     //L*y = b
+        {
+            double v = b[i];
+            for(int p=0; p<i; p++)
+                v -= coarseFactor[(size_t)i*N + p]*x[p];
+            x[i] = v/coarseFactor[(size_t)i*N + i];
+        }
+        for(int i=N-1; i>=0; i--)  //L^T*x = y
+        {
+            double v = x[i];
+            for(int p=i+1; p<N; p++)
+                v -= coarseFactor[(size_t)p*N + i]*x[p];
+            x[i] = v/coarseFactor[(size_t)i*N + i];
+        }
+        return;
+    }
+
+    for(int i=0; i<N; i++)
+        x[i] = 0.0;
+    for(int sweep=0; sweep<MULTIGRID_COARSE_SWEEPS; sweep++)
+        smooth(L, b, x, r);
+}
@@ -0,0 +1,133 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Geometric multigrid preconditioner for the stiffness matrix
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+
+#ifndef GEOMETRIC_MULTIGRID_H
+#define GEOMETRIC_MULTIGRID_H
+
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Geometric multigrid V-cycle for the stiffness matrix of the terrain
+ * following mesh, used as a preconditioner by the conjugate gradient solver.
+ *
+ * The mesh is a logically Cartesian nrows x ncols x nlayers grid, but the
+ * cells near the ground are much thinner than they are wide, so the matrix is
+ * strongly anisotropic with the strong coupling in z.  Point smoothers do not
+ * reduce the smooth-in-z error, so the smoother solves whole vertical lines
+ * at once (damped block Jacobi with one tridiagonal solve per column), and
+ * the grids are only coarsened horizontally.  Higher up, where the stretched
+ * cells are thick, the coupling is mostly horizontal, which horizontal
+ * coarsening handles too.
+ *
+ * The elements use one point quadrature, so A has nearly singular
+ * checkerboard (hourglass) modes that no coarse grid can represent.  A
+ * multicolored Gauss-Seidel smoother leaves error in exactly those patterns
+ * and the cycle stalls; Jacobi does not, and is trivially parallel.
+ *
+ * Each coarse level keeps every other row and column of the finer one (and
+ * always the last one) with bilinear interpolation between them.  The
+ * Dirichlet nodes on the lateral boundary are only injected, so they stay
+ * decoupled on the coarse levels.
+ * The coarse matrices are Galerkin products P^T*A*P, so they stay symmetric
+ * positive definite and keep the 27 point stencil.  Coarsening stops at 3x3
+ * columns, which are solved directly.
+ *
+ * One V-cycle with the same number of Jacobi sweeps on the way down and up is
+ * a symmetric positive definite operator, so it can be used as a CG
+ * preconditioner.
+ *
+ * All matrices are stored as full 27 point stencils, 27 doubles per node.
+ */
+class GeometricMultigrid
+{
+public:
+    GeometricMultigrid();
+    ~GeometricMultigrid();
+
+    bool initialize(const double *A, const int *row_ptr, const int *col_ind,
+                    int nrows, int ncols, int nlayers);
+    void apply(const double *r, double *z, double *work) const;    //z = M^(-1)*r, one V-cycle
+
+    int get_workSize() const;       //size of the work vector apply() needs
+    int get_numLevels() const;
+
+private:
+    //interpolation from a coarse grid line to a fine one: fine index i gets
+    //w0*coarse[i0] + w1*coarse[i1]
+    struct Interp1D
+    {
+        int i0, i1;
+        double w0, w1;
+    };
+
+    //transfer along one grid direction, interp has one entry per fine index,
+    //the restriction (its transpose) lists the fine indices of coarse index I
+    //in restrictIndex[restrictPtr[I]..restrictPtr[I+1]-1]
+    struct Transfer1D
+    {
+        std::vector<Interp1D> interp;
+        std::vector<int> restrictPtr, restrictIndex;
+        std::vector<double> restrictWeight;
+    };
+
+    struct Level
+    {
+        int nrows, ncols, nlayers;
+        int NUMNP;
+        std::vector<double> stencil;        //27 coefficients per node, see stencilIndex()
+        std::vector<double> lineInvPivot, lineUpper;    //factored z-line blocks, see factorLines()
+        Transfer1D rowTransfer, colTransfer;    //to the next coarser level, empty on the coarsest level
+        int workOffset;                     //start of this level's vectors in the work vector
+    };
+
+    std::vector<Level> levels;
+    std::vector<double> coarseFactor;       //Cholesky factor of the coarsest matrix
+    int workSize;
+
+    static int stencilIndex(int dk, int di, int dj) { return (dk+1)*9 + (di+1)*3 + (dj+1); }
+
+    bool buildFinestLevel(const double *A, const int *row_ptr, const int *col_ind);
+    void buildTransfer(int nFine, int &nCoarse, Transfer1D &transfer) const;
+    void buildCoarseLevel(Level &fine, Level &coarse);
+    bool factorLines(Level &L);
+    bool factorCoarsest();
+
+    void vcycle(int l, const double *b, double *x, double *work) const;
+    void smooth(const Level &L, const double *b, double *x, double *r) const;
+    void residual(const Level &L, const double *b, const double *x, double *r) const;
+    void restrictResidual(const Level &fine, const Level &coarse, const double *r, double *b) const;
+    void prolongateAdd(const Level &fine, const Level &coarse, const double *xc, double *x) const;
+    void coarseSolve(const double *b, double *x, double *r) const;
+};
+
+#endif  //GEOMETRIC_MULTIGRID_H
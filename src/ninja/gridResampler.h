@@ -0,0 +1,340 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Index and weight tables to resample grids to another cell size
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef GRID_RESAMPLER_H
+#define GRID_RESAMPLER_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "Array2D.h"
+
+/**
+ * Resamples grids of one geometry (size, lower left corner and cell size)
+ * to another.
+ *
+ * The position of a cell center only depends on its column (x) or its row
+ * (y), so the source cells and weights of a resampled cell are the product
+ * of a column table and a row table, computed once when the resampler is
+ * built.  A resampled grid is then a pass over the rows (split between the
+ * OpenMP threads) that only reads the tables, and several grids of the same
+ * geometry (the surface properties of a dem) share one resampler.
+ *
+ * nearest and bilinear give the same values as AsciiGrid::interpolateGrid()
+ * with order0 and order1 at the resampled cell centers.  areaAverage is a
+ * box filter: each resampled cell is the average of the source cells it
+ * covers, weighted by the covered area and skipping no data cells, which
+ * is the right way to coarsen a grid (nearest only samples one cell in
+ * each block, so it aliases).
+ */
+class GridResampler
+{
+public:
+    enum eMethod
+    {
+        nearest,
+        bilinear,
+        areaAverage
+    };
+
+    GridResampler(int srcCols, int srcRows, double srcXll, double srcYll,
+                  double srcCellSize, int dstCols, int dstRows, double dstXll,
+                  double dstYll, double dstCellSize, eMethod resampleMethod);
+
+    inline int get_nCols() const {return dstCols;}
+    inline int get_nRows() const {return dstRows;}
+    inline double get_xllCorner() const {return dstXll;}
+    inline double get_yllCorner() const {return dstYll;}
+    inline double get_cellSize() const {return dstCellSize;}
+    inline eMethod get_method() const {return method;}
+
+    bool is_sourceGeometry(int nCols, int nRows, double xll, double yll,
+                           double cellSize) const;
+
+    template<class T>
+    void resample(const Array2D<T> &src, Array2D<T> &dst) const;
+
+private:
+    /**
+     * Table of one axis (columns or rows): for each resampled cell, the
+     * source cell of nearest, the cells and weight of bilinear and the range
+     * of cells and covered fractions of areaAverage.
+     */
+    struct Axis
+    {
+        void build(int n, double ll, double cellSize, int nOut, double llOut,
+                   double cellSizeOut, eMethod method);
+
+        std::vector<int> nearestCell;
+        std::vector<char> edge;         //bilinear falls back to nearest
+        std::vector<int> lowCell;       //bilinear is between lowCell and lowCell + 1
+        std::vector<double> weight;     //bilinear weight of lowCell + 1
+        std::vector<int> first;         //first cell covered
+        std::vector<int> offset;        //of the cells covered in coverage
+        std::vector<double> coverage;   //fraction of each cell covered
+    };
+
+    template<class T>
+    void resampleNearest(const Array2D<T> &src, Array2D<T> &dst) const;
+    template<class T>
+    void resampleBilinear(const Array2D<T> &src, Array2D<T> &dst) const;
+    template<class T>
+    void resampleAreaAverage(const Array2D<T> &src, Array2D<T> &dst) const;
+
+    int srcCols, srcRows;
+    double srcXll, srcYll, srcCellSize;
+    int dstCols, dstRows;
+    double dstXll, dstYll, dstCellSize;
+    eMethod method;
+
+    Axis cols;
+    Axis rows;
+};
+
+/**
+ * Builds the tables to resample a grid of the source geometry to the
+ * destination geometry.
+ */
+inline GridResampler::GridResampler(int srcCols, int srcRows, double srcXll,
+                                    double srcYll, double srcCellSize,
+                                    int dstCols, int dstRows, double dstXll,
+                                    double dstYll, double dstCellSize,
+                                    eMethod resampleMethod)
+    : srcCols(srcCols), srcRows(srcRows), srcXll(srcXll), srcYll(srcYll),
+      srcCellSize(srcCellSize), dstCols(dstCols), dstRows(dstRows),
+      dstXll(dstXll), dstYll(dstYll), dstCellSize(dstCellSize),
+      method(resampleMethod)
+{
+    if(srcCols < 1 || srcRows < 1 || dstCols < 0 || dstRows < 0 ||
+       srcCellSize <= 0.0 || dstCellSize <= 0.0)
+        throw std::logic_error("Invalid grid geometry in GridResampler::GridResampler().");
+
+    cols.build(srcCols, srcXll, srcCellSize, dstCols, dstXll, dstCellSize, method);
+    rows.build(srcRows, srcYll, srcCellSize, dstRows, dstYll, dstCellSize, method);
+}
+
+/**
+ * @return true if a grid of this geometry can be resampled.
+ */
+inline bool GridResampler::is_sourceGeometry(int nCols, int nRows, double xll,
+                                             double yll, double cellSize) const
+{
+    return nCols == srcCols && nRows == srcRows && xll == srcXll &&
+           yll == srcYll && cellSize == srcCellSize;
+}
+
+/**
+ * The expressions are the ones of AsciiGrid::get_cellPosition(),
+ * get_cellIndex() and interpolateGrid(), so the results are the same to the
+ * last bit.
+ */
+inline void GridResampler::Axis::build(int n, double ll, double cellSize,
+                                       int nOut, double llOut,
+                                       double cellSizeOut, eMethod method)
+{
+    double dim = cellSize * n;
+
+    if(method == nearest || method == bilinear)
+    {
+        nearestCell.resize(nOut);
+        for(int k = 0; k < nOut; k++)
+        {
+            double c = (cellSizeOut / 2.0) + (k * cellSizeOut) + llOut;
+            nearestCell[k] = std::min(std::max((int)long(((c - ll) / cellSize)), 0), n - 1);
+        }
+    }
+
+    if(method == bilinear)
+    {
+        edge.resize(nOut);
+        lowCell.resize(nOut);
+        weight.resize(nOut);
+        for(int k = 0; k < nOut; k++)
+        {
+            double c = (cellSizeOut / 2.0) + (k * cellSizeOut) + llOut;
+            edge[k] = c >= (ll + (dim - (cellSize / 2))) || c <= ll + (cellSize / 2);
+            lowCell[k] = 0;
+            weight[k] = 0.0;
+            if(edge[k])
+                continue;
+            int m = std::min((int)long((((c - cellSize / 2) - ll) / cellSize)), n - 2);
+            lowCell[k] = m;
+            weight[k] = (c - ((m * cellSize + (cellSize / 2)) + ll)) /
+                        ((((m + 1) * cellSize + (cellSize / 2)) + ll) -
+                        (((m * cellSize + (cellSize / 2))) + ll));
+        }
+    }
+
+    if(method == areaAverage)
+    {
+        first.resize(nOut);
+        offset.resize(nOut + 1);
+        coverage.clear();
+        for(int k = 0; k < nOut; k++)
+        {
+            //extent of the cell in source cells
+            double a = std::max((llOut + k * cellSizeOut - ll) / cellSize, 0.0);
+            double b = std::min((llOut + (k + 1) * cellSizeOut - ll) / cellSize, (double)n);
+            int m0 = std::min((int)std::floor(a), n - 1);
+            int m1 = std::max((int)std::ceil(b), m0 + 1);
+            first[k] = m0;
+            offset[k] = (int)coverage.size();
+            for(int m = m0; m < m1; m++)
+                coverage.push_back(std::max(std::min(b, m + 1.0) - std::max(a, (double)m), 0.0));
+        }
+        offset[nOut] = (int)coverage.size();
+    }
+}
+
+/**
+ * Resamples src, a grid of the source geometry, into dst, allocated with
+ * the destination geometry.
+ */
+template<class T>
+void GridResampler::resample(const Array2D<T> &src, Array2D<T> &dst) const
+{
+    if(src.get_numCols() != srcCols || src.get_numRows() != srcRows ||
+       dst.get_numCols() != dstCols || dst.get_numRows() != dstRows)
+        throw std::logic_error("Grid size does not match the resampler in GridResampler::resample().");
+
+    switch(method)
+    {
+        case nearest:
+            resampleNearest(src, dst);
+            break;
+        case bilinear:
+            resampleBilinear(src, dst);
+            break;
+        case areaAverage:
+            resampleAreaAverage(src, dst);
+            break;
+    }
+}
+
+template<class T>
+void GridResampler::resampleNearest(const Array2D<T> &src, Array2D<T> &dst) const
+{
+    int i;
+#pragma omp parallel for
+    for(i = 0; i < dstRows; i++)
+    {
+        int r = rows.nearestCell[i];
+        for(int j = 0; j < dstCols; j++)
+            dst(i, j) = src(r, cols.nearestCell[j]);
+    }
+}
+
+template<class T>
+void GridResampler::resampleBilinear(const Array2D<T> &src, Array2D<T> &dst) const
+{
+    T noData = src.getNoDataValue();
+    int i;
+#pragma omp parallel for
+    for(i = 0; i < dstRows; i++)
+    {
+        for(int j = 0; j < dstCols; j++)
+        {
+            //within half a cell of the edge, take the nearest cell
+            if(rows.edge[i] || cols.edge[j])
+            {
+                dst(i, j) = src(rows.nearestCell[i], cols.nearestCell[j]);
+                continue;
+            }
+
+            int r = rows.lowCell[i];
+            int c = cols.lowCell[j];
+            T t = rows.weight[i];
+            T u = cols.weight[j];
+            T val1 = src(r, c);
+            T val2 = src(r + 1, c);
+            T val3 = src(r + 1, c + 1);
+            T val4 = src(r, c + 1);
+
+            if(val1 == noData || val2 == noData || val3 == noData || val4 == noData)
+                dst(i, j) = noData;
+            else
+                dst(i, j) = (1 - t) * (1 - u) * val1
+                          + t * (1 - u) * val2
+                          + t * u * val3
+                          + (1 - t) * u * val4;
+        }
+    }
+}
+
+/**
+ * Sums the rows covered by each resampled row first, then the columns, so
+ * each source cell is read once per resampled row that covers it.
+ */
+template<class T>
+void GridResampler::resampleAreaAverage(const Array2D<T> &src, Array2D<T> &dst) const
+{
+    T noData = src.getNoDataValue();
+    int i;
+#pragma omp parallel
+    {
+        std::vector<double> sum(srcCols);
+        std::vector<double> area(srcCols);
+
+#pragma omp for
+        for(i = 0; i < dstRows; i++)
+        {
+            std::fill(sum.begin(), sum.end(), 0.0);
+            std::fill(area.begin(), area.end(), 0.0);
+            for(int m = rows.offset[i]; m < rows.offset[i + 1]; m++)
+            {
+                int r = rows.first[i] + m - rows.offset[i];
+                double wr = rows.coverage[m];
+                for(int c = 0; c < srcCols; c++)
+                {
+                    T v = src(r, c);
+                    if(v != noData)
+                    {
+                        sum[c] += wr * v;
+                        area[c] += wr;
+                    }
+                }
+            }
+
+            for(int j = 0; j < dstCols; j++)
+            {
+                double s = 0.0;
+                double a = 0.0;
+                for(int m = cols.offset[j]; m < cols.offset[j + 1]; m++)
+                {
+                    int c = cols.first[j] + m - cols.offset[j];
+                    s += cols.coverage[m] * sum[c];
+                    a += cols.coverage[m] * area[c];
+                }
+                dst(i, j) = a > 0.0 ? (T)(s / a) : noData;
+            }
+        }
+    }
+}
+
+#endif /* GRID_RESAMPLER_H */
@@ -78,6 +78,8 @@ void griddedInitialization::initializeFields(WindNinjaInputs &input,
 
 void griddedInitialization::setInitializationGrids(WindNinjaInputs &input)
 {
+    NinjaTraceScope trace(input.inputsRunNumber, "init_grids");
+
     //set initialization grids
     setCloudCover(input);
 
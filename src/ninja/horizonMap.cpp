@@ -0,0 +1,455 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Horizon angles of a DEM for fast terrain shading
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "horizonMap.h"
+#include "constants.h"
+#include "cpl_multiproc.h"
+#include "cpl_string.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/* Bump when the layout of the cache file changes */
+static const int cacheVersion = 2;
+static const char cacheMagic[8] = {'W','N','H','O','R','I','Z','N'};
+//roundoff allowed in the column of a line on the edge of the DEM
+static const double edgeTol = 1e-9;
+//cells next to the side of the DEM the lines drift off that march their own path
+static const int edgeCells = 4;
+
+/* FNV-1a */
+static void HashBytes(GUIntBig &h, const void *p, size_t n)
+{
+    const unsigned char *b = (const unsigned char*)p;
+    for(size_t i=0; i<n; i++)
+    {
+        h ^= b[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+namespace
+{
+//a point of a line in the sun direction: distance from the sun side and height
+struct HullPoint
+{
+    double u;
+    double z;
+};
+
+//> 0 if (u, z) is above the line from o through a
+inline double cross(const HullPoint &o, const HullPoint &a, double u, double z)
+{
+    return (a.u - o.u)*(z - o.z) - (a.z - o.z)*(u - o.u);
+}
+}
+
+//map of the last DEM, shared by the runs of the process
+static boost::shared_ptr<const HorizonMap> poLastMap;
+
+HorizonMap::HorizonMap()
+{
+    nRows = 0;
+    nCols = 0;
+    nSectors = 0;
+    key = 0;
+}
+
+/**
+ * Returns the horizon map of a DEM, computing it (or reading it from
+ * the NINJA_HORIZON_CACHE file) if it is not the one of the last call.
+ * @param elev DEM.
+ * @param nThreads Threads to compute the map with.
+ * @return The map, empty if NINJA_HORIZON_SECTORS is 0 or there was not
+ *         enough memory, then the caller has to march rays.
+ */
+boost::shared_ptr<const HorizonMap> HorizonMap::get(Elevation const* elev, int nThreads)
+{
+    int sectors = atoi(CPLGetConfigOption("NINJA_HORIZON_SECTORS", "64"));
+    if(sectors < 1 || elev == NULL || elev->get_nRows() < 1 || elev->get_nCols() < 1)
+        return boost::shared_ptr<const HorizonMap>();
+
+    GUIntBig newKey = computeKey(elev, sectors);
+    boost::shared_ptr<const HorizonMap> map;
+    //concurrent runs of the same DEM wait for the first one to compute it
+#pragma omp critical(horizonMap)
+    {
+        if(poLastMap && poLastMap->key == newKey)
+            map = poLastMap;
+        else
+        {
+            std::string cacheFile;
+            if(CSLTestBoolean(CPLGetConfigOption("NINJA_HORIZON_CACHE", "NO")) && !elev->fileName.empty())
+                cacheFile = CPLSPrintf("%s.%08x%08x.hzn", elev->fileName.c_str(),
+                                       (unsigned int)(newKey >> 32), (unsigned int)(newKey & 0xffffffff));
+            HorizonMap *newMap = NULL;
+            try
+            {
+                newMap = new HorizonMap;
+                if(cacheFile.empty() || !newMap->readCache(cacheFile) || newMap->key != newKey)
+                {
+                    newMap->compute(elev, sectors, nThreads);
+                    if(!cacheFile.empty() && !newMap->writeCache(cacheFile))
+                        CPLDebug("NINJA", "Could not write the horizon map %s", cacheFile.c_str());
+                }
+                poLastMap.reset(newMap);
+                map = poLastMap;
+            }catch(std::bad_alloc &)
+            {
+                delete newMap;
+                CPLDebug("NINJA", "Not enough memory for the horizon map, marching rays.");
+            }
+        }
+    }
+    return map;
+}
+
+/**
+ * Releases the map kept by get().
+ */
+void HorizonMap::clear()
+{
+#pragma omp critical(horizonMap)
+    poLastMap.reset();
+}
+
+/**
+ * Computes the horizon angles of a DEM.
+ * @param elev DEM.
+ * @param sectors Number of azimuths, evenly spaced from north.
+ * @param nThreads Threads to use, each sweeps one azimuth at a time.
+ * @throws std::bad_alloc if the map or a sweep does not fit in memory.
+ */
+void HorizonMap::compute(Elevation const* elev, int sectors, int nThreads)
+{
+    nRows = elev->get_nRows();
+    nCols = elev->get_nCols();
+    nSectors = sectors;
+    key = computeKey(elev, sectors);
+
+    //heights in cells, so horizontal and vertical distances have the same
+    //units, by rows and by columns so each sweep reads them in order
+    std::vector<double> z((size_t)nRows*nCols);
+    std::vector<double> zT((size_t)nRows*nCols);
+    double cellSize = elev->get_cellSize();
+    for(int i=0; i<nRows; i++)
+        for(int j=0; j<nCols; j++)
+            z[(size_t)i*nCols+j] = zT[(size_t)j*nRows+i] = (*elev)(i,j) / cellSize;
+
+    angles.assign((size_t)nRows*nCols*nSectors, 0);
+
+    int k;
+    bool outOfMemory = false;
+#pragma omp parallel for schedule(dynamic) num_threads(std::max(nThreads, 1))
+    for(k=0; k<nSectors; k++)
+    {
+        try
+        {
+            sweepSector(z, zT, k);
+        }
+        catch(std::bad_alloc &)
+        {
+            //exceptions can't leave the parallel region
+#pragma omp critical(horizonMap_compute)
+            outOfMemory = true;
+        }
+    }
+
+    if(outOfMemory)
+        throw std::bad_alloc();
+}
+
+/**
+ * Horizon angles of one azimuth.
+ *
+ * The DEM is walked one row (or column, whichever is closer to the sun
+ * direction) at a time, starting on the sun side, along the lines
+ * b = c + s*a in the sun direction, where a is the row, b the column and c
+ * an integer.  At each row the height of each line (interpolated between
+ * the columns) is added to the upper hull of the heights already walked on
+ * that line; the vertices it removes are the ones below its tangent, so the
+ * vertex left on top gives its horizon in amortized constant time.  A cell
+ * interpolates the horizons of the two lines around it.
+ */
+void HorizonMap::sweepSector(const std::vector<double> &z,
+                             const std::vector<double> &zT, int sector)
+{
+    double azimuth = sector*2.0*pi/nSectors;
+    double dx = std::sin(azimuth);      //sun direction, columns
+    double dy = std::cos(azimuth);      //sun direction, rows
+
+    bool rowsMajor = std::fabs(dy) >= std::fabs(dx);
+    int nA = rowsMajor ? nRows : nCols;
+    int nB = rowsMajor ? nCols : nRows;
+    double dA = rowsMajor ? dy : dx;
+    int dir = dA > 0 ? 1 : -1;          //rows toward the sun
+    double s = (rowsMajor ? dx : dy) / dA;      //|s| <= 1
+    double step = std::sqrt(1.0 + s*s);         //length of a line from one row to the next
+
+    int cMin = (int)std::floor(std::min(0.0, -s*(nA-1))) - 1;
+    int cMax = (int)std::ceil(std::max(nB-1.0, nB-1.0 - s*(nA-1))) + 1;
+    int nLines = cMax - cMin + 1;
+    std::vector<std::vector<HullPoint> > hulls(nLines);
+    std::vector<double> lineSlopes(nLines);
+
+    unsigned short *out = &angles[(size_t)sector*nRows*nCols];
+    for(int n=0; n<nA; n++)
+    {
+        int a = dir > 0 ? nA-1-n : n;
+        double u = n*step;
+        const double *zA = rowsMajor ? &z[(size_t)a*nB] : &zT[(size_t)a*nB];
+
+        //horizon of the lines where they cross this row (-1 < b < nB), and
+        //add the row to their hulls.  Outside of [0, nB-1] a line is off
+        //the DEM, it gets no point and no horizon (slope 0)
+        int kLo = std::max((int)std::floor(-1.0 - s*a - cMin) + 1, 0);
+        int kHi = std::min((int)std::ceil(nB - s*a - cMin) - 1, nLines-1);
+        if(kLo > 0)
+            lineSlopes[kLo-1] = 0.0;
+        if(kHi < nLines-1)
+            lineSlopes[kHi+1] = 0.0;
+        for(int k=kLo; k<=kHi; k++)
+        {
+            lineSlopes[k] = 0.0;
+            double b = cMin + k + s*a;
+            if(b < -edgeTol || b > nB-1.0 + edgeTol)
+                continue;
+            b = std::min(std::max(b, 0.0), nB-1.0);
+            int b0 = std::min((int)b, std::max(nB-2, 0));
+            double w = b - b0;
+            double zs = zA[b0];
+            if(w > 0.0)
+                zs += w*(zA[b0+1] - zs);
+
+            //the vertex left on top after removing the ones below the line
+            //from their neighbour to this point is the tangent from this point
+            std::vector<HullPoint> &hull = hulls[k];
+            while(hull.size() >= 2 && cross(hull[hull.size()-2], hull.back(), u, zs) >= 0.0)
+                hull.pop_back();
+            if(!hull.empty())
+                lineSlopes[k] = (hull.back().z - zs) / (u - hull.back().u);
+            HullPoint p = {u, zs};
+            hull.push_back(p);
+        }
+
+        //a cell is between two lines.  Where the lines drift off the DEM
+        //their paths soon differ from the cell's, so the last few cells
+        //on that side march their own path (it leaves the DEM within a few
+        //rows).  On the other side only the first cell has a line off the
+        //DEM, it takes the other line
+        bool outLo = s*dir < -edgeTol;
+        bool outHi = s*dir > edgeTol;
+        for(int b=0; b<nB; b++)
+        {
+            double f = b - s*a - cMin;
+            int k = (int)f;
+            double w = f - k;
+            double slope;
+            if((outLo && b < edgeCells) || (outHi && b >= nB-edgeCells))
+                slope = marchCell(z, zT, rowsMajor, a, b, dir, s, step);
+            else if(b == 0 && w > edgeTol)
+                slope = lineSlopes[k+1];
+            else if(b == nB-1 && w < 1.0 - edgeTol)
+                slope = lineSlopes[k];
+            else
+                slope = (1.0 - w)*lineSlopes[k] + w*lineSlopes[k+1];
+            if(slope > 0.0)
+                out[rowsMajor ? (size_t)a*nCols + b : (size_t)b*nCols + a] =
+                    (unsigned short)(std::atan(slope)*18000.0/pi + 0.5);
+        }
+    }
+}
+
+/**
+ * Steepest slope to the DEM from cell (a, b) along the rows sunward of it,
+ * in the row/column order of sweepSector().
+ * @param dir +1 if the sun is toward increasing rows, -1 if not.
+ * @return Tangent of the horizon angle, 0 if it is below.
+ */
+double HorizonMap::marchCell(const std::vector<double> &z,
+                             const std::vector<double> &zT, bool rowsMajor,
+                             int a, int b, int dir, double s, double step) const
+{
+    int nA = rowsMajor ? nRows : nCols;
+    int nB = rowsMajor ? nCols : nRows;
+    const std::vector<double> &zR = rowsMajor ? z : zT;
+    double z0 = zR[(size_t)a*nB + b];
+    double slope = 0.0;
+    for(int m=1; ; m++)
+    {
+        int aa = a + dir*m;
+        double c = b + s*dir*m;
+        if(aa < 0 || aa >= nA || c < -edgeTol || c > nB-1.0 + edgeTol)
+            break;
+        c = std::min(std::max(c, 0.0), nB-1.0);
+        int c0 = std::min((int)c, std::max(nB-2, 0));
+        double w = c - c0;
+        const double *zA = &zR[(size_t)aa*nB];
+        double zs = zA[c0];
+        if(w > 0.0)
+            zs += w*(zA[c0+1] - zs);
+        slope = std::max(slope, (zs - z0) / (m*step));
+    }
+    return slope;
+}
+
+/**
+ * The two azimuths around theta and the weight of the second.
+ */
+void HorizonMap::sectorWeights(double theta, int &k0, int &k1, double &w) const
+{
+    double f = std::fmod(theta, 360.0);
+    if(f < 0.0)
+        f += 360.0;
+    f *= nSectors/360.0;
+    k0 = std::min((int)f, nSectors-1);
+    k1 = (k0 + 1) % nSectors;
+    w = f - k0;
+}
+
+/**
+ * @param i Row.
+ * @param j Column.
+ * @param theta Sun azimuth in degrees from north.
+ * @return Angle of the horizon above the horizontal in degrees, 0 if it is
+ *         below.
+ */
+double HorizonMap::get_horizonAngle(int i, int j, double theta) const
+{
+    int k0, k1;
+    double w;
+    sectorWeights(theta, k0, k1, w);
+    size_t nCells = (size_t)nRows*nCols;
+    size_t cell = (size_t)i*nCols + j;
+    return ((1.0 - w)*angles[k0*nCells + cell] + w*angles[k1*nCells + cell]) / 100.0;
+}
+
+/**
+ * Sets a cell of shade to Shade::shaded (1) if the sun is below its
+ * horizon, otherwise to Shade::unshaded (0).
+ * @param theta Sun azimuth in degrees from north.
+ * @param phi Sun elevation in degrees.
+ * @param shade Grid of the size of the DEM.
+ */
+void HorizonMap::shadeGrid(double theta, double phi, AsciiGrid<short> &shade) const
+{
+    int k0, k1;
+    double w;
+    sectorWeights(theta, k0, k1, w);
+    size_t nCells = (size_t)nRows*nCols;
+    const unsigned short *h0 = &angles[k0*nCells];
+    const unsigned short *h1 = &angles[k1*nCells];
+    float sun = (float)(phi*100.0);
+    float w0 = (float)(1.0 - w), w1 = (float)w;
+
+    int i;
+#pragma omp parallel for
+    for(i=0; i<nRows; i++)
+    {
+        for(int j=0; j<nCols; j++)
+        {
+            size_t cell = (size_t)i*nCols + j;
+            shade(i,j) = sun < w0*h0[cell] + w1*h1[cell] ? 1 : 0;
+        }
+    }
+}
+
+GUIntBig HorizonMap::computeKey(Elevation const* elev, int sectors)
+{
+    GUIntBig h = 14695981039346656037ULL;
+    int sizes[4] = {cacheVersion, elev->get_nRows(), elev->get_nCols(), sectors};
+    double header[3] = {elev->get_xllCorner(), elev->get_yllCorner(), elev->get_cellSize()};
+    HashBytes(h, sizes, sizeof(sizes));
+    HashBytes(h, header, sizeof(header));
+    for(int i=0; i<elev->get_nRows(); i++)
+        for(int j=0; j<elev->get_nCols(); j++)
+            HashBytes(h, &(*elev)(i,j), sizeof(double));
+    return h;
+}
+
+/**
+ * Reads a map written by writeCache().
+ * @return false if the file does not exist or is not valid.
+ */
+bool HorizonMap::readCache(const std::string &fileName)
+{
+    VSILFILE *fp = VSIFOpenL(fileName.c_str(), "rb");
+    if(fp == NULL)
+        return false;
+    char magic[8];
+    GIntBig header[4];
+    GUIntBig fileKey;
+    bool ok = VSIFReadL(magic, 1, 8, fp) == 8 && memcmp(magic, cacheMagic, 8) == 0 &&
+              VSIFReadL(header, sizeof(GIntBig), 4, fp) == 4 && header[0] == cacheVersion &&
+              header[1] > 0 && header[2] > 0 && header[3] > 0 &&
+              header[1]*header[2]*header[3] < ((GIntBig)1 << 40) &&
+              VSIFReadL(&fileKey, sizeof(fileKey), 1, fp) == 1;
+    if(ok)
+    {
+        std::vector<unsigned short> values((size_t)(header[1]*header[2]*header[3]));
+        ok = VSIFReadL(&values[0], sizeof(unsigned short), values.size(), fp) == values.size();
+        if(ok)
+        {
+            nRows = (int)header[1];
+            nCols = (int)header[2];
+            nSectors = (int)header[3];
+            key = fileKey;
+            angles.swap(values);
+        }
+    }
+    VSIFCloseL(fp);
+    return ok;
+}
+
+/**
+ * Writes the map next to the DEM.  Files are written in the byte order of
+ * the machine, the key of a file of another byte order does not match.
+ * @return false if the file could not be written.
+ */
+bool HorizonMap::writeCache(const std::string &fileName) const
+{
+    std::string tmpName = fileName + CPLSPrintf(".%d.tmp", (int)CPLGetPID());
+    VSILFILE *fp = VSIFOpenL(tmpName.c_str(), "wb");
+    if(fp == NULL)
+        return false;
+    GIntBig header[4] = {cacheVersion, nRows, nCols, nSectors};
+    bool ok = VSIFWriteL(cacheMagic, 1, 8, fp) == 8 &&
+              VSIFWriteL(header, sizeof(GIntBig), 4, fp) == 4 &&
+              VSIFWriteL(&key, sizeof(key), 1, fp) == 1 &&
+              (angles.empty() || VSIFWriteL(&angles[0], sizeof(unsigned short), angles.size(), fp) == angles.size());
+    if(VSIFCloseL(fp) != 0)
+        ok = false;
+    if(ok)
+        ok = (VSIRename(tmpName.c_str(), fileName.c_str()) == 0);
+    if(!ok)
+        VSIUnlink(tmpName.c_str());
+    return ok;
+}
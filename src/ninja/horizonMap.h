@@ -0,0 +1,104 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Horizon angles of a DEM for fast terrain shading
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef HORIZON_MAP_H
+#define HORIZON_MAP_H
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "ascii_grid.h"
+#include "Elevation.h"
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Horizon angles of every cell of a DEM for a number of sun azimuths.
+ *
+ * A cell is shaded by the terrain when the sun elevation is below the angle
+ * of the horizon in the direction of the sun, so once the horizon is known
+ * the shade of a whole grid for any sun position is a lookup
+ * (shadeGrid()), instead of marching a ray towards the sun from every cell
+ * as Shade used to do for each time step.
+ *
+ * compute() sweeps the DEM once for each of the nSectors azimuths (0 is
+ * north, clockwise, like Solar::get_theta()).  The cells are visited from
+ * the sun side along parallel lines in the sun direction, each line keeps
+ * the upper convex hull of the terrain behind it, and the horizon of a cell
+ * is the tangent from the cell to that hull.  This is amortized O(1) per
+ * cell and azimuth instead of the length of the ray.  Angles between two azimuths
+ * are interpolated.  Angles are stored in hundredths of a degree, below the
+ * horizontal is stored as 0 (the sun is then above the horizon whenever it
+ * is up).
+ *
+ * get() keeps the map of the last DEM for the process, so the runs and time
+ * steps of an army, the stability computations and the matching iterations
+ * of a point initialization share it.  With NINJA_HORIZON_CACHE the map is
+ * also stored next to the DEM file and read back by later processes.
+ * NINJA_HORIZON_SECTORS sets the number of azimuths (default 64), 0 turns
+ * the map off and Shade marches rays instead.
+ */
+class HorizonMap
+{
+public:
+    HorizonMap();
+
+    static boost::shared_ptr<const HorizonMap> get(Elevation const* elev, int nThreads);
+    static void clear();
+
+    void compute(Elevation const* elev, int sectors, int nThreads);
+    void shadeGrid(double theta, double phi, AsciiGrid<short> &shade) const;
+
+    int get_nSectors() const {return nSectors;}
+    double get_horizonAngle(int i, int j, double theta) const;
+
+    bool readCache(const std::string &fileName);
+    bool writeCache(const std::string &fileName) const;
+
+private:
+    int nRows;
+    int nCols;
+    int nSectors;
+    GUIntBig key;           //hash of the DEM and nSectors
+    std::vector<unsigned short> angles;   //hundredths of a degree, nRows*nCols per sector
+
+    static GUIntBig computeKey(Elevation const* elev, int sectors);
+    void sweepSector(const std::vector<double> &z, const std::vector<double> &zT,
+                     int sector);
+    double marchCell(const std::vector<double> &z, const std::vector<double> &zT,
+                     bool rowsMajor, int a, int b, int dir, double s, double step) const;
+    void sectorWeights(double theta, int &k0, int &k1, double &w) const;
+};
+
+#endif  //HORIZON_MAP_H
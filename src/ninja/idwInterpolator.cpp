@@ -0,0 +1,224 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Inverse distance weighting of point data to a grid
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "idwInterpolator.h"
+#include "cpl_conv.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+//interpolator of the last points and grid
+static boost::shared_ptr<const IdwInterpolator> poLastInterpolator;
+
+/**
+ * Finds the points that can reach each tile and, if they fit in maxCacheMB,
+ * the weights of every cell.
+ * @param nCols Number of columns of the grid.
+ * @param nRows Number of rows of the grid.
+ * @param xll X of the lower left corner of the grid.
+ * @param yll Y of the lower left corner of the grid.
+ * @param cellSize Cell size of the grid.
+ * @param X X of the points.
+ * @param Y Y of the points.
+ * @param influenceRadius Maximum distance of influence of each point,
+ *        negative for no limit.
+ * @param numPoints Number of points.
+ * @param power Power of the distance in the weights (usually 1 or 2).
+ * @param maxCacheMB Memory the weights may take, they are computed for each
+ *        interpolation otherwise.
+ */
+IdwInterpolator::IdwInterpolator(int nCols, int nRows, double xll, double yll,
+                                 double cellSize, const double *X,
+                                 const double *Y,
+                                 const double *influenceRadius,
+                                 int numPoints, double power,
+                                 double maxCacheMB)
+    : nCols(nCols), nRows(nRows), xll(xll), yll(yll), cellSize(cellSize),
+      X(X, X + std::max(numPoints, 0)), Y(Y, Y + std::max(numPoints, 0)),
+      influenceRadius(influenceRadius, influenceRadius + std::max(numPoints, 0)),
+      power(power), cached(false)
+{
+    if(power <= 0)
+        throw std::out_of_range("power in IdwInterpolator::IdwInterpolator() must be greater than 0.");
+    if(numPoints <= 0)
+        throw std::out_of_range("numPoints in IdwInterpolator::IdwInterpolator() must be greater than 0.");
+
+    int nTileRows = (nRows + tileSize - 1) / tileSize;
+    int nTileCols = (nCols + tileSize - 1) / tileSize;
+    tiles.resize((size_t)nTileRows * nTileCols);
+
+    double nPairs = 0.0;
+    for(int ti = 0; ti < nTileRows; ti++)
+    {
+        for(int tj = 0; tj < nTileCols; tj++)
+        {
+            Tile &tile = tiles[(size_t)ti * nTileCols + tj];
+            tile.i0 = ti * tileSize;
+            tile.i1 = std::min(tile.i0 + tileSize, nRows);
+            tile.j0 = tj * tileSize;
+            tile.j1 = std::min(tile.j0 + tileSize, nCols);
+
+            //cell centers of the tile
+            double x0 = (cellSize / 2.0) + (tile.j0 * cellSize) + xll;
+            double x1 = (cellSize / 2.0) + ((tile.j1 - 1) * cellSize) + xll;
+            double y0 = (cellSize / 2.0) + (tile.i0 * cellSize) + yll;
+            double y1 = (cellSize / 2.0) + ((tile.i1 - 1) * cellSize) + yll;
+
+            for(int k = 0; k < numPoints; k++)
+            {
+                if(influenceRadius[k] >= 0.0)
+                {
+                    double dx = std::max(0.0, std::max(x0 - X[k], X[k] - x1));
+                    double dy = std::max(0.0, std::max(y0 - Y[k], Y[k] - y1));
+                    //a little slack, the cells test the exact distance
+                    if(std::sqrt(dx*dx + dy*dy) > influenceRadius[k] * (1.0 + 1e-9) + 1e-9)
+                        continue;
+                }
+                tile.points.push_back(k);
+            }
+            nPairs += (double)(tile.i1 - tile.i0) * (tile.j1 - tile.j0) * tile.points.size();
+        }
+    }
+
+    if(nPairs * (sizeof(int) + sizeof(double)) > maxCacheMB * 1024.0 * 1024.0)
+        return;
+
+    int nTiles = (int)tiles.size();
+    int t;
+    bool outOfMemory = false;
+#pragma omp parallel for schedule(dynamic)
+    for(t = 0; t < nTiles; t++)
+    {
+        Tile &tile = tiles[t];
+        try
+        {
+            tile.cellStart.reserve((size_t)(tile.i1 - tile.i0) * (tile.j1 - tile.j0) + 1);
+            for(int i = tile.i0; i < tile.i1; i++)
+            {
+                double yC = (cellSize / 2.0) + (i * cellSize) + yll;
+                for(int j = tile.j0; j < tile.j1; j++)
+                {
+                    double xC = (cellSize / 2.0) + (j * cellSize) + xll;
+                    double weight;
+                    tile.cellStart.push_back((int)tile.cellPoints.size());
+                    for(size_t m = 0; m < tile.points.size(); m++)
+                    {
+                        int k = tile.points[m];
+                        if(!cellWeight(k, xC, yC, weight))
+                            continue;
+                        tile.cellPoints.push_back(k);
+                        tile.cellWeights.push_back(weight);
+                    }
+                }
+            }
+            tile.cellStart.push_back((int)tile.cellPoints.size());
+        }
+        catch(std::bad_alloc &)
+        {
+            //exceptions can't leave the parallel region
+#pragma omp critical(idwInterpolator_build)
+            outOfMemory = true;
+        }
+    }
+
+    if(outOfMemory)
+    {
+        //compute the weights for each interpolation instead
+        for(size_t i = 0; i < tiles.size(); i++)
+        {
+            std::vector<int>().swap(tiles[i].cellStart);
+            std::vector<int>().swap(tiles[i].cellPoints);
+            std::vector<double>().swap(tiles[i].cellWeights);
+        }
+        return;
+    }
+    cached = true;
+}
+
+/**
+ * Interpolator of these points to this grid, shared with the last caller
+ * that asked for the same ones.
+ *
+ * The weights are kept if they fit in NINJA_IDW_CACHE_MB (default 256).
+ */
+boost::shared_ptr<const IdwInterpolator>
+IdwInterpolator::get(int nCols, int nRows, double xll, double yll,
+                     double cellSize, const double *X, const double *Y,
+                     const double *influenceRadius, int numPoints,
+                     double power)
+{
+    boost::shared_ptr<const IdwInterpolator> poInterpolator;
+#pragma omp critical(idwInterpolator)
+    {
+        if(poLastInterpolator &&
+           poLastInterpolator->matches(nCols, nRows, xll, yll, cellSize, X, Y,
+                                       influenceRadius, numPoints, power))
+            poInterpolator = poLastInterpolator;
+    }
+    if(poInterpolator)
+        return poInterpolator;
+
+    double maxCacheMB = atof(CPLGetConfigOption("NINJA_IDW_CACHE_MB", "256"));
+    poInterpolator.reset(new IdwInterpolator(nCols, nRows, xll, yll, cellSize,
+                                             X, Y, influenceRadius, numPoints,
+                                             power, maxCacheMB));
+
+#pragma omp critical(idwInterpolator)
+    {
+        poLastInterpolator = poInterpolator;
+    }
+    return poInterpolator;
+}
+
+/**
+ * Frees the interpolator kept by get().
+ */
+void IdwInterpolator::clear()
+{
+#pragma omp critical(idwInterpolator)
+    {
+        poLastInterpolator.reset();
+    }
+}
+
+bool IdwInterpolator::matches(int nCols, int nRows, double xll, double yll,
+                              double cellSize, const double *X,
+                              const double *Y, const double *influenceRadius,
+                              int numPoints, double power) const
+{
+    if(nCols != this->nCols || nRows != this->nRows || xll != this->xll ||
+       yll != this->yll || cellSize != this->cellSize ||
+       power != this->power || numPoints != (int)this->X.size())
+        return false;
+
+    return std::equal(X, X + numPoints, this->X.begin()) &&
+           std::equal(Y, Y + numPoints, this->Y.begin()) &&
+           std::equal(influenceRadius, influenceRadius + numPoints,
+                      this->influenceRadius.begin());
+}
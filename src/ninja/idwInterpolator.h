@@ -0,0 +1,198 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Inverse distance weighting of point data to a grid
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef IDW_INTERPOLATOR_H
+#define IDW_INTERPOLATOR_H
+
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include <boost/shared_ptr.hpp>
+#include "Array2D.h"
+
+/**
+ * Inverse distance weighting of point data (weather stations) to the cell
+ * centers of a grid, as AsciiGrid::interpolateFromPoints() does: each cell
+ * is the average of the points within their influence radius (all of them
+ * for a negative radius), weighted by 1/distance^power.
+ *
+ * The grid is split in tiles of tileSize x tileSize cells and each tile
+ * keeps the points whose influence reaches it, so a cell only visits the
+ * points that can weigh on it.  The weights only depend on the positions of
+ * the points, so they are computed once and kept (within
+ * NINJA_IDW_CACHE_MB), and interpolate() weighs several variables in one
+ * pass over the grid.  get() keeps the interpolator of the last points and
+ * grid for the process, so the variables, time steps and matching
+ * iterations of a point initialization share the weights.
+ *
+ * The weights are summed in the order of the points, so the results are the
+ * same as the direct loop.
+ */
+class IdwInterpolator
+{
+public:
+    IdwInterpolator(int nCols, int nRows, double xll, double yll,
+                    double cellSize, const double *X, const double *Y,
+                    const double *influenceRadius, int numPoints,
+                    double power, double maxCacheMB);
+
+    static boost::shared_ptr<const IdwInterpolator> get(int nCols, int nRows,
+                    double xll, double yll, double cellSize, const double *X,
+                    const double *Y, const double *influenceRadius,
+                    int numPoints, double power);
+    static void clear();
+
+    template<class T>
+    void interpolate(int numVariables, const T* const* pointData,
+                     Array2D<T>* const* grids) const;
+
+    inline bool has_cachedWeights() const {return cached;}
+
+    static const int tileSize = 32;
+
+private:
+    bool matches(int nCols, int nRows, double xll, double yll,
+                 double cellSize, const double *X, const double *Y,
+                 const double *influenceRadius, int numPoints,
+                 double power) const;
+
+    /**
+     * Weight of point k at (xC, yC), false if it is beyond its influence
+     * radius.  Powers 1 and 2 do without std::pow().
+     */
+    inline bool cellWeight(int k, double xC, double yC, double &w) const
+    {
+        double distance = std::sqrt((xC-X[k])*(xC-X[k]) + (yC-Y[k])*(yC-Y[k]));
+        if(influenceRadius[k] >= 0.0 && distance > influenceRadius[k])
+            return false;
+        if(power == 1.0)
+            w = 1.0/distance;
+        else if(power == 2.0)
+            w = 1.0/(distance*distance);
+        else
+            w = 1.0/std::pow(distance, power);
+        return true;
+    }
+
+    struct Tile
+    {
+        int i0, i1, j0, j1;             //rows i0 to i1-1, columns j0 to j1-1
+        std::vector<int> points;        //points that can reach the tile
+        std::vector<int> cellStart;     //of each cell in cellPoints, cell by cell
+        std::vector<int> cellPoints;
+        std::vector<double> cellWeights;
+    };
+
+    int nCols, nRows;
+    double xll, yll, cellSize;
+    std::vector<double> X, Y, influenceRadius;
+    double power;
+
+    std::vector<Tile> tiles;
+    bool cached;
+};
+
+/**
+ * Interpolates numVariables sets of point values to their grids, which
+ * must have the size of the grid of the interpolator.  Cells no point
+ * reaches are set to the no data value of their grid.
+ * @param numVariables Number of variables.
+ * @param pointData Values of each variable at the points.
+ * @param grids Grid of each variable.
+ */
+template<class T>
+void IdwInterpolator::interpolate(int numVariables, const T* const* pointData,
+                                  Array2D<T>* const* grids) const
+{
+    for(int v = 0; v < numVariables; v++)
+    {
+        if(grids[v]->get_numCols() != nCols || grids[v]->get_numRows() != nRows)
+            throw std::logic_error("Grid size does not match the interpolator in IdwInterpolator::interpolate().");
+    }
+
+    int nTiles = (int)tiles.size();
+    int t;
+#pragma omp parallel
+    {
+        std::vector<T> value(numVariables);
+
+#pragma omp for schedule(dynamic)
+        for(t = 0; t < nTiles; t++)
+        {
+            const Tile &tile = tiles[t];
+            int c = 0;
+            for(int i = tile.i0; i < tile.i1; i++)
+            {
+                double yC = (cellSize / 2.0) + (i * cellSize) + yll;
+                for(int j = tile.j0; j < tile.j1; j++, c++)
+                {
+                    double xC = (cellSize / 2.0) + (j * cellSize) + xll;
+                    double weight, weight_sum = 0.0;
+                    for(int v = 0; v < numVariables; v++)
+                        value[v] = 0.0;
+
+                    if(cached)
+                    {
+                        for(int m = tile.cellStart[c]; m < tile.cellStart[c+1]; m++)
+                        {
+                            int k = tile.cellPoints[m];
+                            weight = tile.cellWeights[m];
+                            weight_sum = weight_sum + weight;
+                            for(int v = 0; v < numVariables; v++)
+                                value[v] = value[v] + pointData[v][k] * weight;
+                        }
+                    }
+                    else
+                    {
+                        for(size_t m = 0; m < tile.points.size(); m++)
+                        {
+                            int k = tile.points[m];
+                            if(!cellWeight(k, xC, yC, weight))
+                                continue;
+                            weight_sum = weight_sum + weight;
+                            for(int v = 0; v < numVariables; v++)
+                                value[v] = value[v] + pointData[v][k] * weight;
+                        }
+                    }
+
+                    for(int v = 0; v < numVariables; v++)
+                    {
+                        //no point reaches the cell, leave it as no data
+                        if(weight_sum != 0)
+                            (*grids[v])(i, j) = value[v]/weight_sum;
+                        else
+                            (*grids[v])(i, j) = grids[v]->getNoDataValue();
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif /* IDW_INTERPOLATOR_H */
@@ -80,6 +80,8 @@ void initialize::initializeWindFromProfile(WindNinjaInputs &input,
                                 wn_3dScalarField& v0,
                                 wn_3dScalarField& w0)
 {
+    NinjaTraceScope trace(input.inputsRunNumber, "init_profile");
+
     int i, j, k;
 //#pragma omp parallel for default(shared) firstprivate(profile) private(i,j,k)
     for(i=0;i<input.dem.get_nRows();i++)
@@ -113,6 +115,8 @@ void initialize::initializeWindFromProfile(WindNinjaInputs &input,
 
 void initialize::initializeBoundaryLayer(WindNinjaInputs& input)
 {
+    NinjaTraceScope trace(input.inputsRunNumber, "init_boundary_layer");
+
     //Set windspeed grid for diurnal computation
     input.surface.set_windspeed(speedInitializationGrid);
 
@@ -176,38 +180,10 @@ void initialize::addDiurnal(WindNinjaInputs& input, Aspect const* asp, Slope con
                              input.downEntrainmentCoeff, input.upDragCoeff,
                              input.upEntrainmentCoeff);
 
-	double u_, v_, w_, height_, L_, U_star_, BL_height_, Xord, Yord, WindSpeed;
-	int i,j;
-
 	// DO THE WORK
-//	#pragma omp parallel for default(none) private(i,j,u_,v_,w_,height_,L_,U_star_,BL_height_, Xord, Yord, WindSpeed, Z) firstprivate(cDiurnal) shared(input.dem,uDiurnal,vDiurnal,wDiurnal,height,L,u_star,bl_height, airTempGrid, asp, cloudCoverGrid, slp, input.surface)
-    for(i = 0; i < input.dem.get_nRows(); i++)
-    {
-        for(j = 0; j < input.dem.get_nCols(); j++)
-        {
-            WindSpeed = speedInitializationGrid(i,j);
-
-            input.dem.get_cellPosition(i, j, &Xord, &Yord);
-
-            cDiurnal.initialize(Xord, Yord, (*asp)(i,j),(*slp)(i,j),
-                    cloudCoverGrid(i,j), airTempGrid(i,j), WindSpeed, input.surface.Z,
-                    input.surface.Albedo(i,j), input.surface.Bowen(i,j),
-                    input.surface.Cg(i,j), input.surface.Anthropogenic(i,j),
-                    input.surface.Roughness(i,j), input.surface.Rough_h(i,j),
-                    input.surface.Rough_d(i,j));
-
-            cDiurnal.compute_cell_diurnal_wind(i, j, &u_, &v_, &w_,
-                    &height_, &L_, &U_star_, &BL_height_);
-
-            uDiurnal.set_cellValue(i, j, u_);
-            vDiurnal.set_cellValue(i, j, v_);
-            wDiurnal.set_cellValue(i, j, w_);
-            height.set_cellValue(i, j, height_);
-            L.set_cellValue(i, j, L_);
-            u_star.set_cellValue(i, j, U_star_);
-            bl_height.set_cellValue(i, j, BL_height_);
-        }
-    }
+    cDiurnal.compute_diurnal_wind_grids(*asp, *slp, cloudCoverGrid, airTempGrid,
+            speedInitializationGrid, input.surface, uDiurnal, vDiurnal, wDiurnal,
+            height, L, u_star, bl_height);
 }
 
 void initialize::addDiurnalComponent(WindNinjaInputs &input,
@@ -216,6 +192,8 @@ void initialize::addDiurnalComponent(WindNinjaInputs &input,
                                     wn_3dScalarField& v0,
                                     wn_3dScalarField& w0)
 {
+    NinjaTraceScope trace(input.inputsRunNumber, "init_diurnal");
+
     int i, j, k;
     double AGL=0; //height above top of roughness elements
 #pragma omp parallel for default(shared) private(i,j,k,AGL)
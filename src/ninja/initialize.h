@@ -40,6 +40,7 @@
 #include <vector>
 #include "cellDiurnal.h"
 #include "SurfProperties.h"
+#include "ninjaTrace.h"
 
 namespace blt = boost::local_time;
 
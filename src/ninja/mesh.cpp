@@ -256,8 +256,8 @@ void Mesh::buildStandardMesh(WindNinjaInputs& input)
         input.surface.resample_in_place(meshResolution, AsciiGrid<double>::order1); //make the grid finer
     }else if(meshResolution > input.dem.get_cellSize())
     {
-        input.dem.resample_Grid_in_place(meshResolution, Elevation::order0); //coarsen the grid
-        input.surface.resample_in_place(meshResolution, AsciiGrid<double>::order0); //coarsen the grids
+        input.dem.resample_Grid_in_place(meshResolution, Elevation::areaAverage); //coarsen the grid
+        input.surface.resample_in_place(meshResolution, AsciiGrid<double>::areaAverage); //coarsen the grids
      
         input.dem.BufferGridInPlace(); //make sure grid at least covers the original domain
         input.surface.BufferGridInPlace();
@@ -591,135 +591,9 @@ double Mesh::maxj(double value1, double value2)
     return ( (value1 > value2) ? value1 : value2);
 }
 
-int Mesh::get_node0(const int &elemNum) const
-{
-    //Calculates the global node number of element elemNum's local node number 0
-    int node, row, col, layer, layer_elements;
-    layer_elements=(nrows-1)*(ncols-1);
-    layer=elemNum/(layer_elements);
-    row=(elemNum-layer*layer_elements)/(ncols-1);
-    col=elemNum-layer*layer_elements-row*(ncols-1);
-    node=layer*(ncols*nrows)+row*ncols+col;
-
-    return node;
-}
-
-int Mesh::get_node0(const int &elem_i, const int &elem_j, const int &elem_k) const
-{
-    //Calculates the global node number of element (i,j,k)'s local node number 0
-    return elem_k*(ncols*nrows)+elem_i*ncols+elem_j;
-}
-
-int Mesh::get_elemNum(const int &elem_i, const int &elem_j, const int &elem_k) const
-{
-    //Calculates the global element number given the element's (i,j,k) index
-    return elem_k*(ncolsElem*nrowsElem)+elem_i*ncolsElem+elem_j;
-}
-
-void Mesh::get_elemIndex(const int &elemNum, int &elem_i, int &elem_j, int &elem_k) const
-{
-    //Calculates the element's (i,j,k) index given the global element number elemNum
-    int layer_elements;
-    layer_elements=nrowsElem*ncolsElem;
-    elem_k=elemNum/layer_elements;
-    elem_i=(elemNum-elem_k*layer_elements)/ncolsElem;
-    elem_j=elemNum-elem_k*layer_elements-elem_i*ncolsElem;
-}
-
-int Mesh::get_global_node(const int &locNodeNum, const int &elemNum) const
-{
-    //Function calculates the global node number of local node "locNodeNum" in the element "elemNum"
-    //with local node 0 equal to global node "node0".
-
-    //NOTE that local node numbering goes counter clockwise and from bottom to top starting at
-    //the lower left cell corner as shown below
-    //
-    //      7----6
-    //      |    |    at the upper level (higher z)
-    //      |    |
-    //      4----5
-    //
-    //
-    //
-    //      3----2
-    //      |    |    at the lower level (lower z)
-    //      |    |
-    //      0----1
-
-
-    int node0 = get_node0(elemNum);
-
-    int node;
-
-    if(locNodeNum==0)
-        node=node0;
-    else if(locNodeNum==1)
-        node=node0+1;
-    else if(locNodeNum==2)
-        node=node0+ncols+1;
-    else if(locNodeNum==3)
-        node=node0+ncols;
-    else if(locNodeNum==4)
-        node=node0+(ncols*nrows);
-    else if(locNodeNum==5)
-        node=node0+(ncols*nrows)+1;
-    else if(locNodeNum==6)
-        node=node0+(ncols*nrows)+ncols+1;
-    else if(locNodeNum==7)
-        node=node0+(ncols*nrows)+ncols;
-    else
-        throw std::logic_error("Error in function \"get_global_node()\"");
-
-    return node;
-}
-
-int Mesh::get_global_node(const int &locNodeNum, const int &cell_i,
-                          const int &cell_j, const int &cell_k) const
-{
-    //Function calculates the global node number of local node "locNodeNum" in the element "elemNum"
-    //with local node 0 equal to global node "node0".
-
-    //NOTE that local node numbering goes counter clockwise and from bottom to top starting at
-    //the lower left cell corner as shown below
-    //
-    //      7----6
-    //      |    |    at the upper level (higher z)
-    //      |    |
-    //      4----5
-    //
-    //
-    //
-    //      3----2
-    //      |    |    at the lower level (lower z)
-    //      |    |
-    //      0----1
-
-    int node0 = get_node0(cell_i, cell_j, cell_k);
-
-    int node;
-
-    if(locNodeNum==0)
-        node=node0;
-    else if(locNodeNum==1)
-        node=node0+1;
-    else if(locNodeNum==2)
-        node=node0+ncols+1;
-    else if(locNodeNum==3)
-        node=node0+ncols;
-    else if(locNodeNum==4)
-        node=node0+(ncols*nrows);
-    else if(locNodeNum==5)
-        node=node0+(ncols*nrows)+1;
-    else if(locNodeNum==6)
-        node=node0+(ncols*nrows)+ncols+1;
-    else if(locNodeNum==7)
-        node=node0+(ncols*nrows)+ncols;
-    else
-        throw std::logic_error("Error in function \"get_global_node()\"");
-
-    return node;
-}
-
+const int Mesh::localNodeI[8] = {0, 0, 1, 1, 0, 0, 1, 1};
+const int Mesh::localNodeJ[8] = {0, 1, 1, 0, 0, 1, 1, 0};
+const int Mesh::localNodeK[8] = {0, 0, 0, 0, 1, 1, 1, 1};
 
 int Mesh::get_node_type(const int &i, const int &j, const int &k) const
 {
@@ -821,9 +695,12 @@ void Mesh::compute_domain_height(WindNinjaInputs& input)
 {
     double first_cell_ht=meshResolution/maxAspectRatio;
     domainHeight=(first_cell_ht*(std::pow(vertGrowth,double(numVertLayers))-1)/(vertGrowth-1));
-    if(domainHeight < 3*(input.outputWindHeight + input.surface.Rough_h.get_maxValue()))
+    double outputHeight = input.outputWindHeight;
+    for(unsigned int h=0;h<input.extraOutputWindHeights.size();h++)
+        outputHeight = std::max(outputHeight, input.extraOutputWindHeights[h]);
+    if(domainHeight < 3*(outputHeight + input.surface.Rough_h.get_maxValue()))
     {
-        domainHeight = 3*(input.outputWindHeight + input.surface.Rough_h.get_maxValue());
+        domainHeight = 3*(outputHeight + input.surface.Rough_h.get_maxValue());
     }
     domainHeight=domainHeight + input.dem.get_maxValue();
 }
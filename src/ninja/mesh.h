@@ -77,12 +77,24 @@ public:
 	double maxAspectRatio;
 	long coarseTargetCells, mediumTargetCells, fineTargetCells;
 
-	int get_node0(const int &elemNum) const;
-	int get_node0(const int &elem_i, const int &elem_j, const int &elem_k) const;
-	int get_elemNum(const int &elem_i, const int &elem_j, const int &elem_k) const;
-	void get_elemIndex(const int &elemNum, int &elem_i, int &elem_j, int &elem_k) const;
-	int get_global_node(const int &locNodeNum, const int &elemNum) const;
-	int get_global_node(const int &locNodeNum, const int &cell_i, const int &cell_j, const int &cell_k) const;
+	//Local node n of element (i,j,k) is node (i+localNodeI[n], j+localNodeJ[n], k+localNodeK[n]).
+	//The numbering goes counter clockwise from the lower left corner, bottom layer first:
+	//
+	//      7----6                3----2
+	//      |    |  upper level   |    |  lower level
+	//      4----5                0----1
+	static const int localNodeI[8];
+	static const int localNodeJ[8];
+	static const int localNodeK[8];
+
+	//Index maths of the structured mesh, inline since the element loops call them for every node
+	inline int get_node0(const int &elemNum) const;
+	inline int get_node0(const int &elem_i, const int &elem_j, const int &elem_k) const;
+	inline int get_elemNum(const int &elem_i, const int &elem_j, const int &elem_k) const;
+	inline void get_elemIndex(const int &elemNum, int &elem_i, int &elem_j, int &elem_k) const;
+	inline int get_global_node(const int &locNodeNum, const int &elemNum) const;
+	inline int get_global_node(const int &locNodeNum, const int &cell_i, const int &cell_j, const int &cell_k) const;
+	inline void get_nodeStrides(int *strides) const;    //global node of local node n is node0+strides[n]
 	int get_node_type(const int &i, const int &j, const int &k) const;
     double get_minX() const {return XORD(0, 0, 0);}
     double get_minY() const {return YORD(0, 0, 0);}
@@ -118,4 +130,56 @@ private:
 	double maxj(double value1, double value2);
 };
 
+inline int Mesh::get_node0(const int &elem_i, const int &elem_j, const int &elem_k) const
+{
+    //Calculates the global node number of element (i,j,k)'s local node number 0
+    return elem_k*(ncols*nrows)+elem_i*ncols+elem_j;
+}
+
+inline int Mesh::get_node0(const int &elemNum) const
+{
+    //Calculates the global node number of element elemNum's local node number 0
+    int elem_i, elem_j, elem_k;
+    get_elemIndex(elemNum, elem_i, elem_j, elem_k);
+    return get_node0(elem_i, elem_j, elem_k);
+}
+
+inline int Mesh::get_elemNum(const int &elem_i, const int &elem_j, const int &elem_k) const
+{
+    //Calculates the global element number given the element's (i,j,k) index
+    return elem_k*(ncolsElem*nrowsElem)+elem_i*ncolsElem+elem_j;
+}
+
+inline void Mesh::get_elemIndex(const int &elemNum, int &elem_i, int &elem_j, int &elem_k) const
+{
+    //Calculates the element's (i,j,k) index given the global element number elemNum
+    int layer_elements=nrowsElem*ncolsElem;
+    elem_k=elemNum/layer_elements;
+    elem_i=(elemNum-elem_k*layer_elements)/ncolsElem;
+    elem_j=elemNum-elem_k*layer_elements-elem_i*ncolsElem;
+}
+
+inline void Mesh::get_nodeStrides(int *strides) const
+{
+    for(int n=0;n<8;n++)
+        strides[n]=localNodeK[n]*(ncols*nrows)+localNodeI[n]*ncols+localNodeJ[n];
+}
+
+inline int Mesh::get_global_node(const int &locNodeNum, const int &elemNum) const
+{
+    //Global node number of local node "locNodeNum" of element "elemNum"
+    if(locNodeNum < 0 || locNodeNum > 7)
+        throw std::logic_error("Error in function \"get_global_node()\"");
+    return get_node0(elemNum)+localNodeK[locNodeNum]*(ncols*nrows)+localNodeI[locNodeNum]*ncols+localNodeJ[locNodeNum];
+}
+
+inline int Mesh::get_global_node(const int &locNodeNum, const int &cell_i,
+                                 const int &cell_j, const int &cell_k) const
+{
+    //Global node number of local node "locNodeNum" of the element (cell_i,cell_j,cell_k)
+    if(locNodeNum < 0 || locNodeNum > 7)
+        throw std::logic_error("Error in function \"get_global_node()\"");
+    return get_node0(cell_i, cell_j, cell_k)+localNodeK[locNodeNum]*(ncols*nrows)+localNodeI[locNodeNum]*ncols+localNodeJ[locNodeNum];
+}
+
 #endif /* MESH_H */
@@ -454,7 +454,7 @@ void ncepGfsSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
         GDALClose((GDALDatasetH) poDS );
 
     // open ds one by one and warp, then write to grid
-    GDALDataset *srcDS, *wrpDS;
+    double dfNoData;
     std::string temp;
     std::string srcWkt;
 
@@ -462,21 +462,10 @@ void ncepGfsSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
 
     int tempBandNum, vBandNum, uBandNum;
 
-    /*
-     * Set the initial values in the warped dataset to no data
-     */
-    GDALWarpOptions* psWarpOptions;
-
     for( unsigned int i = 0;i < varList.size();i++ ) {
 
         temp = "NETCDF:" + input.forecastFilename + ":" + varList[i];
 
-        srcDS = (GDALDataset*)GDALOpenShared( temp.c_str(), GA_ReadOnly );
-        if( srcDS == NULL ) {
-            CPLDebug( "ncepGfsSurfInitialization::setSurfaceGrids()",
-                    "Bad forecast file" );
-        }
-
         /*
          * The GFS projection does not come with the file, it is hard coded
          * here.  This is totally hacked in, I had trouble finding the SRS
@@ -487,58 +476,9 @@ void ncepGfsSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
          */
         srcWkt = "GEOGCS[\"Custom-defined CS\", DATUM[\"unknown\", SPHEROID[\"Sphere\",6371229,0]], PRIMEM[\"Greenwich\",0], UNIT[\"degree\",0.0174532925199433]]";
 
-        /*
-         * Grab the first band to get the nodata value for the variable,
-         * assume all bands have the same ndv
-         */
-
-        GDALRasterBand *poBand = srcDS->GetRasterBand( 1 );
-        int pbSuccess;
-        double dfNoData = poBand->GetNoDataValue( &pbSuccess );
-        psWarpOptions = GDALCreateWarpOptions();
-
-        int nBandCount = srcDS->GetRasterCount();
-        psWarpOptions->nBandCount = nBandCount;
-        psWarpOptions->panSrcBands = 
-            (int*) CPLMalloc( sizeof( int ) * nBandCount );
-        psWarpOptions->panDstBands = 
-            (int*) CPLMalloc( sizeof( int ) * nBandCount );
-        psWarpOptions->padfDstNoDataReal =
-            (double*) CPLMalloc( sizeof( double ) * nBandCount );
-        psWarpOptions->padfDstNoDataImag =
-            (double*) CPLMalloc( sizeof( double ) * nBandCount );
-
-
-        psWarpOptions->padfDstNoDataReal =
-            (double*) CPLMalloc( sizeof( double ) * nBandCount );
-        psWarpOptions->padfDstNoDataImag =
-            (double*) CPLMalloc( sizeof( double ) * nBandCount );
-
-        for( int b = 0;b < srcDS->GetRasterCount();b++ ) {
-            psWarpOptions->padfDstNoDataReal[b] = dfNoData;
-            psWarpOptions->padfDstNoDataImag[b] = dfNoData;
-            psWarpOptions->panSrcBands[b] = b + 1;
-            psWarpOptions->panDstBands[b] = b + 1;
-        }
-
-        if( pbSuccess == false )
-            dfNoData = -9999.0;
-
-        psWarpOptions->papszWarpOptions =
-        CSLSetNameValue( psWarpOptions->papszWarpOptions,
-                 "INIT_DEST", "NO_DATA" );
-
-        wrpDS = (GDALDataset*) GDALAutoCreateWarpedVRT( srcDS, srcWkt.c_str(), dstWkt.c_str(),
-                GRA_NearestNeighbour, 1.0, psWarpOptions );
-        if(wrpDS == NULL)
-        {
-            throw badForecastFile("Could not warp the forecast file, "
-                                  "possibly non-uniform grid.");
-        }
-
         if( varList[i] == "Temperature_height_above_ground" ) {
             tempBandNum = (bandNum * 3) - 2;  // adjust for height dimension (3)
-            GDAL2AsciiGrid( wrpDS, tempBandNum, airGrid );
+            dfNoData = readWarpedBand( temp, srcWkt, dstWkt, tempBandNum, airGrid );
             if( CPLIsNan( dfNoData ) ) {
                 airGrid.set_noDataValue(-9999.0);
                 airGrid.replaceNan( -9999.0 );
@@ -546,7 +486,7 @@ void ncepGfsSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
         }
         else if( varList[i] == "v-component_of_wind_height_above_ground" ) {
             vBandNum = (bandNum * 3) - 2;  // adjust for height dimension (3)
-            GDAL2AsciiGrid( wrpDS, vBandNum, vGrid );
+            dfNoData = readWarpedBand( temp, srcWkt, dstWkt, vBandNum, vGrid );
             if( CPLIsNan( dfNoData ) ) {
                 vGrid.set_noDataValue(-9999.0);
                 vGrid.replaceNan( -9999.0 );
@@ -554,7 +494,7 @@ void ncepGfsSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
         }
         else if( varList[i] == "u-component_of_wind_height_above_ground" ) {
             uBandNum = (bandNum * 3) - 2;  //adjust for height dimension (3)
-            GDAL2AsciiGrid( wrpDS, uBandNum, uGrid );
+            dfNoData = readWarpedBand( temp, srcWkt, dstWkt, uBandNum, uGrid );
             if( CPLIsNan( dfNoData ) ) {
                 uGrid.set_noDataValue(-9999.0);
                 uGrid.replaceNan( -9999.0 );
@@ -565,16 +505,12 @@ void ncepGfsSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
             }
         }
         else if( varList[i] == "Total_cloud_cover_convective_cloud" ) {
-            GDAL2AsciiGrid( wrpDS, bandNum, cloudGrid );
+            dfNoData = readWarpedBand( temp, srcWkt, dstWkt, bandNum, cloudGrid );
             if( CPLIsNan( dfNoData ) ) {
                 cloudGrid.set_noDataValue(-9999.0);
                 cloudGrid.replaceNan( -9999.0 );
             }
         }
-
-        GDALDestroyWarpOptions( psWarpOptions );
-        GDALClose((GDALDatasetH) srcDS );
-        GDALClose((GDALDatasetH) wrpDS );
     }
     cloudGrid /= 100.0;
 
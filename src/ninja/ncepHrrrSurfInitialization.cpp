@@ -237,83 +237,54 @@ void ncepHrrrSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
     std::vector<boost::local_time::local_date_time> timeList( getTimeList( input.ninjaTimeZone ) );
 
     //Search time list for our time to identify our band number for cloud/speed/dir
-    //Right now, just one time step per file
+    //Right now, just one time step per file.  One pass over the band
+    //metadata finds the first band of each variable.
     std::vector<int> bandList;
     for(unsigned int i = 0; i < timeList.size(); i++)
     {
         if(input.ninjaTime == timeList[i])
         {
-            for(unsigned int j = 1; j < srcDS->GetRasterCount(); j++)
-            { 
+            const char *apszComments[] = { "Temperature [K]",               // 2t
+                                           "v-component of wind [m/s]",     // 10v
+                                           "u-component of wind [m/s]",     // 10u
+                                           "Total cloud cover [%]" };       // Total cloud cover in %
+            const char *apszLevels[] = { "2-HTGL", "10-HTGL", "10-HTGL", "0-RESERVED" };
+            int anBands[4] = { -1, -1, -1, -1 };
+            int nFound = 0;
+            for(unsigned int j = 1; j < srcDS->GetRasterCount() && nFound < 4; j++)
+            {
                 poBand = srcDS->GetRasterBand( j );
                 gc = poBand->GetMetadataItem( "GRIB_COMMENT" );
                 std::string bandName( gc );
-
-                if( bandName.find( "Temperature [K]" ) != bandName.npos ){
-                    gc = poBand->GetMetadataItem( "GRIB_SHORT_NAME" );
-                    std::string bandName( gc );
-                    if( bandName.find( "2-HTGL" ) != bandName.npos ){
-                        bandList.push_back( j );  // 2t 
-                        break;
-                    }
-                }
-            }
-            for(unsigned int j = 1; j < srcDS->GetRasterCount(); j++)
-            { 
-                poBand = srcDS->GetRasterBand( j );
-                gc = poBand->GetMetadataItem( "GRIB_COMMENT" );
-                std::string bandName( gc );
-
-                if( bandName.find( "v-component of wind [m/s]" ) != bandName.npos ){
-                    gc = poBand->GetMetadataItem( "GRIB_SHORT_NAME" );
-                    std::string bandName( gc );
-                    if( bandName.find( "10-HTGL" ) != bandName.npos ){
-                        bandList.push_back( j );  // 10v
-                        break;
-                    }
-                }
-            }
-            for(unsigned int j = 1; j < srcDS->GetRasterCount(); j++)
-            { 
-                poBand = srcDS->GetRasterBand( j );
-                gc = poBand->GetMetadataItem( "GRIB_COMMENT" );
-                std::string bandName( gc );
-
-                if( bandName.find( "u-component of wind [m/s]" ) != bandName.npos ){
+                for(int k = 0; k < 4; k++)
+                {
+                    if( anBands[k] > 0 || bandName.find( apszComments[k] ) == bandName.npos )
+                        continue;
                     gc = poBand->GetMetadataItem( "GRIB_SHORT_NAME" );
-                    std::string bandName( gc );
-                    if( bandName.find( "10-HTGL" ) != bandName.npos ){
-                        bandList.push_back( j );  // 10u
-                        break;
+                    std::string shortName( gc );
+                    if( shortName.find( apszLevels[k] ) != shortName.npos ){
+                        anBands[k] = j;
+                        nFound++;
                     }
+                    break;
                 }
             }
-            for(unsigned int j = 1; j < srcDS->GetRasterCount(); j++)
-            { 
-                poBand = srcDS->GetRasterBand( j );
-                gc = poBand->GetMetadataItem( "GRIB_COMMENT" );
-                std::string bandName( gc );
-
-                if( bandName.find( "Total cloud cover [%]" ) != bandName.npos ){
-                    gc = poBand->GetMetadataItem( "GRIB_SHORT_NAME" );
-                    std::string bandName( gc );
-                    if( bandName.find( "0-RESERVED" ) != bandName.npos ){
-                        bandList.push_back( j );  // Total cloud cover in % 
-                        break;
-                    }
-                }
+            for(int k = 0; k < 4; k++)
+            {
+                if( anBands[k] > 0 )
+                    bandList.push_back( anBands[k] );
             }
         }
     }
 
+    if(bandList.size() < 4)
+        throw std::runtime_error("Could not match ninjaTime with a band number in the forecast file.");
+
     CPLDebug("HRRR", "2t: bandList[0] = %d", bandList[0]);
     CPLDebug("HRRR", "10v: bandList[1] = %d", bandList[1]);
     CPLDebug("HRRR", "10u: bandList[2] = %d", bandList[2]);
     CPLDebug("HRRR", "tcc: bandList[3] = %d", bandList[3]);
 
-    if(bandList.size() < 4)
-        throw std::runtime_error("Could not match ninjaTime with a band number in the forecast file.");
-
     std::string dstWkt;
     dstWkt = input.dem.prjString;
 
@@ -414,116 +414,44 @@ void ncepNamSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
         GDALClose((GDALDatasetH) poDS );
 
     // open ds one by one and warp, then write to grid
-    GDALDataset *srcDS, *wrpDS;
+    double dfNoData;
     std::string temp;
     std::string srcWkt;
 
     std::vector<std::string> varList = getVariableList();
 
-    /*
-     * Set the initial values in the warped dataset to no data
-     */
-    GDALWarpOptions* psWarpOptions;
-
     for( unsigned int i = 0;i < varList.size();i++ ) {
 
         temp = "NETCDF:" + input.forecastFilename + ":" + varList[i];
 
-        srcDS = (GDALDataset*)GDALOpenShared( temp.c_str(), GA_ReadOnly );
-        if( srcDS == NULL ) {
-            CPLDebug( "ncepNamSurfInitialization::setSurfaceGrids()",
-                    "Bad forecast file" );
-        }
-
-        srcWkt = srcDS->GetProjectionRef();
-
-        if( srcWkt.empty() ) {
-            CPLDebug( "ncepNamSurfInitialization::setSurfaceGrids()",
-                    "Bad forecast file" );
-            //throw
-        }
-
-        /*
-         * Grab the first band to get the nodata value for the variable,
-         * assume all bands have the same ndv
-         */
-        GDALRasterBand *poBand = srcDS->GetRasterBand( 1 );
-        int pbSuccess;
-        double dfNoData = poBand->GetNoDataValue( &pbSuccess );
-
-        psWarpOptions = GDALCreateWarpOptions();
-
-        int nBandCount = srcDS->GetRasterCount();
-        psWarpOptions->nBandCount = nBandCount;
-        psWarpOptions->panSrcBands = 
-            (int*) CPLMalloc( sizeof( int ) * nBandCount );
-        psWarpOptions->panDstBands = 
-            (int*) CPLMalloc( sizeof( int ) * nBandCount );
-        psWarpOptions->padfDstNoDataReal =
-            (double*) CPLMalloc( sizeof( double ) * nBandCount );
-        psWarpOptions->padfDstNoDataImag =
-            (double*) CPLMalloc( sizeof( double ) * nBandCount );
-
-        for( int b = 0;b < srcDS->GetRasterCount();b++ ) {
-            psWarpOptions->padfDstNoDataReal[b] = dfNoData;
-            psWarpOptions->padfDstNoDataImag[b] = dfNoData;
-            psWarpOptions->panSrcBands[b] = b + 1;
-            psWarpOptions->panDstBands[b] = b + 1;
-         }
-
-        if( pbSuccess == FALSE )
-            dfNoData = -9999.0;
-
-        psWarpOptions->papszWarpOptions =
-            CSLSetNameValue( psWarpOptions->papszWarpOptions,
-                             "INIT_DEST", "NO_DATA" );
-
-        /*
-        ** FIXME(kyle): valgrind reporting memory leak as psWarpOptions is
-        ** cloned internally and then not freed
-        */
-        wrpDS = (GDALDataset*) GDALAutoCreateWarpedVRT( srcDS, srcWkt.c_str(),
-                                                        dstWkt.c_str(),
-                                                        GRA_NearestNeighbour,
-                                                        1.0, psWarpOptions );
-        if(wrpDS == NULL)
-        {
-            throw badForecastFile("Could not warp the forecast file, "
-                                  "possibly non-uniform grid.");
-        }
-
         if( varList[i] == "Temperature_height_above_ground" ) {
-            GDAL2AsciiGrid( wrpDS, bandNum, airGrid );
+            dfNoData = readWarpedBand( temp, srcWkt, dstWkt, bandNum, airGrid );
         if( CPLIsNan( dfNoData ) ) {
         airGrid.set_noDataValue(-9999.0);
         airGrid.replaceNan( -9999.0 );
         }
     }
         else if( varList[i] == "v-component_of_wind_height_above_ground" ) {
-            GDAL2AsciiGrid( wrpDS, bandNum, vGrid );
+            dfNoData = readWarpedBand( temp, srcWkt, dstWkt, bandNum, vGrid );
         if( CPLIsNan( dfNoData ) ) {
         vGrid.set_noDataValue(-9999.0);
         vGrid.replaceNan( -9999.0 );
         }
     }
         else if( varList[i] == "u-component_of_wind_height_above_ground" ) {
-            GDAL2AsciiGrid( wrpDS, bandNum, uGrid );
+            dfNoData = readWarpedBand( temp, srcWkt, dstWkt, bandNum, uGrid );
         if( CPLIsNan( dfNoData ) ) {
         uGrid.set_noDataValue(-9999.0);
         uGrid.replaceNan( -9999.0 );
         }
     }
     else if( varList[i] == "Total_cloud_cover_entire_atmosphere_single_layer" ) {
-            GDAL2AsciiGrid( wrpDS, bandNum, cloudGrid );
+            dfNoData = readWarpedBand( temp, srcWkt, dstWkt, bandNum, cloudGrid );
         if( CPLIsNan( dfNoData ) ) {
         cloudGrid.set_noDataValue(-9999.0);
         cloudGrid.replaceNan( -9999.0 );
         }
     }
-
-        GDALDestroyWarpOptions( psWarpOptions );
-        GDALClose((GDALDatasetH) srcDS );
-        GDALClose((GDALDatasetH) wrpDS );
     }
     cloudGrid /= 100.0;
 
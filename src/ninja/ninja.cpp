@@ -28,6 +28,7 @@
 
 
 #include "ninja.h"
+#include "ninjaTrace.h"
 
 extern boost::local_time::tz_database globalTimeZoneDB;
 
@@ -59,12 +60,16 @@ ninja::ninja()
     endWriteOut=0.0;
 
     //Pointers to dynamically allocated memory
-    DIAG=NULL;
     PHI=NULL;
     RHS=NULL;
     SK=NULL;
     row_ptr=NULL;
     col_ind=NULL;
+    domain=NULL;
+    elemScatter=NULL;
+    stiffnessPrecond=NULL;
+    SKf=NULL;
+    matrixAssembled=false;
     uDiurnal=NULL;
     vDiurnal=NULL;
     wDiurnal=NULL;
@@ -76,6 +81,52 @@ ninja::ninja()
     nMaxMatchingIters = atoi( CPLGetConfigOption( "NINJA_POINT_MAX_MATCH_ITERS",
                                                   "150" ) );
     CPLDebug( "NINJA", "Maximum match iterations set to: %d", nMaxMatchingIters );
+    /*
+    ** Solve without assembling the stiffness matrix (see StiffnessOperator).
+    ** Slower, but needs far less memory on very large meshes.
+    */
+    matrixFree = CSLTestBoolean( CPLGetConfigOption( "NINJA_MATRIX_FREE", "NO" ) );
+    /*
+    ** Use the pipelined CG solver (fewer sweeps over the vectors per
+    ** iteration) instead of the reference one.
+    */
+    pipelinedCG = CSLTestBoolean( CPLGetConfigOption( "NINJA_PIPELINED_CG", "YES" ) );
+    /*
+    ** Solve with single precision matrix values and preconditioner factors
+    ** (see solveMixedPrecision()).
+    */
+    singlePrecision = CSLTestBoolean( CPLGetConfigOption( "NINJA_SINGLE_PRECISION", "NO" ) );
+    /*
+    ** Layout of the element geometry factors (see ElementGeometry).  FULL
+    ** stores the shape function gradients, COMPACT only the z terms for
+    ** meshes with uniform horizontal spacing.
+    */
+    geometryLayout = EQUAL( CPLGetConfigOption( "NINJA_GEOMETRY_LAYOUT", "COMPACT" ), "FULL" ) ?
+                     ElementGeometry::full : ElementGeometry::compact;
+    /*
+    ** Preconditioner for the conjugate gradient solver.  PARALLEL_SSOR is the
+    ** same preconditioner as SSOR with the triangular solves split over the
+    ** threads level by level.  MULTIGRID is a geometric multigrid V-cycle on
+    ** the mesh, its iteration count hardly grows with the mesh resolution.
+    */
+    const char *pszPrecond = CPLGetConfigOption( "NINJA_PRECONDITIONER", "PARALLEL_SSOR" );
+    if( EQUAL( pszPrecond, "SSOR" ) )
+        preconditionerType = Preconditioner::SSOR;
+    else if( EQUAL( pszPrecond, "JACOBI" ) )
+        preconditionerType = Preconditioner::Jacobi;
+    else if( EQUAL( pszPrecond, "MULTIGRID" ) )
+        preconditionerType = Preconditioner::Multigrid;
+    else
+        preconditionerType = Preconditioner::ParallelSSOR;
+    /*
+    ** Start the CG solvers from the best combination of the previous
+    ** solutions with the same matrix instead of from zero (see SolutionSpace):
+    ** the iterations of the "matching" loop, and the runs of an army sharing
+    ** a DomainContext.
+    */
+    warmStart = CSLTestBoolean( CPLGetConfigOption( "NINJA_WARM_START", "NO" ) );
+    warmStartVectors = atoi( CPLGetConfigOption( "NINJA_WARM_START_VECTORS", "8" ) );
+    nSolverIterations = 0;
 
     //ninjaCom stuff
     input.lastComString[0] = '\0';
@@ -103,6 +154,8 @@ ninja::~ninja()
 ninja::ninja(const ninja &rhs)
 : AngleGrid(rhs.AngleGrid)
 , VelocityGrid(rhs.VelocityGrid)
+, extraAngleGrids(rhs.extraAngleGrids)
+, extraVelocityGrids(rhs.extraVelocityGrids)
 , CloudGrid(rhs.CloudGrid)
 #ifdef EMISSIONS
 , DustGrid(rhs.DustGrid)
@@ -132,6 +185,14 @@ ninja::ninja(const ninja &rhs)
     isNullRun = rhs.isNullRun;
     maxStartingOuterDiff = rhs.maxStartingOuterDiff;
     nMaxMatchingIters = rhs.nMaxMatchingIters;
+    matrixFree = rhs.matrixFree;
+    pipelinedCG = rhs.pipelinedCG;
+    singlePrecision = rhs.singlePrecision;
+    geometryLayout = rhs.geometryLayout;
+    preconditionerType = rhs.preconditionerType;
+    warmStart = rhs.warmStart;
+    warmStartVectors = rhs.warmStartVectors;
+    nSolverIterations = rhs.nSolverIterations;
     matchTol = rhs.matchTol;
     num_outer_iter_tries_u = rhs.num_outer_iter_tries_u;
     num_outer_iter_tries_v = rhs.num_outer_iter_tries_v;
@@ -152,12 +213,16 @@ ninja::ninja(const ninja &rhs)
     endWriteOut=0.0;
 
     //Pointers to dynamically allocated memory
-    DIAG=NULL;
     PHI=NULL;
     RHS=NULL;
     SK=NULL;
     row_ptr=NULL;
     col_ind=NULL;
+    domain=NULL;
+    elemScatter=NULL;
+    stiffnessPrecond=NULL;
+    SKf=NULL;
+    matrixAssembled=false;
     uDiurnal=NULL;
     vDiurnal=NULL;
     wDiurnal=NULL;
@@ -181,6 +246,8 @@ ninja &ninja::operator=(const ninja &rhs)
     {
         AngleGrid = rhs.AngleGrid;
         VelocityGrid = rhs.VelocityGrid;
+        extraAngleGrids = rhs.extraAngleGrids;
+        extraVelocityGrids = rhs.extraVelocityGrids;
         CloudGrid = rhs.CloudGrid;
         #ifdef EMISSIONS
         DustGrid = rhs.DustGrid;
@@ -205,6 +272,15 @@ ninja &ninja::operator=(const ninja &rhs)
         isNullRun = rhs.isNullRun;
         maxStartingOuterDiff = rhs.maxStartingOuterDiff;
         nMaxMatchingIters = rhs.nMaxMatchingIters;
+        matrixFree = rhs.matrixFree;
+        pipelinedCG = rhs.pipelinedCG;
+        singlePrecision = rhs.singlePrecision;
+        geometryLayout = rhs.geometryLayout;
+        geometry.deallocate();      //belongs to the old mesh
+        preconditionerType = rhs.preconditionerType;
+        warmStart = rhs.warmStart;
+        warmStartVectors = rhs.warmStartVectors;
+        nSolverIterations = rhs.nSolverIterations;
         matchTol = rhs.matchTol;
         num_outer_iter_tries_u = rhs.num_outer_iter_tries_u;
         num_outer_iter_tries_v = rhs.num_outer_iter_tries_v;
@@ -225,12 +301,16 @@ ninja &ninja::operator=(const ninja &rhs)
         endWriteOut=0.0;
 
         //Pointers to dynamically allocated memory
-        DIAG=NULL;
         PHI=NULL;
         RHS=NULL;
         SK=NULL;
         row_ptr=NULL;
         col_ind=NULL;
+        domain=NULL;
+        elemScatter=NULL;
+        stiffnessPrecond=NULL;
+        SKf=NULL;
+        matrixAssembled=false;
         uDiurnal=NULL;
         vDiurnal=NULL;
         wDiurnal=NULL;
@@ -252,11 +332,18 @@ bool ninja::simulate_wind()
 {
 	checkCancel();
 
-	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Reading elevation file...");
-	
-	readInputFile();
-	set_position();
-	set_uniVegetation();
+	if(domain)
+	{
+	    //DEM, surface grids and mesh were built once for the whole army
+	    domain->applyTo(input, mesh);
+	    set_position();
+	}else{
+	    input.Com->ninjaCom(ninjaComClass::ninjaNone, "Reading elevation file...");
+
+	    readInputFile();
+	    set_position();
+	    set_uniVegetation();
+	}
 
 	checkInputs();
 
@@ -274,6 +361,7 @@ bool ninja::simulate_wind()
 	#ifdef _OPENMP
 		startTotal = omp_get_wtime();
 	#endif
+	NinjaTraceScope traceRun(input.inputsRunNumber, "simulate_wind");
 
 	 //taucs_double *SK;
 
@@ -297,9 +385,14 @@ bool ninja::simulate_wind()
 		startMesh = omp_get_wtime();
 	#endif
 
-	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Generating mesh...");
-	//generate mesh
-	mesh.buildStandardMesh(input);
+	if(!domain)
+	{
+	    input.Com->ninjaCom(ninjaComClass::ninjaNone, "Generating mesh...");
+	    //generate mesh
+	    NinjaTraceScope trace(input.inputsRunNumber, "mesh");
+	    mesh.buildStandardMesh(input);
+	    geometry.deallocate();
+	}
 	
 	u0.allocate(&mesh);		//u is positive toward East
 	v0.allocate(&mesh);		//v is positive toward North
@@ -326,6 +419,23 @@ if(input.initializationMethod == WindNinjaInputs::pointInitializationFlag)
 
 int matchingIterCount = 0;
 bool matchFlag = false;
+if(warmStart)
+{
+    //solutions of an earlier simulate_wind() may belong to another matrix
+    solutionSpace.initialize(mesh.NUMNP, warmStartVectors);
+    solutionSpace.clear();
+}
+//The stiffness matrix only depends on the mesh and alphaV, not on the station
+//values matched() adjusts, so it is assembled in the first matching iteration
+//and kept (with its preconditioner) for the others.  Only the initial wind
+//field and RHS are rebuilt.  If alphaV is computed from the initial wind
+//field it can change between iterations, so then the matrix is rebuilt.
+bool keepMatrix = input.matchWxStations;
+#ifdef STABILITY
+if(input.stabilityFlag && input.alphaStability == -1)
+    keepMatrix = false;
+#endif
+double startUVW = 0.0, endUVW = 0.0;
 if(input.matchWxStations == true)
 {
     num_outer_iter_tries_u = std::vector<int>(input.stations.size(),0);
@@ -351,8 +461,10 @@ do
 		input.Com->ninjaCom(ninjaComClass::ninjaNone, "Initializing flow...");
 
 		//initialize
+                double traceStart = NinjaTrace::now();
                 init.reset(initializationFactory::makeInitialization(input));
                 init->initializeFields(input, mesh, u0, v0, w0, CloudGrid);
+                NinjaTrace::addPhase(input.inputsRunNumber, "initialization", traceStart, NinjaTrace::now());
 #ifdef _OPENMP
                 endInit = omp_get_wtime();
 #endif
@@ -407,11 +519,29 @@ do
 		#endif
 
 		//solver
+		traceStart = NinjaTrace::now();
 
-		//if the CG solver diverges, try the minres solver
-		if(solve(SK, RHS, PHI, row_ptr, col_ind, mesh.NUMNP, MAXITS, print_iters, stop_tol)==false)
-		    if(solveMinres(SK, RHS, PHI, row_ptr, col_ind, mesh.NUMNP, MAXITS, print_iters, stop_tol)==false)
+		if(matrixFree)
+		{
+		    if(solveMatrixFree(RHS, PHI, mesh.NUMNP, MAXITS, print_iters, stop_tol)==false)
 			throw std::runtime_error("Solver returned false.");
+		}else{
+		    //initial guess from the previous solutions, PHI is zero otherwise
+		    int nGuessVectors = 0;
+		    if(warmStart)
+			nGuessVectors = warmStartSolution(SK, RHS, PHI, row_ptr, col_ind, mesh.NUMNP);
+
+		    //if the CG solver diverges, try the minres solver
+		    if((singlePrecision ? solveMixedPrecision(SK, RHS, PHI, row_ptr, col_ind, mesh.NUMNP, MAXITS, print_iters, stop_tol)
+		        : pipelinedCG ? solvePipelined(SK, RHS, PHI, row_ptr, col_ind, mesh.NUMNP, MAXITS, print_iters, stop_tol)
+		        : solve(SK, RHS, PHI, row_ptr, col_ind, mesh.NUMNP, MAXITS, print_iters, stop_tol))==false)
+			if(solveMinres(SK, RHS, PHI, row_ptr, col_ind, mesh.NUMNP, MAXITS, print_iters, stop_tol)==false)
+			    throw std::runtime_error("Solver returned false.");
+
+		    if(warmStart)
+			storeSolution(SK, PHI, row_ptr, col_ind, mesh.NUMNP, nGuessVectors);
+		}
+		NinjaTrace::addPhase(input.inputsRunNumber, "solve", traceStart, NinjaTrace::now());
 
 		#ifdef _OPENMP
 			endSolve = omp_get_wtime();
@@ -419,22 +549,9 @@ do
 
 		checkCancel();
 
-		 if(SK)
-		 {
-			delete[] SK;
-			SK=NULL;
-		 }
+		 if(!keepMatrix)
+			 deleteStiffnessMatrix();
 
-		 if(col_ind)
-		 {
-			delete[] col_ind;
-			col_ind=NULL;
-		 }
-		 if(row_ptr)
-		 {
-			delete[] row_ptr;
-			row_ptr=NULL;
-		 }
 		 if(RHS)
 		 {
 			delete[] RHS;
@@ -445,15 +562,29 @@ do
 /*  COMPUTE UVW WIND FIELD                   */
 /*  ----------------------------------------*/
 
+		#ifdef _OPENMP
+			startUVW = omp_get_wtime();
+		#endif
+
 		 //compute uvw field from phi field
 		 computeUVWField();
 
+		#ifdef _OPENMP
+			endUVW = omp_get_wtime();
+		#endif
+
 		 checkCancel();
 
+		 if(input.matchWxStations == true)
+			 input.Com->ninjaCom(ninjaComClass::ninjaDebug, "\"matching\" loop iteration %i times: initialization %lf, equation building %lf, solver %lf, wind field %lf seconds.",
+			                     matchingIterCount, endInit-startInit, endBuildEq-startBuildEq, endSolve-startSolve, endUVW-startUVW);
+
 		 matchFlag = matched(matchingIterCount);
 
  }while(matchingIterCount<max_matching_iters && !matchFlag);	//end outer iterations is over max_matching_iters or wind field matches wx stations
 
+deleteStiffnessMatrix();    //kept between the matching iterations
+
 if(input.matchWxStations == true && !isNullRun)
 {
 	double smallestInfluenceRadius = getSmallestRadiusOfInfluence();
@@ -559,6 +690,7 @@ if(input.frictionVelocityFlag == 1){
 			input.Com->ninjaCom(ninjaComClass::ninjaNone, "Total simulation time was %lf seconds.",endTotal-startTotal);
 	#endif
 
+     NinjaTrace::addPeakMemory(input.inputsRunNumber);
      input.Com->ninjaCom(ninjaComClass::ninjaNone, "Run number %d done!", input.inputsRunNumber);
 
      //If its a pointInitialization Run, explicitly set run completion to 100 when they finish
@@ -578,6 +710,8 @@ if(input.frictionVelocityFlag == 1){
 	 {
 	     AngleGrid.deallocate();
          VelocityGrid.deallocate();
+         extraAngleGrids.clear();
+         extraVelocityGrids.clear();
 	     CloudGrid.deallocate();
 	     #ifdef FRICTION_VELOCITY
 	     if(input.frictionVelocityFlag == 1){
@@ -612,6 +746,190 @@ double ninja::getSmallestRadiusOfInfluence()
 	return smallest;
 }
 
+static const char *precondNames[] = {"no", "Jacobi", "SSOR", "parallel SSOR", "multigrid"};    //indexed by Preconditioner::precondType
+
+/* Copy of the nnz values of a matrix rounded to float, for solveMixedPrecision() */
+static float *SinglePrecisionCopy(const double *A, int nnz)
+{
+    int j;
+    float *Af = new float[nnz];
+#pragma omp parallel for
+    for(j=0;j<nnz;j++)
+        Af[j] = (float)A[j];
+    return Af;
+}
+
+/**Sets up the preconditioner for the CG solvers.
+ * If A is the stiffness matrix of the shared domain context its preconditioner
+ * is already set up and is used instead.  Otherwise the preconditioner is
+ * kept with SK (until deleteStiffnessMatrix()), so the matching iterations
+ * that reuse SK reuse it too.  Falls back to Jacobi if the requested
+ * preconditioner cannot be initialized.
+ * @param A Stiffness matrix in symmetric compressed sparse row storage, SK.
+ * @param row_ptr Vector used to index to a row in A.
+ * @param col_ind Vector storing the column number of corresponding value in A.
+ * @param NUMNP Number of nodal points.
+ * @return The preconditioner to use.  Only call its thread safe solve() with
+ *         a work vector of get_workSize() values.
+ */
+const Preconditioner *ninja::initializePreconditioner(double *A, int *row_ptr, int *col_ind, int NUMNP)
+{
+    if(domain && A == domain->SK)
+        return &domain->precond;
+    if(A != SK)
+        throw std::logic_error("ninja::initializePreconditioner() called for a matrix other than SK.");
+    if(stiffnessPrecond)
+        return stiffnessPrecond;
+
+    NinjaTraceScope trace(input.inputsRunNumber, "preconditioner");
+    stiffnessPrecond = new Preconditioner;
+    Preconditioner &M = *stiffnessPrecond;
+
+    char matdescra[6];
+    matdescra[0]='s';	//symmetric
+    matdescra[1]='u';	//upper triangle stored
+    matdescra[2]='n';	//non-unit diagonal
+    matdescra[3]='c';	//c-style array (ie 0 is index of first element, not 1 like in Fortran)
+
+    M.set_gridDimensions(mesh.nrows, mesh.ncols, mesh.nlayers);    //only used by the multigrid preconditioner
+    M.set_singlePrecision(singlePrecision);
+    if(M.initialize(NUMNP, A, row_ptr, col_ind, preconditionerType, matdescra)==false)
+    {
+        input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Initialization of %s preconditioner failed, trying Jacobi preconditioner...", precondNames[preconditionerType]);
+        if(M.initialize(NUMNP, A, row_ptr, col_ind, M.Jacobi, matdescra)==false)
+            throw std::runtime_error("Initialization of Jacobi preconditioner failed.");
+    }
+    else if(M.get_type() == Preconditioner::ParallelSSOR)
+        input.Com->ninjaCom(ninjaComClass::ninjaDebug, "Parallel SSOR preconditioner uses %d levels.", M.get_numLevels());
+    else if(M.get_type() == Preconditioner::Multigrid)
+        input.Com->ninjaCom(ninjaComClass::ninjaDebug, "Multigrid preconditioner uses %d grid levels.", M.get_numLevels());
+
+    return &M;
+}
+
+/**Returns the single precision copy of the stiffness matrix used by
+ * solveMixedPrecision().  If A is the stiffness matrix of the shared domain
+ * context its copy was made with the context and is used instead.  Otherwise
+ * the copy is made on first use and kept with SK (until
+ * deleteStiffnessMatrix()), like the preconditioner.
+ * @param A Stiffness matrix in symmetric compressed sparse row storage, SK.
+ * @param row_ptr Vector used to index to a row in A.
+ * @param NUMNP Number of nodal points.
+ * @return The values of A rounded to float, only to be read.
+ */
+const float *ninja::get_singlePrecisionMatrix(double *A, int *row_ptr, int NUMNP)
+{
+    if(domain && A == domain->SK)
+    {
+        if(domain->SKf == NULL)
+            throw std::logic_error("Domain context was built without a single precision matrix.");
+        return domain->SKf;
+    }
+    if(A != SK)
+        throw std::logic_error("ninja::get_singlePrecisionMatrix() called for a matrix other than SK.");
+    if(SKf == NULL)
+        SKf = SinglePrecisionCopy(A, row_ptr[NUMNP]);
+    return SKf;
+}
+
+/**Returns the element geometry factors of the shared domain context, or this run's (built on first use).
+ */
+const ElementGeometry &ninja::get_geometry()
+{
+    if(domain)
+        return domain->geometry;
+    if(!geometry.isBuilt())
+    {
+        geometry.initialize(&mesh, geometryLayout);
+        input.Com->ninjaCom(ninjaComClass::ninjaDebug, "Element geometry factors (%s layout): %.1lf MB.",
+                            geometry.get_layout() == ElementGeometry::full ? "full" : "compact",
+                            geometry.get_memoryMB());
+    }
+    return geometry;
+}
+
+/**Returns the previous solutions that go with the matrix A: those of the
+ * army if A is the stiffness matrix of the shared domain context, otherwise
+ * those of this run's matching loop.
+ * @param A Stiffness matrix.
+ */
+SolutionSpace *ninja::get_solutionSpace(double *A)
+{
+    if(domain && A == domain->SK)
+        return &domain->solutions;
+    return &solutionSpace;
+}
+
+/**Computes the initial guess for the CG solvers from the previous solutions
+ * with the same matrix (see SolutionSpace).  If the guess is worse than
+ * zero (in the A-norm) the matrix must have changed, so the previous
+ * solutions are dropped and the solve starts from zero.
+ * @param A Stiffness matrix in symmetric compressed sparse row storage.
+ * @param b Right hand side.
+ * @param x Set to the initial guess.
+ * @param row_ptr Vector used to index to a row in A.
+ * @param col_ind Vector storing the column number of corresponding value in A.
+ * @param NUMNP Number of nodal points.
+ * @return The number of previous solutions the guess is made of, 0 if x is zero.
+ */
+int ninja::warmStartSolution(double *A, double *b, double *x, int *row_ptr, int *col_ind, int NUMNP)
+{
+    SolutionSpace *space = get_solutionSpace(A);
+    int nVectors = space->project(b, x);
+    if(nVectors == 0)
+        return 0;
+
+    //compare 1/2 x.A*x - x.b (the A-norm error, up to a constant) with that of x = 0
+    int j;
+    double xb;
+    double *Ax = new double[NUMNP];
+    double xAx = symmetricCsrMatVecDot(NUMNP, A, col_ind, row_ptr, &row_ptr[1], x, Ax, b, &xb);
+    delete[] Ax;
+
+    if(0.5*xAx - xb >= 0.0)
+    {
+        input.Com->ninjaCom(ninjaComClass::ninjaDebug, "Previous solutions do not fit the stiffness matrix, starting the solver from zero.");
+        space->clear();
+#pragma omp parallel for
+        for(j=0; j<NUMNP; j++)
+            x[j] = 0.0;
+        return 0;
+    }
+
+    input.Com->ninjaCom(ninjaComClass::ninjaDebug, "Initial guess from %d previous solutions.", nVectors);
+    return nVectors;
+}
+
+/**Adds a solution to the previous solutions used by warmStartSolution() and
+ * reports the solver iterations saved compared to the last solve started
+ * from zero.
+ * @param A Stiffness matrix in symmetric compressed sparse row storage.
+ * @param x Solution.
+ * @param row_ptr Vector used to index to a row in A.
+ * @param col_ind Vector storing the column number of corresponding value in A.
+ * @param NUMNP Number of nodal points.
+ * @param nGuessVectors Return value of warmStartSolution() for this solve.
+ */
+void ninja::storeSolution(double *A, double *x, int *row_ptr, int *col_ind, int NUMNP, int nGuessVectors)
+{
+    SolutionSpace *space = get_solutionSpace(A);
+
+    if(nGuessVectors == 0)
+        space->set_coldStartIterations(nSolverIterations);
+    else
+    {
+        int coldIterations = space->get_coldStartIterations();
+        if(coldIterations >= 0)
+            input.Com->ninjaCom(ninjaComClass::ninjaNone, "Warm start from %d previous solutions: %d solver iterations, %d saved compared to starting from zero.",
+                                nGuessVectors, nSolverIterations, coldIterations-nSolverIterations);
+    }
+
+    double *Ax = new double[NUMNP];
+    symmetricCsrMatVec(NUMNP, A, col_ind, row_ptr, &row_ptr[1], x, Ax);
+    space->add(x, Ax);
+    delete[] Ax;
+}
+
 /*
 
 //  CG solver
@@ -621,6 +939,8 @@ double ninja::getSmallestRadiusOfInfluence()
  * This is a congugate gradient solver.
  * It seems to be the fastest, but is not monotonic convergence (residual oscillates a bit up and down).
  * If this solver diverges, try the MINRES from PetSc which is commented out below...
+ * This is the textbook preconditioned CG, kept as the reference for
+ * ninja::solvePipelined(), which is used unless NINJA_PIPELINED_CG is off.
  * @param A Stiffness matrix in Ax=b matrix equation.  Storage is symmetric compressed sparse row storage.
  * @param b Right hand side of matrix equations.
  * @param x Vector to store solution in.
@@ -652,13 +972,18 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
 
     residual_percent_complete_old = -1.;
 
-    Preconditioner M;
-    if(M.initialize(NUMNP, A, row_ptr, col_ind, M.SSOR, matdescra)==false)
-    {
-        input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Initialization of SSOR preconditioner failed, trying Jacobi preconditioner...");
-        if(M.initialize(NUMNP, A, row_ptr, col_ind, M.Jacobi, matdescra)==false)
-            throw std::runtime_error("Initialization of Jacobi preconditioner failed.");
-    }
+    int nIterations = 0;
+    double startPrecond = 0.0, endPrecond = 0.0, endIterations = 0.0;
+#ifdef _OPENMP
+    startPrecond = omp_get_wtime();
+#endif
+
+    const Preconditioner *precond = initializePreconditioner(A, row_ptr, col_ind, NUMNP);
+    double *precondWork = new double[precond->get_workSize()];
+
+#ifdef _OPENMP
+    endPrecond = omp_get_wtime();
+#endif
 
 //#define NINJA_DEBUG_VERBOSE
 #ifdef NINJA_DEBUG_VERBOSE
@@ -699,6 +1024,8 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
     {
         tol = resid;
         max_iter = 0;
+        nSolverIterations = 0;
+        delete[] precondWork;
         return true;
     }
 
@@ -706,8 +1033,9 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
     for (int i = 1; i <= max_iter; i++)
     {
         checkCancel();
+        nIterations = i;
 
-        M.solve(r, z, row_ptr, col_ind);	//apply preconditioner
+        precond->solve(r, z, row_ptr, col_ind, precondWork);	//apply preconditioner
 
         rho = cblas_ddot(NUMNP, z, 1, r, 1);
         //rho = dot(NUMNP, z, r);
@@ -737,6 +1065,7 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
 
         resid = cblas_dnrm2(NUMNP, r, 1) / normb;	//compute resid
         //resid = nrm2(NUMNP, r) / normb;
+        NinjaTrace::addSample(input.inputsRunNumber, "residual", i, resid);
 
         if(i==1)
             start_resid = resid;
@@ -796,11 +1125,477 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
         delete[] r;
         r=NULL;
     }
+    delete[] precondWork;
 
 #ifdef NINJA_DEBUG_VERBOSE
     fclose(convergence_history);
 #endif //NINJA_DEBUG_VERBOSE
 
+#ifdef _OPENMP
+    endIterations = omp_get_wtime();
+#endif
+    nSolverIterations = nIterations;
+    NinjaTrace::addCounter(input.inputsRunNumber, "solver_iterations", nIterations);
+    input.Com->ninjaCom(ninjaComClass::ninjaNone, "CG solver with %s preconditioner: %d iterations, %lf seconds (preconditioner setup %lf seconds).",
+                        precondNames[precond->get_type()], nIterations, endIterations-startPrecond, endPrecond-startPrecond);
+
+    if(resid>tol)
+    {
+        throw std::runtime_error("Solution did not converge.\nMAXITS reached.");
+    }else{
+        time_percent_complete = 100; //When the solver finishes, set it to 100
+        input.Com->ninjaCom(ninjaComClass::ninjaSolverProgress, "%d",(int) (time_percent_complete+0.5));
+        return true;
+    }
+}
+
+/**Pipelined preconditioned conjugate gradient solver.
+ * Chronopoulos and Gear's variant of CG: the recurrence s = A*p replaces the
+ * separate A*p product, so each iteration needs one preconditioner solve, one
+ * matrix vector product and just two sweeps over the vectors (see
+ * ninja::pipelinedIterations()).  In exact arithmetic the iterates are the
+ * same as those of ninja::solve(), which is kept as the reference.  It takes
+ * one more vector of NUMNP values.
+ * @param A Stiffness matrix in Ax=b matrix equation.  Storage is symmetric compressed sparse row storage.
+ * @param b Right hand side of matrix equations.
+ * @param x Vector to store solution in.
+ * @param row_ptr Vector used to index to a row in A.
+ * @param col_ind Vector storing the column number of corresponding value in A.
+ * @param NUMNP Number of nodal points, so also the size of b, x, and row_ptr.
+ * @param max_iter Maximum number of iterations to do.
+ * @param print_iters How often to print out solver information.
+ * @param tol Convergence tolerance to stop at.
+ * @return Returns true if solver converges and completes properly.
+ */
+bool ninja::solvePipelined(double *A, double *b, double *x, int *row_ptr, int *col_ind, int NUMNP, int max_iter, int print_iters, double tol)
+{
+    int j;
+    double bb, normb, resid, time_percent_complete;
+    int nIterations = 0;
+    double startPrecond = 0.0, endPrecond = 0.0, endIterations = 0.0;
+#ifdef _OPENMP
+    startPrecond = omp_get_wtime();
+#endif
+
+    const Preconditioner *precond = initializePreconditioner(A, row_ptr, col_ind, NUMNP);
+    double *precondWork = new double[precond->get_workSize()];
+
+#ifdef _OPENMP
+    endPrecond = omp_get_wtime();
+#endif
+
+    bb = 0.0;
+#pragma omp parallel for reduction(+:bb)
+    for(j=0;j<NUMNP;j++)
+        bb += b[j]*b[j];
+    normb = std::sqrt(bb);
+    if (normb == 0.0)
+        normb = 1.;
+
+    resid = pipelinedIterations(A, b, x, row_ptr, col_ind, NUMNP, precond, precondWork,
+                                max_iter, print_iters, normb, tol, nIterations);
+
+    delete[] precondWork;
+
+#ifdef _OPENMP
+    endIterations = omp_get_wtime();
+#endif
+    nSolverIterations = nIterations;
+    NinjaTrace::addCounter(input.inputsRunNumber, "solver_iterations", nIterations);
+    input.Com->ninjaCom(ninjaComClass::ninjaNone, "Pipelined CG solver with %s preconditioner: %d iterations, %lf seconds (preconditioner setup %lf seconds).",
+                        precondNames[precond->get_type()], nIterations, endIterations-startPrecond, endPrecond-startPrecond);
+
+    if(resid>tol)
+    {
+        throw std::runtime_error("Solution did not converge.\nMAXITS reached.");
+    }else{
+        time_percent_complete = 100; //When the solver finishes, set it to 100
+        input.Com->ninjaCom(ninjaComClass::ninjaSolverProgress, "%d",(int) (time_percent_complete+0.5));
+        return true;
+    }
+}
+
+
+/**The iterations of the pipelined CG solver, starting from x.
+ * Each iteration is
+ *   1. p = z + beta*p, s = q + beta*s, x = x + alpha*p, r = r - alpha*s and
+ *      r.r, all in one parallel loop.
+ *   2. z = M^(-1)*r, then q = A*z together with z.q and r.z
+ *      (symmetricCsrMatVecDot()).
+ * alpha and beta come from r.z and z.q of the same iteration.  The matrix
+ * values are double or, for ninja::solveMixedPrecision(), float; the vectors
+ * and all sums are double either way.
+ * @param A Stiffness matrix values (symmetric compressed sparse row storage).
+ * @param b Right hand side.
+ * @param x Initial guess, overwritten with the solution.
+ * @param row_ptr Vector used to index to a row in A.
+ * @param col_ind Vector storing the column number of corresponding value in A.
+ * @param NUMNP Number of nodal points.
+ * @param precond Initialized preconditioner.
+ * @param precondWork Work vector of precond->get_workSize() values.
+ * @param max_iter Maximum number of iterations to do.
+ * @param print_iters How often to report the progress.
+ * @param normb Norm the residual is measured relative to, usually |b|.
+ * @param tol Stop once |r|/normb is below tol.
+ * @param nIterations Set to the number of iterations done.
+ * @return The final |r|/normb.
+ */
+template<class T>
+double ninja::pipelinedIterations(const T *A, const double *b, double *x, int *row_ptr, int *col_ind, int NUMNP,
+                                  const Preconditioner *precond, double *precondWork,
+                                  int max_iter, int print_iters, double normb, double tol, int &nIterations)
+{
+    int j;
+    double *p, *s, *z, *q, *r;
+    double alpha, beta, gamma, gamma_1, delta, rr, resid;
+    double residual_percent_complete, residual_percent_complete_old, time_percent_complete, start_resid;
+    residual_percent_complete = 0.0;
+    residual_percent_complete_old = -1.;
+    nIterations = 0;
+
+    p=new double[NUMNP];
+    s=new double[NUMNP];
+    z=new double[NUMNP];
+    q=new double[NUMNP];
+    r=new double[NUMNP];
+
+    symmetricCsrMatVec(NUMNP, A, col_ind, row_ptr, &row_ptr[1], x, r);
+
+    rr = 0.0;
+#pragma omp parallel for reduction(+:rr)
+    for(j=0;j<NUMNP;j++)
+    {
+        r[j] = b[j] - r[j];     //initial residual
+        p[j] = 0.0;
+        s[j] = 0.0;
+        rr += r[j]*r[j];
+    }
+
+    resid = std::sqrt(rr) / normb;
+
+    if(resid > tol)
+    {
+        precond->solve(r, z, row_ptr, col_ind, precondWork);
+        delta = symmetricCsrMatVecDot(NUMNP, A, col_ind, row_ptr, &row_ptr[1], z, q, r, &gamma);
+        alpha = gamma / delta;
+        beta = 0.0;
+
+        for (int i = 1; i <= max_iter; i++)
+        {
+            checkCancel();
+            nIterations = i;
+
+            rr = 0.0;
+#pragma omp parallel for reduction(+:rr)
+            for(j=0;j<NUMNP;j++)
+            {
+                double pj = z[j] + beta*p[j];
+                double sj = q[j] + beta*s[j];     //s = A*p
+                p[j] = pj;
+                s[j] = sj;
+                x[j] += alpha*pj;
+                r[j] -= alpha*sj;
+                rr += r[j]*r[j];
+            }
+
+            resid = std::sqrt(rr) / normb;
+            NinjaTrace::addSample(input.inputsRunNumber, "residual", i, resid);
+
+            if(i==1)
+                start_resid = resid;
+
+            if((i%print_iters)==0)
+            {
+                residual_percent_complete=100-100*((resid-tol)/(start_resid-tol));
+                if(residual_percent_complete<residual_percent_complete_old)
+                    residual_percent_complete=residual_percent_complete_old;
+                if(residual_percent_complete<0.)
+                    residual_percent_complete=0.;
+                else if(residual_percent_complete>100.)
+                    residual_percent_complete=100.0;
+
+                time_percent_complete=1.8*exp(0.0401*residual_percent_complete);
+                if(time_percent_complete >= 99.0)
+                    time_percent_complete = 99.0;
+                residual_percent_complete_old=residual_percent_complete;
+                input.Com->ninjaCom(ninjaComClass::ninjaSolverProgress, "%d",(int) (time_percent_complete+0.5)); //Tell the GUI what the percentage to complete for the ninja is
+            }
+
+            if (resid <= tol)
+                break;
+
+            precond->solve(r, z, row_ptr, col_ind, precondWork);	//z = M^(-1)*r
+
+            gamma_1 = gamma;
+            //q = A*z, delta = z.q, gamma = r.z
+            delta = symmetricCsrMatVecDot(NUMNP, A, col_ind, row_ptr, &row_ptr[1], z, q, r, &gamma);
+
+            beta = gamma / gamma_1;
+            alpha = gamma / (delta - beta*gamma/alpha);
+        }
+    }
+
+    delete[] p;
+    delete[] s;
+    delete[] z;
+    delete[] q;
+    delete[] r;
+
+    return resid;
+}
+
+/**Mixed precision conjugate gradient solver (NINJA_SINGLE_PRECISION).
+ * Iterative refinement: the residual r = b - A*x is computed with the double
+ * precision SK, the correction d from A*d = r with the pipelined CG
+ * iterations on a single precision copy of SK (and single precision
+ * ParallelSSOR factors), then x = x + d.  The copy is made once per matrix
+ * (get_singlePrecisionMatrix()), not per solve.  Only the matrix and
+ * preconditioner values read every iteration are single precision, the
+ * vectors and all sums stay double.  Usually one refinement step reaches the tolerance.  If a step
+ * does not at least halve the residual the solve is finished by the double
+ * precision solver, starting from the current x.
+ * @param A Stiffness matrix in Ax=b matrix equation.  Storage is symmetric compressed sparse row storage.
+ * @param b Right hand side of matrix equations.
+ * @param x Vector to store solution in.
+ * @param row_ptr Vector used to index to a row in A.
+ * @param col_ind Vector storing the column number of corresponding value in A.
+ * @param NUMNP Number of nodal points, so also the size of b, x, and row_ptr.
+ * @param max_iter Maximum number of iterations to do.
+ * @param print_iters How often to print out solver information.
+ * @param tol Convergence tolerance to stop at.
+ * @return Returns true if solver converges and completes properly.
+ */
+bool ninja::solveMixedPrecision(double *A, double *b, double *x, int *row_ptr, int *col_ind, int NUMNP, int max_iter, int print_iters, double tol)
+{
+    const int maxRefinements = 10;
+    int j, n;
+    double bb, rr, normb, resid, residOld;
+    int nIterations = 0, nRefinements = 0;
+    bool stalled = false;
+    double startPrecond = 0.0, endPrecond = 0.0, endIterations = 0.0;
+#ifdef _OPENMP
+    startPrecond = omp_get_wtime();
+#endif
+
+    const Preconditioner *precond = initializePreconditioner(A, row_ptr, col_ind, NUMNP);
+    double *precondWork = new double[precond->get_workSize()];
+
+#ifdef _OPENMP
+    endPrecond = omp_get_wtime();
+#endif
+
+    const float *Af = get_singlePrecisionMatrix(A, row_ptr, NUMNP);
+
+    double *r = new double[NUMNP];
+    double *d = new double[NUMNP];
+
+    symmetricCsrMatVec(NUMNP, A, col_ind, row_ptr, &row_ptr[1], x, r);
+    bb = 0.0;
+    rr = 0.0;
+#pragma omp parallel for reduction(+:bb,rr)
+    for(j=0;j<NUMNP;j++)
+    {
+        r[j] = b[j] - r[j];
+        bb += b[j]*b[j];
+        rr += r[j]*r[j];
+    }
+    normb = std::sqrt(bb);
+    if (normb == 0.0)
+        normb = 1.;
+    resid = std::sqrt(rr) / normb;
+
+    while(resid > tol)
+    {
+        if(nRefinements == maxRefinements || nIterations >= max_iter)
+        {
+            stalled = true;
+            break;
+        }
+        nRefinements++;
+
+#pragma omp parallel for
+        for(j=0;j<NUMNP;j++)
+            d[j] = 0.0;
+
+        //aim below tol, the rounding of Af shows up in the double precision residual
+        pipelinedIterations(Af, r, d, row_ptr, col_ind, NUMNP, precond, precondWork,
+                            max_iter-nIterations, print_iters, normb, 0.5*tol, n);
+        nIterations += n;
+
+#pragma omp parallel for
+        for(j=0;j<NUMNP;j++)
+            x[j] += d[j];
+
+        //true residual in double precision
+        symmetricCsrMatVec(NUMNP, A, col_ind, row_ptr, &row_ptr[1], x, r);
+        rr = 0.0;
+#pragma omp parallel for reduction(+:rr)
+        for(j=0;j<NUMNP;j++)
+        {
+            r[j] = b[j] - r[j];
+            rr += r[j]*r[j];
+        }
+        residOld = resid;
+        resid = std::sqrt(rr) / normb;
+        NinjaTrace::addSample(input.inputsRunNumber, "refinement_residual", nIterations, resid);
+
+        if(resid > tol && resid > 0.5*residOld)
+        {
+            stalled = true;
+            break;
+        }
+    }
+
+    delete[] r;
+    delete[] d;
+    delete[] precondWork;
+
+#ifdef _OPENMP
+    endIterations = omp_get_wtime();
+#endif
+    nSolverIterations = nIterations;
+    NinjaTrace::addCounter(input.inputsRunNumber, "solver_iterations", nIterations);
+    input.Com->ninjaCom(ninjaComClass::ninjaNone, "Mixed precision CG solver with %s preconditioner: %d iterations in %d refinement steps, %lf seconds (preconditioner setup %lf seconds).",
+                        precondNames[precond->get_type()], nIterations, nRefinements, endIterations-startPrecond, endPrecond-startPrecond);
+
+    if(stalled)
+    {
+        input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Single precision solve stalled at residual %lf, continuing in double precision...", resid);
+        return pipelinedCG ? solvePipelined(A, b, x, row_ptr, col_ind, NUMNP, max_iter, print_iters, tol)
+                           : solve(A, b, x, row_ptr, col_ind, NUMNP, max_iter, print_iters, tol);
+    }
+
+    input.Com->ninjaCom(ninjaComClass::ninjaSolverProgress, "%d", 100);
+    return true;
+}
+
+/**Matrix-free preconditioned conjugate gradient solver.
+ * Same iteration as ninja::solve(), but A*x is computed element by element
+ * with a StiffnessOperator instead of from the assembled SK, so SK, col_ind and
+ * row_ptr are never allocated.  The preconditioner is selected with the
+ * NINJA_MATRIX_FREE_PRECONDITIONER config option (JACOBI or CHEBYSHEV, the
+ * default) and NINJA_CHEBYSHEV_DEGREE (default 4).
+ * @param b Right hand side of matrix equations.
+ * @param x Vector to store solution in.
+ * @param NUMNP Number of nodal points, so also the size of b and x.
+ * @param max_iter Maximum number of iterations to do.
+ * @param print_iters How often to print out solver information.
+ * @param tol Convergence tolerance to stop at.
+ * @return Returns true if solver converges and completes properly.
+ */
+bool ninja::solveMatrixFree(double *b, double *x, int NUMNP, int max_iter, int print_iters, double tol)
+{
+    int j;
+    double *p, *z, *q, *r;
+    double alpha, beta, rho, rho_1, normb, resid;
+    double residual_percent_complete, residual_percent_complete_old, time_percent_complete, start_resid;
+    residual_percent_complete = 0.0;
+    residual_percent_complete_old = -1.;
+
+    int precondType = StiffnessOperator::Chebyshev;
+    if(EQUAL(CPLGetConfigOption("NINJA_MATRIX_FREE_PRECONDITIONER", "CHEBYSHEV"), "JACOBI"))
+        precondType = StiffnessOperator::Jacobi;
+    int chebyshevDegree = atoi(CPLGetConfigOption("NINJA_CHEBYSHEV_DEGREE", "4"));
+    int nIterations = 0;
+    double startTime = 0.0, endTime = 0.0;
+#ifdef _OPENMP
+    startTime = omp_get_wtime();
+#endif
+
+    double traceStart = NinjaTrace::now();
+    StiffnessOperator A;
+    #ifdef STABILITY
+    A.initialize(&mesh, &get_geometry(), &alphaVfield, alphaH, precondType, chebyshevDegree);
+    #else
+    A.initialize(&mesh, &get_geometry(), NULL, alphaH, precondType, chebyshevDegree);
+    #endif
+    NinjaTrace::addPhase(input.inputsRunNumber, "preconditioner", traceStart, NinjaTrace::now());
+
+    p=new double[NUMNP];
+    z=new double[NUMNP];
+    q=new double[NUMNP];
+    r=new double[NUMNP];
+
+    A.apply(x, r);
+
+#pragma omp parallel for
+    for(j=0;j<NUMNP;j++)
+        r[j]=b[j]-r[j];                  //calculate the initial residual
+
+    normb = cblas_dnrm2(NUMNP, b, 1);
+    if (normb == 0.0)
+        normb = 1.;
+
+    resid = cblas_dnrm2(NUMNP, r, 1) / normb;
+
+    for (int i = 1; i <= max_iter && resid > tol; i++)
+    {
+        checkCancel();
+        nIterations = i;
+
+        A.precondition(r, z);	//apply preconditioner
+
+        rho = cblas_ddot(NUMNP, z, 1, r, 1);
+
+        if (i == 1)
+        {
+            cblas_dcopy(NUMNP, z, 1, p, 1);
+        }else {
+            beta = rho / rho_1;
+
+#pragma omp parallel for
+            for(j=0; j<NUMNP; j++)
+                p[j] = z[j] + beta*p[j];
+        }
+
+        A.apply(p, q);		//q = A*p
+
+        alpha = rho / cblas_ddot(NUMNP, p, 1, q, 1);
+
+        cblas_daxpy(NUMNP, alpha, p, 1, x, 1);	//x = x + alpha * p;
+        cblas_daxpy(NUMNP, -alpha, q, 1, r, 1);	//r = r - alpha * q;
+
+        resid = cblas_dnrm2(NUMNP, r, 1) / normb;
+        NinjaTrace::addSample(input.inputsRunNumber, "residual", i, resid);
+
+        if(i==1)
+            start_resid = resid;
+
+        if((i%print_iters)==0)
+        {
+            input.Com->ninjaCom(ninjaComClass::ninjaDebug, "Iteration = %d\tResidual = %lf\ttol = %lf", i, resid, tol);
+
+            residual_percent_complete=100-100*((resid-tol)/(start_resid-tol));
+            if(residual_percent_complete<residual_percent_complete_old)
+                residual_percent_complete=residual_percent_complete_old;
+            if(residual_percent_complete<0.)
+                residual_percent_complete=0.;
+            else if(residual_percent_complete>100.)
+                residual_percent_complete=100.0;
+
+            time_percent_complete=1.8*exp(0.0401*residual_percent_complete);
+            if(time_percent_complete >= 99.0)
+                time_percent_complete = 99.0;
+            residual_percent_complete_old=residual_percent_complete;
+            input.Com->ninjaCom(ninjaComClass::ninjaSolverProgress, "%d",(int) (time_percent_complete+0.5));
+        }
+
+        rho_1 = rho;
+    }
+
+    delete[] p;
+    delete[] z;
+    delete[] q;
+    delete[] r;
+
+#ifdef _OPENMP
+    endTime = omp_get_wtime();
+#endif
+    nSolverIterations = nIterations;
+    NinjaTrace::addCounter(input.inputsRunNumber, "solver_iterations", nIterations);
+    input.Com->ninjaCom(ninjaComClass::ninjaNone, "Matrix-free CG solver with %s preconditioner: %d iterations, %lf seconds.",
+                        precondType == StiffnessOperator::Jacobi ? "Jacobi" : "Chebyshev", nIterations, endTime-startTime);
+
     if(resid>tol)
     {
         throw std::runtime_error("Solution did not converge.\nMAXITS reached.");
@@ -1185,35 +1980,8 @@ void ninja::mkl_dcsrmv(char *transa, int *m, int *k, double *alpha, char *matdes
 		//"indx" is an array describing the column index of "A" (sometimes called "col_ind")
 		//"pntrb" is a pointer containing indices of "A" of the starting locations of the rows
 		//"pntre" is a pointer containg indices of "A" of the ending locations of the rows
-		int i,j,N;
-		N=*m;
-
-    #pragma omp parallel private(i,j)
-    {
-        #pragma omp for
-        for(i=0;i<N;i++)
-            y[i]=0.0;
-
-        #pragma omp for
-        for(i=0;i<N;i++)
-        {
-            y[i] += val[pntrb[i]]*x[i];	// diagonal
-            for(j=pntrb[i]+1;j<pntre[i];j++)
-            {
-                y[i] += val[j]*x[indx[j]];
-            }
-        }
-    }	//end parallel region
-
-    for(i=0;i<N;i++)
-    {
-        for(j=pntrb[i]+1;j<pntre[i];j++)
-        {
-            {
-                y[indx[j]] += val[j]*x[i];
-            }
-        }
-    }
+		//the transpose half is also done in parallel, see symmetricCsrMatVec()
+		symmetricCsrMatVec(*m, val, indx, pntrb, pntre, x, y);
 }
 
 /**
@@ -1286,81 +2054,162 @@ void ninja::mkl_trans_dcsrmv(char *transa, int *m, int *k, double *alpha, char *
         delete[] temp;
 }
 
-/**Interpolates the 3d volume wind field to the output wind height surface.
- *
+/**Interpolates the 3d volume wind field to the output wind height surface
+ * (VelocityGrid, AngleGrid) and the extra output height surfaces
+ * (extraVelocityGrids, extraAngleGrids).
  */
 void ninja::interp_uvw()
 {
-#pragma omp parallel default(shared)
+    NinjaTraceScope trace(input.inputsRunNumber, "interpolation");
+
+    std::vector<double> heights(1, input.outputWindHeight);
+    heights.insert(heights.end(), input.extraOutputWindHeights.begin(), input.extraOutputWindHeights.end());
+
+    std::vector<AsciiGrid<double> > speedGrids, angleGrids;
+    interp_uvw(heights, speedGrids, angleGrids);
+
+    VelocityGrid = speedGrids[0];
+    AngleGrid = angleGrids[0];
+    extraVelocityGrids.assign(speedGrids.begin()+1, speedGrids.end());
+    extraAngleGrids.assign(angleGrids.begin()+1, angleGrids.end());
+}
+
+/**Interpolates the horizontal wind to speed and direction grids at several
+ * output heights above the vegetation.
+ * One walk up each column of mesh.ZORD finds the layer above every height (in
+ * ascending order of height) and the weights of the two nodes bracketing it.
+ * In the first cell the log profile (windProfile) is used, which is linear in
+ * the input speed, so it becomes a single weight on the node above.  The
+ * surfaces are then gathered row by row with those weights in contiguous loops
+ * without branches on the layer.
+ * @param heights Output heights above the vegetation (meters).
+ * @param speedGrids Set to the horizontal speed grid of each height (base units).
+ * @param angleGrids Set to the direction grid (degrees, direction the wind
+ *        comes from) of each height.
+ */
+void ninja::interp_uvw(const std::vector<double> &heights, std::vector<AsciiGrid<double> > &speedGrids,
+                       std::vector<AsciiGrid<double> > &angleGrids)
+{
+    const int nHeights = heights.size();
+    const int nrows = input.dem.get_nRows();
+    const int ncols = input.dem.get_nCols();
+    const int nLayerNodes = mesh.nrows*mesh.ncols;
+    const double *U = &u(0);
+    const double *V = &v(0);
+
+    speedGrids.resize(nHeights);
+    angleGrids.resize(nHeights);
+    for(int h=0;h<nHeights;h++)
+    {
+        speedGrids[h].set_headerData(ncols, nrows, input.dem.get_xllCorner(), input.dem.get_yllCorner(), input.dem.get_cellSize(), input.dem.get_noDataValue(), 0, input.dem.prjString);
+        angleGrids[h].set_headerData(ncols, nrows, input.dem.get_xllCorner(), input.dem.get_yllCorner(), input.dem.get_cellSize(), input.dem.get_noDataValue(), 0, input.dem.prjString);
+    }
+
+    //heights in ascending order, so one walk up a column brackets all of them
+    std::vector<int> order(nHeights);
+    for(int h=0;h<nHeights;h++)
     {
+        int m = h;
+        while(m > 0 && heights[order[m-1]] > heights[h])
+        {
+            order[m] = order[m-1];
+            m--;
+        }
+        order[m] = h;
+    }
 
-        int i,j,k;
-        double h2, h1=0.0, slopeu, slopev, slopew, uu, vv, ww, intermedval;
+#pragma omp parallel default(shared)
+    {
+        int i, j, k, h, m, n;
+        double z, t, h2, h1, a;
+        //per height and column of a row: bracketing nodes and their weights
+        int *lo = new int[nHeights*ncols];
+        int *hi = new int[nHeights*ncols];
+        double *wLo = new double[nHeights*ncols];
+        double *wHi = new double[nHeights*ncols];
+        double *uu = new double[ncols];
+        double *vv = new double[ncols];
         windProfile profile;
         profile.profile_switch = windProfile::monin_obukov_similarity;	//switch that detemines what profile is used...
 
-                                                                        //make sure rough_h is set to zero if profile switch is 0 or 2
 #pragma omp for
-        for(i=0;i<VelocityGrid.get_nRows();i++)
+        for(i=0;i<nrows;i++)
         {
-            for(j=0;j<VelocityGrid.get_nCols();j++)
+            for(j=0;j<ncols;j++)
             {
                 k=1;
                 h2=0;
-
-                while(h2 < (input.outputWindHeight + input.surface.Rough_h(i,j)))
+                h1=0.0;
+                for(m=0;m<nHeights;m++)
                 {
-                    assert( k < mesh.nlayers );
-                    h2=mesh.ZORD(i, j, k)-mesh.ZORD(i, j, 0);
-                    h1=mesh.ZORD(i, j, k-1)-mesh.ZORD(i, j, 0);
-                    k++;
+                    h = order[m];
+                    z = heights[h] + input.surface.Rough_h(i,j);
+                    while(h2 < z)
+                    {
+                        assert( k < mesh.nlayers );
+                        h2=mesh.ZORD(i, j, k)-mesh.ZORD(i, j, 0);
+                        h1=mesh.ZORD(i, j, k-1)-mesh.ZORD(i, j, 0);
+                        k++;
+                    }
+
+                    n = h*ncols + j;
+                    if(k-1 <= 1)   //if we're in the first cell, use log profile
+                    {
+                        profile.ObukovLength = init->L(i,j);
+                        profile.ABL_height = init->bl_height(i,j);
+                        profile.Roughness = input.surface.Roughness(i,j);
+                        profile.Rough_h = input.surface.Rough_h(i,j);
+                        profile.Rough_d = input.surface.Rough_d(i,j);
+                        profile.inputWindHeight = h2 - input.surface.Rough_h(i,j);
+                        profile.AGL = z;			//this is height above THE GROUND!! (not "z=0" for the log profile)
+                        profile.inputWindSpeed = 1.0;
+
+                        lo[n] = (k-1)*nLayerNodes + i*ncols + j;
+                        hi[n] = lo[n];
+                        wLo[n] = 0.0;
+                        wHi[n] = profile.getWindSpeed();
+                    }else{  //else use linear interpolation
+                        t = (z - h1)/(h2 - h1);
+                        lo[n] = (k-2)*nLayerNodes + i*ncols + j;
+                        hi[n] = (k-1)*nLayerNodes + i*ncols + j;
+                        wLo[n] = 1.0 - t;
+                        wHi[n] = t;
+                    }
                 }
-                k--;
+            }
 
-                if(k <= 1)   //if we're in the first cell, use log profile
+            for(h=0;h<nHeights;h++)
+            {
+                const int *l = &lo[h*ncols];
+                const int *r = &hi[h*ncols];
+                const double *wl = &wLo[h*ncols];
+                const double *wr = &wHi[h*ncols];
+                double *speed = &speedGrids[h](i,0);
+                double *angle = &angleGrids[h](i,0);
+
+                for(j=0;j<ncols;j++)
                 {
-                    profile.ObukovLength = init->L(i,j);
-                    profile.ABL_height = init->bl_height(i,j);
-                    profile.Roughness = input.surface.Roughness(i,j);
-                    profile.Rough_h = input.surface.Rough_h(i,j);
-                    profile.Rough_d = input.surface.Rough_d(i,j);
-                    profile.inputWindHeight = h2 - input.surface.Rough_h(i,j);
-
-                    profile.AGL=input.outputWindHeight + input.surface.Rough_h(i,j);			//this is height above THE GROUND!! (not "z=0" for the log profile)
-
-                    profile.inputWindSpeed = u(i, j, k);
-                    uu = profile.getWindSpeed();
-
-                    profile.inputWindSpeed = v(i, j, k);
-                    vv = profile.getWindSpeed();
-
-                    profile.inputWindSpeed = w(i, j, k);
-                    ww = profile.getWindSpeed();
-
-                    VelocityGrid(i,j)=std::pow((uu*uu+vv*vv),0.5);       //calculate velocity magnitude (in x,y plane; I decided to NOT include z here so the wind is the horizontal wind)
-
-                }else{  //else use linear interpolation
-                    slopeu=(u(i, j, k)-u(i, j, k-1))/(h2-h1);
-                    slopev=(v(i, j, k)-v(i, j, k-1))/(h2-h1);
-                    slopew=(w(i, j, k)-w(i, j, k-1))/(h2-h1);
-                    uu=slopeu*(input.outputWindHeight + input.surface.Rough_h(i,j))+u(i, j, k-1)-slopeu*h1;
-                    vv=slopev*(input.outputWindHeight + input.surface.Rough_h(i,j))+v(i, j, k-1)-slopev*h1;
-                    ww=slopew*(input.outputWindHeight + input.surface.Rough_h(i,j))+w(i, j, k-1)-slopew*h1;
-                    VelocityGrid(i,j)=std::pow((uu*uu+vv*vv),0.5);       //calculate velocity magnitude (in x,y plane; I decided to NOT include z here so the wind is the horizontal wind)
+                    uu[j] = wl[j]*U[l[j]] + wr[j]*U[r[j]];
+                    vv[j] = wl[j]*V[l[j]] + wr[j]*V[r[j]];
+                    speed[j] = std::sqrt(uu[j]*uu[j] + vv[j]*vv[j]);   //horizontal wind only, w is not included
+                }
+                for(j=0;j<ncols;j++)
+                {
+                    a = (uu[j]==0.0 && vv[j]==0.0) ? 0.0 : -atan2(uu[j], -vv[j]);
+                    angle[j] = 180.0/pi*(a < 0.0 ? a + 2.0*pi : a);
                 }
-
-                if (uu==0.0 && vv==0.0)
-                    intermedval=0.0;
-                else
-                    intermedval=-atan2(uu, -vv);
-                if(intermedval<0)
-                    intermedval+=2.0*pi;
-                AngleGrid(i,j)=(180.0/pi*intermedval);
-
             }
         }
+
+        delete[] lo;
+        delete[] hi;
+        delete[] wLo;
+        delete[] wHi;
+        delete[] uu;
+        delete[] vv;
     }	//end parallel region
 }
+
 /**Writes an output file comparing the current simulation to an input file containing points of measured wind speeds and directions.
  *
  */
@@ -1443,46 +2292,26 @@ bool ninja::checkForNullRun()
 	{
 		if(v0(i) != 0.0)
 			isNullRun = false;
-	}
-	for(i=0;i<mesh.NUMNP;i++)
-	{
-		if(w0(i) != 0.0)
-			isNullRun = false;
-	}
-
-	return isNullRun;
-}
-
-/**Function to build discretized equations.
- *
- */
-void ninja::discretize()
-{
-    //The governing equation to solve is
-    //
-    //    d        dPhi      d        dPhi      d        dPhi
-    //   ---- ( Rx ---- ) + ---- ( Ry ---- ) + ---- ( Rz ---- ) + H = 0.0
-    //    dx        dx       dy        dy       dz        dz
-    //
-    //        where
-    //
-    //                    1                          1
-    //    Rx = Ry =  ------------          Rz = ------------
-    //                2*alphaH^2                 2*alphaV^2
-    //
-    //         du0     dv0     dz0
-    //    H = ----- + ----- + -----
-    //         dx      dy      dz
-
+	}
+	for(i=0;i<mesh.NUMNP;i++)
+	{
+		if(w0(i) != 0.0)
+			isNullRun = false;
+	}
 
-	//Set array values to zero----------------------------
-	if(PHI == NULL)
-		PHI=new double[mesh.NUMNP];
+	return isNullRun;
+}
 
+/**Allocates SK, col_ind and row_ptr and sets up the Compressed Row Storage
+ * (CRS) sparsity pattern of the upper triangle of the stiffness matrix.
+ * SK is zeroed.
+ */
+void ninja::buildSparsityPattern()
+{
      int interrows=input.dem.get_nRows()-2;
      int intercols=input.dem.get_nCols()-2;
      int interlayers=mesh.nlayers-2;
-	 int i, ii, j, jj, k, kk, l;
+	 int i, ii, j, jj, k, kk;
                          //NZND is the # of nonzero elements in the SK stiffness array that are stored
      int NZND=(8*8)+(intercols*4+interrows*4+interlayers*4)*12+(intercols*interlayers*2+interrows*interlayers*2+intercols*interrows*2)*18+(intercols*interrows*interlayers)*27;
 
@@ -1493,18 +2322,13 @@ void ninja::discretize()
 
 	 col_ind=new int[NZND];      //This holds the global column number of the corresponding element in the CRS storage
 	 row_ptr=new int[mesh.NUMNP+1];     //This holds the element number in the SK array (CRS) of the first non-zero entry for the global row (the "+1" is so we can use the last entry to quit loops; ie. so we know how many non-zero elements are in the last node)
-	 RHS=new double[mesh.NUMNP];       //This is the final right hand side (RHS) matrix
 
      int type;                     //This is the type of node (corner, edge, side, internal)
      int temp,temp1;
 
      #pragma omp parallel for default(shared) private(i)
 	 for(i=0;i<mesh.NUMNP;i++)
-     {
-          PHI[i]=0.;
-          RHS[i]=0.;
           row_ptr[i]=0;
-     }
 
 	 #pragma omp parallel for default(shared) private(i)
      for(i=0;i<NZND;i++)
@@ -1641,6 +2465,100 @@ void ninja::discretize()
      }
      row_ptr[mesh.NUMNP]=temp;     //Set last value of row_ptr, so we can use "row_ptr+1" to use to index to in loops
 
+     buildScatterMap();
+}
+
+/**Builds the element scatter map used to place element stiffness matrices into SK.
+ * For each element the position in SK (and col_ind) of the 36 upper triangle
+ * entries of its 8x8 element matrix is stored, in the order (j,k) for j=0..7 and
+ * k=j..7 over the local node numbers.  This replaces searching col_ind for every
+ * entry during assembly.  Must be called after the CRS pattern is set up.
+ */
+void ninja::buildScatterMap()
+{
+    if(elemScatter)
+        delete[] elemScatter;
+    elemScatter = new int[mesh.NUMEL*36];
+
+    int i;
+#pragma omp parallel for default(shared) private(i)
+    for(i=0;i<mesh.NUMEL;i++)
+    {
+        int nodes[8];
+        int j, k, l, row, col;
+        int pos=i*36;
+
+        for(j=0;j<mesh.NNPE;j++)
+            nodes[j]=mesh.get_global_node(j, i);
+
+        for(j=0;j<mesh.NNPE;j++)
+        {
+            for(k=j;k<mesh.NNPE;k++)
+            {
+                row=std::min(nodes[j], nodes[k]);   //only the upper triangle is stored
+                col=std::max(nodes[j], nodes[k]);
+                l=row_ptr[row];
+                while(col_ind[l]!=col)
+                    l++;
+                elemScatter[pos++]=l;
+            }
+        }
+    }
+}
+
+/**Function to build discretized equations.
+ *
+ */
+void ninja::discretize()
+{
+    NinjaTraceScope trace(input.inputsRunNumber, "assembly");
+
+    //The governing equation to solve is
+    //
+    //    d        dPhi      d        dPhi      d        dPhi
+    //   ---- ( Rx ---- ) + ---- ( Ry ---- ) + ---- ( Rz ---- ) + H = 0.0
+    //    dx        dx       dy        dy       dz        dz
+    //
+    //        where
+    //
+    //                    1                          1
+    //    Rx = Ry =  ------------          Rz = ------------
+    //                2*alphaH^2                 2*alphaV^2
+    //
+    //         du0     dv0     dz0
+    //    H = ----- + ----- + -----
+    //         dx      dy      dz
+
+
+	//Set array values to zero----------------------------
+	if(PHI == NULL)
+		PHI=new double[mesh.NUMNP];
+
+	 RHS=new double[mesh.NUMNP];       //This is the final right hand side (RHS) matrix
+
+	 int i, j, k, l;
+
+     #pragma omp parallel for default(shared) private(i)
+	 for(i=0;i<mesh.NUMNP;i++)
+     {
+          PHI[i]=0.;
+          RHS[i]=0.;
+     }
+
+	 //With a shared domain context the stiffness matrix (boundary conditions already
+	 //applied) comes from the context and only the RHS is assembled here.  The
+	 //matrix-free solver never needs the matrix.  Neither do the matching iterations
+	 //after the first one, they keep SK from the first one (see simulate_wind()).
+	 bool assembleMatrix = (domain == NULL && !matrixFree && !matrixAssembled);
+	 if(assembleMatrix)
+	 {
+		 buildSparsityPattern();
+	 }else if(domain){
+		 SK=domain->SK;
+		 col_ind=domain->col_ind;
+		 row_ptr=domain->row_ptr;
+	 }
+
 	 checkCancel();
 
     #ifdef STABILITY
@@ -1753,129 +2671,140 @@ void ninja::discretize()
     #endif // STABILITY
 
 
+	const ElementGeometry &geom = get_geometry();
+
+	//u0, v0, w0 packed node by node for the gather in H
+	double *UVW0 = new double[3*mesh.NUMNP];
+	wn_3dScalarField::packInterleaved(u0, v0, w0, UVW0);
+
 #pragma omp parallel default(shared) private(i,j,k,l)
 	 {
 		 element elem(&mesh);
 		 int pos;
+		 double DVW, XJ, YJ, ZJ;
+		 int color, c, ci, cj, ck, nci, ncj, nck, nColorElems;
+		 int ei, ej, ek;
+		 int strides[8];
+		 mesh.get_nodeStrides(strides);     //global node number of local node k is node0+strides[k]
 
 		 #ifdef STABILITY
 		 int ii, jj, kk;
          double alphaV; //alpha vertical from governing equation, weighting for change in vertical winds
 		 #endif
 
-#pragma omp for
-		 for(i=0;i<mesh.NUMEL;i++)                    //Start loop over elements
+		 //Elements are split into 8 colours by the parity of their (i,j,k) index.  Elements
+		 //of one colour share no nodes, so they can be scattered into SK and RHS without atomics.
+		 for(color=0;color<8;color++)
 		 {
-			 /*-----------------------------------------------------*/
-			 /*      NO SURFACE QUADRATURE NEEDED SINCE NONE OF     */
-			 /*      THE BOUNDARY CONDITIONS HAVE A NON-ZERO FLUX   */
-			 /*      SPECIFICATION:                                 */
-			 /*      Flow through =>  Phi = 0                       */
-			 /*      Ground       =>  normal flux = 0               */
-			 /*-----------------------------------------------------*/
-
+			 ci=color%2;
+			 cj=(color/2)%2;
+			 ck=color/4;
+			 nci=(mesh.nrowsElem-ci+1)/2;
+			 ncj=(mesh.ncolsElem-cj+1)/2;
+			 nck=(mesh.nlayersElem-ck+1)/2;
+			 nColorElems=nci*ncj*nck;
 
+#pragma omp for
+			 for(c=0;c<nColorElems;c++)                    //Start loop over elements of this colour
+			 {
+				 ei=2*((c/ncj)%nci)+ci;
+				 ej=2*(c%ncj)+cj;
+				 ek=2*(c/(ncj*nci))+ck;
+				 i=mesh.get_elemNum(ei, ej, ek);
 
-			 //elem.computeElementStiffnessMatrix(i, u0, v0, w0, alpha);
+				 /*-----------------------------------------------------*/
+				 /*      NO SURFACE QUADRATURE NEEDED SINCE NONE OF     */
+				 /*      THE BOUNDARY CONDITIONS HAVE A NON-ZERO FLUX   */
+				 /*      SPECIFICATION:                                 */
+				 /*      Flow through =>  Phi = 0                       */
+				 /*      Ground       =>  normal flux = 0               */
+				 /*-----------------------------------------------------*/
 
 
 
+				 //elem.computeElementStiffnessMatrix(i, u0, v0, w0, alpha);
 
 
 
 
-			 //Given the above parameters, function computes the element stiffness matrix
 
-			 if(elem.SFV == NULL)
-				 elem.initializeQuadPtArrays();
 
-			 for(j=0;j<mesh.NNPE;j++)
-			 {
-				 elem.QE[j]=0.0;
-				 for(int k=0;k<mesh.NNPE;k++)
-					 elem.S[j*mesh.NNPE+k]=0.0;
 
-			 }
-			 //Begin quadrature for current element
+				 //Given the above parameters, function computes the element stiffness matrix
 
-			 elem.node0=mesh.get_node0(i);  //get the global nodal number of local node 0 of element i
+				 if(elem.SFV == NULL)
+					 elem.initializeQuadPtArrays();
 
+				 for(j=0;j<mesh.NNPE;j++)
+				 {
+					 elem.QE[j]=0.0;
+					 for(int k=0;k<mesh.NNPE;k++)
+						 elem.S[j*mesh.NNPE+k]=0.0;
 
-			 for(j=0;j<elem.NUMQPTV;j++)             //Start loop over quadrature points in the element
-			 {
+				 }
+				 //Begin quadrature for current element
 
-				 elem.computeJacobianQuadraturePoint(j, i);
+				 elem.node0=mesh.get_node0(ei, ej, ek);  //get the global nodal number of local node 0 of element i
 
-				 //Calculate the coefficient H here and the alpha-squared term in front of the second partial of z in governing equation (we are still on element i, quadrature point j)
-				 //
-				 //           d u0   d v0   d w0
-				 //     H = ( ---- + ---- + ---- )
-				 //           d x    d y    d z
-				 //
-				 //                and
-                 //
-                 //                     1                          1
-                 //     Rx = Ry =  ------------          Rz = ------------
-                 //                 2*alphaH^2                 2*alphaV^2
 
+				 for(j=0;j<elem.NUMQPTV;j++)             //Start loop over quadrature points in the element
+				 {
 
-				 elem.HVJ=0.0;
+					 geom.get(i, j, elem.DNDX, elem.DNDY, elem.DNDZ, DVW, XJ, YJ, ZJ);
 
-				 double alphaV = 1;
+					 //Calculate the coefficient H here and the alpha-squared term in front of the second partial of z in governing equation (we are still on element i, quadrature point j)
+					 //
+					 //           d u0   d v0   d w0
+					 //     H = ( ---- + ---- + ---- )
+					 //           d x    d y    d z
+					 //
+					 //                and
+	                 //
+	                 //                     1                          1
+	                 //     Rx = Ry =  ------------          Rz = ------------
+	                 //                 2*alphaH^2                 2*alphaV^2
 
-				 #ifdef STABILITY
-				 alphaV = 0;
-				 #endif
 
-				 for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
-				 {
-					 elem.NPK=mesh.get_global_node(k, i);            //NPK is the global nodal number
+					 elem.HVJ=0.0;
 
-					 elem.HVJ=elem.HVJ+((elem.DNDX[k]*u0(elem.NPK))+(elem.DNDY[k]*v0(elem.NPK))+(elem.DNDZ[k]*w0(elem.NPK)));
+					 double alphaV = 1;
 
 					 #ifdef STABILITY
-					 alphaV=alphaV+elem.SFV[0*mesh.NNPE*elem.NUMQPTV+k*elem.NUMQPTV+j]*alphaVfield(elem.NPK);
-					 //cout<<"alphaV = "<<alphaV<<endl;
-                                         #endif
-				 }                             //End loop over nodes in the element
-				 //elem.HVJ=2*elem.HVJ;                    //This is the H for quad point j (the 2* comes from governing equation)
+					 alphaV = 0;
+					 #endif
 
-				 //elem.RZ=alpha*alpha;               //This is the RZ from the governing equation
+					 for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
+					 {
+						 elem.NPK=elem.node0+strides[k];            //NPK is the global nodal number
 
-				 elem.RX = 1.0/(2.0*alphaH*alphaH);
-				 elem.RY = 1.0/(2.0*alphaH*alphaH);
-				 elem.RZ = 1.0/(2.0*alphaV*alphaV);
-				 elem.DV=elem.DETJ;                      //DV is the DV for the volume integration (could be eliminated and just use DETJ everywhere)
+						 elem.HVJ=elem.HVJ+((elem.DNDX[k]*UVW0[3*elem.NPK])+(elem.DNDY[k]*UVW0[3*elem.NPK+1])+(elem.DNDZ[k]*UVW0[3*elem.NPK+2]));
 
-				 if(elem.NUMQPTV==27)
-				 {
-					 if(j<=7)
-					 {
-						 elem.WT=elem.WT1;
-					 }else if(j<=19)
-					 {
-						 elem.WT=elem.WT2;
-					 }else if(j<=25)
-					 {
-						 elem.WT=elem.WT3;
-					 }else
-					 {
-						 elem.WT=elem.WT4;
-					 }
-				 }
+						 #ifdef STABILITY
+						 alphaV=alphaV+elem.SFV[0*mesh.NNPE*elem.NUMQPTV+k*elem.NUMQPTV+j]*alphaVfield(elem.NPK);
+						 //cout<<"alphaV = "<<alphaV<<endl;
+	                                         #endif
+					 }                             //End loop over nodes in the element
+					 //elem.HVJ=2*elem.HVJ;                    //This is the H for quad point j (the 2* comes from governing equation)
 
-				 //Create element stiffness matrix---------------------------------------------
-				 for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
-				 {
-					 elem.QE[k]=elem.QE[k]+elem.WT*elem.SFV[0*mesh.NNPE*elem.NUMQPTV+k*elem.NUMQPTV+j]*elem.HVJ*elem.DV;
-					 for(l=0;l<mesh.NNPE;l++)
-					 {
-                                             elem.S[k*mesh.NNPE+l]=elem.S[k*mesh.NNPE+l]+elem.WT*(elem.DNDX[k]*elem.RX*elem.DNDX[l] + elem.DNDY[k]*elem.RY*elem.DNDY[l] + elem.DNDZ[k]*elem.RZ*elem.DNDZ[l])*elem.DV;
-					 }
-				 }                            //End loop over nodes in the element
-			 }                                  //End loop over quadrature points in the element
+					 //elem.RZ=alpha*alpha;               //This is the RZ from the governing equation
 
+					 elem.RX = 1.0/(2.0*alphaH*alphaH);
+					 elem.RY = 1.0/(2.0*alphaH*alphaH);
+					 elem.RZ = 1.0/(2.0*alphaV*alphaV);
+					 //DVW is the DV for the volume integration times the quadrature weight
 
+					 //Create element stiffness matrix---------------------------------------------
+					 for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
+					 {
+						 elem.QE[k]=elem.QE[k]+elem.SFV[0*mesh.NNPE*elem.NUMQPTV+k*elem.NUMQPTV+j]*elem.HVJ*DVW;
+						 if(!assembleMatrix)
+							 continue;
+						 for(l=0;l<mesh.NNPE;l++)
+						 {
+	                                             elem.S[k*mesh.NNPE+l]=elem.S[k*mesh.NNPE+l]+(elem.DNDX[k]*elem.RX*elem.DNDX[l] + elem.DNDY[k]*elem.RY*elem.DNDY[l] + elem.DNDZ[k]*elem.RZ*elem.DNDZ[l])*DVW;
+						 }
+					 }                            //End loop over nodes in the element
+				 }                                  //End loop over quadrature points in the element
 
 
 
@@ -1893,39 +2822,32 @@ void ninja::discretize()
 
 
 
-			 //Place completed element matrix in global SK and Q matrices
 
-			 for(j=0;j<mesh.NNPE;j++)                          //Start loop over nodes in the element (also, it is the row # in S[])
-			 {
-				 elem.NPK=mesh.get_global_node(j, i);            //elem.NPK is the global row number of the element stiffness matrix
 
-#pragma omp atomic
-				 RHS[elem.NPK] += elem.QE[j];
+				 //Place completed element matrix in global SK and Q matrices
+				 //(no atomics needed, elements of the current colour share no nodes)
 
-				 for(k=0;k<mesh.NNPE;k++)           //k is the local column number in S[]
+				 for(j=0;j<mesh.NNPE;j++)                          //Start loop over nodes in the element
 				 {
-					 elem.KNP=mesh.get_global_node(k, i);
+					 elem.NPK=elem.node0+strides[j];            //elem.NPK is the global row number of the element stiffness matrix
+					 RHS[elem.NPK] += elem.QE[j];
+				 }                             //End loop over nodes in the element
 
-					 if(elem.KNP >= elem.NPK)	//do only if we're on the upper triangular region of SK[]
-					 {
-						 pos=-1;                  //pos is the position # in SK[] to place S[j*mesh.NNPE+k]
-						 l=0;                     //l increments through col_ind[] starting from where row_ptr[] says until we find the column number we're looking for
-						 do
-						 {
-							 if(col_ind[row_ptr[elem.NPK]+l]==elem.KNP)   //Check if we're at the correct position
-								 pos=row_ptr[elem.NPK]+l;           //If so, save that position in pos
-							 l++;
-						 }while(pos<0);
-
-#pragma omp atomic
-						 SK[pos] += elem.S[j*mesh.NNPE+k];     //Here is the final global stiffness matrix in symmetric storage
-					 }
-				 }
+				 if(!assembleMatrix)
+					 continue;
 
-			 }                             //End loop over nodes in the element
-		 }                                  //End loop over elements
+				 pos=i*36;                     //elemScatter[] holds the SK[] position of each (j,k>=j) pair of local nodes
+				 for(j=0;j<mesh.NNPE;j++)
+				 {
+					 for(k=j;k<mesh.NNPE;k++)
+						 SK[elemScatter[pos++]] += elem.S[j*mesh.NNPE+k];     //S[] is symmetric, so S[j][k] is also the (k,j) entry
+				 }
+			 }                                  //End loop over elements of this colour
+		 }                                  //End loop over colours
 	 }		//End parallel region
 
+	 delete[] UVW0;
+
      #ifdef STABILITY
      stb.alphaField.deallocate();
      #endif
@@ -1936,6 +2858,8 @@ void ninja::discretize()
  */
 void ninja::setBoundaryConditions()
 {
+     NinjaTraceScope trace(input.inputsRunNumber, "boundary_conditions");
+
      //Specify known values of PHI
      //This is done by replacing the particular node equation (row) with all zeros except a "1" on the diagonal of SK[].
      //Then the corresponding row in RHS[] is replaced with the value of the known PHI.
@@ -1945,6 +2869,26 @@ void ninja::setBoundaryConditions()
 	 int NPK, KNP;
 	 int i, j, k, l;
 
+	 if(domain || matrixFree || matrixAssembled)
+	 {
+		 //SK from the shared domain context or from an earlier matching iteration already
+		 //has the boundary conditions applied (and the matrix-free operator applies them
+		 //itself), only the known values of PHI need to be set in RHS
+		 #pragma omp parallel for default(shared) private(i,j,k)
+		 for(k=0;k<mesh.nlayers;k++)
+		 {
+			 for(i=0;i<input.dem.get_nRows();i++)
+			 {
+				 for(j=0;j<input.dem.get_nCols();j++)
+				 {
+					 if(j==0||j==(input.dem.get_nCols()-1)||i==0||i==(input.dem.get_nRows()-1)||k==(mesh.nlayers-1))
+						 RHS[k*input.dem.get_nCols()*input.dem.get_nRows()+i*input.dem.get_nCols()+j]=0.;    //Phi is zero on "flow through boundaries"
+				 }
+			 }
+		 }
+		 return;
+	 }
+
 
 	  bool *isBoundaryNode;
 	  isBoundaryNode=new bool[mesh.NUMNP];       //flag to specify if it's a boundary node
@@ -1997,6 +2941,7 @@ void ninja::setBoundaryConditions()
 		delete[] isBoundaryNode;
 		isBoundaryNode=NULL;
 	  }
+	  matrixAssembled = true;
 
 }
 
@@ -2022,6 +2967,7 @@ void ninja::setBoundaryConditions()
  */
 void ninja::computeUVWField()
 {
+     NinjaTraceScope trace(input.inputsRunNumber, "wind_field");
 
      /*-----------------------------------------------------*/
      /*      Calculate u,v, and w from derivatives of PHI   */
@@ -2048,158 +2994,31 @@ void ninja::computeUVWField()
      /*     of the surrounding cells.                       */
      /*-----------------------------------------------------*/
 
-	 int i, j, k;
+	 int i;
 
 	 u.allocate(&mesh);           //u is positive toward East
 	 v.allocate(&mesh);           //v is positive toward North
 	 w.allocate(&mesh);           //w is positive up
-	 if(DIAG == NULL)
-		 DIAG=new double[mesh.nlayers*input.dem.get_nRows()*input.dem.get_nCols()];        //DIAG is the sum of the weights at each nodal point; eventually, dPHI/dx, etc. are divided by this value to get the "smoothed" (or averaged) value of dPHI/dx at each node point
-
-	 for(i=0;i<mesh.NUMNP;i++)                         //Initialize u,v, and w
-     {
-          u(i)=0.;
-          v(i)=0.;
-          w(i)=0.;
-	    DIAG[i]=0.;
-     }
-
-	#pragma omp parallel default(shared) private(i,j,k)
-	{
-
-	 element elem(&mesh);
-
-     double DPHIDX, DPHIDY, DPHIDZ;
-	 double XJ, YJ, ZJ;
-     double wght, XK, YK, ZK;
-	 double *uScratch, *vScratch, *wScratch, *DIAGScratch;
-	 uScratch=NULL;
-	 vScratch=NULL;
-	 wScratch=NULL;
-	 DIAGScratch=NULL;
-
-	 uScratch=new double[mesh.nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-	 vScratch=new double[mesh.nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-	 wScratch=new double[mesh.nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-	 DIAGScratch=new double[mesh.nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-
-     for(i=0;i<mesh.NUMNP;i++)                         //Initialize scratch u,v, and w
-     {
-          uScratch[i]=0.;
-          vScratch[i]=0.;
-          wScratch[i]=0.;
-	      DIAGScratch[i]=0.;
-     }
 
-	 #pragma omp for
-     for(i=0;i<mesh.NUMEL;i++)                  //Start loop over elements
-     {
-          elem.node0 = mesh.get_node0(i);  //get the global node number of local node 0 of element i
-          for(j=0;j<elem.NUMQPTV;j++)             //Start loop over quadrature points in the element
-          {
-
-			   DPHIDX=0.0;     //Set DPHI/DX, etc. to zero for the new quad point
-               DPHIDY=0.0;
-               DPHIDZ=0.0;
-
-			   elem.computeJacobianQuadraturePoint(j, i, XJ, YJ, ZJ);
-
-               //Calculate dN/dx, dN/dy, dN/dz (Remember we're using the transpose of the inverse!)
-               for(k=0;k<mesh.NNPE;k++)
-               {
-                    elem.NPK=mesh.get_global_node(k, i);            //NPK is the global node number
-
-                    DPHIDX=DPHIDX+elem.DNDX[k]*PHI[elem.NPK];       //Calculate the DPHI/DX, etc. for the quad point we are on
-                    DPHIDY=DPHIDY+elem.DNDY[k]*PHI[elem.NPK];
-                    DPHIDZ=DPHIDZ+elem.DNDZ[k]*PHI[elem.NPK];
-               }
-
-               //Now we know DPHI/DX, etc. for quad point j.  We will distribute this inverse distance weighted average to each nodal point for the cell we're on
-               for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
-               {                            //Calculate the Jacobian at the quad point
-                    elem.NPK=mesh.get_global_node(k, i);            //NPK is the global nodal number
-
-                    XK=mesh.XORD(elem.NPK);            //Coodinates of the nodal point
-                    YK=mesh.YORD(elem.NPK);
-                    ZK=mesh.ZORD(elem.NPK);
-
-                    wght=std::pow((XK-XJ),2)+std::pow((YK-YJ),2)+std::pow((ZK-ZJ),2);
-                    wght=1.0/(std::sqrt(wght));
-//c				    #pragma omp critical
-				    {
-                    uScratch[elem.NPK]=uScratch[elem.NPK]+wght*DPHIDX;   //Here we store the summing values of DPHI/DX, etc. in the u,v,w arrays for later use (to actually calculate u,v,w)
-                    vScratch[elem.NPK]=vScratch[elem.NPK]+wght*DPHIDY;
-                    wScratch[elem.NPK]=wScratch[elem.NPK]+wght*DPHIDZ;
-                    DIAGScratch[elem.NPK]=DIAGScratch[elem.NPK]+wght;     //Store the sum of the weights for the node
-					}
-
-               }                             //End loop over nodes in the element
-
-
-          }                                  //End loop over quadrature points in the element
-     }                                       //End loop over elements
-
-	 #pragma omp critical
-	 {
-     for(i=0;i<mesh.NUMNP;i++)
-     {
-          u(i) += uScratch[i];      //Dividing by the DIAG[NPK] gives the value of DPHI/DX, etc. (still stored in the u,v,w arrays)
-          v(i) += vScratch[i];
-          w(i) += wScratch[i];
-		  DIAG[i] += DIAGScratch[i];
-	 }
-	 } //end critical
-
-	 if(uScratch)
-	 {
-		delete[] uScratch;
-		uScratch=NULL;
-	 }
-	 if(vScratch)
-	 {
-		delete[] vScratch;
-		vScratch=NULL;
-	 }
-	 if(wScratch)
-	 {
-		delete[] wScratch;
-		wScratch=NULL;
-	 }
-	 if(DIAGScratch)
-	 {
-		delete[] DIAGScratch;
-		DIAGScratch=NULL;
-	 }
-
-     #pragma omp barrier
+	 //dPHI/dx, etc. are stored in u, v, w, then turned into the velocities in place
+	 get_geometry().smoothGradient(PHI, &u(0), &v(0), &w(0));
 
      double alphaV = 1.0;
+     double RH = 1.0/(2.0*alphaH*alphaH);
 
-     #ifdef STABILITY
-     alphaV = 1.0; //should be 1 unless stability parameters are set
-     #endif
-
-     #pragma omp for
-
+     #pragma omp parallel for default(shared) private(i) firstprivate(alphaV)
      for(i=0;i<mesh.NUMNP;i++)
      {
-          u(i)=u(i)/DIAG[i];      //Dividing by the DIAG[NPK] gives the value of DPHI/DX, etc. (still stored in the u,v,w arrays)
-          v(i)=v(i)/DIAG[i];
-          w(i)=w(i)/DIAG[i];
-
           //Finally, calculate u,v,w
 
           #ifdef STABILITY
           alphaV = alphaVfield(i); //set alphaV for stability
 		  #endif
 
-		  u(i)=u0(i)+1.0/(2.0*alphaH*alphaH)*u(i);         //Remember, dPHI/dx is stored in u
-		  v(i)=v0(i)+1.0/(2.0*alphaH*alphaH)*v(i);
+		  u(i)=u0(i)+RH*u(i);         //Remember, dPHI/dx is stored in u
+		  v(i)=v0(i)+RH*v(i);
 		  w(i)=w0(i)+1.0/(2.0*alphaV*alphaV)*w(i);
-
-
      }
-     }		//end parallel section
 
      #ifdef STABILITY
      alphaVfield.deallocate();
@@ -2236,6 +3055,11 @@ void ninja::prepareOutput()
 	
 	if(!isNullRun)
 		interp_uvw();
+	else
+	{
+		extraVelocityGrids.clear();
+		extraAngleGrids.clear();
+	}
  
         if(input.initializationMethod == WindNinjaInputs::foamDomainAverageInitializationFlag){
             //Set cloud grid
@@ -2256,6 +3080,11 @@ void ninja::prepareOutput()
 	//Clip off bounding doughnut if desired
 	VelocityGrid.clipGridInPlaceSnapToCells(input.outputBufferClipping);
 	AngleGrid.clipGridInPlaceSnapToCells(input.outputBufferClipping);
+	for(unsigned int h=0;h<extraVelocityGrids.size();h++)
+	{
+		extraVelocityGrids[h].clipGridInPlaceSnapToCells(input.outputBufferClipping);
+		extraAngleGrids[h].clipGridInPlaceSnapToCells(input.outputBufferClipping);
+	}
 
 	//Clip cloud cover grid if it's a wxModel intitialization (since it's gridded)
 	//	if not wxModel initialization, don't clip since it's just one cell anyway
@@ -2265,6 +3094,8 @@ void ninja::prepareOutput()
 	}
 	//change windspeed units back to what is specified by speed units switch
 	velocityUnits::fromBaseUnits(VelocityGrid, input.outputSpeedUnits);
+	for(unsigned int h=0;h<extraVelocityGrids.size();h++)
+		velocityUnits::fromBaseUnits(extraVelocityGrids[h], input.outputSpeedUnits);
 
 	/*
 	 * Interpolate u, v, w to specific locations if an input_points_file is provided
@@ -2689,7 +3520,7 @@ void ninja::computeFrictionVelocity()
     UstarGrid = 0;
 
     //fv.ComputeUstar(input, UstarGrid, u, v, w, mesh, "shearStress"); // options are "logProfile" and "shearStress"
-    fv.ComputeUstar(input, UstarGrid, u, v, w, mesh, input.frictionVelocityCalculationMethod);
+    fv.ComputeUstar(input, UstarGrid, u, v, w, mesh, input.frictionVelocityCalculationMethod, &get_geometry());
     //UstarGrid.write_Grid("ustar", 2);
 
 }
@@ -2729,13 +3560,16 @@ void ninja::computeDustEmissions()
 
 void ninja::writeOutputFiles()
 {
+    NinjaTraceScope trace(input.inputsRunNumber, "write_output");
     set_outputFilenames(mesh.meshResolution, mesh.meshResolutionUnits);
 
 	//Write volume data to VTK format (always in m/s?)
 	if(input.volVTKOutFlag)
 	{
 		try{
+			NinjaTraceScope trace(input.inputsRunNumber, "write_vtk");
 			volVTK VTK(u, v, w, mesh.XORD, mesh.YORD, mesh.ZORD, input.dem.get_nCols(), input.dem.get_nRows(), mesh.nlayers, input.volVTKFile);
+			NinjaTrace::addFileBytes(input.inputsRunNumber, input.volVTKFile);
 		}catch (exception& e)
 		{
 			input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Exception caught during volume VTK file writing: %s", e.what());
@@ -2759,6 +3593,7 @@ void ninja::writeOutputFiles()
 	try{
 		if(input.asciiOutFlag==true)
 		{
+			NinjaTraceScope trace(input.inputsRunNumber, "write_ascii");
 			AsciiGrid<double> *velTempGrid, *angTempGrid;
 			velTempGrid=NULL;
 			angTempGrid=NULL;
@@ -2777,6 +3612,9 @@ void ninja::writeOutputFiles()
 			tempCloud.write_Grid(input.cldFile.c_str(), 1);
 			angTempGrid->write_Grid(input.angFile.c_str(), 0);
 			velTempGrid->write_Grid(input.velFile.c_str(), 2);
+			NinjaTrace::addFileBytes(input.inputsRunNumber, input.cldFile);
+			NinjaTrace::addFileBytes(input.inputsRunNumber, input.angFile);
+			NinjaTrace::addFileBytes(input.inputsRunNumber, input.velFile);
 
 			#ifdef FRICTION_VELOCITY
 			if(input.frictionVelocityFlag == 1){
@@ -2786,6 +3624,7 @@ void ninja::writeOutputFiles()
                 ustarTempGrid = new AsciiGrid<double> (UstarGrid.resample_Grid(input.velResolution, AsciiGrid<double>::order0));
 
                 ustarTempGrid->write_Grid(input.ustarFile.c_str(), 2);
+                NinjaTrace::addFileBytes(input.inputsRunNumber, input.ustarFile);
 
                 if(ustarTempGrid)
                 {
@@ -2803,6 +3642,7 @@ void ninja::writeOutputFiles()
                 dustTempGrid = new AsciiGrid<double> (DustGrid.resample_Grid(input.velResolution, AsciiGrid<double>::order0));
 
                 dustTempGrid->write_Grid(input.dustFile.c_str(), 2);
+                NinjaTrace::addFileBytes(input.inputsRunNumber, input.dustFile);
 
                 if(dustTempGrid)
                 {
@@ -2829,6 +3669,7 @@ void ninja::writeOutputFiles()
 			    farsiteAtm atmosphere;
 			    atmosphere.push(input.ninjaTime, input.velFile, input.angFile, input.cldFile);
 			    atmosphere.writeAtmFile(input.atmFile, input.outputSpeedUnits, input.outputWindHeight);
+			    NinjaTrace::addFileBytes(input.inputsRunNumber, input.atmFile);
 			}
 		}
 	}catch (exception& e)
@@ -2847,7 +3688,10 @@ void ninja::writeOutputFiles()
 	{
 	try{
 		if(input.txtOutFlag==true)
+		{
+			NinjaTraceScope trace(input.inputsRunNumber, "write_text");
 			write_compare_output();
+		}
 	}catch (exception& e)
 	{
 		input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Exception caught during text file writing: %s", e.what());
@@ -2863,6 +3707,7 @@ void ninja::writeOutputFiles()
 	try{
 		if(input.shpOutFlag==true)
 		{
+			NinjaTraceScope trace(input.inputsRunNumber, "write_shapefile");
 			AsciiGrid<double> *velTempGrid, *angTempGrid, *ustarTempGrid;
 			velTempGrid=NULL;
 			angTempGrid=NULL;
@@ -2878,6 +3723,9 @@ void ninja::writeOutputFiles()
 			ninjaShapeFiles.setDataBaseName(input.dbfFile);
 			ninjaShapeFiles.setShapeFileName(input.shpFile);
 			ninjaShapeFiles.makeShapeFiles();
+			NinjaTrace::addFileBytes(input.inputsRunNumber, input.shpFile);
+			NinjaTrace::addFileBytes(input.inputsRunNumber, CPLResetExtension(input.shpFile.c_str(), "shx"));
+			NinjaTrace::addFileBytes(input.inputsRunNumber, input.dbfFile);
 
 			if(angTempGrid)
 			{
@@ -2907,6 +3755,7 @@ void ninja::writeOutputFiles()
 		if(input.googOutFlag==true)
 
 		{
+			NinjaTraceScope trace(input.inputsRunNumber, "write_kmz");
 			AsciiGrid<double> *velTempGrid, *angTempGrid;
 			velTempGrid=NULL;
 			angTempGrid=NULL;
@@ -2976,6 +3825,8 @@ void ninja::writeOutputFiles()
 				if(ninjaKmlFiles.makeKmz())
 					ninjaKmlFiles.removeKmlFile();
 			}
+			NinjaTrace::addFileBytes(input.inputsRunNumber, input.kmzFile);
+			NinjaTrace::addFileBytes(input.inputsRunNumber, input.kmlFile);  //if the kmz failed
 			if(angTempGrid)
 			{
 				delete angTempGrid;
@@ -3001,6 +3852,7 @@ void ninja::writeOutputFiles()
 	try{
 		if(input.pdfOutFlag==true)
 		{
+			NinjaTraceScope trace(input.inputsRunNumber, "write_pdf");
 			AsciiGrid<double> *velTempGrid, *angTempGrid;
 			velTempGrid=NULL;
 			angTempGrid=NULL;
@@ -3016,6 +3868,7 @@ void ninja::writeOutputFiles()
             output.setDPI(input.pdfDPI);
             output.setSize(input.pdfWidth, input.pdfHeight);
             output.write(input.pdfFile, "PDF");
+            NinjaTrace::addFileBytes(input.inputsRunNumber, input.pdfFile);
 
 
 
@@ -3045,6 +3898,7 @@ void ninja::writeOutputFiles()
 	try{
 		if(input.geotiffOutFlag==true)
 		{
+            NinjaTraceScope trace(input.inputsRunNumber, "write_geotiff");
             OutputWriter output;
             
             output.setNinjaTime( boost::lexical_cast<std::string>(input.ninjaTime) );
@@ -3063,6 +3917,7 @@ void ninja::writeOutputFiles()
             }
 #endif
             output.write(input.geotiffOutFilename, "GTiff");
+            NinjaTrace::addFileBytes(input.inputsRunNumber, input.geotiffOutFilename);
 		}
 	}catch (exception& e)
 	{
@@ -3079,6 +3934,47 @@ void ninja::writeOutputFiles()
 /**Deletes allocated dynamic memory.
  *
  */
+/**Deletes the stiffness matrix arrays (SK, col_ind, row_ptr, elemScatter)
+ * and the preconditioner and single precision copy built on SK.
+ * If a shared domain context is used the arrays belong to the context, so
+ * they are only detached here.
+ */
+void ninja::deleteStiffnessMatrix()
+{
+	if(elemScatter)
+	{	delete[] elemScatter;
+		elemScatter=NULL;
+	}
+	if(stiffnessPrecond)
+	{	delete stiffnessPrecond;
+		stiffnessPrecond=NULL;
+	}
+	if(SKf)
+	{	delete[] SKf;
+		SKf=NULL;
+	}
+	matrixAssembled=false;
+	if(domain)
+	{
+		SK=NULL;
+		col_ind=NULL;
+		row_ptr=NULL;
+		return;
+	}
+	if(SK)
+	{	delete[] SK;
+		SK=NULL;
+	}
+	if(col_ind)
+	{	delete[] col_ind;
+		col_ind=NULL;
+	}
+	if(row_ptr)
+	{	delete[] row_ptr;
+		row_ptr=NULL;
+	}
+}
+
 void ninja::deleteDynamicMemory()
 {
 	if(solar)
@@ -3117,18 +4013,8 @@ void ninja::deleteDynamicMemory()
 	{	delete[] PHI;
 		PHI=NULL;
 	}
-	if(SK)
-	{	delete[] SK;
-		SK=NULL;
-	}
-	if(col_ind)
-	{	delete[] col_ind;
-		col_ind=NULL;
-	}
-	if(row_ptr)
-	{	delete[] row_ptr;
-		row_ptr=NULL;
-	}
+	deleteStiffnessMatrix();
+	geometry.deallocate();
 	if(RHS)
 	{	delete[] RHS;
 		RHS=NULL;
@@ -3145,10 +4031,6 @@ void ninja::deleteDynamicMemory()
 	//{	delete[] w;
 	//	w=NULL;
 	//}
-	if(DIAG)
-	{	delete[] DIAG;
-		DIAG=NULL;
-	}
 
 	u0.deallocate();
 	v0.deallocate();
@@ -3967,6 +4849,28 @@ double ninja::get_outputWindHeight() const
     return input.outputWindHeight;
 }
 
+/**Sets heights, in addition to the output wind height, to interpolate the
+ * wind to after the solve.  The grids are in extraVelocityGrids and
+ * extraAngleGrids, in the same order.
+ * @param heights Heights above the top of the vegetation.
+ * @param units Units of heights.
+ */
+void ninja::set_extraOutputWindHeights(std::vector<double> heights, lengthUnits::eLengthUnits units)
+{
+    for(unsigned int h=0;h<heights.size();h++)
+    {
+        if(heights[h] < 0.0)
+            throw std::range_error("Height is less than zero in ninja::set_extraOutputWindHeights().");
+        lengthUnits::toBaseUnits(heights[h], units);
+    }
+    input.extraOutputWindHeights = heights;
+}
+
+std::vector<double> ninja::get_extraOutputWindHeights() const
+{
+    return input.extraOutputWindHeights;
+}
+
 void ninja::set_diurnalWinds(bool flag)
 {
    input.diurnalWinds = flag;
@@ -4077,6 +4981,117 @@ void ninja::set_memDs(GDALDatasetH hSpdMemDs, GDALDatasetH hDirMemDs, GDALDatase
     input.hDustMemDs = hDustMemDs;
 }
 
+/**
+ * Builds the read-only domain data shared by the runs of a ninjaArmy.
+ * readInputFile(), set_position(), set_uniVegetation() and
+ * Mesh::buildStandardMesh() must already have been called on this ninja.
+ * The stiffness matrix is assembled and the boundary conditions applied the
+ * same way as in simulate_wind(), then the SSOR preconditioner is initialized
+ * on it.  Only valid for neutral stability runs since alphaV must not depend
+ * on the initialization.
+ * @param context Context to fill.  It takes ownership of the matrix arrays.
+ */
+void ninja::buildDomainContext(DomainContext &context)
+{
+    if(domain)
+        throw std::logic_error("ninja::buildDomainContext() called on a ninja that already uses a domain context.");
+    if(input.stabilityFlag)
+        throw std::logic_error("ninja::buildDomainContext() can only be used for neutral stability runs.");
+
+    context.deallocate();
+    context.dem = input.dem;
+    context.surface = input.surface;
+    context.mesh = mesh;
+
+    //the initial velocity only enters the RHS, which is thrown away below
+    u0.allocate(&mesh);
+    v0.allocate(&mesh);
+    w0.allocate(&mesh);
+    for(int i=0; i<mesh.NUMNP; i++)
+    {
+        u0(i) = 0.0;
+        v0(i) = 0.0;
+        w0(i) = 0.0;
+    }
+
+    discretize();
+    setBoundaryConditions();
+
+    context.NUMNP = mesh.NUMNP;
+    context.SK = SK;
+    context.row_ptr = row_ptr;
+    context.col_ind = col_ind;
+    SK = NULL;
+    row_ptr = NULL;
+    col_ind = NULL;
+    deleteStiffnessMatrix();    //the scatter map is only needed for assembly
+    geometry.deallocate();      //the runs use context.geometry, built below
+
+    if(RHS)
+    {
+        delete[] RHS;
+        RHS=NULL;
+    }
+    if(PHI)
+    {
+        delete[] PHI;
+        PHI=NULL;
+    }
+    u0.deallocate();
+    v0.deallocate();
+    w0.deallocate();
+    #ifdef STABILITY
+    alphaVfield.deallocate();
+    #endif
+
+    initializeDomainContext(context);
+}
+
+/**
+ * Builds the parts of a domain context that are derived from its mesh and
+ * matrix: the element geometry, the preconditioner, the single precision
+ * copy of the matrix (NINJA_SINGLE_PRECISION) and the warm start solution
+ * space.  Called by buildDomainContext(), or directly after
+ * DomainContext::readCache().
+ * @param context Context with the DEM, surface grids, mesh and matrix set.
+ */
+void ninja::initializeDomainContext(DomainContext &context)
+{
+    context.geometry.initialize(&context.mesh, geometryLayout);
+
+    char matdescra[6];
+    matdescra[0]='s';	//symmetric
+    matdescra[1]='u';	//upper triangle stored
+    matdescra[2]='n';	//non-unit diagonal
+    matdescra[3]='c';	//c-style array (ie 0 is index of first element, not 1 like in Fortran)
+
+    context.precond.set_gridDimensions(context.mesh.nrows, context.mesh.ncols, context.mesh.nlayers);
+    context.precond.set_singlePrecision(singlePrecision);
+    if(context.precond.initialize(context.NUMNP, context.SK, context.row_ptr, context.col_ind, preconditionerType, matdescra)==false)
+    {
+        input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Initialization of %s preconditioner failed, trying Jacobi preconditioner...", precondNames[preconditionerType]);
+        if(context.precond.initialize(context.NUMNP, context.SK, context.row_ptr, context.col_ind, Preconditioner::Jacobi, matdescra)==false)
+            throw std::runtime_error("Initialization of Jacobi preconditioner failed.");
+    }
+
+    if(singlePrecision && context.SKf == NULL)
+        context.SKf = SinglePrecisionCopy(context.SK, context.row_ptr[context.NUMNP]);
+
+    context.solutions.initialize(context.NUMNP, warmStart ? warmStartVectors : 0);
+}
+
+/**
+ * Sets a shared domain context to use instead of reading the DEM, building the
+ * mesh and assembling the stiffness matrix in simulate_wind().
+ * @param context Built context (not owned, must outlive the run) or NULL to
+ *                go back to building everything in this ninja.
+ */
+void ninja::set_domainContext(const DomainContext *context)
+{
+    deleteStiffnessMatrix();    //detach any arrays pointing into the old context
+    domain = context;
+}
+
 /**
  * Sets the flag indicating whether station fetch is on or off 
  * @param flag true if station fetch is enbaled, otherwise false 
@@ -73,6 +73,11 @@
 #include "KmlVector.h"
 #include "ShapeVector.h"
 #include "preconditioner.h"
+#include "domainContext.h"
+#include "elementGeometry.h"
+#include "solutionSpace.h"
+#include "stiffnessOperator.h"
+#include "sparseMatVec.h"
 #include "volVTK.h"
 #include "ninjaCom.h"
 #include "ninjaException.h"
@@ -150,6 +155,9 @@ public:
     //output grids to access the final wind grids (typically used by other programs running the windninja API such as WFDSS, FlamMap, etc.
     AsciiGrid<double>AngleGrid;
     AsciiGrid<double>VelocityGrid;
+    //grids at the heights set by set_extraOutputWindHeights(), in the same order
+    std::vector<AsciiGrid<double> > extraAngleGrids;
+    std::vector<AsciiGrid<double> > extraVelocityGrids;
     AsciiGrid<double>CloudGrid;
 
     //AsciiGrid<double> alphaVGrid; //store spatially varying alphaV variable
@@ -195,6 +203,9 @@ public:
     void setSurfaceGrids();
 
     void set_memDs(GDALDatasetH hSpdMemDs, GDALDatasetH hDirMemDs, GDALDatasetH hDustMemDs); 
+    void buildDomainContext(DomainContext &context);   //build the mesh/matrix/preconditioner shared by an army (see domainContext.h)
+    void initializeDomainContext(DomainContext &context); //geometry/preconditioner of a context read with DomainContext::readCache()
+    void set_domainContext(const DomainContext *context); //use a shared domain context instead of building our own, NULL to disable
     void setArmySize(int n);
     void set_DEM(std::string dem_file_name);		//Sets elevation filename (Should be in units of meters!)
     void set_initializationMethod(WindNinjaInputs::eInitializationMethod method, bool matchPoints = false);	//input wind initialization method
@@ -236,6 +247,8 @@ public:
     velocityUnits::eVelocityUnits get_outputSpeedUnits() const;
     void set_outputWindHeight(double height, lengthUnits::eLengthUnits units);
     double get_outputWindHeight() const;
+    void set_extraOutputWindHeights(std::vector<double> heights, lengthUnits::eLengthUnits units);
+    std::vector<double> get_extraOutputWindHeights() const;
     void set_diurnalWinds(bool flag);				//used to include or not include diurnal winds in the simulation (true or false)
     bool get_diurnalWindFlag(); //returns whether diurnal winds are set or not
     //void set_stabilityFlag(bool flag);              //used to include or not include stability
@@ -370,6 +383,16 @@ private:
                             //Each u, v, w velocity component is checked.
 
     int nMaxMatchingIters;
+    bool matrixFree;        //solve with a StiffnessOperator instead of an assembled SK (NINJA_MATRIX_FREE)
+    bool pipelinedCG;       //use solvePipelined() instead of solve() (NINJA_PIPELINED_CG)
+    bool singlePrecision;   //use solveMixedPrecision() (NINJA_SINGLE_PRECISION)
+    int preconditionerType; //Preconditioner::precondType used by solve() (NINJA_PRECONDITIONER)
+    bool warmStart;         //start the CG solvers from the previous solutions (NINJA_WARM_START)
+    int warmStartVectors;   //number of previous solutions kept for warm starts (NINJA_WARM_START_VECTORS)
+    SolutionSpace solutionSpace;    //previous solutions of this run's matching loop, not copied
+    ElementGeometry geometry;       //element geometry factors of mesh, built by get_geometry(), not copied
+    ElementGeometry::eLayout geometryLayout;    //(NINJA_GEOMETRY_LAYOUT)
+    int nSolverIterations;  //iterations of the last CG solve
     std::vector<int> num_outer_iter_tries_u;   //used in outer iterations calcs
     std::vector<int> num_outer_iter_tries_v;   //used in outer iterations calcs
     std::vector<int> num_outer_iter_tries_w;   //used in outer iterations calcs
@@ -379,9 +402,13 @@ private:
     wn_3dScalarField v0;		//v is positive toward North
     wn_3dScalarField w0;		//w is positive up
 
-    double *DIAG;
     double *PHI, *RHS, *SK;
     int *row_ptr, *col_ind;
+    int *elemScatter;   //positions in SK of the 36 upper triangle entries of each element matrix (see buildScatterMap())
+    Preconditioner *stiffnessPrecond;   //preconditioner built on SK, deleted with it
+    float *SKf;         //single precision copy of SK for solveMixedPrecision(), deleted with it
+    bool matrixAssembled;   //SK holds the matrix with boundary conditions applied, kept between matching iterations
+    const DomainContext *domain;  //shared read-only mesh, matrix and preconditioner (not owned), NULL if not used
     double alphaH; //alpha horizontal from governing equation, weighting for change in horizontal winds
     double alpha;                //alpha = alphaH/alphaV, determined by stability
     AsciiGrid<double> *uDiurnal, *vDiurnal, *wDiurnal, *height;
@@ -416,6 +443,19 @@ private:
      * alternative solvers                                                           
      *-----------------------------------------------------------------------------*/
     bool solveMinres(double *A, double *b, double *x, int *row_ptr, int *col_ind, int NUMNP, int max_iter, int print_iters, double tol);
+    bool solveMatrixFree(double *b, double *x, int NUMNP, int max_iter, int print_iters, double tol);
+    bool solvePipelined(double *A, double *b, double *x, int *row_ptr, int *col_ind, int NUMNP, int max_iter, int print_iters, double tol);
+    bool solveMixedPrecision(double *A, double *b, double *x, int *row_ptr, int *col_ind, int NUMNP, int max_iter, int print_iters, double tol);
+    template<class T>
+    double pipelinedIterations(const T *A, const double *b, double *x, int *row_ptr, int *col_ind, int NUMNP,
+                               const Preconditioner *precond, double *precondWork,
+                               int max_iter, int print_iters, double normb, double tol, int &nIterations);
+    const Preconditioner *initializePreconditioner(double *A, int *row_ptr, int *col_ind, int NUMNP);
+    const float *get_singlePrecisionMatrix(double *A, int *row_ptr, int NUMNP);
+    SolutionSpace *get_solutionSpace(double *A);
+    const ElementGeometry &get_geometry();
+    int warmStartSolution(double *A, double *b, double *x, int *row_ptr, int *col_ind, int NUMNP);
+    void storeSolution(double *A, double *x, int *row_ptr, int *col_ind, int NUMNP, int nGuessVectors);
 
     /*-----------------------------------------------------------------------------
      *  MKL Specific Functions
@@ -442,6 +482,8 @@ private:
      *  End MKL Section
      *-----------------------------------------------------------------------------*/
     void interp_uvw();
+    void interp_uvw(const std::vector<double> &heights, std::vector<AsciiGrid<double> > &speedGrids,
+                    std::vector<AsciiGrid<double> > &angleGrids);
 
     void write_A_and_b(int NUMNP, double *A, int *col_ind, int *row_ptr, double *b);
     double get_aspect_ratio(int NUMEL, int NUMNP, double *XORD, double *YORD, double *ZORD,
@@ -467,12 +509,15 @@ private:
     //double stability_function(double z_over_L, double L_switch);
     bool writePrjFile(std::string inPrjString, std::string outFileName);
     bool checkForNullRun();
-    void discretize(); 
+    void buildSparsityPattern();
+    void buildScatterMap();
+    void discretize();
     void setBoundaryConditions();
     void computeUVWField();
     void prepareOutput();
     bool matched(int iter);
     void writeOutputFiles(); 
+    void deleteStiffnessMatrix();
     void deleteDynamicMemory();
 };
 
@@ -393,6 +393,12 @@ bool ninjaArmy::startRuns(int numProcessors)
     //omp_set_dynamic(true);
 #endif
 
+    //the runs of a forecast share its time list and warped variables
+    SharedForecastDataScope sharedForecastData;
+
+    //phases of the runs for NINJA_TRACE_FILE
+    NinjaTrace::start();
+
     setAtmFlags();
    //TODO: move common parameters (resolutions, input filenames, output arguments) to ninjaArmy or change storage class specifier to static
     /*
@@ -521,10 +527,24 @@ bool ninjaArmy::startRuns(int numProcessors)
     {
         //set number of threads for the run
         ninjas[0]->set_numberCPUs(numProcessors);
+
+        //a single run only shares its domain with later processes, through
+        //NINJA_DOMAIN_CACHE_DIR
+        DomainContext domain;
         try{
             //start the run
-            if(!ninjas[0]->simulate_wind())
-               printf("Return of false from simulate_wind()");
+            try{
+                if( canShareDomain() )
+                    prepareDomain( domain, true );
+                if(!ninjas[0]->simulate_wind())
+                   printf("Return of false from simulate_wind()");
+            }catch (...)
+            {
+                //the domain context goes out of scope with this block
+                ninjas[0]->set_domainContext( NULL );
+                throw;
+            }
+            ninjas[0]->set_domainContext( NULL );
 #ifdef NINJAFOAM
             //if it's a ninjafoam run and diurnal is turned on, link the ninjafoam with 
             //a ninja run to add diurnal flow after the cfd solution is computed
@@ -709,14 +729,13 @@ bool ninjaArmy::startRuns(int numProcessors)
 #endif
         std::vector<int> anErrors( numProcessors);
         std::vector<std::string>asMessages( numProcessors );
-        
-        std::vector<boost::local_time::local_date_time> timeList; 
      
-        //create MEM datasets for GTiff output writer
-        ninjas[0]->readInputFile();
-        ninjas[0]->set_position();
-        ninjas[0]->set_uniVegetation();
-        ninjas[0]->mesh.buildStandardMesh(ninjas[0]->input);
+        //must be checked before ninjas[0] builds its mesh below
+        bool shareDomain = canShareDomain();
+
+        //ninjas[0] also gives the size of the MEM datasets for the GTiff output writer
+        DomainContext domain;
+        prepareDomain( domain, shareDomain );
         
         int nXSize = ninjas[0]->input.dem.get_nCols(); //57; 
         int nYSize = ninjas[0]->input.dem.get_nRows(); //70; 
@@ -727,19 +746,32 @@ bool ninjaArmy::startRuns(int numProcessors)
         hDirMemDS = GDALCreate(hDriver, "", nXSize, nYSize, 1, GDT_Float64, NULL);
         hDustMemDS = GDALCreate(hDriver, "", nXSize, nYSize, 1, GDT_Float64, NULL);
 
-	#pragma omp parallel for //spread runs on single threads
-        //FOR_EVERY(iter_ninja, ninjas) //Doesn't work with omp
-        for( int i = 0; i < ninjas.size(); i++ )
+        //idle workers take the next run, the processors are split between
+        //the concurrent runs and the loops inside them
+        ArmyScheduler scheduler( ninjas.size(), numProcessors );
+        ninjas[0]->input.Com->ninjaCom(ninjaComClass::ninjaNone,
+                "Scheduling %d runs on %d processors, up to %d runs in memory at a time.",
+                (int)ninjas.size(), numProcessors, scheduler.get_numWorkers());
+
+        int i, nThreads;
+	#pragma omp parallel num_threads( scheduler.get_numWorkers() ) private( i, nThreads )
+        while( scheduler.nextRun( i, nThreads ) )
         {
             try
             {
+                //the threads of this run go to the loops inside it
+#ifdef _OPENMP
+                omp_set_nested( nThreads > 1 );
+#endif
+                ninjas[i]->set_numberCPUs( nThreads );
+
                 //list of paths to forecast files, possibly in various zip archives
                 if( wxList.size() > 1 )
                 {
                     wxModelInitialization* model;
                     model = wxModelInitializationFactory::makeWxInitialization(wxList[i]); 
                 
-                    timeList = model->getTimeList(tz);
+                    std::vector<boost::local_time::local_date_time> timeList = model->getTimeList(tz);
                     ninjas[i]->set_date_time(timeList[0]);
                     ninjas[i]->set_wxModelFilename( wxList[i] );
                     ninjas[i]->set_date_time( timeList[0] );
@@ -750,7 +782,7 @@ bool ninjaArmy::startRuns(int numProcessors)
                 }
 
                 //start the run
-                ninjas[i]->simulate_wind();	//runs are done on 1 thread each since omp_set_nested(false)
+                ninjas[i]->simulate_wind();
 
                 //store data for atmosphere file
                 if(writeFarsiteAtmFile)
@@ -759,13 +791,6 @@ bool ninjaArmy::startRuns(int numProcessors)
                                      ninjas[i]->get_AngFileName(), ninjas[i]->get_CldFileName() );
                 }
 
-                //delete all but ninjas[0] (ninjas[0] is used to set the output path in the GUI)
-                if( i != 0  )
-                {
-                    delete ninjas[i];
-                    ninjas[i] = NULL;
-                }
-
             }catch (bad_alloc& e)
             {
 #ifdef _OPENMP
@@ -832,6 +857,27 @@ bool ninjaArmy::startRuns(int numProcessors)
                 throw;
 #endif
             }
+            //retire the run, failed or not, so only the runs in progress hold
+            //grids and fields (ninjas[0] is used to set the output path in the GUI)
+            if( i != 0  )
+            {
+                delete ninjas[i];
+                ninjas[i] = NULL;
+            }
+            scheduler.finishRun( nThreads );
+        }
+#ifdef _OPENMP
+        omp_set_nested(false);
+#endif
+        ninjas[0]->input.Com->ninjaCom(ninjaComClass::ninjaNone,
+                "%d runs done in %.1f seconds, %.2f runs/minute.",
+                (int)ninjas.size(), scheduler.get_elapsedSeconds(), scheduler.get_runsPerMinute());
+        NinjaTrace::finish();
+        //the domain context goes out of scope with this function
+        for( unsigned int i = 0; i < ninjas.size(); i++ )
+        {
+            if( ninjas[i] )
+                ninjas[i]->set_domainContext( NULL );
         }
 #ifdef _OPENMP
         NinjaRethrowThreadedException( anErrors, asMessages, numProcessors );
@@ -864,6 +910,9 @@ bool ninjaArmy::startRuns(int numProcessors)
             throw;
         }
     }
+    HorizonMap::clear();
+    IdwInterpolator::clear();
+    NinjaTrace::finish();
     
     return status;
 }
@@ -956,6 +1005,118 @@ void ninjaArmy::writeFarsiteAtmosphereFile()
     }
 }
 
+/**
+ * @brief Determine if the runs can share one DomainContext.
+ *
+ * The DEM, surface grids, mesh, stiffness matrix and preconditioner are the
+ * same for every run of a neutral stability domain average or weather model
+ * army, so they only need to be built once.  Set NINJA_ARMY_SHARE_DOMAIN=NO to
+ * build them separately for each run.
+ *
+ * @return true if all runs can use the same DomainContext.
+ */
+bool ninjaArmy::canShareDomain()
+{
+    //a single run only gains from sharing through the domain cache
+    const char *pszCacheDir = CPLGetConfigOption( "NINJA_DOMAIN_CACHE_DIR", NULL );
+    if( ninjas.size() < 2 && ( pszCacheDir == NULL || *pszCacheDir == '\0' ) )
+        return false;
+    if( ninjas.empty() )
+        return false;
+    if( !CSLTestBoolean( CPLGetConfigOption( "NINJA_ARMY_SHARE_DOMAIN", "YES" ) ) )
+        return false;
+    //the matrix-free solver has no assembled matrix to share
+    if( CSLTestBoolean( CPLGetConfigOption( "NINJA_MATRIX_FREE", "NO" ) ) )
+        return false;
+
+    for( unsigned int i = 0; i < ninjas.size(); i++ )
+    {
+        if( ninjas[i]->identify() != "ninja" )
+            return false;
+        if( ninjas[i]->input.initializationMethod != WindNinjaInputs::domainAverageInitializationFlag &&
+            ninjas[i]->input.initializationMethod != WindNinjaInputs::wxModelInitializationFlag )
+            return false;
+        if( ninjas[i]->input.stabilityFlag )
+            return false;
+        if( ninjas[i]->input.dem.fileName != ninjas[0]->input.dem.fileName ||
+            ninjas[i]->input.vegetation != ninjas[0]->input.vegetation )
+            return false;
+        //the domain height depends on the output heights
+        if( ninjas[i]->input.outputWindHeight != ninjas[0]->input.outputWindHeight ||
+            ninjas[i]->input.extraOutputWindHeights != ninjas[0]->input.extraOutputWindHeights )
+            return false;
+
+        const Mesh &m = ninjas[i]->mesh;
+        const Mesh &m0 = ninjas[0]->mesh;
+        if( m.meshResChoice != m0.meshResChoice ||
+            m.meshResolution != m0.meshResolution ||
+            m.meshResolutionUnits != m0.meshResolutionUnits ||
+            m.domainHeight != m0.domainHeight ||
+            m.numVertLayers != m0.numVertLayers ||
+            m.vertGrowth != m0.vertGrowth )
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Read the DEM of the first run and set up the domain shared by the runs.
+ *
+ * The DEM and mesh of ninjas[0] are always set up (the army needs the grid
+ * size).  With shareDomain the mesh, stiffness matrix and preconditioner
+ * are built once, or read from NINJA_DOMAIN_CACHE_DIR, and every run is
+ * pointed at them.
+ *
+ * @param domain Context for the runs, must outlive them.
+ * @param shareDomain Result of canShareDomain().
+ */
+void ninjaArmy::prepareDomain( DomainContext &domain, bool shareDomain )
+{
+    //with NINJA_DOMAIN_CACHE_DIR the shared domain may come from an earlier process
+    std::string domainCacheFile;
+    bool domainCached = false;
+    if( shareDomain )
+    {
+        domainCacheFile = DomainContext::cacheFileName( ninjas[0]->input, ninjas[0]->mesh );
+        if( !domainCacheFile.empty() )
+            domainCached = domain.readCache( domainCacheFile );
+    }
+
+    if( domainCached )
+    {
+        ninjas[0]->input.Com->ninjaCom(ninjaComClass::ninjaNone,
+                "Read mesh and equations from %s", domainCacheFile.c_str());
+        domain.applyTo( ninjas[0]->input, ninjas[0]->mesh );
+        ninjas[0]->set_position();
+    }
+    else
+    {
+        ninjas[0]->readInputFile();
+        ninjas[0]->set_position();
+        ninjas[0]->set_uniVegetation();
+        ninjas[0]->mesh.buildStandardMesh(ninjas[0]->input);
+    }
+
+    //build the mesh, stiffness matrix and preconditioner once for all runs
+    if( shareDomain )
+    {
+        NinjaTraceScope trace( -1, "domain" );
+        if( domainCached )
+            ninjas[0]->initializeDomainContext( domain );
+        else
+        {
+            ninjas[0]->input.Com->ninjaCom(ninjaComClass::ninjaNone,
+                    "Building mesh and equations shared by all %d runs...", (int)ninjas.size());
+            ninjas[0]->buildDomainContext( domain );
+            if( !domainCacheFile.empty() && !domain.writeCache( domainCacheFile ) )
+                ninjas[0]->input.Com->ninjaCom(ninjaComClass::ninjaWarning,
+                        "Could not write the domain cache file %s", domainCacheFile.c_str());
+        }
+        for( unsigned int i = 0; i < ninjas.size(); i++ )
+            ninjas[i]->set_domainContext( &domain );
+    }
+}
+
 /**
  * @brief Determine what type of atm file to write.
  *
@@ -39,6 +39,10 @@
 #endif
 
 #include "ninja_threaded_exception.h"
+#include "armyScheduler.h"
+#include "ninjaTrace.h"
+#include "horizonMap.h"
+#include "idwInterpolator.h"
 #include "farsiteAtm.h"
 #include "wxModelInitializationFactory.h"
 #include "ninja_errors.h"
@@ -1180,6 +1184,8 @@ protected:
     bool writeFarsiteAtmFile;
     void writeFarsiteAtmosphereFile();
     void setAtmFlags();
+    bool canShareDomain();
+    void prepareDomain( DomainContext &domain, bool shareDomain );
 
     /*
     ** This function initializes various data for the lifetime of the
@@ -0,0 +1,412 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Phase timers and counters of the runs written to a trace file
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "ninjaTrace.h"
+
+#include <cstdio>
+#include <ctime>
+
+#ifdef WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+bool NinjaTrace::enabled_ = false;
+double NinjaTrace::startTime_ = 0.0;
+std::string NinjaTrace::fileName_;
+std::string NinjaTrace::format_;
+int NinjaTrace::nThreads_ = 0;
+std::vector<NinjaTrace::Phase> NinjaTrace::phases_;
+std::map<std::pair<int, std::string>, double> NinjaTrace::counters_;
+std::vector<NinjaTrace::Sample> NinjaTrace::samples_;
+
+//number as JSON text, JSON has no NaN or infinity (a diverged residual)
+static std::string jsonNumber(double value)
+{
+    if(!CPLIsFinite(value))
+        return "null";
+    char text[32];
+    sprintf(text, "%.17g", value);
+    return text;
+}
+
+//number of the calling thread in the trace, -1 until it records something,
+//kept between traces
+static int nTraceThread = -1;
+#pragma omp threadprivate(nTraceThread)
+
+/**
+ * Starts recording if NINJA_TRACE_FILE is set.  Records of an earlier
+ * start() are discarded.  Not thread safe, call it before the runs start.
+ */
+void NinjaTrace::start()
+{
+    phases_.clear();
+    counters_.clear();
+    samples_.clear();
+
+    fileName_ = CPLGetConfigOption("NINJA_TRACE_FILE", "");
+    format_ = CPLGetConfigOption("NINJA_TRACE_FORMAT", "JSON");
+    enabled_ = !fileName_.empty();
+    startTime_ = wallTime();
+    if(enabled_)
+        CPLDebug("NINJA", "Writing a %s trace of the runs to %s", format_.c_str(), fileName_.c_str());
+}
+
+/**
+ * Stops recording and writes the trace file.  The whole army is recorded as
+ * the "army" phase of run -1.  Not thread safe, call it after the runs.
+ * @return false if the trace file could not be written.
+ */
+bool NinjaTrace::finish()
+{
+    if(!enabled_)
+        return true;
+
+    addPhase(-1, "army", 0.0, now());
+    addPeakMemory(-1);
+    enabled_ = false;
+
+    FILE *fout = fopen(fileName_.c_str(), "w");
+    if(fout == NULL)
+    {
+        CPLError(CE_Warning, CPLE_OpenFailed, "Could not open trace file %s", fileName_.c_str());
+        return false;
+    }
+    bool ok;
+    if(EQUAL(format_.c_str(), "CSV"))
+        ok = writeCsv(fout);
+    else if(EQUAL(format_.c_str(), "CHROME"))
+        ok = writeChrome(fout);
+    else
+        ok = writeJson(fout);
+    if(fclose(fout) != 0)
+        ok = false;
+
+    phases_.clear();
+    counters_.clear();
+    samples_.clear();
+    return ok;
+}
+
+/**
+ * @return Seconds since start().
+ */
+double NinjaTrace::now()
+{
+    return wallTime() - startTime_;
+}
+
+/**
+ * Records a phase of a run.  Usually done by a NinjaTraceScope.
+ * @param run Run number, -1 for the army.
+ * @param name Name of the phase, a string without quotes.
+ * @param startTime Start of the phase in seconds since start().
+ * @param endTime End of the phase in seconds since start().
+ */
+void NinjaTrace::addPhase(int run, const char *name, double startTime, double endTime)
+{
+    if(!enabled_)
+        return;
+    Phase phase;
+    phase.run = run;
+    phase.thread = threadNumber();
+    phase.name = name;
+    phase.start = startTime;
+    phase.end = endTime;
+#pragma omp critical(ninjaTrace)
+    phases_.push_back(phase);
+}
+
+/**
+ * Adds value to a counter of a run.
+ */
+void NinjaTrace::addCounter(int run, const char *name, double value)
+{
+    if(!enabled_)
+        return;
+#pragma omp critical(ninjaTrace)
+    counters_[std::make_pair(run, std::string(name))] += value;
+}
+
+/**
+ * Records one point of a series of a run, such as the residual (value) of
+ * a solver iteration (x).
+ */
+void NinjaTrace::addSample(int run, const char *name, double x, double value)
+{
+    if(!enabled_)
+        return;
+    Sample sample;
+    sample.run = run;
+    sample.thread = threadNumber();
+    sample.name = name;
+    sample.time = now();
+    sample.x = x;
+    sample.value = value;
+#pragma omp critical(ninjaTrace)
+    samples_.push_back(sample);
+}
+
+/**
+ * Adds the size of a written file to the bytes_written counter of a run.
+ * Files that do not exist are skipped.
+ */
+void NinjaTrace::addFileBytes(int run, const std::string &fileName)
+{
+    if(!enabled_ || fileName.empty())
+        return;
+    VSIStatBufL sStat;
+    if(VSIStatL(fileName.c_str(), &sStat) == 0)
+        addCounter(run, "bytes_written", (double)sStat.st_size);
+}
+
+/**
+ * Sets the peak_resident_mb counter of a run to the peak resident set size
+ * of the process so far.  The runs of an army share the process, so this is
+ * the peak of all runs that were in memory up to now.
+ */
+void NinjaTrace::addPeakMemory(int run)
+{
+    if(!enabled_)
+        return;
+    double peak = getPeakResidentMB();
+#pragma omp critical(ninjaTrace)
+    counters_[std::make_pair(run, std::string("peak_resident_mb"))] = peak;
+}
+
+/**
+ * @return Peak resident set size of the process in MB, 0 if unknown.
+ */
+double NinjaTrace::getPeakResidentMB()
+{
+#ifdef WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    return 0.0;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);    //bytes
+#else
+    return usage.ru_maxrss / 1024.0;               //kilobytes
+#endif
+#endif
+}
+
+double NinjaTrace::wallTime()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)time(NULL);
+#endif
+}
+
+int NinjaTrace::threadNumber()
+{
+    if(nTraceThread < 0)
+    {
+#pragma omp critical(ninjaTrace)
+        nTraceThread = nThreads_++;
+    }
+    return nTraceThread;
+}
+
+/**
+ * Writes per run and army totals of the phases and the counters, the
+ * samples per run and all phases:
+ * {"runs": [{"run": 0, "phases": {"solve": {"count": 1, "seconds": 2.5}, ...},
+ *            "counters": {...}, "samples": {"residual": [[1, 0.5], ...]}}, ...],
+ *  "army": {"seconds": ..., "phases": {...}, "counters": {...}},
+ *  "events": [{"run": 0, "thread": 1, "name": "solve", "start": 1.2, "seconds": 2.5}, ...]}
+ * The samples of a run are grouped by name, whatever order they were
+ * recorded in.  Counters and samples that are NaN or infinite are written
+ * as null.
+ */
+bool NinjaTrace::writeJson(FILE *fout)
+{
+    //per run totals, run -1 is the army
+    typedef std::map<std::string, std::pair<int, double> > PhaseTotals;
+    std::map<int, PhaseTotals> runPhases;
+    PhaseTotals armyPhases;
+    double armySeconds = 0.0;
+    for(size_t i = 0; i < phases_.size(); i++)
+    {
+        const Phase &p = phases_[i];
+        if(p.run < 0)
+        {
+            if(p.name == "army")
+                armySeconds = p.end - p.start;
+            continue;
+        }
+        std::pair<int, double> &t = runPhases[p.run][p.name];
+        t.first++;
+        t.second += p.end - p.start;
+        std::pair<int, double> &a = armyPhases[p.name];
+        a.first++;
+        a.second += p.end - p.start;
+    }
+    std::map<int, std::map<std::string, double> > runCounters;
+    std::map<std::string, double> armyCounters;
+    for(std::map<std::pair<int, std::string>, double>::const_iterator it = counters_.begin();
+        it != counters_.end(); ++it)
+    {
+        runCounters[it->first.first][it->first.second] = it->second;
+        if(it->first.first >= 0 && it->first.second != "peak_resident_mb")
+            armyCounters[it->first.second] += it->second;
+    }
+    armyCounters["peak_resident_mb"] = runCounters[-1]["peak_resident_mb"];
+    //series of a run by name, several series can be recorded in turns
+    std::map<int, std::map<std::string, std::vector<const Sample*> > > runSamples;
+    for(size_t i = 0; i < samples_.size(); i++)
+    {
+        runPhases[samples_[i].run];
+        runSamples[samples_[i].run][samples_[i].name].push_back(&samples_[i]);
+    }
+
+    fprintf(fout, "{\n  \"runs\": [");
+    bool firstRun = true;
+    for(std::map<int, PhaseTotals>::const_iterator r = runPhases.begin(); r != runPhases.end(); ++r)
+    {
+        if(r->first < 0)
+            continue;
+        fprintf(fout, "%s\n    {\"run\": %d, \"phases\": {", firstRun ? "" : ",", r->first);
+        firstRun = false;
+        for(PhaseTotals::const_iterator p = r->second.begin(); p != r->second.end(); ++p)
+            fprintf(fout, "%s\"%s\": {\"count\": %d, \"seconds\": %.6f}",
+                    p == r->second.begin() ? "" : ", ", p->first.c_str(), p->second.first, p->second.second);
+        fprintf(fout, "},\n     \"counters\": {");
+        const std::map<std::string, double> &c = runCounters[r->first];
+        for(std::map<std::string, double>::const_iterator it = c.begin(); it != c.end(); ++it)
+            fprintf(fout, "%s\"%s\": %s", it == c.begin() ? "" : ", ", it->first.c_str(), jsonNumber(it->second).c_str());
+        fprintf(fout, "},\n     \"samples\": {");
+        const std::map<std::string, std::vector<const Sample*> > &series = runSamples[r->first];
+        for(std::map<std::string, std::vector<const Sample*> >::const_iterator it = series.begin();
+            it != series.end(); ++it)
+        {
+            fprintf(fout, "%s\"%s\": [", it == series.begin() ? "" : ", ", it->first.c_str());
+            for(size_t i = 0; i < it->second.size(); i++)
+                fprintf(fout, "%s[%s, %s]", i == 0 ? "" : ", ", jsonNumber(it->second[i]->x).c_str(),
+                        jsonNumber(it->second[i]->value).c_str());
+            fprintf(fout, "]");
+        }
+        fprintf(fout, "}}");
+    }
+    fprintf(fout, "\n  ],\n  \"army\": {\"runs\": %d, \"seconds\": %.6f, \"phases\": {",
+            (int)runPhases.size(), armySeconds);
+    for(PhaseTotals::const_iterator p = armyPhases.begin(); p != armyPhases.end(); ++p)
+        fprintf(fout, "%s\"%s\": {\"count\": %d, \"seconds\": %.6f}",
+                p == armyPhases.begin() ? "" : ", ", p->first.c_str(), p->second.first, p->second.second);
+    fprintf(fout, "},\n           \"counters\": {");
+    for(std::map<std::string, double>::const_iterator it = armyCounters.begin(); it != armyCounters.end(); ++it)
+        fprintf(fout, "%s\"%s\": %s", it == armyCounters.begin() ? "" : ", ", it->first.c_str(), jsonNumber(it->second).c_str());
+    fprintf(fout, "}},\n  \"events\": [");
+    for(size_t i = 0; i < phases_.size(); i++)
+    {
+        const Phase &p = phases_[i];
+        fprintf(fout, "%s\n    {\"run\": %d, \"thread\": %d, \"name\": \"%s\", \"start\": %.6f, \"seconds\": %.6f}",
+                i == 0 ? "" : ",", p.run, p.thread, p.name.c_str(), p.start, p.end - p.start);
+    }
+    return fprintf(fout, "\n  ]\n}\n") > 0;
+}
+
+/**
+ * Writes one row per phase, counter and sample:
+ * type,run,thread,name,start,seconds,x,value
+ */
+bool NinjaTrace::writeCsv(FILE *fout)
+{
+    fprintf(fout, "type,run,thread,name,start,seconds,x,value\n");
+    for(size_t i = 0; i < phases_.size(); i++)
+    {
+        const Phase &p = phases_[i];
+        fprintf(fout, "phase,%d,%d,%s,%.6f,%.6f,,\n", p.run, p.thread, p.name.c_str(), p.start, p.end - p.start);
+    }
+    for(std::map<std::pair<int, std::string>, double>::const_iterator it = counters_.begin();
+        it != counters_.end(); ++it)
+        fprintf(fout, "counter,%d,,%s,,,,%.17g\n", it->first.first, it->first.second.c_str(), it->second);
+    for(size_t i = 0; i < samples_.size(); i++)
+    {
+        const Sample &s = samples_[i];
+        fprintf(fout, "sample,%d,%d,%s,%.6f,,%.17g,%.17g\n", s.run, s.thread, s.name.c_str(), s.time, s.x, s.value);
+    }
+    return !ferror(fout);
+}
+
+/**
+ * Writes the trace event format: complete events for the phases, counter
+ * events for the samples and the counters of each run as its metadata.
+ * Times are in microseconds, the process id is the run (-1 for the army).
+ * NaN or infinite values are written as null.
+ */
+bool NinjaTrace::writeChrome(FILE *fout)
+{
+    fprintf(fout, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    bool first = true;
+    std::map<int, std::map<std::string, double> > runCounters;
+    for(std::map<std::pair<int, std::string>, double>::const_iterator it = counters_.begin();
+        it != counters_.end(); ++it)
+        runCounters[it->first.first][it->first.second] = it->second;
+    for(size_t i = 0; i < phases_.size(); i++)
+        runCounters[phases_[i].run];
+    for(std::map<int, std::map<std::string, double> >::const_iterator r = runCounters.begin();
+        r != runCounters.end(); ++r)
+    {
+        if(r->first < 0)
+            fprintf(fout, "%s\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": -1, \"args\": {\"name\": \"army\"", first ? "" : ",");
+        else
+            fprintf(fout, "%s\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"run %d\"",
+                    first ? "" : ",", r->first, r->first);
+        first = false;
+        for(std::map<std::string, double>::const_iterator it = r->second.begin(); it != r->second.end(); ++it)
+            fprintf(fout, ", \"%s\": %s", it->first.c_str(), jsonNumber(it->second).c_str());
+        fprintf(fout, "}}");
+    }
+    for(size_t i = 0; i < phases_.size(); i++)
+    {
+        const Phase &p = phases_[i];
+        fprintf(fout, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                first ? "" : ",", p.name.c_str(), p.run, p.thread, p.start * 1e6, (p.end - p.start) * 1e6);
+        first = false;
+    }
+    for(size_t i = 0; i < samples_.size(); i++)
+    {
+        const Sample &s = samples_[i];
+        fprintf(fout, "%s\n{\"name\": \"%s\", \"ph\": \"C\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"args\": {\"%s\": %s}}",
+                first ? "" : ",", s.name.c_str(), s.run, s.thread, s.time * 1e6, s.name.c_str(),
+                jsonNumber(s.value).c_str());
+        first = false;
+    }
+    return fprintf(fout, "\n]}\n") > 0;
+}
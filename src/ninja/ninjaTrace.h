@@ -0,0 +1,147 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Phase timers and counters of the runs written to a trace file
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef NINJA_TRACE_H
+#define NINJA_TRACE_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Process wide record of where the time of the runs goes.
+ *
+ * ninjaArmy::startRuns() calls start() and finish().  If the
+ * NINJA_TRACE_FILE config option (the --trace_file argument of the command
+ * line interface) is set, the runs record in between:
+ *  - phases: a name, the run, the thread and the start and end time, from
+ *    a NinjaTraceScope around mesh generation, each initialization stage,
+ *    assembly, boundary conditions, preconditioner setup, the solver, the
+ *    wind field, output preparation and each output writer,
+ *  - counters, summed per run: solver iterations, bytes written and the
+ *    peak resident set size,
+ *  - samples: the residual history of the solver.
+ * finish() writes them to NINJA_TRACE_FILE as NINJA_TRACE_FORMAT: JSON (per
+ * run and army totals plus all phases), CSV (one row per record) or CHROME
+ * (the trace event format of chrome://tracing and Perfetto, one process per
+ * run and one thread per OS thread).
+ *
+ * Threads are numbered in the order they first record something, so the
+ * threads of nested loops get their own number.  With no trace file every
+ * call is a test of one flag.
+ */
+class NinjaTrace
+{
+public:
+    static void start();
+    static bool finish();
+
+    static inline bool isEnabled() { return enabled_; }
+    static double now();
+
+    static void addPhase(int run, const char *name, double startTime, double endTime);
+    static void addCounter(int run, const char *name, double value);
+    static void addSample(int run, const char *name, double x, double value);
+    static void addFileBytes(int run, const std::string &fileName);
+    static void addPeakMemory(int run);
+
+    static double getPeakResidentMB();
+
+private:
+    struct Phase
+    {
+        int run;
+        int thread;
+        std::string name;
+        double start;
+        double end;
+    };
+    struct Sample
+    {
+        int run;
+        int thread;
+        std::string name;
+        double time;
+        double x;
+        double value;
+    };
+
+    static bool enabled_;
+    static double startTime_;
+    static std::string fileName_;
+    static std::string format_;
+    static int nThreads_;
+
+    static std::vector<Phase> phases_;
+    static std::map<std::pair<int, std::string>, double> counters_;
+    static std::vector<Sample> samples_;
+
+    static double wallTime();
+    static int threadNumber();
+
+    static bool writeJson(FILE *fout);
+    static bool writeCsv(FILE *fout);
+    static bool writeChrome(FILE *fout);
+};
+
+/**
+ * Records the time between its construction and destruction as a phase of
+ * a run.
+ */
+class NinjaTraceScope
+{
+public:
+    NinjaTraceScope(int run, const char *name)
+    {
+        run_ = run;
+        name_ = name;
+        start_ = NinjaTrace::isEnabled() ? NinjaTrace::now() : 0.0;
+    }
+    ~NinjaTraceScope()
+    {
+        if(NinjaTrace::isEnabled())
+            NinjaTrace::addPhase(run_, name_, start_, NinjaTrace::now());
+    }
+
+private:
+    int run_;
+    const char *name_;
+    double start_;
+
+    NinjaTraceScope(const NinjaTraceScope &);
+    NinjaTraceScope &operator=(const NinjaTraceScope &);
+};
+
+#endif  //NINJA_TRACE_H
@@ -111,6 +111,8 @@ void pointInitialization::initializeFields(WindNinjaInputs &input,
 
 void pointInitialization::setInitializationGrids(WindNinjaInputs& input)
 {
+    NinjaTraceScope trace(input.inputsRunNumber, "init_grids");
+
     Aspect aspect;
     Slope slope;
     Shade shade;
@@ -154,8 +156,15 @@ void pointInitialization::setInitializationGrids(WindNinjaInputs& input)
     input.inputWindHeight = maxStationHeight;  //for use later during vertical fill of 3D grid
     input.surface.Z = input.inputWindHeight;
 
-    airTempGrid.interpolateFromPoints(T, X, Y, influenceRadius, input.stationsScratch.size(), dfInvDistWeight);
-    cloudCoverGrid.interpolateFromPoints(cc, X, Y, influenceRadius, input.stationsScratch.size(), dfInvDistWeight);
+    //air temperature and cloud cover share the station weights
+    boost::shared_ptr<const IdwInterpolator> idw =
+        IdwInterpolator::get(airTempGrid.get_nCols(), airTempGrid.get_nRows(),
+                             airTempGrid.get_xllCorner(), airTempGrid.get_yllCorner(),
+                             airTempGrid.get_cellSize(), X, Y, influenceRadius,
+                             input.stationsScratch.size(), dfInvDistWeight);
+    const double *tcValues[] = {T, cc};
+    Array2D<double> *tcGrids[] = {&airTempGrid.data, &cloudCoverGrid.data};
+    idw->interpolate(2, tcValues, tcGrids);
 
     //Check one grid to be sure that the interpolation completely filled the grid
     if(cloudCoverGrid.checkForNoDataValues())
@@ -322,8 +331,14 @@ void pointInitialization::setInitializationGrids(WindNinjaInputs& input)
         }
     }
 
-    uInitializationGrid.interpolateFromPoints(u, X, Y, influenceRadius, input.stationsScratch.size(), dfInvDistWeight);
-    vInitializationGrid.interpolateFromPoints(v, X, Y, influenceRadius, input.stationsScratch.size(), dfInvDistWeight);
+    //same stations and grid as the air temperature, so this reuses the weights
+    idw = IdwInterpolator::get(uInitializationGrid.get_nCols(), uInitializationGrid.get_nRows(),
+                               uInitializationGrid.get_xllCorner(), uInitializationGrid.get_yllCorner(),
+                               uInitializationGrid.get_cellSize(), X, Y, influenceRadius,
+                               input.stationsScratch.size(), dfInvDistWeight);
+    const double *uvValues[] = {u, v};
+    Array2D<double> *uvGrids[] = {&uInitializationGrid.data, &vInitializationGrid.data};
+    idw->interpolate(2, uvValues, uvGrids);
 
     input.surface.windSpeedGrid.set_headerData(uInitializationGrid);
     input.surface.windGridExists = true;
@@ -31,13 +31,34 @@
 
 Preconditioner::Preconditioner()
 {
-	NUMNP = 0;
+	NUMNP = 0;
+	preConditionerType = none;
 	D = NULL;
 	Lt = NULL;
 	U = NULL;
 	scratch = NULL;
 	L_row_ptr = NULL;
 	L_col_ind = NULL;
+	nFwdLevels = 0;
+	nBwdLevels = 0;
+	fwdLevel_ptr = NULL;
+	fwdLevel_rows = NULL;
+	bwdLevel_ptr = NULL;
+	bwdLevel_rows = NULL;
+	Lfwd_ptr = NULL;
+	Lfwd_col = NULL;
+	Lfwd_val = NULL;
+	Ubwd_ptr = NULL;
+	Ubwd_col = NULL;
+	Ubwd_val = NULL;
+	Ubwd_diag = NULL;
+	singlePrecision = false;
+	Lfwd_valf = NULL;
+	Ubwd_valf = NULL;
+	gridRows = 0;
+	gridCols = 0;
+	gridLayers = 0;
+	multigrid = NULL;
 	w = 1.0;
 
 	//stuff for sparse BLAS solve
@@ -77,6 +98,36 @@ Preconditioner::~Preconditioner()
 		delete[] L_col_ind;
 	//if(U_col_ind)
 	//	delete U_col_ind;
+
+	if(fwdLevel_ptr)
+		delete[] fwdLevel_ptr;
+	if(fwdLevel_rows)
+		delete[] fwdLevel_rows;
+	if(bwdLevel_ptr)
+		delete[] bwdLevel_ptr;
+	if(bwdLevel_rows)
+		delete[] bwdLevel_rows;
+	if(Lfwd_ptr)
+		delete[] Lfwd_ptr;
+	if(Lfwd_col)
+		delete[] Lfwd_col;
+	if(Lfwd_val)
+		delete[] Lfwd_val;
+	if(Ubwd_ptr)
+		delete[] Ubwd_ptr;
+	if(Ubwd_col)
+		delete[] Ubwd_col;
+	if(Ubwd_val)
+		delete[] Ubwd_val;
+	if(Ubwd_diag)
+		delete[] Ubwd_diag;
+	if(Lfwd_valf)
+		delete[] Lfwd_valf;
+	if(Ubwd_valf)
+		delete[] Ubwd_valf;
+
+	if(multigrid)
+		delete multigrid;
 }
 
 bool Preconditioner::initialize(int numnp, double *A, int *row_ptr, int *col_ind, int preconditionerType, char *matdescra)
@@ -113,7 +164,7 @@ bool Preconditioner::initialize(int numnp, double *A, int *row_ptr, int *col_ind
         
 		return true;
 		
-	}else if(preconditionerType == SSOR)
+	}else if(preconditionerType == SSOR || preconditionerType == ParallelSSOR)
 	{
 		preConditionerType = preconditionerType;
 		NUMNP = numnp;
@@ -177,6 +228,26 @@ bool Preconditioner::initialize(int numnp, double *A, int *row_ptr, int *col_ind
 				count++;
 			}
 		}
+
+		if(preconditionerType == ParallelSSOR)
+			buildLevels(row_ptr, col_ind);
+	}else if(preconditionerType == Multigrid)
+	{
+		//needs the symmetric matrix of the structured mesh
+		if(matdescra[0] != 's' || gridRows*gridCols*gridLayers != numnp)
+			return false;
+
+		preConditionerType = preconditionerType;
+		NUMNP = numnp;
+
+		multigrid = new GeometricMultigrid;
+		if(multigrid->initialize(A, row_ptr, col_ind, gridRows, gridCols, gridLayers) == false)
+		{
+			delete multigrid;
+			multigrid = NULL;
+			return false;
+		}
+		scratch = new double[multigrid->get_workSize()];
 	}
 
 	return true;
@@ -184,6 +255,13 @@ bool Preconditioner::initialize(int numnp, double *A, int *row_ptr, int *col_ind
 
 bool Preconditioner::solve(double *r, double *z, int *row_ptr, int *col_ind)
 {	//solves M*z=r;  ie z=M^(-1)*r
+	return solve(r, z, row_ptr, col_ind, scratch);
+}
+
+bool Preconditioner::solve(double *r, double *z, int *row_ptr, int *col_ind, double *work) const
+{	//solves M*z=r;  ie z=M^(-1)*r
+	//Only reads the preconditioner data, so several threads can share one initialized
+	//preconditioner as long as each passes its own work vector (get_workSize() values).
 
 	if(preConditionerType == none)
 	{
@@ -200,12 +278,25 @@ bool Preconditioner::solve(double *r, double *z, int *row_ptr, int *col_ind)
 		//solves M*z = r
 		//	-->  LU*z = r
 		//	-->	 L(U*z) = r
-		//	-->  L(scratch) = r
-		//	-->  U*z = scratch
+		//	-->  L(work) = r
+		//	-->  U*z = work
 		//--------------------------------------------------
 
-		mkl_dcsrsv(&L_transa, &NUMNP, &one, L_matdescra, Lt, L_col_ind, L_row_ptr, &L_row_ptr[1], r, scratch);
-		mkl_dcsrsv(&U_transa, &NUMNP, &one, U_matdescra, U, col_ind, row_ptr, &row_ptr[1], scratch, z);
+		mkl_dcsrsv(&L_transa, &NUMNP, &one, L_matdescra, Lt, L_col_ind, L_row_ptr, &L_row_ptr[1], r, work);
+		mkl_dcsrsv(&U_transa, &NUMNP, &one, U_matdescra, U, col_ind, row_ptr, &row_ptr[1], work, z);
+
+		return true;
+	}else if(preConditionerType == ParallelSSOR)
+	{
+		if(Lfwd_valf)
+			levelScheduledSolve(r, z, work, Lfwd_valf, Ubwd_valf);
+		else
+			levelScheduledSolve(r, z, work, Lfwd_val, Ubwd_val);
+
+		return true;
+	}else if(preConditionerType == Multigrid)
+	{
+		multigrid->apply(r, z, work);
 
 		return true;
 	}
@@ -213,7 +304,263 @@ bool Preconditioner::solve(double *r, double *z, int *row_ptr, int *col_ind)
 	return false;
 }
 
-void Preconditioner::mkl_dcsrsv(char *transa, int *m, double *alpha, char *matdescra, double *val, int *indx, int *pntrb, int *pntre, double *x, double *y)
+int Preconditioner::get_type() const
+{
+	return preConditionerType;
+}
+
+int Preconditioner::get_numLevels() const
+{
+	if(multigrid)
+		return multigrid->get_numLevels();
+	return nFwdLevels + nBwdLevels;
+}
+
+int Preconditioner::get_workSize() const
+{
+	if(multigrid)
+		return multigrid->get_workSize();
+	return NUMNP;
+}
+
+void Preconditioner::set_gridDimensions(int nrows, int ncols, int nlayers)
+{
+	gridRows = nrows;
+	gridCols = ncols;
+	gridLayers = nlayers;
+}
+
+/**
+ * Store the factors of the ParallelSSOR preconditioner in single precision.
+ * The triangular solves still sum in double, only their memory traffic for
+ * the factors is halved.  The other preconditioners ignore it.
+ * @param single true for single precision factors.
+ */
+void Preconditioner::set_singlePrecision(bool single)
+{
+	singlePrecision = single;
+}
+
+/**
+ * Sets up the level scheduled triangular solves for the ParallelSSOR
+ * preconditioner.
+ *
+ * In the forward solve L*y = r row i needs y[j] for every j < i with
+ * A(j,i) != 0, in the backward solve U*z = y row i needs z[j] for every j > i
+ * with A(i,j) != 0.  Rows are grouped into levels such that a row only depends
+ * on rows of earlier levels, so all the rows of one level can be solved at the
+ * same time.  For the 27 point stencil of the mesh the number of levels in
+ * each solve is about ncols + 2*nrows + 4*nlayers, which leaves hundreds to
+ * thousands of rows per level.
+ *
+ * The rows of a level are spread over the whole domain, so L and U are copied
+ * row by row in the order they are solved in.  This keeps the reads of the
+ * matrix values sequential, which matters as much as the threading (reading
+ * the rows in level order straight out of A is several times slower than the
+ * sequential solve on one thread).  The forward solve has to pull y[j] into
+ * row i, so L is stored by rows, the transpose of Lt.  Lt and U are not needed
+ * after this and are freed.
+ *
+ * @param row_ptr Row pointer of A (upper triangle, diagonal first, increasing columns).
+ * @param col_ind Column indices of A.
+ */
+void Preconditioner::buildLevels(const int *row_ptr, const int *col_ind)
+{
+	int i, j, l, n, count;
+	int *level = new int[NUMNP];
+	int *next = new int[NUMNP+1];
+
+	//L by rows: the entries of Lt row j become entries of column j in L
+	int *Lrow_ptr = new int[NUMNP+1];
+	for(i=0; i<=NUMNP; i++)
+		Lrow_ptr[i] = 0;
+	for(i=0; i<NUMNP; i++)
+	{
+		for(j=L_row_ptr[i]; j<L_row_ptr[i+1]; j++)
+			Lrow_ptr[L_col_ind[j]+1]++;
+	}
+	for(i=0; i<NUMNP; i++)
+		Lrow_ptr[i+1] += Lrow_ptr[i];
+
+	double *Lrow_val = new double[Lrow_ptr[NUMNP]];
+	int *Lrow_col = new int[Lrow_ptr[NUMNP]];
+	for(i=0; i<NUMNP; i++)
+		next[i] = Lrow_ptr[i];
+	for(i=0; i<NUMNP; i++)	//going down the rows of Lt keeps the columns of L increasing
+	{
+		for(j=L_row_ptr[i]; j<L_row_ptr[i+1]; j++)
+		{
+			Lrow_col[next[L_col_ind[j]]] = i;
+			Lrow_val[next[L_col_ind[j]]] = Lt[j];
+			next[L_col_ind[j]]++;
+		}
+	}
+
+	//forward levels, row i is one level past the last row it depends on
+	nFwdLevels = 0;
+	for(i=0; i<NUMNP; i++)
+	{
+		level[i] = 0;
+		for(j=Lrow_ptr[i]; j<Lrow_ptr[i+1]; j++)
+		{
+			if(level[Lrow_col[j]] + 1 > level[i])
+				level[i] = level[Lrow_col[j]] + 1;
+		}
+		if(level[i] + 1 > nFwdLevels)
+			nFwdLevels = level[i] + 1;
+	}
+
+	//bucket the rows by level, increasing row numbers within a level
+	fwdLevel_ptr = new int[nFwdLevels+1];
+	fwdLevel_rows = new int[NUMNP];
+	for(l=0; l<=nFwdLevels; l++)
+		fwdLevel_ptr[l] = 0;
+	for(i=0; i<NUMNP; i++)
+		fwdLevel_ptr[level[i]+1]++;
+	for(l=0; l<nFwdLevels; l++)
+		fwdLevel_ptr[l+1] += fwdLevel_ptr[l];
+	for(l=0; l<nFwdLevels; l++)
+		next[l] = fwdLevel_ptr[l];
+	for(i=0; i<NUMNP; i++)
+		fwdLevel_rows[next[level[i]]++] = i;
+
+	//copy L in forward solve order
+	Lfwd_ptr = new int[NUMNP+1];
+	Lfwd_col = new int[Lrow_ptr[NUMNP]];
+	Lfwd_val = new double[Lrow_ptr[NUMNP]];
+	count = 0;
+	for(n=0; n<NUMNP; n++)
+	{
+		i = fwdLevel_rows[n];
+		Lfwd_ptr[n] = count;
+		for(j=Lrow_ptr[i]; j<Lrow_ptr[i+1]; j++)
+		{
+			Lfwd_col[count] = Lrow_col[j];
+			Lfwd_val[count] = Lrow_val[j];
+			count++;
+		}
+	}
+	Lfwd_ptr[NUMNP] = count;
+
+	delete[] Lrow_ptr;
+	delete[] Lrow_col;
+	delete[] Lrow_val;
+
+	//backward levels, same thing going up from the last row
+	nBwdLevels = 0;
+	for(i=NUMNP-1; i>=0; i--)
+	{
+		level[i] = 0;
+		for(j=row_ptr[i]+1; j<row_ptr[i+1]; j++)
+		{
+			if(level[col_ind[j]] + 1 > level[i])
+				level[i] = level[col_ind[j]] + 1;
+		}
+		if(level[i] + 1 > nBwdLevels)
+			nBwdLevels = level[i] + 1;
+	}
+
+	bwdLevel_ptr = new int[nBwdLevels+1];
+	bwdLevel_rows = new int[NUMNP];
+	for(l=0; l<=nBwdLevels; l++)
+		bwdLevel_ptr[l] = 0;
+	for(i=0; i<NUMNP; i++)
+		bwdLevel_ptr[level[i]+1]++;
+	for(l=0; l<nBwdLevels; l++)
+		bwdLevel_ptr[l+1] += bwdLevel_ptr[l];
+	for(l=0; l<nBwdLevels; l++)
+		next[l] = bwdLevel_ptr[l];
+	for(i=0; i<NUMNP; i++)
+		bwdLevel_rows[next[level[i]]++] = i;
+
+	//copy U in backward solve order, diagonal separately
+	Ubwd_ptr = new int[NUMNP+1];
+	Ubwd_col = new int[row_ptr[NUMNP]-NUMNP];
+	Ubwd_val = new double[row_ptr[NUMNP]-NUMNP];
+	Ubwd_diag = new double[NUMNP];
+	count = 0;
+	for(n=0; n<NUMNP; n++)
+	{
+		i = bwdLevel_rows[n];
+		Ubwd_ptr[n] = count;
+		Ubwd_diag[n] = U[row_ptr[i]];
+		for(j=row_ptr[i]+1; j<row_ptr[i+1]; j++)
+		{
+			Ubwd_col[count] = col_ind[j];
+			Ubwd_val[count] = U[j];
+			count++;
+		}
+	}
+	Ubwd_ptr[NUMNP] = count;
+
+	delete[] next;
+	delete[] level;
+
+	if(singlePrecision)
+	{
+		Lfwd_valf = new float[Lfwd_ptr[NUMNP]];
+		for(j=0; j<Lfwd_ptr[NUMNP]; j++)
+			Lfwd_valf[j] = (float)Lfwd_val[j];
+		delete[] Lfwd_val;
+		Lfwd_val = NULL;
+		Ubwd_valf = new float[Ubwd_ptr[NUMNP]];
+		for(j=0; j<Ubwd_ptr[NUMNP]; j++)
+			Ubwd_valf[j] = (float)Ubwd_val[j];
+		delete[] Ubwd_val;
+		Ubwd_val = NULL;
+	}
+
+	delete[] Lt;
+	Lt = NULL;
+	delete[] L_col_ind;
+	L_col_ind = NULL;
+	delete[] L_row_ptr;
+	L_row_ptr = NULL;
+	delete[] U;
+	U = NULL;
+}
+
+/**
+ * Solves M*z = r for the ParallelSSOR preconditioner, first L*work = r then
+ * U*z = work.  Gives the same z as the SSOR preconditioner (up to round off)
+ * but the rows of each level are split over the threads.
+ * Lval and Uval are Lfwd_val and Ubwd_val, or their single precision copies.
+ */
+template<class T>
+void Preconditioner::levelScheduledSolve(const double *r, double *z, double *work, const T *Lval, const T *Uval) const
+{
+	int l, n, j;
+	double sum;
+
+#pragma omp parallel private(l,n,j,sum)
+	{
+		for(l=0; l<nFwdLevels; l++)
+		{
+			#pragma omp for
+			for(n=fwdLevel_ptr[l]; n<fwdLevel_ptr[l+1]; n++)
+			{
+				sum = r[fwdLevel_rows[n]];	//unit diagonal
+				for(j=Lfwd_ptr[n]; j<Lfwd_ptr[n+1]; j++)
+					sum -= (double)Lval[j]*work[Lfwd_col[j]];
+				work[fwdLevel_rows[n]] = sum;
+			}
+		}
+
+		for(l=0; l<nBwdLevels; l++)
+		{
+			#pragma omp for
+			for(n=bwdLevel_ptr[l]; n<bwdLevel_ptr[l+1]; n++)
+			{
+				sum = work[bwdLevel_rows[n]];
+				for(j=Ubwd_ptr[n]; j<Ubwd_ptr[n+1]; j++)
+					sum -= (double)Uval[j]*z[Ubwd_col[j]];
+				z[bwdLevel_rows[n]] = sum/Ubwd_diag[n];
+			}
+		}
+	}	//end parallel region
+}
+
+void Preconditioner::mkl_dcsrsv(const char *transa, const int *m, const double *alpha, const char *matdescra, const double *val, const int *indx, const int *pntrb, const int *pntre, const double *x, double *y) const
 {	// My version of the mkl_dcsrsv() function; solves val*y=x
 	// Only works for my specific settings
 	//		Case 1:
@@ -261,7 +608,7 @@ void Preconditioner::mkl_dcsrsv(char *transa, int *m, double *alpha, char *matde
 		throw std::logic_error("ERROR IN PRECONDITIONER: TRIANGULAR SOLVER FAILED");
 }
 
-void Preconditioner::cblas_dcopy(const int N, const double *X, const int incX, double *Y, const int incY)
+void Preconditioner::cblas_dcopy(const int N, const double *X, const int incX, double *Y, const int incY) const
 {	// My version of cblas_dcopy, only works for incX==1 and incY==1
 	int i;
 	for(i=0; i<N; i++)
@@ -39,6 +39,7 @@
 	
 
 #include "ninjaException.h"
+#include "geometricMultigrid.h"
 
 
 #ifdef _OPENMP
@@ -55,11 +56,19 @@ public:
 	enum precondType{
 		none,
 		Jacobi,
-		SSOR
+		SSOR,
+		ParallelSSOR,	//same preconditioner as SSOR, triangular solves run in parallel level by level
+		Multigrid	//geometric multigrid V-cycle, call set_gridDimensions() before initialize()
 	};
     
     bool initialize(int numnp, double *A, int *row_ptr, int *col_ind, int preconditionerType, char *matdescra);
 	bool solve(double *r, double *z, int *row_ptr, int *col_ind);
+	bool solve(double *r, double *z, int *row_ptr, int *col_ind, double *work) const;	//thread safe version, work must hold get_workSize() values
+	int get_type() const;	//precondType initialize() set up, Jacobi if the requested one failed
+	int get_numLevels() const;	//levels in the ParallelSSOR forward and backward solves together, or multigrid levels
+	int get_workSize() const;	//size of the work vector the thread safe solve() needs
+	void set_gridDimensions(int nrows, int ncols, int nlayers);	//mesh node dimensions, needed for Multigrid
+	void set_singlePrecision(bool single);	//store the ParallelSSOR factors in single precision, call before initialize()
 
 private:
 	
@@ -69,6 +78,21 @@ private:
 	double *Lt, *U;	//These are the upper and lower triangular matrices for the SSOR preconditioner
 	double *scratch;	//This is a vector used for intermediate computations in the SSOR preconditioner
 	int *L_row_ptr, *L_col_ind;
+
+	//stuff for the level scheduled (ParallelSSOR) triangular solves
+	int nFwdLevels, nBwdLevels;	//number of levels in the forward (L) and backward (U) solves
+	int *fwdLevel_ptr, *fwdLevel_rows;	//rows of each level, the rows of a level only depend on earlier levels
+	int *bwdLevel_ptr, *bwdLevel_rows;
+	int *Lfwd_ptr, *Lfwd_col;	//strict lower triangle of L by rows, row fwdLevel_rows[n] stored n-th
+	double *Lfwd_val;
+	int *Ubwd_ptr, *Ubwd_col;	//strict upper triangle of U by rows, row bwdLevel_rows[n] stored n-th
+	double *Ubwd_val, *Ubwd_diag;
+	bool singlePrecision;
+	float *Lfwd_valf, *Ubwd_valf;	//used instead of Lfwd_val and Ubwd_val if singlePrecision
+
+	//stuff for the multigrid preconditioner
+	int gridRows, gridCols, gridLayers;
+	GeometricMultigrid *multigrid;
 	//int *U_row_ptr, *U_col_ind;
 	double w;	//omega used in the SSOR preconditioner
 	
@@ -79,8 +103,11 @@ private:
 	char U_transa;	//solve using regular matrix (not transpose) y := alpha*inv(A)*x
 	char U_matdescra[6];
 
-	void mkl_dcsrsv(char *transa, int *m, double *alpha, char *matdescra, double *val, int *indx, int *pntrb, int *pntre, double *x, double *y);
-	void cblas_dcopy(const int N, const double *X, const int incX, double *Y, const int incY);
+	void buildLevels(const int *row_ptr, const int *col_ind);
+	template<class T>
+	void levelScheduledSolve(const double *r, double *z, double *work, const T *Lval, const T *Uval) const;
+	void mkl_dcsrsv(const char *transa, const int *m, const double *alpha, const char *matdescra, const double *val, const int *indx, const int *pntrb, const int *pntre, const double *x, double *y) const;
+	void cblas_dcopy(const int N, const double *X, const int incX, double *Y, const int incY) const;
 };
 
 #endif	//PRECONDITIONER_H
@@ -79,9 +79,9 @@ Solar::Solar(Solar &s)
 	slope = s.slope;
 	solarIntensity = s.solarIntensity;
 
+	//keep the sun position computed for s
 	solarPosData = new posdata;
-
-	set_allSolarPosData();
+	*solarPosData = *s.solarPosData;
 	
 }
 
@@ -194,6 +194,32 @@ bool Solar::call_solPos()
 	return true;
 }
 
+/**
+ * Extraterrestrial solar intensity on a surface of another aspect and slope
+ * at the time and place of the last call_solPos().  This is the tilt step of
+ * S_solpos() alone, so a grid of cells only computes the sun position once.
+ * @param aspect_in Aspect of the surface in degrees from north.
+ * @param slope_in Slope of the surface in degrees from horizontal.
+ * @return Solar intensity in W/m^2, 0 if the sun is behind the surface.
+ */
+double Solar::get_solarIntensity(double aspect_in, double slope_in) const
+{
+	const double raddeg = 0.0174532925;	//same as solpos
+	double ca = cos(raddeg * solarPosData->azim);
+	double cp = cos(raddeg * aspect_in);
+	double ct = cos(raddeg * slope_in);
+	double sa = sin(raddeg * solarPosData->azim);
+	double sp = sin(raddeg * aspect_in);
+	double st = sin(raddeg * slope_in);
+	double sz = sin(raddeg * solarPosData->zenref);
+	double cosinc = solarPosData->coszen * ct + sz * st * (ca * cp + sa * sp);
+
+	if(cosinc > 0.0)
+		return solarPosData->etrn * cosinc;
+	else
+		return 0.0;
+}
+
 bool Solar::print_allSolarPosData()
 {
 	//Compute offset from UTC, including if in daylight savings or not
@@ -255,8 +281,7 @@ Solar &Solar::operator=(Solar &S)
           if(solarPosData)
                delete solarPosData;
 		solarPosData = new posdata;
-
-		set_allSolarPosData();
+		*solarPosData = *S.solarPosData;
 	}
 	return *this;
 }
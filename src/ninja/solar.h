@@ -92,6 +92,7 @@ public:
     
 	bool set_allSolarPosData();
 	bool call_solPos();
+	double get_solarIntensity(double aspect_in, double slope_in) const;
 //	bool call_solPos(int day_in, int month_in, int year_in,
 //		int second_in, int minute_in, int hour_in,
 //		double latitude_in, double longitude_in,
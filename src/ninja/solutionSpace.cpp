@@ -0,0 +1,236 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Initial guesses for the solver from previous solutions
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "solutionSpace.h"
+
+#include <cmath>
+
+SolutionSpace::SolutionSpace()
+{
+    NUMNP = 0;
+    maxVectors = 0;
+    coldStartIterations = -1;
+    omp_init_lock(&lock);
+}
+
+SolutionSpace::~SolutionSpace()
+{
+    omp_destroy_lock(&lock);
+}
+
+/**
+ * Set the size of the vectors and how many of them to keep.  Empties the
+ * space if the size changes.
+ * @param NUMNP Number of nodal points, the size of the solution vectors.
+ * @param maxVectors Maximum number of solutions to keep.
+ */
+void SolutionSpace::initialize(int NUMNP, int maxVectors)
+{
+    omp_guard guard(lock);
+
+    if(NUMNP != this->NUMNP)
+    {
+        solutions.clear();
+        gram.clear();
+        coldStartIterations = -1;
+    }
+    this->NUMNP = NUMNP;
+    this->maxVectors = maxVectors;
+    while((int)solutions.size() > maxVectors)
+        dropOldest();
+}
+
+/**
+ * Forget all stored solutions, for instance because the matrix changed.
+ */
+void SolutionSpace::clear()
+{
+    omp_guard guard(lock);
+
+    solutions.clear();
+    gram.clear();
+    coldStartIterations = -1;
+}
+
+/**
+ * Compute the initial guess for A*x=b from the stored solutions.
+ * @param b Right hand side.
+ * @param x Set to the A-norm best approximation of the solution in the span of
+ *          the stored solutions, zero if the space is empty.
+ * @return The number of stored solutions used.
+ */
+int SolutionSpace::project(const double *b, double *x)
+{
+    omp_guard guard(lock);
+
+    int i, j, k;
+    int n = (int)solutions.size();
+    std::vector<double> c(n);
+
+    for(i=0; i<n; i++)
+    {
+        const double *xi = &solutions[i][0];
+        double sum = 0.0;
+#pragma omp parallel for reduction(+:sum)
+        for(j=0; j<NUMNP; j++)
+            sum += xi[j]*b[j];
+        c[i] = sum;
+    }
+
+    //Cholesky factorization G = L*L^T, leaving out the solutions that are
+    //(nearly) in the span of the ones before them
+    std::vector<std::vector<double> > L(n, std::vector<double>(n, 0.0));
+    std::vector<bool> used(n, false);
+    int nUsed = 0;
+    for(j=0; j<n; j++)
+    {
+        double d = gram[j][j];
+        for(k=0; k<j; k++)
+            d -= L[j][k]*L[j][k];
+        if(!(d > 1e-10*gram[j][j]))
+            continue;
+        used[j] = true;
+        nUsed++;
+        L[j][j] = std::sqrt(d);
+        for(i=j+1; i<n; i++)
+        {
+            double sum = gram[i][j];
+            for(k=0; k<j; k++)
+                sum -= L[i][k]*L[j][k];
+            L[i][j] = sum/L[j][j];
+        }
+    }
+
+    //solve L*L^T*c = (x_i.b), zero for the solutions left out
+    for(i=0; i<n; i++)
+    {
+        if(!used[i])
+        {
+            c[i] = 0.0;
+            continue;
+        }
+        for(k=0; k<i; k++)
+            c[i] -= L[i][k]*c[k];
+        c[i] /= L[i][i];
+    }
+    for(i=n-1; i>=0; i--)
+    {
+        if(!used[i])
+            continue;
+        for(k=i+1; k<n; k++)
+            c[i] -= L[k][i]*c[k];
+        c[i] /= L[i][i];
+    }
+
+#pragma omp parallel for private(i)
+    for(j=0; j<NUMNP; j++)
+    {
+        double xj = 0.0;
+        for(i=0; i<n; i++)
+            xj += c[i]*solutions[i][j];
+        x[j] = xj;
+    }
+
+    return nUsed;
+}
+
+/**
+ * Add a solution to the space, dropping the oldest one if it is full.
+ * @param x Solution of A*x=b.
+ * @param Ax The product A*x.
+ */
+void SolutionSpace::add(const double *x, const double *Ax)
+{
+    omp_guard guard(lock);
+
+    if(maxVectors <= 0)
+        return;
+    if((int)solutions.size() == maxVectors)
+        dropOldest();
+
+    int i, j;
+    int n = (int)solutions.size();
+    std::vector<double> row(n+1);
+
+    for(i=0; i<n; i++)
+    {
+        const double *xi = &solutions[i][0];
+        double sum = 0.0;
+#pragma omp parallel for reduction(+:sum)
+        for(j=0; j<NUMNP; j++)
+            sum += xi[j]*Ax[j];
+        row[i] = sum;
+    }
+    double xAx = 0.0;
+#pragma omp parallel for reduction(+:xAx)
+    for(j=0; j<NUMNP; j++)
+        xAx += x[j]*Ax[j];
+    row[n] = xAx;
+
+    if(!(xAx > 0.0))
+        return;     //x = 0 (or A is not positive definite), nothing to add
+
+    for(i=0; i<n; i++)
+        gram[i].push_back(row[i]);
+    gram.push_back(row);
+    solutions.push_back(std::vector<double>(x, x+NUMNP));
+}
+
+int SolutionSpace::get_numVectors()
+{
+    omp_guard guard(lock);
+    return (int)solutions.size();
+}
+
+/**
+ * Record the iterations of a solve that started from a zero initial guess,
+ * the reference for the iterations saved by the initial guesses.  Only the
+ * first call after the space was emptied counts.
+ * @param iterations Number of solver iterations.
+ */
+void SolutionSpace::set_coldStartIterations(int iterations)
+{
+    omp_guard guard(lock);
+    if(coldStartIterations < 0)
+        coldStartIterations = iterations;
+}
+
+int SolutionSpace::get_coldStartIterations()
+{
+    omp_guard guard(lock);
+    return coldStartIterations;
+}
+
+//the caller holds the lock
+void SolutionSpace::dropOldest()
+{
+    solutions.erase(solutions.begin());
+    gram.erase(gram.begin());
+    for(unsigned int i=0; i<gram.size(); i++)
+        gram[i].erase(gram[i].begin());
+}
@@ -0,0 +1,95 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Initial guesses for the solver from previous solutions
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef SOLUTION_SPACE_H
+#define SOLUTION_SPACE_H
+
+#include <vector>
+
+#include "omp_guard.h"
+
+/**
+ * Previous solutions of A*x=b, used to compute the initial guess for the next
+ * right hand side with the same matrix A.
+ *
+ * The matching loop of a point initialization run and the time steps of an
+ * army solve with the same stiffness matrix over and over, and neighbouring
+ * right hand sides are very similar.  Instead of starting the conjugate
+ * gradient solver from zero, the new solution is first approximated in the
+ * span of the stored solutions (Fischer, "Projection techniques for iterative
+ * solution of Ax=b with successive right-hand sides", 1998).
+ *
+ * The best approximation of A^(-1)*b in the span of x_1..x_n in the A-norm
+ * is x0 = sum_i c_i x_i with
+ *
+ *      G c = (x_1.b, ..., x_n.b),      G_ij = x_i.A*x_j
+ *
+ * so only the small Gram matrix G has to be solved, A is not needed.  G is
+ * updated with one row per solution added, from x and A*x.  The space keeps
+ * the newest maxVectors solutions; nearly dependent ones are left out of the
+ * solve of G (their Cholesky pivot is tiny).
+ *
+ * All public functions lock, so one SolutionSpace can be shared by runs on
+ * different threads (see DomainContext).  Which solutions the space holds then
+ * depends on the order the runs finish in, so the initial guess, and with it
+ * the solution (within the solver tolerance), can differ from one execution
+ * to the next.
+ */
+class SolutionSpace
+{
+public:
+    SolutionSpace();
+    ~SolutionSpace();
+
+    void initialize(int NUMNP, int maxVectors);
+    void clear();
+
+    int project(const double *b, double *x);           //x = best approximation of A^(-1)*b, returns the number of vectors used
+    void add(const double *x, const double *Ax);        //add a solution x (and A*x) to the space
+
+    int get_numVectors();
+
+    void set_coldStartIterations(int iterations);       //iterations of a solve started from zero
+    int get_coldStartIterations();
+
+private:
+    SolutionSpace(const SolutionSpace &rhs);            //not copyable
+    SolutionSpace &operator=(const SolutionSpace &rhs);
+
+    void dropOldest();
+
+    int NUMNP;
+    int maxVectors;
+    std::vector<std::vector<double> > solutions;        //oldest first
+    std::vector<std::vector<double> > gram;             //gram[i][j] = solutions[i].A*solutions[j]
+    int coldStartIterations;                            //-1 if not known yet
+
+    omp_lock_t lock;
+};
+
+#endif  //SOLUTION_SPACE_H
@@ -0,0 +1,261 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Sparse matrix-vector products used by the solvers
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+
+#include "sparseMatVec.h"
+
+#include <cstddef>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+template<class T>
+static void symmetricCsrMatVecKernel(int N, const T *val, const int *indx,
+                                     const int *pntrb, const int *pntre,
+                                     const double *x, double *y,
+                                     const double *r, double *xAx, double *rx);
+
+/**
+ * Computes y = A*x for a symmetric matrix with only the upper triangle stored.
+ *
+ * Row i contributes A(i,j)*x[j] to y[i] and, through the transpose,
+ * A(i,j)*x[i] to y[j] for j > i.  The rows are split into one contiguous
+ * block per thread.  Transpose contributions landing inside the thread's own
+ * block are added to y directly; the ones past the end of the block (at most
+ * one matrix bandwidth's worth) go to a per-thread halo buffer.  After a
+ * barrier the halos are added to y one thread at a time, each split over all
+ * threads, so no two threads ever write the same entry of y.
+ *
+ * @param N Number of rows (and columns) of A.
+ * @param val Nonzero values of the upper triangle of A, row by row.
+ * @param indx Column index of each entry of val.
+ * @param pntrb Index in val of the first entry (the diagonal) of each row.
+ * @param pntre Index in val one past the last entry of each row.
+ * @param x Vector of size N.
+ * @param y Vector of size N to store the result in.
+ */
+void symmetricCsrMatVec(int N, const double *val, const int *indx,
+                        const int *pntrb, const int *pntre,
+                        const double *x, double *y)
+{
+    symmetricCsrMatVecKernel(N, val, indx, pntrb, pntre, x, y, NULL, NULL, NULL);
+}
+
+/**
+ * Computes y = A*x like symmetricCsrMatVec() and in the same sweep the dot
+ * products x.y (= x'*A*x) and, if r is not NULL, r.x.  The conjugate gradient
+ * solver needs both right after its matrix vector product, so it does not
+ * have to read x, y and r again.
+ *
+ * x'*A*x is summed row by row from the stored upper triangle: row i adds
+ * x[i]*(A(i,i)*x[i] + 2*sum_j>i A(i,j)*x[j]).  The thread partial sums are
+ * added in thread order, so the result is the same on every call with the
+ * same number of threads.
+ *
+ * @param r Vector of size N, or NULL.
+ * @param rx Where to store r.x, not used if r is NULL.
+ * @return x.y
+ */
+double symmetricCsrMatVecDot(int N, const double *val, const int *indx,
+                             const int *pntrb, const int *pntre,
+                             const double *x, double *y,
+                             const double *r, double *rx)
+{
+    double xAx = 0.0;
+    symmetricCsrMatVecKernel(N, val, indx, pntrb, pntre, x, y, r, &xAx, rx);
+    return xAx;
+}
+
+/**
+ * symmetricCsrMatVec() with the matrix values stored in single precision.
+ * Each value is converted to double as it is read, so only the memory
+ * traffic for val is halved, the products are summed in double.
+ */
+void symmetricCsrMatVec(int N, const float *val, const int *indx,
+                        const int *pntrb, const int *pntre,
+                        const double *x, double *y)
+{
+    symmetricCsrMatVecKernel(N, val, indx, pntrb, pntre, x, y, NULL, NULL, NULL);
+}
+
+/**
+ * symmetricCsrMatVecDot() with the matrix values stored in single precision.
+ */
+double symmetricCsrMatVecDot(int N, const float *val, const int *indx,
+                             const int *pntrb, const int *pntre,
+                             const double *x, double *y,
+                             const double *r, double *rx)
+{
+    double xAx = 0.0;
+    symmetricCsrMatVecKernel(N, val, indx, pntrb, pntre, x, y, r, &xAx, rx);
+    return xAx;
+}
+
+/*
+** Shared by symmetricCsrMatVec() and symmetricCsrMatVecDot() for double (T =
+** double) and single (T = float) precision matrix values, the dot products
+** are only summed if xAx is not NULL.
+*/
+template<class T>
+static void symmetricCsrMatVecKernel(int N, const T *val, const int *indx,
+                                     const int *pntrb, const int *pntre,
+                                     const double *x, double *y,
+                                     const double *r, double *xAx, double *rx)
+{
+    int maxThreads = 1;
+#ifdef _OPENMP
+    maxThreads = omp_get_max_threads();
+#endif
+    std::vector<double*> halo(maxThreads, (double*)NULL);
+    std::vector<int> haloStart(maxThreads, 0);
+    std::vector<int> haloSize(maxThreads, 0);
+    std::vector<double> partialXAx(maxThreads, 0.0);
+    std::vector<double> partialRx(maxThreads, 0.0);
+    int usedThreads = 1;
+
+#pragma omp parallel
+    {
+        int i, j, col, t, h;
+        int nThreads = 1;
+        int thread = 0;
+#ifdef _OPENMP
+        nThreads = omp_get_num_threads();
+        thread = omp_get_thread_num();
+#endif
+        int start = (int)(((long long)N * thread) / nThreads);
+        int end = (int)(((long long)N * (thread + 1)) / nThreads);
+
+        //columns increase along a row, so the last entry is the farthest one
+        int haloEnd = end;
+        for(i=start;i<end;i++)
+        {
+            if(indx[pntre[i]-1] + 1 > haloEnd)
+                haloEnd = indx[pntre[i]-1] + 1;
+        }
+
+        std::vector<double> myHalo(haloEnd - end, 0.0);
+        halo[thread] = myHalo.empty() ? NULL : &myHalo[0];
+        haloStart[thread] = end;
+        haloSize[thread] = haloEnd - end;
+
+        for(i=start;i<end;i++)
+            y[i] = 0.0;
+
+        double myXAx = 0.0, myRx = 0.0;
+        for(i=start;i<end;i++)
+        {
+            double xi = x[i];
+            double diag = (double)val[pntrb[i]]*xi;
+            double sum = diag;
+            for(j=pntrb[i]+1;j<pntre[i];j++)
+            {
+                double a = val[j];
+                col = indx[j];
+                sum += a*x[col];
+                if(col < end)
+                    y[col] += a*xi;
+                else
+                    myHalo[col-end] += a*xi;
+            }
+            y[i] += sum;
+            if(xAx)
+            {
+                myXAx += xi*(2.0*sum - diag);
+                if(r)
+                    myRx += r[i]*xi;
+            }
+        }
+        partialXAx[thread] = myXAx;
+        partialRx[thread] = myRx;
+        if(thread == 0)
+            usedThreads = nThreads;
+
+        #pragma omp barrier
+
+        for(t=0;t<nThreads;t++)
+        {
+            double *th = halo[t];
+            double *ty = y + haloStart[t];
+            #pragma omp for
+            for(h=0;h<haloSize[t];h++)
+                ty[h] += th[h];
+        }
+    }   //end parallel region, myHalo is freed after all threads are done with it
+
+    if(xAx)
+    {
+        *xAx = 0.0;
+        for(int t=0;t<usedThreads;t++)
+            *xAx += partialXAx[t];
+        if(r)
+        {
+            *rx = 0.0;
+            for(int t=0;t<usedThreads;t++)
+                *rx += partialRx[t];
+        }
+    }
+}
+
+/**
+ * Computes y = A*x for a symmetric matrix with only the upper triangle stored.
+ * The row products are done in parallel, the transpose part serially.  See
+ * symmetricCsrMatVec() for the parameters.
+ */
+void symmetricCsrMatVecSerial(int N, const double *val, const int *indx,
+                              const int *pntrb, const int *pntre,
+                              const double *x, double *y)
+{
+    int i, j;
+
+#pragma omp parallel private(i,j)
+    {
+        #pragma omp for
+        for(i=0;i<N;i++)
+            y[i]=0.0;
+
+        #pragma omp for
+        for(i=0;i<N;i++)
+        {
+            y[i] += val[pntrb[i]]*x[i];	// diagonal
+            for(j=pntrb[i]+1;j<pntre[i];j++)
+            {
+                y[i] += val[j]*x[indx[j]];
+            }
+        }
+    }	//end parallel region
+
+    for(i=0;i<N;i++)
+    {
+        for(j=pntrb[i]+1;j<pntre[i];j++)
+        {
+            y[indx[j]] += val[j]*x[i];
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Sparse matrix-vector products used by the solvers
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+
+#ifndef SPARSE_MAT_VEC_H
+#define SPARSE_MAT_VEC_H
+
+/*
+** Products of a symmetric matrix stored as its upper triangle in compressed
+** row storage (the SK, col_ind, row_ptr arrays built in ninja::discretize())
+** with a vector, y = A*x.  The diagonal must be the first entry of each row
+** and the column indices of a row must increase.
+*/
+
+//Parallel version.  Each thread takes a contiguous block of rows and keeps
+//the transpose contributions that fall past the end of its block in a small
+//halo buffer, which is added to y once all threads are done.
+void symmetricCsrMatVec(int N, const double *val, const int *indx,
+                        const int *pntrb, const int *pntre,
+                        const double *x, double *y);
+
+//Same as symmetricCsrMatVec(), also returns x.y and, if r is not NULL, sets
+//rx = r.x, all in one sweep.
+double symmetricCsrMatVecDot(int N, const double *val, const int *indx,
+                             const int *pntrb, const int *pntre,
+                             const double *x, double *y,
+                             const double *r, double *rx);
+
+//Single precision storage of the matrix values (see ninja::solveMixedPrecision()),
+//the vectors and all sums are double.
+void symmetricCsrMatVec(int N, const float *val, const int *indx,
+                        const int *pntrb, const int *pntre,
+                        const double *x, double *y);
+double symmetricCsrMatVecDot(int N, const float *val, const int *indx,
+                             const int *pntrb, const int *pntre,
+                             const double *x, double *y,
+                             const double *r, double *rx);
+
+//Original version with a serial transpose loop, kept as a reference for the
+//tests and the spmv benchmark.
+void symmetricCsrMatVecSerial(int N, const double *val, const int *indx,
+                              const int *pntrb, const int *pntre,
+                              const double *x, double *y);
+
+#endif  //SPARSE_MAT_VEC_H
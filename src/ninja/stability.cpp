@@ -131,7 +131,7 @@ void Stability::Set3dVariableAlpha(WindNinjaInputs &input,
 
     
     wn_3dVectorField thetaDerivatives;
-    theta.ComputeGradient(input, thetaDerivatives); // calculate dtheta/dz, dx, dy at each node
+    theta.ComputeGradient(thetaDerivatives); // calculate dtheta/dz, dx, dy at each node
     
     hTest = 0.0;
     hMax = mesh.ZORD(0,0,0);
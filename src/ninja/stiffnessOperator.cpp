@@ -0,0 +1,390 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Matrix-free application of the stiffness matrix
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "stiffnessOperator.h"
+
+StiffnessOperator::StiffnessOperator()
+{
+    NUMNP = 0;
+    mesh_ = NULL;
+    geometry_ = NULL;
+    alphaVfield_ = NULL;
+    alphaH_ = 1.0;
+    preconditionerType_ = Jacobi;
+    chebyshevDegree_ = 4;
+    lambdaMin = 0.0;
+    lambdaMax = 0.0;
+
+    isBoundaryNode = NULL;
+    invDiag = NULL;
+    xMasked = NULL;
+    chebRes = NULL;
+    chebDir = NULL;
+    chebAd = NULL;
+}
+
+StiffnessOperator::~StiffnessOperator()
+{
+    deallocate();
+}
+
+void StiffnessOperator::deallocate()
+{
+    if(isBoundaryNode)
+    {
+        delete[] isBoundaryNode;
+        isBoundaryNode = NULL;
+    }
+    if(invDiag)
+    {
+        delete[] invDiag;
+        invDiag = NULL;
+    }
+    if(xMasked)
+    {
+        delete[] xMasked;
+        xMasked = NULL;
+    }
+    if(chebRes)
+    {
+        delete[] chebRes;
+        chebRes = NULL;
+    }
+    if(chebDir)
+    {
+        delete[] chebDir;
+        chebDir = NULL;
+    }
+    if(chebAd)
+    {
+        delete[] chebAd;
+        chebAd = NULL;
+    }
+}
+
+/**
+ * Sets up the operator and its preconditioner.
+ * @param m Mesh the equations are discretized on.
+ * @param geometry Element geometry factors of m.
+ * @param alphaVfield Nodal alphaV values (see ninja::discretize()) or NULL if alphaV = 1.
+ * @param alphaH alphaH from the governing equation.
+ * @param preconditionerType StiffnessOperator::Jacobi or StiffnessOperator::Chebyshev.
+ * @param chebyshevDegree Degree of the Chebyshev polynomial (operator applications per preconditioner call).
+ */
+void StiffnessOperator::initialize(Mesh const* m, ElementGeometry const* geometry,
+                                   wn_3dScalarField const* alphaVfield, double alphaH,
+                                   int preconditionerType, int chebyshevDegree)
+{
+    deallocate();
+
+    mesh_ = m;
+    mesh_->get_nodeStrides(nodeStrides_);
+    geometry_ = geometry;
+    alphaVfield_ = alphaVfield;
+    alphaH_ = alphaH;
+    preconditionerType_ = preconditionerType;
+    chebyshevDegree_ = chebyshevDegree;
+    NUMNP = mesh_->NUMNP;
+
+    if(preconditionerType_ != Jacobi && preconditionerType_ != Chebyshev)
+        throw std::logic_error("Unknown preconditioner type in StiffnessOperator::initialize().");
+    if(preconditionerType_ == Chebyshev && chebyshevDegree_ < 1)
+        throw std::logic_error("The Chebyshev preconditioner degree must be at least 1.");
+
+    isBoundaryNode = new bool[NUMNP];
+    invDiag = new double[NUMNP];
+    xMasked = new double[NUMNP];
+
+    int i, j, k;
+#pragma omp parallel for default(shared) private(i,j,k)
+    for(k=0;k<mesh_->nlayers;k++)
+    {
+        for(i=0;i<mesh_->nrows;i++)
+        {
+            for(j=0;j<mesh_->ncols;j++)
+            {
+                //same boundary nodes as in ninja::setBoundaryConditions()
+                isBoundaryNode[k*mesh_->ncols*mesh_->nrows+i*mesh_->ncols+j] =
+                    (j==0||j==(mesh_->ncols-1)||i==0||i==(mesh_->nrows-1)||k==(mesh_->nlayers-1));
+            }
+        }
+    }
+
+    computeDiagonal();
+
+    if(preconditionerType_ == Chebyshev)
+    {
+        chebRes = new double[NUMNP];
+        chebDir = new double[NUMNP];
+        chebAd = new double[NUMNP];
+        computeEigenvalueBound();
+    }
+}
+
+/**
+ * Computes y = A*x without forming A.
+ * Boundary rows and columns of A are those of the identity, as set by
+ * ninja::setBoundaryConditions().
+ */
+void StiffnessOperator::apply(const double *x, double *y)
+{
+    int i;
+#pragma omp parallel for default(shared) private(i)
+    for(i=0;i<NUMNP;i++)
+    {
+        xMasked[i] = isBoundaryNode[i] ? 0.0 : x[i];
+        y[i] = 0.0;
+    }
+
+    loopElements(elemProduct, xMasked, y);
+
+#pragma omp parallel for default(shared) private(i)
+    for(i=0;i<NUMNP;i++)
+    {
+        if(isBoundaryNode[i])
+            y[i] = x[i];
+    }
+}
+
+/**
+ * Applies the preconditioner, z = M^(-1)*r.
+ * For the Chebyshev preconditioner z is the result of chebyshevDegree_ steps
+ * of Chebyshev iteration on A*z = r (Jacobi scaled, starting from z = 0)
+ * targeting the eigenvalue interval [lambdaMin, lambdaMax] of D^(-1)*A.
+ * This is a fixed polynomial in D^(-1)*A, so it is symmetric positive definite
+ * and can be used with CG.
+ */
+void StiffnessOperator::precondition(const double *r, double *z)
+{
+    int i;
+    if(preconditionerType_ == Jacobi)
+    {
+#pragma omp parallel for default(shared) private(i)
+        for(i=0;i<NUMNP;i++)
+            z[i] = invDiag[i]*r[i];
+        return;
+    }
+
+    double theta = 0.5*(lambdaMax + lambdaMin);
+    double delta = 0.5*(lambdaMax - lambdaMin);
+    double sigma = theta/delta;
+    double rho = 1.0/sigma;
+    double rhoNew;
+
+#pragma omp parallel for default(shared) private(i)
+    for(i=0;i<NUMNP;i++)
+    {
+        z[i] = 0.0;
+        chebRes[i] = r[i];
+        chebDir[i] = invDiag[i]*r[i]/theta;
+    }
+
+    for(int n=0; n<chebyshevDegree_; n++)
+    {
+#pragma omp parallel for default(shared) private(i)
+        for(i=0;i<NUMNP;i++)
+            z[i] += chebDir[i];
+
+        if(n == chebyshevDegree_-1)
+            break;
+
+        apply(chebDir, chebAd);
+
+        rhoNew = 1.0/(2.0*sigma - rho);
+#pragma omp parallel for default(shared) private(i)
+        for(i=0;i<NUMNP;i++)
+        {
+            chebRes[i] -= chebAd[i];
+            chebDir[i] = rhoNew*rho*chebDir[i] + 2.0*rhoNew/delta*invDiag[i]*chebRes[i];
+        }
+        rho = rhoNew;
+    }
+}
+
+/**
+ * Loops over the elements, adding each element's contribution to out (see
+ * elementProduct()).
+ * Elements are done in 8 colours (parity of the element (i,j,k) index) like in
+ * ninja::discretize(), so no two threads update the same node.
+ */
+void StiffnessOperator::loopElements(int op, const double *x, double *out)
+{
+#pragma omp parallel default(shared)
+    {
+        element elem(mesh_);
+        int color, c, ci, cj, ck, nci, ncj, nck, nColorElems;
+        int ei, ej, ek;
+
+        for(color=0;color<8;color++)
+        {
+            ci=color%2;
+            cj=(color/2)%2;
+            ck=color/4;
+            nci=(mesh_->nrowsElem-ci+1)/2;
+            ncj=(mesh_->ncolsElem-cj+1)/2;
+            nck=(mesh_->nlayersElem-ck+1)/2;
+            nColorElems=nci*ncj*nck;
+
+#pragma omp for
+            for(c=0;c<nColorElems;c++)
+            {
+                ei=2*((c/ncj)%nci)+ci;
+                ej=2*(c%ncj)+cj;
+                ek=2*(c/(ncj*nci))+ck;
+                elementProduct(elem, mesh_->get_elemNum(ei, ej, ek), mesh_->get_node0(ei, ej, ek), op, x, out);
+            }
+        }
+    }
+}
+
+/**
+ * Adds the contribution of one element to out, where S is the element
+ * stiffness matrix computed the same way as in ninja::discretize().
+ * Depending on op this is S*x, the diagonal of S or the row sums of |S|.
+ */
+void StiffnessOperator::elementProduct(element &elem, const int &elemNum, const int &node0, int op, const double *x, double *out)
+{
+    int nodes[8];
+    double xe[8], ye[8], Se[64];
+    double gx, gy, gz, alphaV, RX, RZ, dv, xq, yq, zq;
+    int k, l, q;
+
+    if(elem.SFV == NULL)
+        elem.initializeQuadPtArrays();
+
+    for(k=0;k<mesh_->NNPE;k++)
+    {
+        nodes[k] = node0 + nodeStrides_[k];
+        xe[k] = (op == elemProduct) ? x[nodes[k]] : 0.0;
+        ye[k] = 0.0;
+    }
+    if(op == elemAbsRowSum)
+    {
+        for(k=0;k<64;k++)
+            Se[k] = 0.0;
+    }
+
+    RX = 1.0/(2.0*alphaH_*alphaH_);     //RX = RY
+
+    for(q=0;q<elem.NUMQPTV;q++)
+    {
+        geometry_->get(elemNum, q, elem.DNDX, elem.DNDY, elem.DNDZ, dv, xq, yq, zq);     //dv = DETJ*WT
+
+        alphaV = 1.0;
+        if(alphaVfield_)
+        {
+            alphaV = 0.0;
+            for(k=0;k<mesh_->NNPE;k++)
+                alphaV += elem.SFV[0*mesh_->NNPE*elem.NUMQPTV+k*elem.NUMQPTV+q]*(*alphaVfield_)(nodes[k]);
+        }
+        RZ = 1.0/(2.0*alphaV*alphaV);
+
+        if(op == elemProduct)
+        {
+            gx = gy = gz = 0.0;
+            for(k=0;k<mesh_->NNPE;k++)
+            {
+                gx += elem.DNDX[k]*xe[k];
+                gy += elem.DNDY[k]*xe[k];
+                gz += elem.DNDZ[k]*xe[k];
+            }
+            for(k=0;k<mesh_->NNPE;k++)
+                ye[k] += dv*(elem.DNDX[k]*RX*gx + elem.DNDY[k]*RX*gy + elem.DNDZ[k]*RZ*gz);
+        }else if(op == elemDiagonal){
+            for(k=0;k<mesh_->NNPE;k++)
+                ye[k] += dv*(elem.DNDX[k]*RX*elem.DNDX[k] + elem.DNDY[k]*RX*elem.DNDY[k] + elem.DNDZ[k]*RZ*elem.DNDZ[k]);
+        }else{
+            for(k=0;k<mesh_->NNPE;k++)
+            {
+                for(l=0;l<mesh_->NNPE;l++)
+                    Se[k*8+l] += dv*(elem.DNDX[k]*RX*elem.DNDX[l] + elem.DNDY[k]*RX*elem.DNDY[l] + elem.DNDZ[k]*RZ*elem.DNDZ[l]);
+            }
+        }
+    }
+
+    if(op == elemAbsRowSum)
+    {
+        for(k=0;k<mesh_->NNPE;k++)
+        {
+            for(l=0;l<mesh_->NNPE;l++)
+                ye[k] += std::fabs(Se[k*8+l]);
+        }
+    }
+
+    for(k=0;k<mesh_->NNPE;k++)
+        out[nodes[k]] += ye[k];
+}
+
+void StiffnessOperator::computeDiagonal()
+{
+    int i;
+#pragma omp parallel for default(shared) private(i)
+    for(i=0;i<NUMNP;i++)
+        invDiag[i] = 0.0;
+
+    loopElements(elemDiagonal, NULL, invDiag);
+
+#pragma omp parallel for default(shared) private(i)
+    for(i=0;i<NUMNP;i++)
+    {
+        if(isBoundaryNode[i])
+            invDiag[i] = 1.0;
+        else
+            invDiag[i] = 1.0/invDiag[i];
+    }
+}
+
+/**
+ * Sets the eigenvalue interval the Chebyshev preconditioner works on.  The
+ * upper end is a Gershgorin bound of D^(-1)*A built from the element matrices,
+ * max_i sum_e sum_j |S_e(i,j)| / a_ii.  A power iteration estimate is cheaper
+ * to get close but is always from below, and if lambdaMax ends up under the
+ * true largest eigenvalue the Chebyshev polynomial is no longer positive
+ * definite and CG stalls.  The lower end is a fixed fraction of lambdaMax, the
+ * smoother only has to damp the upper part of the spectrum.
+ */
+void StiffnessOperator::computeEigenvalueBound()
+{
+    int i;
+    double bound = 1.0;     //boundary rows are identity rows
+
+#pragma omp parallel for default(shared) private(i)
+    for(i=0;i<NUMNP;i++)
+        chebRes[i] = 0.0;
+
+    loopElements(elemAbsRowSum, NULL, chebRes);
+
+    for(i=0;i<NUMNP;i++)    //serial, reduction(max) needs OpenMP 3.1 which MSVC lacks
+    {
+        if(!isBoundaryNode[i] && chebRes[i]*invDiag[i] > bound)
+            bound = chebRes[i]*invDiag[i];
+    }
+
+    lambdaMax = bound;
+    lambdaMin = lambdaMax/30.0;
+}
@@ -0,0 +1,102 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Matrix-free application of the stiffness matrix
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef STIFFNESS_OPERATOR_H
+#define STIFFNESS_OPERATOR_H
+
+#include "mesh.h"
+#include "element.h"
+#include "elementGeometry.h"
+#include "wn_3dScalarField.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Matrix-free version of the stiffness matrix built in ninja::discretize().
+ *
+ * Instead of storing SK in CRS format (about 14 doubles and 14 ints per node)
+ * the product A*x is computed element by element from the element geometry
+ * factors (see ElementGeometry) each time it is needed.  Only a few
+ * vectors of length NUMNP are stored.  The boundary conditions set in
+ * ninja::setBoundaryConditions() are applied on the fly, boundary rows and
+ * columns act as the identity.
+ *
+ * The operator comes with its own preconditioner: Jacobi (inverse of the
+ * diagonal) or a Chebyshev polynomial in the Jacobi scaled operator.  The
+ * Chebyshev preconditioner costs "degree" operator applications per call but
+ * cuts the number of CG iterations considerably.
+ */
+class StiffnessOperator
+{
+public:
+    StiffnessOperator();
+    ~StiffnessOperator();
+
+    enum precondType{
+        Jacobi,
+        Chebyshev
+    };
+
+    void initialize(Mesh const* m, ElementGeometry const* geometry,
+                    wn_3dScalarField const* alphaVfield, double alphaH,
+                    int preconditionerType, int chebyshevDegree);
+    void apply(const double *x, double *y);                 //y = A*x
+    void precondition(const double *r, double *z);          //z = M^(-1)*r
+
+    int NUMNP;
+
+private:
+    Mesh const* mesh_;
+    int nodeStrides_[8];                    //see Mesh::get_nodeStrides()
+    ElementGeometry const* geometry_;
+    wn_3dScalarField const* alphaVfield_;   //NULL if alphaV is 1 everywhere
+    double alphaH_;
+    int preconditionerType_;
+    int chebyshevDegree_;
+    double lambdaMin, lambdaMax;    //eigenvalue bounds of D^(-1)*A used by the Chebyshev preconditioner
+
+    bool *isBoundaryNode;
+    double *invDiag;        //inverse of the diagonal of A
+    double *xMasked;        //x with the boundary values removed
+    double *chebRes, *chebDir, *chebAd;     //work vectors for the Chebyshev preconditioner
+
+    enum elementOperation{
+        elemProduct,        //S*x
+        elemDiagonal,       //diagonal of S
+        elemAbsRowSum       //row sums of |S|
+    };
+    void elementProduct(element &elem, const int &elemNum, const int &node0, int op, const double *x, double *out);
+    void loopElements(int op, const double *x, double *out);
+    void computeDiagonal();
+    void computeEigenvalueBound();
+    void deallocate();
+};
+
+#endif  //STIFFNESS_OPERATOR_H
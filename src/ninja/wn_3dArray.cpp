@@ -38,16 +38,9 @@ wn_3dArray::wn_3dArray()
 }
 
 wn_3dArray::wn_3dArray(int rows, int cols, int layers)
-	: rows_ (rows)
-	, cols_ (cols)
-	, layers_ (layers)
 {
-#ifdef NINJA_DEBUG
-	if (rows <= 0 || cols <= 0 || layers <= 0)
-		throw std::range_error("Rows, columns, or layers are less than or equal to 0 in wn_3dArray::wn_3dArray(int rows, int cols, int layers).");
-#endif
-	if(rows>0 && cols>0 && layers>0)
-	    data_ = new double[rows * cols * layers];
+	data_ = NULL;
+	allocate(rows, cols, layers);
 }
 
 wn_3dArray::~wn_3dArray()
@@ -57,10 +50,11 @@ wn_3dArray::~wn_3dArray()
 
 wn_3dArray::wn_3dArray(wn_3dArray const& m)	// Copy constructor
 {
+	data_ = NULL;
 	allocate(m.rows_, m.cols_, m.layers_);
 
 	for(int i=0; i<rows_*cols_*layers_; i++)
-		data_[i] = m(i);
+		data_[i] = m.data_[i];
 }
 		
 wn_3dArray& wn_3dArray::operator= (wn_3dArray const& m)	// Assignment operator
@@ -70,7 +64,7 @@ wn_3dArray& wn_3dArray::operator= (wn_3dArray const& m)	// Assignment operator
 	    allocate(m.rows_, m.cols_, m.layers_);
 
 		for(int i=0; i<rows_*cols_*layers_; i++)
-			data_[i] = m(i);
+			data_[i] = m.data_[i];
 	}
 	return *this;
 }
@@ -103,47 +97,10 @@ void wn_3dArray::deallocate()
 	layers_ = 0;
 }
 
-double& wn_3dArray::operator() (int row, int col, int layer)
+void wn_3dArray::check(int row, int col, int layer) const
 {
-#ifdef NINJA_DEBUG
 	if(data_ == NULL)
 		throw std::domain_error("No memory allocated for \"data_\" in wn3dArray.");
 	if (row >= rows_ || col >= cols_ || layer >= layers_ || row < 0 || col < 0 || layer < 0)
 		throw std::range_error("Rows, columns, or layers are are out of range in wn_3dArray::operator()(int row, int col, int layer).");
-	
-#endif
-	return data_[layer*rows_*cols_ + cols_*row + col];
-}
-
-double wn_3dArray::operator() (int row, int col, int layer) const
-{
-#ifdef NINJA_DEBUG
-	if(data_ == NULL)
-		throw std::domain_error("No memory allocated for \"data_\" in wn3dArray.");
-	if (row >= rows_ || col >= cols_ || layer >= layers_ || row < 0 || col < 0 || layer < 0)
-		throw std::range_error("Rows, columns, or layers are are out of range in wn_3dArray::operator()(int row, int col, int layer) const.");
-#endif
-	return data_[layer*rows_*cols_ + cols_*row + col];
-}
-
-double& wn_3dArray::operator() (int num)
-{
-#ifdef NINJA_DEBUG
-	if(data_ == NULL)
-		throw std::domain_error("No memory allocated for \"data_\" in wn3dArray.");
-	if (num >= rows_*cols_*layers_)
-		throw std::range_error("Index is out of range in wn_3dArray::operator()(int num).");
-#endif
-	return data_[num];
-}
-
-double wn_3dArray::operator() (int num) const
-{
-#ifdef NINJA_DEBUG
-	if(data_ == NULL)
-		throw std::domain_error("No memory allocated for \"data_\" in wn3dArray.");
-	if (num >= rows_*cols_*layers_)
-		throw std::range_error("Index is out of range in wn_3dArray::operator()(int num).");
-#endif
-	return data_[num];
 }
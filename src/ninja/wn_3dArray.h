@@ -30,8 +30,17 @@
 #ifndef WN_3D_ARRAY_H
 #define WN_3D_ARRAY_H
 
+#include <stddef.h>
 #include "ninjaException.h"
 
+/**
+ * 3d array of doubles indexed (row, col, layer), stored layer by layer:
+ * layer*rows*cols + row*cols + col, the numbering of the mesh nodes, so
+ * operator()(num) and &a(0) are the raw data.
+ *
+ * The accessors are inline, they are called for every node of every element
+ * in the element loops.
+ */
 class wn_3dArray
 {
 	public:
@@ -45,16 +54,55 @@ class wn_3dArray
 		void allocate(int rows, int cols, int layers);	//make 3d array of this size, re-allocate if necessary
 		void deallocate();			//kills memory (data_ array)
 		
-		double& operator() (int row, int col, int layer);
-		double  operator() (int row, int col, int layer) const;
-		double& operator() (int num);
-		double  operator() (int num) const;
+		inline double& operator() (int row, int col, int layer);
+		inline double  operator() (int row, int col, int layer) const;
+		inline double& operator() (int num);
+		inline double  operator() (int num) const;
 		
 		int rows_, cols_, layers_;
 
 	private:
+		void check(int row, int col, int layer) const;
 		
 		double* data_;
 };
 
+inline double& wn_3dArray::operator() (int row, int col, int layer)
+{
+#ifdef NINJA_DEBUG
+	check(row, col, layer);
+#endif
+	return data_[layer*rows_*cols_ + cols_*row + col];
+}
+
+inline double wn_3dArray::operator() (int row, int col, int layer) const
+{
+#ifdef NINJA_DEBUG
+	check(row, col, layer);
+#endif
+	return data_[layer*rows_*cols_ + cols_*row + col];
+}
+
+inline double& wn_3dArray::operator() (int num)
+{
+#ifdef NINJA_DEBUG
+	if(data_ == NULL)
+		throw std::domain_error("No memory allocated for \"data_\" in wn3dArray.");
+	if (num >= rows_*cols_*layers_ || num < 0)
+		throw std::range_error("Index is out of range in wn_3dArray::operator()(int num).");
+#endif
+	return data_[num];
+}
+
+inline double wn_3dArray::operator() (int num) const
+{
+#ifdef NINJA_DEBUG
+	if(data_ == NULL)
+		throw std::domain_error("No memory allocated for \"data_\" in wn3dArray.");
+	if (num >= rows_*cols_*layers_ || num < 0)
+		throw std::range_error("Index is out of range in wn_3dArray::operator()(int num).");
+#endif
+	return data_[num];
+}
+
 #endif /* WN_3D_ARRAY_H */
@@ -29,6 +29,7 @@
  *****************************************************************************/
 
 #include "wn_3dScalarField.h"
+#include "elementGeometry.h"
 
 wn_3dScalarField::wn_3dScalarField()
 {
@@ -84,6 +85,29 @@ void wn_3dScalarField::deallocate()
 	scalarData_.deallocate();
 }
 
+/**
+ * @brief Pack three fields node by node, x, y, z of a node next to each other.
+ *
+ * Element loops gathering all three components at the 8 nodes of an element
+ * read one cache line per node from the packed array instead of three.
+ *
+ * @param x, y, z Fields on the same mesh.
+ * @param xyz Packed values, 3*NUMNP, xyz[3*n+c] is component c of node n.
+ */
+void wn_3dScalarField::packInterleaved(wn_3dScalarField const& x, wn_3dScalarField const& y,
+                                       wn_3dScalarField const& z, double *xyz)
+{
+    int n;
+    int NUMNP = x.mesh_->NUMNP;
+#pragma omp parallel for default(shared) private(n)
+    for(n=0;n<NUMNP;n++)
+    {
+        xyz[3*n] = x(n);
+        xyz[3*n+1] = y(n);
+        xyz[3*n+2] = z(n);
+    }
+}
+
 /**
  * @brief Interpolate a wn_3dScalarField from one mesh to another.
  * @param newScalarData The new wn_3dScalarField to be populated.
@@ -97,7 +121,7 @@ void wn_3dScalarField::interpolateScalarData(wn_3dScalarField &newScalarData,
 {
     element elem(&mesh);
     element elem_wx(this->mesh_);
-
+
 	int wx_i; //element index for wx model
 	int elem_wx_i, elem_wx_j, elem_wx_k; // wx model cells
     int elem_i, elem_j, elem_k; // wn cells
@@ -482,168 +506,32 @@ double wn_3dScalarField::interpolate(element &elem, const int &cell_i, const int
 	return value;
 }
 
-double& wn_3dScalarField::operator() (int row, int col, int layer)
-{
-	return scalarData_(row, col, layer);
-}
-
-double wn_3dScalarField::operator() (int row, int col, int layer) const
-{
-	return scalarData_(row, col, layer);
-}
-
-double& wn_3dScalarField::operator() (int num)
-{
-	return scalarData_(num);
-}
-
-double wn_3dScalarField::operator() (int num) const
-{
-	return scalarData_(num);
-}
-
 /**
  * @brief Calculate and store gradients at each node
  *
- * @param Reference to inputs
+ * The nodal gradients are smoothed from the quadrature points of the
+ * surrounding elements, see ElementGeometry::smoothGradient().
+ *
  * @param Reference to a wn_3dVectorField
+ * @param Element geometry factors of the mesh, computed here if NULL
  */
-void wn_3dScalarField::ComputeGradient(WindNinjaInputs &input, wn_3dVectorField &derivatives)
+void wn_3dScalarField::ComputeGradient(wn_3dVectorField &derivatives,
+                                       ElementGeometry const* geometry)
 {
-    int i, j, k;
-    double *DIAG;
     wn_3dScalarField x, y, z;
-    DIAG = NULL;
-
-    x.allocate(mesh_);    //x is positive toward East
-    y.allocate(mesh_);    //y is positive toward North
-    z.allocate(mesh_);    //z is positive up
-
-    if(DIAG == NULL)
-
-        DIAG=new double[mesh_->nlayers*input.dem.get_nRows()*input.dem.get_nCols()];  //DIAG is the sum of the weights at each nodal point; eventually, dPHI/dx, etc. are divided by this value to get the "smoothed" (or averaged) value of dPHI/dx at each node point
 
-    for(i=0;i<mesh_->NUMNP;i++)    //Initialize x,y, and z
+    ElementGeometry localGeometry;
+    if(geometry == NULL)
     {
-        x(i)=0.;
-        y(i)=0.;
-        z(i)=0.;
-        DIAG[i]=0.;
+        localGeometry.initialize(mesh_, ElementGeometry::compact);
+        geometry = &localGeometry;
     }
 
-	#pragma omp parallel default(shared) private(i,j,k)
-    {
-
-    element elem(mesh_);
-
-    double DPHIDX, DPHIDY, DPHIDZ;
-    double XJ, YJ, ZJ;
-    double wght, XK, YK, ZK;
-    double *xScratch, *yScratch, *zScratch, *DIAGScratch;
-    xScratch=NULL;
-    yScratch=NULL;
-    zScratch=NULL;
-    DIAGScratch=NULL;
-
-    xScratch=new double[mesh_->nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-    yScratch=new double[mesh_->nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-    zScratch=new double[mesh_->nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-    DIAGScratch=new double[mesh_->nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-
-    for(i=0;i<mesh_->NUMNP;i++)     //Initialize scratch x,y, and z
-    {
-        xScratch[i]=0.;
-        yScratch[i]=0.;
-        zScratch[i]=0.;
-        DIAGScratch[i]=0.;
-    }
-
-    #pragma omp for
-    for(i=0;i<mesh_->NUMEL;i++)     //Start loop over elements
-    {
-        elem.node0 = mesh_->get_node0(i);  //get the global node number of local node 0 of element i
-        for(j=0;j<elem.NUMQPTV;j++)      //Start loop over quadrature points in the element
-        {
-            DPHIDX=0.0;     //Set DPHI/DX, etc. to zero for the new quad point
-            DPHIDY=0.0;
-            DPHIDZ=0.0;
-
-            elem.computeJacobianQuadraturePoint(j, i, XJ, YJ, ZJ);
-
-            //Calculate dN/dx, dN/dy, dN/dz (Remember we're using the transpose of the inverse!)
-            for(k=0;k<mesh_->NNPE;k++)
-            {
-                elem.NPK=mesh_->get_global_node(k, i);            //NPK is the global node number
-
-                DPHIDX=DPHIDX+elem.DNDX[k]*(*this)(elem.NPK);       //Calculate the DPHI/DX, etc. for the quad point we are on
-                DPHIDY=DPHIDY+elem.DNDY[k]*(*this)(elem.NPK);
-                DPHIDZ=DPHIDZ+elem.DNDZ[k]*(*this)(elem.NPK);
-            }
-
-            //Now we know DPHI/DX, etc. for quad point j.  We will distribute this inverse distance weighted average to each nodal point for the cell we're on
-            for(k=0;k<mesh_->NNPE;k++)     //Start loop over nodes in the element
-            {                            //Calculate the Jacobian at the quad point
-                elem.NPK=mesh_->get_global_node(k, i);            //NPK is the global nodal number
-
-                XK=mesh_->XORD(elem.NPK);      //Coodinates of the nodal point
-                YK=mesh_->YORD(elem.NPK);
-                ZK=mesh_->ZORD(elem.NPK);
-
-                wght=std::pow((XK-XJ),2)+std::pow((YK-YJ),2)+std::pow((ZK-ZJ),2);
-                wght=1.0/(std::sqrt(wght));
-//c				#pragma omp critical
-                {
-                    xScratch[elem.NPK]=xScratch[elem.NPK]+wght*DPHIDX;   //Here we store the summing values of DPHI/DX, etc. in the x,y,z arrays
-                    yScratch[elem.NPK]=yScratch[elem.NPK]+wght*DPHIDY;
-                    zScratch[elem.NPK]=zScratch[elem.NPK]+wght*DPHIDZ;
-                    DIAGScratch[elem.NPK]=DIAGScratch[elem.NPK]+wght;    //Store the sum of the weights for the node
-                }
-            }                             //End loop over nodes in the element
-        }                                 //End loop over quadrature points in the element
-    }                                     //End loop over elements
-
-    #pragma omp critical
-    {
-    for(i=0;i<mesh_->NUMNP;i++)
-    {
-        x(i) += xScratch[i];      //Dividing by the DIAG[NPK] gives the value of DPHI/DX, etc. (stored in the x,y,z arrays)
-        y(i) += yScratch[i];
-        z(i) += zScratch[i];
-        DIAG[i] += DIAGScratch[i];
-    }
-    } //end critical
-
-    if(xScratch)
-    {
-        delete[] xScratch;
-		xScratch=NULL;
-    }
-    if(yScratch)
-    {
-        delete[] yScratch;
-		yScratch=NULL;
-    }
-    if(zScratch)
-    {
-		delete[] zScratch;
-		zScratch=NULL;
-    }
-    if(DIAGScratch)
-    {
-		delete[] DIAGScratch;
-		DIAGScratch=NULL;
-    }
-
-    #pragma omp barrier
+    x.allocate(mesh_);    //x is positive toward East
+    y.allocate(mesh_);    //y is positive toward North
+    z.allocate(mesh_);    //z is positive up
 
-    #pragma omp for
-    for(i=0;i<mesh_->NUMNP;i++)
-    {
-        x(i)=x(i)/DIAG[i];      //Dividing by the DIAG[NPK] gives the value of DPHI/DX, etc.
-        y(i)=y(i)/DIAG[i];
-        z(i)=z(i)/DIAG[i];
-    }
-    }   //end parallel section
+    geometry->smoothGradient(&scalarData_(0), &x(0), &y(0), &z(0));
 
     wn_3dVectorField gradient_vector(x, y, z);
     derivatives = gradient_vector;
@@ -38,6 +38,8 @@
 #include "wn_3dVectorField.h"
 #include "WindNinjaInputs.h"
 
+class ElementGeometry;
+
 class wxModelInitialization;
 class wn_3dVectorField;
 class wn_3dScalarField
@@ -61,12 +63,15 @@ public:
                                
     double interpolate(double const& x,double const& y, double const& z);
     double interpolate(element &elem, const int &cell_i, const int &cell_j, const int &cell_k, const double &u, const double &v, const double &w);
-    void ComputeGradient(WindNinjaInputs &input, wn_3dVectorField &gradient_vector);
+    void ComputeGradient(wn_3dVectorField &gradient_vector,
+                         ElementGeometry const* geometry = NULL);
+    static void packInterleaved(wn_3dScalarField const& x, wn_3dScalarField const& y,
+                                wn_3dScalarField const& z, double *xyz);
 
-    double& operator() (int row, int col, int layer);
-    double  operator() (int row, int col, int layer) const;
-    double& operator() (int num);
-    double  operator() (int num) const;
+    inline double& operator() (int row, int col, int layer) {return scalarData_(row, col, layer);}
+    inline double  operator() (int row, int col, int layer) const {return scalarData_(row, col, layer);}
+    inline double& operator() (int num) {return scalarData_(num);}
+    inline double  operator() (int num) const {return scalarData_(num);}
 
 private:
     Mesh const* mesh_;
@@ -29,6 +29,29 @@
 
 #include "wxModelInitialization.h"
 
+#include <map>
+
+/*
+** Forecast data shared by the runs of an army: each run makes its own
+** wxModelInitialization, but all runs of a forecast read the same file.
+** Only used between setSharedForecastData(true) and (false), filled on the
+** first use then.
+*/
+namespace {
+
+struct WarpedForecastVariable
+{
+    double dfNoData;                            //of the source, -9999 if not set
+    std::vector<AsciiGrid<double> > bands;      //every band, warped to the DEM projection
+};
+
+std::map<std::string, std::vector<blt::local_date_time> > oSharedTimeLists;
+std::map<std::string, WarpedForecastVariable> oSharedWarpedVariables;
+double dfSharedWarpedMB = 0.0;
+bool bSharedForecastData = false;
+
+}
+
 
 // #define NC_NOERR        0       /* No Error */
 
@@ -531,6 +554,10 @@ std::vector<blt::local_date_time> wxModelInitialization::getTimeList(std::string
     if( aoCachedTimes.size() > 0 ) {
         return aoCachedTimes;
     }
+    std::string osKey = getForecastIdentifier() + "|" + wxModelFileName + "||" + timeZoneString;
+    if( getSharedTimeList( osKey, aoCachedTimes ) ) {
+        return aoCachedTimes;
+    }
     boost::local_time::time_zone_ptr timeZonePtr;
     timeZonePtr = globalTimeZoneDB.time_zone_from_region(timeZoneString.c_str());
     if( timeZonePtr == NULL ) {
@@ -541,6 +568,7 @@ std::vector<blt::local_date_time> wxModelInitialization::getTimeList(std::string
         throw std::runtime_error( os.str() );
     }
     aoCachedTimes = getTimeList( blt::time_zone_ptr ( timeZonePtr ) );
+    setSharedTimeList( osKey, aoCachedTimes );
     return aoCachedTimes;
 }
 /**
@@ -559,6 +587,11 @@ wxModelInitialization::getTimeList(const char *pszVariable,
     if( aoCachedTimes.size() > 0 ) {
         return aoCachedTimes;
     }
+    std::string osKey = getForecastIdentifier() + "|" + wxModelFileName + "|" +
+                        ( pszVariable ? pszVariable : "" ) + "|" + timeZoneString;
+    if( getSharedTimeList( osKey, aoCachedTimes ) ) {
+        return aoCachedTimes;
+    }
     boost::local_time::time_zone_ptr timeZonePtr;
     timeZonePtr = globalTimeZoneDB.time_zone_from_region(timeZoneString.c_str());
     if( timeZonePtr == NULL ) {
@@ -569,6 +602,7 @@ wxModelInitialization::getTimeList(const char *pszVariable,
         throw std::runtime_error( os.str() );
     }
     aoCachedTimes = getTimeList(pszVariable, blt::time_zone_ptr(timeZonePtr));
+    setSharedTimeList( osKey, aoCachedTimes );
     return aoCachedTimes;
 }
 
@@ -1132,8 +1166,10 @@ void wxModelInitialization::initializeFields(WindNinjaInputs &input,
     setGridHeaderData(input, cloud);
 
     //Read in wxModel grids (speed, direction, temperature and cloud cover grids)
+    double traceStart = NinjaTrace::now();
     setSurfaceGrids(input, airTempGrid_wxModel, cloudCoverGrid_wxModel, uGrid_wxModel,
                     vGrid_wxModel, wGrid_wxModel);
+    NinjaTrace::addPhase(input.inputsRunNumber, "init_read_forecast", traceStart, NinjaTrace::now());
 #ifdef NOMADS_ENABLE_3D
     set3dGrids(input, mesh);
 #endif
@@ -1173,6 +1209,8 @@ void wxModelInitialization::initializeFields(WindNinjaInputs &input,
 
 void wxModelInitialization::interpolateWxGridsToNinjaGrids(WindNinjaInputs &input)
 {
+    NinjaTraceScope trace(input.inputsRunNumber, "init_grids");
+
     //Interpolate from original wxModel grids to dem coincident grids
     airTempGrid.interpolateFromGrid(airTempGrid_wxModel, AsciiGrid<double>::order1);
     cloudCoverGrid.interpolateFromGrid(cloudCoverGrid_wxModel, AsciiGrid<double>::order1);
@@ -1230,6 +1268,8 @@ void wxModelInitialization::initializeWindFrom3dData(WindNinjaInputs &input,
                                 wn_3dScalarField& v0,
                                 wn_3dScalarField& w0)
 { 
+    NinjaTraceScope trace(input.inputsRunNumber, "init_profile");
+
     int kk;
     int i, j, k;
     double tempGradient;
@@ -1784,3 +1824,255 @@ std::string wxModelInitialization::getForecastReadable( const char bySwapWithSpa
     free( s );
     return os;
 }
+
+/**
+ * Look up a time list another run of the army has read.
+ * @param osKey Forecast identifier, file, variable and time zone.
+ * @param timeList Set to the time list if found.
+ * @return True if found.
+ */
+bool wxModelInitialization::getSharedTimeList( const std::string &osKey,
+                                               std::vector<blt::local_date_time> &timeList )
+{
+    bool bFound = false;
+#pragma omp critical(sharedForecastData)
+    {
+        std::map<std::string, std::vector<blt::local_date_time> >::const_iterator it =
+            oSharedTimeLists.find( osKey );
+        if( bSharedForecastData && it != oSharedTimeLists.end() ) {
+            timeList = it->second;
+            bFound = true;
+        }
+    }
+    return bFound;
+}
+
+void wxModelInitialization::setSharedTimeList( const std::string &osKey,
+                                               const std::vector<blt::local_date_time> &timeList )
+{
+    if( timeList.empty() )
+        return;
+#pragma omp critical(sharedForecastData)
+    {
+        if( bSharedForecastData )
+            oSharedTimeLists[osKey] = timeList;
+    }
+}
+
+/**
+ * Create a warped VRT of some bands of a forecast variable in the DEM
+ * projection, with the same options the surface initializations always
+ * used: nearest neighbour, destination initialized to the source no data
+ * value.
+ * @param srcDS Forecast variable.
+ * @param srcWkt Projection of the forecast.
+ * @param dstWkt Projection of the DEM.
+ * @param nBands Number of bands to warp.
+ * @param panBands Source band numbers, they are bands 1..nBands of the VRT.
+ * @param dfNoData Set to the no data value of the source, -9999 if it has none.
+ * @return The warped dataset.
+ * @throw badForecastFile if the forecast cannot be warped.
+ */
+GDALDataset* wxModelInitialization::createWarpedVRT( GDALDataset *srcDS,
+                                                     const std::string &srcWkt,
+                                                     const std::string &dstWkt,
+                                                     int nBands, const int *panBands,
+                                                     double &dfNoData )
+{
+    /*
+     * Grab the first band to get the nodata value for the variable,
+     * assume all bands have the same ndv
+     */
+    int pbSuccess;
+    dfNoData = srcDS->GetRasterBand( 1 )->GetNoDataValue( &pbSuccess );
+
+    GDALWarpOptions *psWarpOptions = GDALCreateWarpOptions();
+    psWarpOptions->nBandCount = nBands;
+    psWarpOptions->panSrcBands = (int*) CPLMalloc( sizeof( int ) * nBands );
+    psWarpOptions->panDstBands = (int*) CPLMalloc( sizeof( int ) * nBands );
+    psWarpOptions->padfDstNoDataReal = (double*) CPLMalloc( sizeof( double ) * nBands );
+    psWarpOptions->padfDstNoDataImag = (double*) CPLMalloc( sizeof( double ) * nBands );
+    for( int b = 0; b < nBands; b++ ) {
+        psWarpOptions->padfDstNoDataReal[b] = dfNoData;
+        psWarpOptions->padfDstNoDataImag[b] = dfNoData;
+        psWarpOptions->panSrcBands[b] = panBands[b];
+        psWarpOptions->panDstBands[b] = b + 1;
+    }
+    if( pbSuccess == FALSE )
+        dfNoData = -9999.0;
+
+    psWarpOptions->papszWarpOptions =
+        CSLSetNameValue( psWarpOptions->papszWarpOptions,
+                         "INIT_DEST", "NO_DATA" );
+
+    GDALDataset *wrpDS = (GDALDataset*) GDALAutoCreateWarpedVRT( srcDS, srcWkt.c_str(),
+                                                                 dstWkt.c_str(),
+                                                                 GRA_NearestNeighbour,
+                                                                 1.0, psWarpOptions );
+    GDALDestroyWarpOptions( psWarpOptions );
+    if( wrpDS == NULL ) {
+        throw badForecastFile( "Could not warp the forecast file, "
+                               "possibly non-uniform grid." );
+    }
+    return wrpDS;
+}
+
+/**
+ * Read one band of a forecast variable, warped to the DEM projection.
+ *
+ * The runs of an army read the same variables of the same file for
+ * different times.  Warping the whole variable for each of them (the warped
+ * VRT warps all its bands block by block) made an army of n time steps warp
+ * n*n bands.  Instead the first run warps and reads every band of the
+ * variable in one pass and the others copy their band from that.  Variables
+ * that would take the shared data over NINJA_WX_SHARED_MB megabytes (default
+ * 512) are not kept, only the requested band is warped for them.  Outside
+ * of the runs of an army (see setSharedForecastData()) only the requested
+ * band is warped as well.
+ *
+ * Callers reading netCDF files must hold netCDF_lock.
+ *
+ * @param srcName GDAL name of the variable, for example NETCDF:file:variable.
+ * @param srcWkt Projection of the forecast, or empty to use the one of the file.
+ * @param dstWkt Projection of the DEM.
+ * @param nBand Band number to read.
+ * @param grid Filled with the warped band.
+ * @return The no data value of the source, -9999 if it has none.
+ */
+double wxModelInitialization::readWarpedBand( const std::string &srcName,
+                                              const std::string &srcWkt,
+                                              const std::string &dstWkt,
+                                              int nBand, AsciiGrid<double> &grid )
+{
+    std::string osKey = srcName + "|" + srcWkt + "|" + dstWkt;
+    double dfNoData = -9999.0;
+    bool bFound = false;
+#pragma omp critical(sharedForecastData)
+    {
+        std::map<std::string, WarpedForecastVariable>::const_iterator it =
+            oSharedWarpedVariables.find( osKey );
+        if( it != oSharedWarpedVariables.end() ) {
+            if( nBand < 1 || nBand > (int)it->second.bands.size() )
+                bFound = false;
+            else {
+                grid = it->second.bands[nBand - 1];
+                dfNoData = it->second.dfNoData;
+                bFound = true;
+            }
+        }
+    }
+    if( bFound )
+        return dfNoData;
+
+    GDALDataset *srcDS = (GDALDataset*)GDALOpenShared( srcName.c_str(), GA_ReadOnly );
+    if( srcDS == NULL ) {
+        throw badForecastFile( "Could not open " + srcName + "." );
+    }
+    int nBandCount = srcDS->GetRasterCount();
+    if( nBand < 1 || nBand > nBandCount ) {
+        GDALClose( (GDALDatasetH) srcDS );
+        throw std::runtime_error( "Could not match ninjaTime with a band number in the forecast file." );
+    }
+    std::string osSrcWkt = srcWkt.empty() ? std::string( srcDS->GetProjectionRef() ) : srcWkt;
+    if( osSrcWkt.empty() ) {
+        CPLDebug( "wxModelInitialization::readWarpedBand()",
+                  "Bad forecast file" );
+    }
+
+    double dfMaxMB = atof( CPLGetConfigOption( "NINJA_WX_SHARED_MB", "512" ) );
+    bool bShare;
+    //estimate from the source, the budget is checked again when the
+    //variable is kept
+#pragma omp critical(sharedForecastData)
+    bShare = bSharedForecastData && dfSharedWarpedMB + (double)nBandCount * srcDS->GetRasterXSize() *
+                                srcDS->GetRasterYSize() * sizeof( double ) / ( 1024.0 * 1024.0 ) <= dfMaxMB;
+
+    if( !bShare ) {
+        GDALDataset *wrpDS = createWarpedVRT( srcDS, osSrcWkt, dstWkt, 1, &nBand, dfNoData );
+        GDAL2AsciiGrid( wrpDS, 1, grid );
+        GDALClose( (GDALDatasetH) wrpDS );
+        GDALClose( (GDALDatasetH) srcDS );
+        return dfNoData;
+    }
+
+    std::vector<int> anBands( nBandCount );
+    for( int b = 0; b < nBandCount; b++ )
+        anBands[b] = b + 1;
+    GDALDataset *wrpDS = createWarpedVRT( srcDS, osSrcWkt, dstWkt, nBandCount, &anBands[0], dfNoData );
+
+    int nXSize = wrpDS->GetRasterXSize();
+    int nYSize = wrpDS->GetRasterYSize();
+    double adfGeoTransform[6];
+    wrpDS->GetGeoTransform( adfGeoTransform );
+    std::string prj = wrpDS->GetProjectionRef();
+
+    //all bands in one pass over the blocks of the warped VRT
+    std::vector<double> adfData( (size_t)nXSize * nYSize * nBandCount );
+    CPLErr eErr = wrpDS->RasterIO( GF_Read, 0, 0, nXSize, nYSize, &adfData[0],
+                                   nXSize, nYSize, GDT_Float64, nBandCount, NULL,
+                                   0, 0, 0 );
+    if( eErr != CE_None ) {
+        GDALClose( (GDALDatasetH) wrpDS );
+        GDALClose( (GDALDatasetH) srcDS );
+        throw badForecastFile( "Could not read the forecast file " + srcName + "." );
+    }
+
+    WarpedForecastVariable variable;
+    variable.dfNoData = dfNoData;
+    variable.bands.resize( nBandCount );
+    for( int b = 0; b < nBandCount; b++ ) {
+        //same header as GDAL2AsciiGrid()
+        int pbSuccess = 0;
+        double dfBandNoData = wrpDS->GetRasterBand( b + 1 )->GetNoDataValue( &pbSuccess );
+        if( pbSuccess == false )
+            dfBandNoData = -9999.0;
+        AsciiGrid<double> &band = variable.bands[b];
+        band.set_headerData( nXSize, nYSize,
+                             adfGeoTransform[0], adfGeoTransform[3] + ( nYSize * adfGeoTransform[5] ),
+                             adfGeoTransform[1], dfBandNoData, dfBandNoData );
+        const double *padfBand = &adfData[(size_t)b * nXSize * nYSize];
+        for( int i = 0; i < nYSize; i++ )
+            for( int j = 0; j < nXSize; j++ )
+                band.set_cellValue( nYSize - 1 - i, j, padfBand[(size_t)i * nXSize + j] );
+        band.set_prjString( prj );
+    }
+    GDALClose( (GDALDatasetH) wrpDS );
+    GDALClose( (GDALDatasetH) srcDS );
+
+    grid = variable.bands[nBand - 1];
+    double dfVariableMB = (double)nBandCount * nXSize * nYSize * sizeof( double ) / ( 1024.0 * 1024.0 );
+    bool bKept = false;
+#pragma omp critical(sharedForecastData)
+    {
+        //other runs may have kept variables since the estimate above
+        if( bSharedForecastData &&
+            oSharedWarpedVariables.find( osKey ) == oSharedWarpedVariables.end() &&
+            dfSharedWarpedMB + dfVariableMB <= dfMaxMB ) {
+            oSharedWarpedVariables[osKey] = variable;
+            dfSharedWarpedMB += dfVariableMB;
+            bKept = true;
+        }
+    }
+    if( bKept )
+        CPLDebug( "NINJA", "Warped %d bands of %s for all runs.", nBandCount, srcName.c_str() );
+    return dfNoData;
+}
+
+/**
+ * Turn the time lists and warped forecast variables shared by the runs of
+ * an army on or off, freeing the ones kept so far either way.  They are
+ * only shared for the runs of one ninjaArmy::startRuns() (see
+ * SharedForecastDataScope), so callers using a forecast outside of it, or a
+ * forecast file downloaded again under the same name, read the file again.
+ * @param bShare True to share the forecast data.
+ */
+void wxModelInitialization::setSharedForecastData( bool bShare )
+{
+#pragma omp critical(sharedForecastData)
+    {
+        bSharedForecastData = bShare;
+        oSharedTimeLists.clear();
+        oSharedWarpedVariables.clear();
+        dfSharedWarpedMB = 0.0;
+    }
+}
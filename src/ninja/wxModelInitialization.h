@@ -129,6 +129,8 @@ class wxModelInitialization : public initialize
     std::string generateForecastName();
     
     void setModelFileName( std::string filename ) {wxModelFileName = filename;}
+
+    static void setSharedForecastData( bool bShare );
     
     void SetProgressFunc( GDALProgressFunc );
     void SetProgressArg( void *p );
@@ -160,6 +162,12 @@ class wxModelInitialization : public initialize
     #endif
 
     std::string GetTimeName(const char *pszVariable);
+
+    static double readWarpedBand( const std::string &srcName, const std::string &srcWkt,
+                                  const std::string &dstWkt, int nBand, AsciiGrid<double> &grid );
+    static GDALDataset* createWarpedVRT( GDALDataset *srcDS, const std::string &srcWkt,
+                                         const std::string &dstWkt, int nBands,
+                                         const int *panBands, double &dfNoData );
     
     int wxModel_nLayers;
     int wxModel_nCols; //wx model ncols/nrows in reprojected coords (DEM space) after ndvs are stripped
@@ -186,6 +194,11 @@ class wxModelInitialization : public initialize
     GDALProgressFunc pfnProgress;
 
 private:
+    static bool getSharedTimeList( const std::string &osKey,
+                                   std::vector<blt::local_date_time> &timeList );
+    static void setSharedTimeList( const std::string &osKey,
+                                   const std::vector<blt::local_date_time> &timeList );
+
     void interpolateWxGridsToNinjaGrids(WindNinjaInputs& input);
 
     void initializeWindFrom3dData(WindNinjaInputs &input,
@@ -212,4 +225,19 @@ private:
 
 };
 
+/**
+ * Shares the forecast time lists and warped variables between the runs
+ * started in its scope (see wxModelInitialization::setSharedForecastData()).
+ */
+class SharedForecastDataScope
+{
+public:
+    SharedForecastDataScope() { wxModelInitialization::setSharedForecastData( true ); }
+    ~SharedForecastDataScope() { wxModelInitialization::setSharedForecastData( false ); }
+
+private:
+    SharedForecastDataScope( const SharedForecastDataScope & );
+    SharedForecastDataScope &operator=( const SharedForecastDataScope & );
+};
+
 #endif /* WX_MODEL_INITIALIZATION_H */